@@ -226,7 +226,7 @@ bool convertGdalRaster(GDALDataset* dataset, gis::Crit3DRasterGrid* myRaster, in
     }
     else
     {
-        updateMinMaxRasterGrid(myRaster);
+        updateMinMaxRasterGrid(myRaster, false);
     }
 
     return true;
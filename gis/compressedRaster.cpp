@@ -0,0 +1,528 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "mappedFile.h"
+#include "compressedRaster.h"
+
+
+/*
+ * file format (native byte order)
+ * magic "CRIT3DCR", version
+ * nrRows, nrCols, blockRows (int32)
+ * cellSize, llCorner.x, llCorner.y (double), flag (float), quantizationStep (double, 0 = lossless)
+ * block table: offsets (uint64) and sizes (uint32) of the blocks of blockRows rows
+ * blocks: see compressFloatBlock
+*/
+
+static const char COMPRESSED_RASTER_MAGIC[8] = {'C','R','I','T','3','D','C','R'};
+static const int32_t COMPRESSED_RASTER_VERSION = 2;
+
+static const uint8_t BLOCK_LOSSLESS = 0;
+static const uint8_t BLOCK_QUANTIZED = 1;
+static const int32_t QUANTIZED_NODATA = INT32_MIN;
+
+
+namespace gis
+{
+    /*!
+     * \brief packBits
+     * byte oriented run length coding: control byte c < 128: c + 1 literal bytes follow,
+     * otherwise a run of (c & 0x7F) + 3 equal bytes (one byte follows)
+     */
+    static void packBits(const uint8_t* data, size_t n, std::vector<char> &buffer)
+    {
+        size_t i = 0;
+        while (i < n)
+        {
+            size_t run = 1;
+            while (i + run < n && run < 130 && data[i + run] == data[i])
+                run++;
+
+            if (run >= 3)
+            {
+                buffer.push_back(char(0x80 | (run - 3)));
+                buffer.push_back(char(data[i]));
+                i += run;
+            }
+            else
+            {
+                size_t start = i;
+                size_t count = 0;
+                while (i < n && count < 128)
+                {
+                    if (i + 2 < n && data[i] == data[i + 1] && data[i] == data[i + 2])
+                        break;
+                    i++;
+                    count++;
+                }
+
+                buffer.push_back(char(count - 1));
+                buffer.insert(buffer.end(), reinterpret_cast<const char*>(data + start),
+                              reinterpret_cast<const char*>(data + start + count));
+            }
+        }
+    }
+
+
+    static bool unpackBits(const char* data, size_t nrBytes, uint8_t* output, size_t n)
+    {
+        size_t pos = 0;
+        size_t i = 0;
+        while (pos < nrBytes && i < n)
+        {
+            uint8_t c = uint8_t(data[pos++]);
+            if (c & 0x80)
+            {
+                size_t run = size_t(c & 0x7F) + 3;
+                if (pos >= nrBytes || i + run > n)
+                    return false;
+
+                std::memset(output + i, uint8_t(data[pos++]), run);
+                i += run;
+            }
+            else
+            {
+                size_t count = size_t(c) + 1;
+                if (pos + count > nrBytes || i + count > n)
+                    return false;
+
+                std::memcpy(output + i, data + pos, count);
+                pos += count;
+                i += count;
+            }
+        }
+
+        return (i == n && pos == nrBytes);
+    }
+
+
+    static inline uint32_t zigzagEncode(uint32_t difference)
+    {
+        return (difference << 1) ^ uint32_t(int32_t(difference) >> 31);
+    }
+
+    static inline uint32_t zigzagDecode(uint32_t code)
+    {
+        return (code >> 1) ^ (0u - (code & 1u));
+    }
+
+
+    /*!
+     * \brief getPrediction
+     * planar prediction (left + upper - upper left) of the word i from the previous ones of the block,
+     * left or upper value on the first row and column
+     */
+    static inline uint32_t getPrediction(const std::vector<uint32_t> &words, size_t i, size_t nrCols)
+    {
+        if (i < nrCols)
+            return (i > 0) ? words[i - 1] : 0;
+
+        if (i % nrCols == 0)
+            return words[i - nrCols];
+
+        return words[i - 1] + words[i - nrCols] - words[i - nrCols - 1];
+    }
+
+
+    /*!
+     * \brief compressFloatBlock
+     * compress a block of values (row major, nrCols columns):
+     * mode (uint8), then the 4 byte planes of the 32 bit residuals (from the least significant),
+     * each one as size (uint32) and PackBits data.
+     * The words are the float bits (lossless) or the codes round(value / quantizationStep) if quantizationStep > 0
+     * and all the codes fit in 32 bit (flag = INT32_MIN); the residuals are the zigzag differences
+     * from the planar prediction (see getPrediction)
+     */
+    void compressFloatBlock(const std::vector<float> &values, int nrCols, float flag, double quantizationStep,
+                            std::vector<char> &buffer)
+    {
+        const size_t nrValues = values.size();
+        std::vector<uint32_t> words(nrValues);
+
+        uint8_t mode = BLOCK_LOSSLESS;
+        if (quantizationStep > 0)
+        {
+            mode = BLOCK_QUANTIZED;
+            for (size_t i = 0; i < nrValues; i++)
+            {
+                if (isEqual(values[i], flag))
+                {
+                    words[i] = uint32_t(QUANTIZED_NODATA);
+                    continue;
+                }
+
+                double code = std::round(double(values[i]) / quantizationStep);
+                if (! (fabs(code) < double(INT32_MAX)))
+                {
+                    mode = BLOCK_LOSSLESS;
+                    break;
+                }
+                words[i] = uint32_t(int32_t(code));
+            }
+        }
+
+        if (mode == BLOCK_LOSSLESS && nrValues > 0)
+            std::memcpy(words.data(), values.data(), nrValues * sizeof(float));
+
+        // residuals, from the last value (the predictions are not modified)
+        for (size_t i = nrValues; i-- > 0; )
+            words[i] = zigzagEncode(words[i] - getPrediction(words, i, size_t(nrCols)));
+
+        // byte shuffle and run length coding of each plane
+        buffer.clear();
+        buffer.push_back(char(mode));
+
+        std::vector<uint8_t> plane(nrValues);
+        for (int b = 0; b < 4; b++)
+        {
+            for (size_t i = 0; i < nrValues; i++)
+                plane[i] = uint8_t(words[i] >> (8 * b));
+
+            size_t sizePosition = buffer.size();
+            buffer.resize(sizePosition + sizeof(uint32_t));
+            packBits(plane.data(), nrValues, buffer);
+
+            uint32_t planeBytes = uint32_t(buffer.size() - sizePosition - sizeof(uint32_t));
+            std::memcpy(&buffer[sizePosition], &planeBytes, sizeof(uint32_t));
+        }
+    }
+
+
+    /*!
+     * \brief decompressFloatBlock
+     * values must be already sized (number of values of the block)
+     */
+    bool decompressFloatBlock(const char* data, size_t nrBytes, int nrCols, float flag, double quantizationStep,
+                              std::vector<float> &values)
+    {
+        const size_t nrValues = values.size();
+
+        if (nrBytes < 1 || nrCols <= 0 || nrValues % size_t(nrCols) != 0)
+            return false;
+
+        uint8_t mode = uint8_t(data[0]);
+        if (mode != BLOCK_LOSSLESS && (mode != BLOCK_QUANTIZED || quantizationStep <= 0))
+            return false;
+
+        std::vector<uint32_t> words(nrValues, 0);
+        std::vector<uint8_t> plane(nrValues);
+
+        size_t pos = 1;
+        for (int b = 0; b < 4; b++)
+        {
+            uint32_t planeBytes;
+            if (pos + sizeof(uint32_t) > nrBytes)
+                return false;
+            std::memcpy(&planeBytes, data + pos, sizeof(uint32_t));
+            pos += sizeof(uint32_t);
+
+            if (pos + planeBytes > nrBytes || ! unpackBits(data + pos, planeBytes, plane.data(), nrValues))
+                return false;
+            pos += planeBytes;
+
+            for (size_t i = 0; i < nrValues; i++)
+                words[i] |= uint32_t(plane[i]) << (8 * b);
+        }
+
+        for (size_t i = 0; i < nrValues; i++)
+            words[i] = getPrediction(words, i, size_t(nrCols)) + zigzagDecode(words[i]);
+
+        if (mode == BLOCK_LOSSLESS)
+        {
+            if (nrValues > 0)
+                std::memcpy(values.data(), words.data(), nrValues * sizeof(float));
+            return true;
+        }
+
+        for (size_t i = 0; i < nrValues; i++)
+        {
+            int32_t code = int32_t(words[i]);
+            values[i] = (code == QUANTIZED_NODATA) ? flag : float(double(code) * quantizationStep);
+        }
+
+        return true;
+    }
+
+
+    // rows [firstRow, lastRow) of the raster
+    static void encodeBlock(const Crit3DRasterGrid &rasterGrid, int firstRow, int lastRow, double quantizationStep,
+                            std::vector<char> &buffer)
+    {
+        const size_t nrCols = size_t(rasterGrid.header->nrCols);
+        std::vector<float> values(size_t(lastRow - firstRow) * nrCols);
+
+        for (int row = firstRow; row < lastRow; row++)
+            std::memcpy(&values[size_t(row - firstRow) * nrCols], rasterGrid.value[row], nrCols * sizeof(float));
+
+        compressFloatBlock(values, int(nrCols), rasterGrid.header->flag, quantizationStep, buffer);
+    }
+
+
+    static bool decodeBlock(const char* data, size_t nrBytes, int firstRow, int lastRow, double quantizationStep,
+                            Crit3DRasterGrid &rasterGrid)
+    {
+        const size_t nrCols = size_t(rasterGrid.header->nrCols);
+        std::vector<float> values(size_t(lastRow - firstRow) * nrCols);
+
+        if (! decompressFloatBlock(data, nrBytes, int(nrCols), rasterGrid.header->flag, quantizationStep, values))
+            return false;
+
+        for (int row = firstRow; row < lastRow; row++)
+            std::memcpy(rasterGrid.value[row], &values[size_t(row - firstRow) * nrCols], nrCols * sizeof(float));
+
+        return true;
+    }
+
+
+    /*!
+     * \brief writeCompressedRaster
+     * write the raster in blocks of COMPRESSED_RASTER_BLOCKROWS rows, compressed in parallel.
+     * quantizationStep = 0: lossless (same float values),
+     * quantizationStep > 0: lossy, maximum error quantizationStep / 2 (plus the float rounding).
+     * The file is written in a temporary file which then replaces fileName
+     */
+    bool writeCompressedRaster(const std::string &fileName, const Crit3DRasterGrid &rasterGrid, double quantizationStep,
+                               bool isParallelComputing, std::string &errorStr)
+    {
+        if (! rasterGrid.isLoaded || rasterGrid.header->nrRows <= 0 || rasterGrid.header->nrCols <= 0
+            || quantizationStep < 0)
+        {
+            errorStr = "Wrong data for compressed raster file.";
+            return false;
+        }
+
+        const std::string tmpFileName = fileName + ".tmp";
+        std::ofstream outFile(tmpFileName, std::ios::binary | std::ios::trunc);
+        if (! outFile.is_open())
+        {
+            errorStr = "Error in writing file: " + tmpFileName;
+            return false;
+        }
+
+        const Crit3DRasterHeader &header = *(rasterGrid.header);
+        int32_t nrRows = header.nrRows;
+        int32_t nrCols = header.nrCols;
+        int32_t blockRows = COMPRESSED_RASTER_BLOCKROWS;
+        int nrBlocks = (nrRows + blockRows - 1) / blockRows;
+
+        outFile.write(COMPRESSED_RASTER_MAGIC, sizeof(COMPRESSED_RASTER_MAGIC));
+        outFile.write(reinterpret_cast<const char*>(&COMPRESSED_RASTER_VERSION), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrRows), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrCols), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&blockRows), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&(header.cellSize)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.llCorner.x)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.llCorner.y)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.flag)), sizeof(float));
+        outFile.write(reinterpret_cast<const char*>(&quantizationStep), sizeof(double));
+
+        std::vector<std::vector<char>> buffers(static_cast<size_t>(nrBlocks));
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int block = 0; block < nrBlocks; block++)
+        {
+            int firstRow = block * blockRows;
+            int lastRow = std::min(firstRow + blockRows, nrRows);
+            encodeBlock(rasterGrid, firstRow, lastRow, quantizationStep, buffers[unsigned(block)]);
+        }
+
+        // block table
+        uint64_t offset = uint64_t(outFile.tellp()) + uint64_t(nrBlocks) * (sizeof(uint64_t) + sizeof(uint32_t));
+        std::vector<uint64_t> blockOffset;
+        std::vector<uint32_t> blockBytes;
+        blockOffset.resize(unsigned(nrBlocks));
+        blockBytes.resize(unsigned(nrBlocks));
+        for (unsigned block = 0; block < unsigned(nrBlocks); block++)
+        {
+            blockOffset[block] = offset;
+            blockBytes[block] = uint32_t(buffers[block].size());
+            offset += blockBytes[block];
+        }
+
+        outFile.write(reinterpret_cast<const char*>(blockOffset.data()), std::streamsize(blockOffset.size() * sizeof(uint64_t)));
+        outFile.write(reinterpret_cast<const char*>(blockBytes.data()), std::streamsize(blockBytes.size() * sizeof(uint32_t)));
+
+        for (unsigned block = 0; block < unsigned(nrBlocks); block++)
+            outFile.write(buffers[block].data(), std::streamsize(buffers[block].size()));
+
+        outFile.close();
+        if (! outFile.good())
+        {
+            errorStr = "Error in writing file: " + tmpFileName;
+            remove(tmpFileName.c_str());
+            return false;
+        }
+
+        if (! replaceFile(tmpFileName, fileName))
+        {
+            errorStr = "Error replacing file: " + fileName;
+            remove(tmpFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief readCompressedRaster
+     * the blocks are decompressed in parallel if isParallelComputing
+     */
+    bool readCompressedRaster(const std::string &fileName, Crit3DRasterGrid *rasterGrid, bool isParallelComputing,
+                              std::string &errorStr)
+    {
+        if (rasterGrid == nullptr)
+        {
+            errorStr = "Invalid raster grid.";
+            return false;
+        }
+
+        rasterGrid->clear();
+
+        Crit3DMappedFile file;
+        if (! file.open(fileName, errorStr))
+            return false;
+
+        const char* data = file.data();
+        size_t dataSize = file.size();
+
+        // header
+        size_t pos = 0;
+        auto readData = [data, dataSize, &pos](void* ptr, size_t size)
+        {
+            if (pos + size > dataSize)
+                return false;
+            std::memcpy(ptr, data + pos, size);
+            pos += size;
+            return true;
+        };
+
+        char magic[8];
+        int32_t version, nrRows, nrCols, blockRows;
+        double cellSize, xll, yll, quantizationStep;
+        float flag;
+
+        if (! readData(magic, sizeof(magic)) || std::memcmp(magic, COMPRESSED_RASTER_MAGIC, sizeof(magic)) != 0
+            || ! readData(&version, sizeof(version)) || version != COMPRESSED_RASTER_VERSION
+            || ! readData(&nrRows, sizeof(int32_t)) || ! readData(&nrCols, sizeof(int32_t))
+            || ! readData(&blockRows, sizeof(int32_t))
+            || ! readData(&cellSize, sizeof(double)) || ! readData(&xll, sizeof(double))
+            || ! readData(&yll, sizeof(double)) || ! readData(&flag, sizeof(float))
+            || ! readData(&quantizationStep, sizeof(double))
+            || nrRows <= 0 || nrCols <= 0 || blockRows <= 0 || cellSize <= 0 || quantizationStep < 0)
+        {
+            errorStr = "Wrong compressed raster file: " + fileName;
+            return false;
+        }
+
+        int nrBlocks = (nrRows + blockRows - 1) / blockRows;
+        std::vector<uint64_t> blockOffset;
+        std::vector<uint32_t> blockBytes;
+        blockOffset.resize(unsigned(nrBlocks));
+        blockBytes.resize(unsigned(nrBlocks));
+        if (! readData(blockOffset.data(), blockOffset.size() * sizeof(uint64_t))
+            || ! readData(blockBytes.data(), blockBytes.size() * sizeof(uint32_t)))
+        {
+            errorStr = "Wrong compressed raster file: " + fileName;
+            return false;
+        }
+
+        for (unsigned block = 0; block < unsigned(nrBlocks); block++)
+        {
+            if (blockOffset[block] + blockBytes[block] > dataSize)
+            {
+                errorStr = "Wrong compressed raster file: " + fileName;
+                return false;
+            }
+        }
+
+        Crit3DRasterHeader header;
+        header.nrRows = nrRows;
+        header.nrCols = nrCols;
+        header.cellSize = cellSize;
+        header.invCellSize = 1. / cellSize;
+        header.llCorner.x = xll;
+        header.llCorner.y = yll;
+        header.flag = flag;
+
+        if (! rasterGrid->initializeGrid(header))
+        {
+            errorStr = "Memory error: file too big.";
+            return false;
+        }
+
+        int isError = 0;
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int block = 0; block < nrBlocks; block++)
+        {
+            int firstRow = block * blockRows;
+            int lastRow = std::min(firstRow + blockRows, nrRows);
+            if (! decodeBlock(data + blockOffset[unsigned(block)], blockBytes[unsigned(block)],
+                              firstRow, lastRow, quantizationStep, *rasterGrid))
+            {
+                #pragma omp atomic write
+                isError = 1;
+            }
+        }
+
+        if (isError)
+        {
+            rasterGrid->clear();
+            errorStr = "Wrong compressed raster file: " + fileName;
+            return false;
+        }
+
+        updateMinMaxRasterGrid(rasterGrid, isParallelComputing);
+        rasterGrid->isLoaded = true;
+
+        return true;
+    }
+
+
+    /*!
+     * \brief convertToCompressedRaster
+     * convert a raster (.flt, .asc, .bil, .img, .tgr) to the compressed format
+     */
+    bool convertToCompressedRaster(const std::string &inputFileName, const std::string &outputFileName,
+                                   int currentUtmZone, double quantizationStep, bool isParallelComputing,
+                                   std::string &errorStr)
+    {
+        Crit3DRasterGrid rasterGrid;
+        if (! openRaster(inputFileName, &rasterGrid, currentUtmZone, isParallelComputing, errorStr))
+            return false;
+
+        return writeCompressedRaster(outputFileName, rasterGrid, quantizationStep, isParallelComputing, errorStr);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef COMPRESSEDRASTER_H
+#define COMPRESSEDRASTER_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    #define COMPRESSED_RASTER_BLOCKROWS 64
+
+    namespace gis
+    {
+        void compressFloatBlock(const std::vector<float> &values, int nrCols, float flag, double quantizationStep,
+                                std::vector<char> &buffer);
+
+        bool decompressFloatBlock(const char* data, size_t nrBytes, int nrCols, float flag, double quantizationStep,
+                                  std::vector<float> &values);
+
+        bool writeCompressedRaster(const std::string &fileName, const Crit3DRasterGrid &rasterGrid, double quantizationStep,
+                                   bool isParallelComputing, std::string &errorStr);
+
+        bool readCompressedRaster(const std::string &fileName, Crit3DRasterGrid *rasterGrid, bool isParallelComputing,
+                                  std::string &errorStr);
+
+        bool convertToCompressedRaster(const std::string &inputFileName, const std::string &outputFileName,
+                                       int currentUtmZone, double quantizationStep, bool isParallelComputing,
+                                       std::string &errorStr);
+    }
+
+
+#endif // COMPRESSEDRASTER_H
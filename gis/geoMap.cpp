@@ -110,9 +110,10 @@ namespace gis
     }
 
 
-    bool updateColorScale(Crit3DRasterGrid* myGrid, const Crit3DRasterWindow& myWindow)
+    bool updateColorScale(Crit3DRasterGrid* myGrid, const Crit3DRasterWindow& myWindow, bool isParallelComputing)
     {
-        return updateColorScale(myGrid, myWindow.v[0].row, myWindow.v[0].col, myWindow.v[1].row, myWindow.v[1].col);
+        return updateColorScale(myGrid, myWindow.v[0].row, myWindow.v[0].col, myWindow.v[1].row, myWindow.v[1].col,
+                                isParallelComputing);
     }
 
     bool getUtmWindow(const Crit3DLatLonHeader& latLonHeader, const Crit3DRasterHeader& utmHeader,
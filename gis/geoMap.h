@@ -57,7 +57,7 @@
         };
 
 
-        bool updateColorScale(Crit3DRasterGrid* myGrid, const Crit3DRasterWindow& myWindow);
+        bool updateColorScale(Crit3DRasterGrid* myGrid, const Crit3DRasterWindow& myWindow, bool isParallelComputing);
         bool getUtmWindow(const Crit3DLatLonHeader& latLonHeader, const Crit3DRasterHeader& utmHeader,
                           const Crit3DRasterWindow& latLonWindow, Crit3DRasterWindow* utmWindow, int utmZone);
 
@@ -27,13 +27,18 @@
 
 #include <math.h>
 #include <algorithm>
-#include <set>
 #include <unordered_set>
+#include <cstring>
+#include <new>
 
 #include "commonConstants.h"
 #include "basicMath.h"
 #include "statistics.h"
 #include "gis.h"
+#include "mappedFile.h"
+#include "rasterExpression.h"
+#include "rasterStatistics.h"
+#include "resamplePlan.h"
 
 namespace gis
 {
@@ -253,6 +258,8 @@ namespace gis
         minimum = NODATA;
         maximum = NODATA;
         value = nullptr;
+        _data = nullptr;
+        _stride = 0;
     }
 
 
@@ -262,18 +269,102 @@ namespace gis
     }
 
 
-    void Crit3DRasterGrid::clear()
+    /*!
+     * \brief allocateData
+     * single aligned buffer for all the values, value[row] points to the rows
+     */
+    bool Crit3DRasterGrid::allocateData()
     {
-        if (value != nullptr && header->nrRows > 0)
+        freeData();
+
+        if (header->nrRows < 0 || header->nrCols < 0)
+            return false;
+
+        _stride = size_t(header->nrCols);
+        size_t nrBytes = std::max(size_t(header->nrRows) * _stride * sizeof(float), size_t(RASTER_DATA_ALIGNMENT));
+
+        _data = static_cast<float*>(::operator new[](nrBytes, std::align_val_t(RASTER_DATA_ALIGNMENT), std::nothrow));
+        if (_data == nullptr)
+            return false;
+
+        value = new (std::nothrow) float*[size_t(header->nrRows) + 1];
+        if (value == nullptr)
         {
-            for (int row = 0; row < header->nrRows; row++)
-                if (value[row] != nullptr)
-                    delete [] value[row];
+            freeData();
+            return false;
+        }
+
+        for (int row = 0; row < header->nrRows; row++)
+            value[row] = _data + size_t(row) * _stride;
 
+        return true;
+    }
+
+
+    void Crit3DRasterGrid::freeData()
+    {
+        if (value != nullptr)
+        {
             delete [] value;
             value = nullptr;
         }
 
+        if (_mappedFile != nullptr)
+        {
+            _mappedFile.reset();
+            _data = nullptr;
+        }
+        else if (_data != nullptr)
+        {
+            ::operator delete[](_data, std::align_val_t(RASTER_DATA_ALIGNMENT));
+            _data = nullptr;
+        }
+
+        _stride = 0;
+    }
+
+
+    /*!
+     * \brief mapFloatData
+     * the values are a copy-on-write view of the file (native float32, row major, starting at offset):
+     * the pages are read on demand and a page becomes a private copy when it is modified.
+     * The header must be already set. Returns false (and the grid is not allocated) if the file can not be mapped
+     */
+    bool Crit3DRasterGrid::mapFloatData(const std::string &fileName, size_t offset)
+    {
+        freeData();
+
+        if (header->nrRows <= 0 || header->nrCols <= 0 || offset % RASTER_DATA_ALIGNMENT != 0)
+            return false;
+
+        std::shared_ptr<Crit3DMappedFile> mappedFile = std::make_shared<Crit3DMappedFile>();
+        std::string errorStr;
+        if (! mappedFile->open(fileName, errorStr))
+            return false;
+
+        size_t nrBytes = size_t(header->nrRows) * size_t(header->nrCols) * sizeof(float);
+        if (mappedFile->size() < offset + nrBytes)
+            return false;
+
+        value = new (std::nothrow) float*[size_t(header->nrRows) + 1];
+        if (value == nullptr)
+            return false;
+
+        _mappedFile = mappedFile;
+        _data = reinterpret_cast<float*>(mappedFile->data() + offset);
+        _stride = size_t(header->nrCols);
+
+        for (int row = 0; row < header->nrRows; row++)
+            value[row] = _data + size_t(row) * _stride;
+
+        return true;
+    }
+
+
+    void Crit3DRasterGrid::clear()
+    {
+        freeData();
+
         mapTime.setNullTime();
         minimum = NODATA;
         maximum = NODATA;
@@ -292,25 +383,18 @@ namespace gis
     // clean the grid (set all NO DATA)
     void Crit3DRasterGrid::emptyGrid()
     {
-        for (int row = 0; row < header->nrRows; row++)
-            for (int col = 0; col < header->nrCols; col++)
-                value[row][col] = header->flag;
+        if (_data != nullptr)
+            std::fill(_data, _data + getNrCells(), header->flag);
     }
 
 
     bool Crit3DRasterGrid::initializeGrid()
     {
-        this->value = new float*[unsigned(this->header->nrRows)];
-
-        for (int row = 0; row < this->header->nrRows; row++)
+        if (! allocateData())
         {
-            this->value[row] = new float[unsigned(this->header->nrCols)];
-            if (this->value[row] == nullptr)
-            {
-                // Memory error: file too big
-                this->clear();
-                return false;
-            }
+            // Memory error: file too big
+            this->clear();
+            return false;
         }
 
         isLoaded = true;
@@ -373,9 +457,8 @@ namespace gis
 
     void Crit3DRasterGrid::setConstantValue(float initValue)
     {
-        for (int row = 0; row < this->header->nrRows; row++)
-            for (int col = 0; col < header->nrCols; col++)
-                value[row][col] = initValue;
+        if (_data != nullptr)
+            std::fill(_data, _data + getNrCells(), initValue);
 
         this->minimum = initValue;
         this->maximum = initValue;
@@ -389,13 +472,13 @@ namespace gis
         *(header) = *(initGrid.header);
         *(colorScale) = *(initGrid.colorScale);
 
-        initializeGrid();
+        if (! initializeGrid())
+            return false;
 
-        for (int row = 0; row < header->nrRows; row++)
-            for (int col = 0; col < header->nrCols; col++)
-                    value[row][col] = initGrid.value[row][col];
+        if (initGrid.data() != nullptr)
+            std::memcpy(_data, initGrid.data(), getNrCells() * sizeof(float));
 
-        gis::updateMinMaxRasterGrid(this);
+        gis::updateMinMaxRasterGrid(this, false);
         isLoaded = true;
         return true;
     }
@@ -414,7 +497,7 @@ namespace gis
                 if (! isEqual(initGrid.value[row][col], initGrid.header->flag))
                     this->value[row][col] = initValue;
 
-        return gis::updateMinMaxRasterGrid(this);
+        return gis::updateMinMaxRasterGrid(this, false);
     }
 
 
@@ -566,100 +649,44 @@ namespace gis
     }
 
 
-    bool updateMinMaxRasterGrid(Crit3DRasterGrid* myGrid)
+    /*!
+     * \brief updateMinMaxRasterGrid
+     * isParallelComputing: large rasters are scanned in parallel (false inside parallel regions)
+     */
+    bool updateMinMaxRasterGrid(Crit3DRasterGrid* myGrid, bool isParallelComputing)
     {
-        int nRows = myGrid->header->nrRows;
-        int nCols = myGrid->header->nrCols;
-        float flag = myGrid->header->flag;
-
-        bool isFirstValue = true;
-        float minimum = NODATA;
-        float maximum = NODATA;
-
-        for (int row = 0; row < nRows; row++)
-        {
-            float* rowPtr = myGrid->value[row];
-            for (int col = 0; col < nCols; col++)
-            {
-                float value = rowPtr[col];
-                if (!isEqual(value, flag) && !isEqual(value, NODATA))
-                {
-                    if (isFirstValue)
-                    {
-                        minimum = maximum = value;
-                        isFirstValue = false;
-                    }
-                    else
-                    {
-                        if (value < minimum) minimum = value;
-                        else if (value > maximum) maximum = value;
-                    }
-                }
-            }
-        }
+        Crit3DRasterStatistics statistics;
+        bool isParallel = isParallelComputing && (myGrid->getNrCells() >= RASTER_STATISTICS_PARALLEL_CELLS);
 
         /*!  no values */
-        if (isFirstValue)
+        if (! statistics.compute(*myGrid, isParallel) || statistics.nrValues == 0)
             return false;
 
-        myGrid->maximum = maximum;
-        myGrid->minimum = minimum;
+        myGrid->maximum = statistics.maximum;
+        myGrid->minimum = statistics.minimum;
 
         if (! myGrid->colorScale->isFixedRange())
         {
-            myGrid->colorScale->setRange(minimum, maximum);
+            myGrid->colorScale->setRange(statistics.minimum, statistics.maximum);
         }
 
         return true;
     }
 
 
-    bool updateColorScale(Crit3DRasterGrid* myGrid, int row0, int col0, int row1, int col1)
+    bool updateColorScale(Crit3DRasterGrid* myGrid, int row0, int col0, int row1, int col1, bool isParallelComputing)
     {
-        float myValue;
-        bool isFirstValue = true;
-        float minimum = NODATA;
-        float maximum = NODATA;
-
-        if (row0 > row1)
-        {
-            int tmp = row0;
-            row0 = row1;
-            row1 = tmp;
-        }
-        row0 = std::max(row0, int(0));
-        col0 = std::max(col0, int(0));
-        row1 = std::min(row1, myGrid->header->nrRows-1);
-        col1 = std::min(col1, myGrid->header->nrCols-1);
-
-        for (int row = row0; row <= row1; row++)
-            for (int col = col0; col <= col1; col++)
-            {
-                myValue = myGrid->value[row][col];
-                if (! isEqual(myValue, myGrid->header->flag) && ! isEqual(myValue, NODATA))
-                {
-                    if (isFirstValue)
-                    {
-                        minimum = myValue;
-                        maximum = myValue;
-                        isFirstValue = false;
-                    }
-                    else
-                    {
-                        if (myValue < minimum) minimum = myValue;
-                        else if (myValue > maximum) maximum = myValue;
-                    }
-                }
-            }
+        Crit3DRasterStatistics statistics;
+        bool isParallel = isParallelComputing && (myGrid->getNrCells() >= RASTER_STATISTICS_PARALLEL_CELLS);
 
         //  no values
-        if (isFirstValue)
+        if (! statistics.compute(*myGrid, row0, col0, row1, col1, isParallel) || statistics.nrValues == 0)
         {
             myGrid->colorScale->setRange(NODATA, NODATA);
             return false;
         }
 
-        myGrid->colorScale->setRange(minimum, maximum);
+        myGrid->colorScale->setRange(statistics.minimum, statistics.maximum);
 
         return true;
     }
@@ -855,6 +882,31 @@ namespace gis
     }
 
 
+    /*!
+     * \brief getUtmZoneNumber
+     * \param lat in decimal degrees
+     * \param lonTemp in decimal degrees [-180, 180)
+     * \return UTM zone of the point, with the special zones for Norway and Svalbard
+     */
+    static int getUtmZoneNumber(double lat, double lonTemp)
+    {
+        int zoneNumber = int(ceil((lonTemp + 180.) / 6.));
+
+        //!<  Special zones for Norway: */
+        if ((lat >= 56.0) && (lat < 64.0) && (lonTemp >= 3.0) && (lonTemp < 12.0)) zoneNumber = 32 ;
+        //!<  Special zones for Svalbard: */
+        if ((lat >= 72.0)&&(lat < 84.0))
+        {
+            if ((lonTemp >= 0) && (lonTemp < 9.0)) zoneNumber = 31;
+            else if ((lonTemp >= 9.0)&& (lonTemp < 21.0)) zoneNumber = 33;
+            else if ((lonTemp >= 21.0)&& ( lonTemp < 33.0)) zoneNumber = 35;
+            else if ((lonTemp >= 33.0)&& (lonTemp < 42.0)) zoneNumber = 3;
+        }
+
+        return zoneNumber;
+    }
+
+
     /*!
      * \brief Converts lat/int to UTM coords.  Equations from USGS Bulletin 1532.
      * Source:
@@ -883,18 +935,7 @@ namespace gis
 
         latRad = lat * DEG_TO_RAD ;
         lonRad = lonTemp * DEG_TO_RAD ;
-        *zoneNumber = int(ceil((lonTemp + 180.) / 6.));
-
-        //!<  Special zones for Norway: */
-        if ((lat >= 56.0) && (lat < 64.0) && (lonTemp >= 3.0) && (lonTemp < 12.0)) (*zoneNumber) = 32 ;
-        //!<  Special zones for Svalbard: */
-        if ((lat >= 72.0)&&(lat < 84.0))
-        {
-            if ((lonTemp >= 0) && (lonTemp < 9.0)) (*zoneNumber) = 31;
-            else if ((lonTemp >= 9.0)&& (lonTemp < 21.0)) (*zoneNumber) = 33;
-            else if ((lonTemp >= 21.0)&& ( lonTemp < 33.0)) (*zoneNumber) = 35;
-            else if ((lonTemp >= 33.0)&& (lonTemp < 42.0)) (*zoneNumber) = 3;
-        }
+        *zoneNumber = getUtmZoneNumber(lat, lonTemp);
 
         //!<  puts origin in middle of zone */
         lonOrigin = ((*zoneNumber) - 1.) * 6. - 180. + 3.;
@@ -1063,6 +1104,275 @@ namespace gis
     }
 
 
+    /*!
+     * \brief The UtmSeries struct
+     * coefficients of the USGS Bulletin 1532 series on the reference ellipsoid, computed once
+     */
+    struct UtmSeries
+    {
+        double k0, ae, eccSquared, eccPrimeSquared;
+        double m0, m2, m4, m6;              // meridian arc
+        double phi2, phi4, phi6;            // footpoint latitude
+
+        UtmSeries()
+        {
+            Crit3DEllipsoid referenceEllipsoid;
+            k0 = 0.9996;
+            ae = referenceEllipsoid.equatorialRadius;
+            eccSquared = referenceEllipsoid.eccentricitySquared;
+            eccPrimeSquared = eccSquared / (1. - eccSquared);
+
+            double e4 = eccSquared * eccSquared;
+            double e6 = e4 * eccSquared;
+            m0 = 1. - eccSquared / 4. - 3. * e4 / 64. - 5. * e6 / 256.;
+            m2 = 3. * eccSquared / 8. + 3. * e4 / 32. + 45. * e6 / 1024.;
+            m4 = 15. * e4 / 256. + 45. * e6 / 1024.;
+            m6 = 35. * e6 / 3072.;
+
+            double e1 = (1. - sqrt(1. - eccSquared)) / (1. + sqrt(1. - eccSquared));
+            phi2 = 3. * e1 / 2. - 27. * e1 * e1 * e1 / 32.;
+            phi4 = 21. * e1 * e1 / 16. - 55. * e1 * e1 * e1 * e1 / 32.;
+            phi6 = 151. * e1 * e1 * e1 / 96.;
+        }
+    };
+
+    static const UtmSeries& getUtmSeries()
+    {
+        static const UtmSeries series;
+        return series;
+    }
+
+
+    /*!
+     * \brief sin(2x), sin(4x), sin(6x) from sin(x) and cos(x), without branches (vectorizable)
+     */
+    static inline void getMultipleAngleSines(double sinX, double cosX, double &sin2x, double &sin4x, double &sin6x)
+    {
+        sin2x = 2. * sinX * cosX;
+        double cos2x = (cosX - sinX) * (cosX + sinX);
+        sin4x = 2. * sin2x * cos2x;
+        double cos4x = (cos2x - sin2x) * (cos2x + sin2x);
+        sin6x = sin4x * cos2x + cos4x * sin2x;
+    }
+
+
+    /*!
+     * \brief same series of latLonToUtmForceZone, with a single sine and cosine of the latitude
+     */
+    static inline void latLonToUtmSeries(const UtmSeries &s, double lat, double lon, double lonOriginRad,
+                                         double &utmEasting, double &utmNorthing)
+    {
+        double lonTemp = (lon + 180.) - floor((lon + 180.) / 360.) * 360. - 180.;
+        double latRad = lat * DEG_TO_RAD;
+        double lonRad = lonTemp * DEG_TO_RAD;
+
+        double sinLat = sin(latRad);
+        double cosLat = cos(latRad);
+        double tanLat = sinLat / cosLat;
+        double sin2Lat, sin4Lat, sin6Lat;
+        getMultipleAngleSines(sinLat, cosLat, sin2Lat, sin4Lat, sin6Lat);
+
+        double n = s.ae / sqrt(1. - s.eccSquared * sinLat * sinLat);
+        double t = tanLat * tanLat;
+        double c = s.eccPrimeSquared * cosLat * cosLat;
+        double a = cosLat * (lonRad - lonOriginRad);
+        double a2 = a * a;
+
+        double m = s.ae * (s.m0 * latRad - s.m2 * sin2Lat + s.m4 * sin4Lat - s.m6 * sin6Lat);
+
+        utmEasting = s.k0 * n * (a + (1. - t + c) * a * a2 / 6.
+                     + (5. - 18. * t + t * t + 72. * c - 58. * s.eccPrimeSquared) * a * a2 * a2 / 120.)
+                     + 500000.;
+
+        utmNorthing = s.k0 * (m + n * tanLat * (a2 / 2.
+                      + (5. - t + 9. * c + 4. * c * c) * a2 * a2 / 24.
+                      + (61. - 58. * t + t * t + 600. * c - 330. * s.eccPrimeSquared) * a2 * a2 * a2 / 720.));
+
+        //!<  offset for southern hemisphere: */
+        utmNorthing += (lat < 0) ? 10000000. : 0.;
+    }
+
+
+    /*!
+     * \brief same series of utmToLatLon, with a single sine and cosine of mu and of the footpoint latitude
+     */
+    static inline void utmToLatLonSeries(const UtmSeries &s, double utmEasting, double utmNorthing,
+                                         double northingOffset, double lonOrigin, double &lat, double &lon)
+    {
+        double x = utmEasting - 500000.;
+        double y = utmNorthing - northingOffset;
+
+        double mu = y / s.k0 / (s.ae * s.m0);
+        double sin2Mu, sin4Mu, sin6Mu;
+        getMultipleAngleSines(sin(mu), cos(mu), sin2Mu, sin4Mu, sin6Mu);
+        double phi1Rad = mu + s.phi2 * sin2Mu + s.phi4 * sin4Mu + s.phi6 * sin6Mu;
+
+        double sinPhi = sin(phi1Rad);
+        double cosPhi = cos(phi1Rad);
+        double tanPhi = sinPhi / cosPhi;
+        double w = 1. - s.eccSquared * sinPhi * sinPhi;
+        double sqrtW = sqrt(w);
+
+        double n1 = s.ae / sqrtW;
+        double t1 = tanPhi * tanPhi;
+        double c1 = s.eccPrimeSquared * cosPhi * cosPhi;
+        double r1 = s.ae * (1. - s.eccSquared) / (w * sqrtW);
+        double d = x / (n1 * s.k0);
+        double d2 = d * d;
+
+        lat = phi1Rad - (n1 * tanPhi / r1) * (d2 / 2.
+              - (5. + 3. * t1 + 10. * c1 - 4. * c1 * c1 - 9. * s.eccPrimeSquared) * d2 * d2 / 24.
+              + (61. + 90. * t1 + 298. * c1 + 45. * t1 * t1 - 252. * s.eccPrimeSquared - 3. * c1 * c1) * d2 * d2 * d2 / 720.);
+
+        lon = (d - (1. + 2. * t1 + c1) * d * d2 / 6.
+              + (5. - 2. * c1 + 28. * t1 - 3. * c1 * c1 + 8. * s.eccPrimeSquared + 24. * t1 * t1) * d * d2 * d2 / 120.) / cosPhi;
+
+        lat *= RAD_TO_DEG;
+        lon = lon * RAD_TO_DEG + lonOrigin;
+    }
+
+
+    /*!
+     * \brief latLonToUtmForceZone on arrays of points (nrPoints values in each array)
+     * the zone constants are computed once, the points are converted in blocks (parallel) of vectorizable loops.
+     * The results match the scalar function to less than a micrometre
+     */
+    void latLonToUtmForceZone(int zoneNumber, const double *lat, const double *lon, double *utmEasting, double *utmNorthing,
+                              size_t nrPoints, bool isParallelComputing)
+    {
+        const UtmSeries &series = getUtmSeries();
+        double lonOriginRad = ((zoneNumber - 1.) * 6. - 180. + 3.) * DEG_TO_RAD;
+        long nrBlocks = long((nrPoints + UTM_BATCH_BLOCKSIZE - 1) / UTM_BATCH_BLOCKSIZE);
+
+        #pragma omp parallel for if (isParallelComputing && nrBlocks > 1)
+        for (long block = 0; block < nrBlocks; block++)
+        {
+            size_t first = size_t(block) * UTM_BATCH_BLOCKSIZE;
+            size_t last = std::min(first + UTM_BATCH_BLOCKSIZE, nrPoints);
+
+            #pragma omp simd
+            for (size_t i = first; i < last; i++)
+            {
+                latLonToUtmSeries(series, lat[i], lon[i], lonOriginRad, utmEasting[i], utmNorthing[i]);
+            }
+        }
+    }
+
+
+    /*!
+     * \brief latLonToUtm on arrays of points: the zone of each point is returned in zoneNumber
+     */
+    void latLonToUtm(const double *lat, const double *lon, double *utmEasting, double *utmNorthing, int *zoneNumber,
+                     size_t nrPoints, bool isParallelComputing)
+    {
+        const UtmSeries &series = getUtmSeries();
+        long nrBlocks = long((nrPoints + UTM_BATCH_BLOCKSIZE - 1) / UTM_BATCH_BLOCKSIZE);
+
+        #pragma omp parallel for if (isParallelComputing && nrBlocks > 1)
+        for (long block = 0; block < nrBlocks; block++)
+        {
+            size_t first = size_t(block) * UTM_BATCH_BLOCKSIZE;
+            size_t last = std::min(first + UTM_BATCH_BLOCKSIZE, nrPoints);
+
+            for (size_t i = first; i < last; i++)
+            {
+                double lonTemp = (lon[i] + 180.) - floor((lon[i] + 180.) / 360.) * 360. - 180.;
+                zoneNumber[i] = getUtmZoneNumber(lat[i], lonTemp);
+            }
+
+            #pragma omp simd
+            for (size_t i = first; i < last; i++)
+            {
+                double lonOriginRad = ((zoneNumber[i] - 1.) * 6. - 180. + 3.) * DEG_TO_RAD;
+                latLonToUtmSeries(series, lat[i], lon[i], lonOriginRad, utmEasting[i], utmNorthing[i]);
+            }
+        }
+    }
+
+
+    /*!
+     * \brief utmToLatLon on arrays of points (nrPoints values in each array)
+     * the zone constants are computed once, the points are converted in blocks (parallel) of vectorizable loops.
+     * The results match the scalar function to less than 1E-11 degrees
+     */
+    void utmToLatLon(int zoneNumber, double referenceLat, const double *utmEasting, const double *utmNorthing,
+                     double *lat, double *lon, size_t nrPoints, bool isParallelComputing)
+    {
+        const UtmSeries &series = getUtmSeries();
+        double lonOrigin = double(zoneNumber - 1.) * 6. - 180. + 3.;
+        double northingOffset = (referenceLat < 0) ? 10000000. : 0.;
+        long nrBlocks = long((nrPoints + UTM_BATCH_BLOCKSIZE - 1) / UTM_BATCH_BLOCKSIZE);
+
+        #pragma omp parallel for if (isParallelComputing && nrBlocks > 1)
+        for (long block = 0; block < nrBlocks; block++)
+        {
+            size_t first = size_t(block) * UTM_BATCH_BLOCKSIZE;
+            size_t last = std::min(first + UTM_BATCH_BLOCKSIZE, nrPoints);
+
+            #pragma omp simd
+            for (size_t i = first; i < last; i++)
+            {
+                utmToLatLonSeries(series, utmEasting[i], utmNorthing[i], northingOffset, lonOrigin, lat[i], lon[i]);
+            }
+        }
+    }
+
+
+    void getLatLonFromUtm(const Crit3DGisSettings& gisSettings, const std::vector<Crit3DUtmPoint> &utmPoints,
+                          std::vector<Crit3DGeoPoint> &geoPoints, bool isParallelComputing)
+    {
+        size_t nrPoints = utmPoints.size();
+        std::vector<double> x, y, lat, lon;
+        x.resize(nrPoints);
+        y.resize(nrPoints);
+        lat.resize(nrPoints);
+        lon.resize(nrPoints);
+
+        for (size_t i = 0; i < nrPoints; i++)
+        {
+            x[i] = utmPoints[i].x;
+            y[i] = utmPoints[i].y;
+        }
+
+        utmToLatLon(gisSettings.utmZone, gisSettings.startLocation.latitude, x.data(), y.data(),
+                    lat.data(), lon.data(), nrPoints, isParallelComputing);
+
+        geoPoints.resize(nrPoints);
+        for (size_t i = 0; i < nrPoints; i++)
+        {
+            geoPoints[i].latitude = lat[i];
+            geoPoints[i].longitude = lon[i];
+        }
+    }
+
+
+    void getUtmFromLatLon(int zoneNumber, const std::vector<Crit3DGeoPoint> &geoPoints,
+                          std::vector<Crit3DUtmPoint> &utmPoints, bool isParallelComputing)
+    {
+        size_t nrPoints = geoPoints.size();
+        std::vector<double> lat, lon, x, y;
+        lat.resize(nrPoints);
+        lon.resize(nrPoints);
+        x.resize(nrPoints);
+        y.resize(nrPoints);
+
+        for (size_t i = 0; i < nrPoints; i++)
+        {
+            lat[i] = geoPoints[i].latitude;
+            lon[i] = geoPoints[i].longitude;
+        }
+
+        latLonToUtmForceZone(zoneNumber, lat.data(), lon.data(), x.data(), y.data(), nrPoints, isParallelComputing);
+
+        utmPoints.resize(nrPoints);
+        for (size_t i = 0; i < nrPoints; i++)
+        {
+            utmPoints[i].x = x[i];
+            utmPoints[i].y = y[i];
+        }
+    }
+
+
     /*!
     * UTM zone:   [1,60]
     * Time zone:  [-12,12]
@@ -1080,29 +1390,45 @@ namespace gis
 
     bool computeLatLonMaps(const gis::Crit3DRasterGrid& myGrid,
                            gis::Crit3DRasterGrid* latMap, gis::Crit3DRasterGrid* lonMap,
-                           const gis::Crit3DGisSettings& gisSettings)
+                           const gis::Crit3DGisSettings& gisSettings, bool isParallelComputing)
     {
         if (! myGrid.isLoaded) return false;
 
-        double latDegrees, lonDegrees;
-        double utmX, utmY;
-
         latMap->initializeGrid(myGrid);
         lonMap->initializeGrid(myGrid);
 
+        // batch conversion of the valid cells of each row
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
         for (int row = 0; row < myGrid.header->nrRows; row++)
+        {
+            std::vector<int> cols;
+            std::vector<double> utmX, utmY, latDegrees, lonDegrees;
+            double x, y;
+
             for (int col = 0; col < myGrid.header->nrCols; col++)
                 if (! isEqual(myGrid.value[row][col], myGrid.header->flag))
                 {
-                    myGrid.getXY(row, col, utmX, utmY);
-                    getLatLonFromUtm(gisSettings, utmX, utmY, &latDegrees, &lonDegrees);
-
-                    latMap->value[row][col] = float(latDegrees);
-                    lonMap->value[row][col] = float(lonDegrees);
+                    myGrid.getXY(row, col, x, y);
+                    cols.push_back(col);
+                    utmX.push_back(x);
+                    utmY.push_back(y);
                 }
 
-        gis::updateMinMaxRasterGrid(latMap);
-        gis::updateMinMaxRasterGrid(lonMap);
+            size_t nrPoints = cols.size();
+            latDegrees.resize(nrPoints);
+            lonDegrees.resize(nrPoints);
+            utmToLatLon(gisSettings.utmZone, gisSettings.startLocation.latitude, utmX.data(), utmY.data(),
+                        latDegrees.data(), lonDegrees.data(), nrPoints, false);
+
+            for (size_t i = 0; i < nrPoints; i++)
+            {
+                latMap->value[row][cols[i]] = float(latDegrees[i]);
+                lonMap->value[row][cols[i]] = float(lonDegrees[i]);
+            }
+        }
+
+        gis::updateMinMaxRasterGrid(latMap, isParallelComputing);
+        gis::updateMinMaxRasterGrid(lonMap, isParallelComputing);
 
         latMap->isLoaded = true;
         lonMap->isLoaded = true;
@@ -1189,76 +1515,99 @@ namespace gis
     // Horn (3x3 standard)
     bool computeSlopeAspectMaps(const gis::Crit3DRasterGrid& dem,
                                 gis::Crit3DRasterGrid* slopeMap,
-                                gis::Crit3DRasterGrid* aspectMap)
+                                gis::Crit3DRasterGrid* aspectMap, bool isParallelComputing)
     {
         if (!dem.isLoaded || !slopeMap || !aspectMap)
             return false;
 
         const double cellSize = dem.header->cellSize;
+        const int nrRows = dem.header->nrRows;
+        const int nrCols = dem.header->nrCols;
 
         slopeMap->initializeGrid(dem);
         aspectMap->initializeGrid(dem);
 
         const float flag = dem.header->flag;
 
-        for (int row = 0; row < dem.header->nrRows; ++row)
+        #pragma omp parallel if (isParallelComputing)
         {
-            for (int col = 0; col < dem.header->nrCols; ++col)
-            {
-                const float z = dem.value[row][col];
+            std::vector<double> dzdxRow(size_t(nrCols), 0.);
+            std::vector<double> dzdyRow(size_t(nrCols), 0.);
 
-                if (isEqual(z, flag))
-                    continue;
+            #pragma omp for schedule(dynamic)
+            for (int row = 0; row < nrRows; ++row)
+            {
+                const bool isInnerRow = (row > 0 && row < nrRows - 1);
 
-                if (isBoundary(dem, row, col))
+                // Horn derivatives of the inner cells, without tests (vectorized)
+                if (isInnerRow)
                 {
-                    computeSlopeAspectBoundary(dem, slopeMap, aspectMap, z, row, col);
-                    continue;
+                    const float* up = dem.value[row-1];
+                    const float* center = dem.value[row];
+                    const float* down = dem.value[row+1];
+                    double* dzdx = dzdxRow.data();
+                    double* dzdy = dzdyRow.data();
+
+                    #pragma omp simd
+                    for (int col = 1; col < nrCols - 1; ++col)
+                    {
+                        const double z1 = up[col-1];
+                        const double z2 = up[col];
+                        const double z3 = up[col+1];
+                        const double z4 = center[col-1];
+                        const double z6 = center[col+1];
+                        const double z7 = down[col-1];
+                        const double z8 = down[col];
+                        const double z9 = down[col+1];
+
+                        dzdx[col] = ((z3 + 2*z6 + z9) - (z1 + 2*z4 + z7)) / (8.0 * cellSize);
+                        dzdy[col] = ((z7 + 2*z8 + z9) - (z1 + 2*z2 + z3)) / (8.0 * cellSize);
+                    }
                 }
 
-                const double z1 = dem.value[row-1][col-1];
-                const double z2 = dem.value[row-1][col];
-                const double z3 = dem.value[row-1][col+1];
-                const double z4 = dem.value[row][col-1];
+                for (int col = 0; col < nrCols; ++col)
+                {
+                    const float z = dem.value[row][col];
 
-                const double z6 = dem.value[row][col+1];
-                const double z7 = dem.value[row+1][col-1];
-                const double z8 = dem.value[row+1][col];
-                const double z9 = dem.value[row+1][col+1];
+                    if (isEqual(z, flag))
+                        continue;
 
-                // Horn derivatives
-                const double dzdx =
-                    ((z3 + 2*z6 + z9) - (z1 + 2*z4 + z7)) / (8.0 * cellSize);
+                    if (! isInnerRow || col == 0 || col == nrCols - 1 || isBoundary(dem, row, col))
+                    {
+                        computeSlopeAspectBoundary(dem, slopeMap, aspectMap, z, row, col);
+                        continue;
+                    }
 
-                const double dzdy =
-                    ((z7 + 2*z8 + z9) - (z1 + 2*z2 + z3)) / (8.0 * cellSize);
+                    const double dzdx = dzdxRow[size_t(col)];
+                    const double dzdy = dzdyRow[size_t(col)];
 
-                if (std::abs(dzdx) < EPSILON && std::abs(dzdy) < EPSILON)
-                {
-                    slopeMap->value[row][col] = 0.0;
-                    aspectMap->value[row][col] = 0.0;
-                    continue;
-                }
+                    if (std::abs(dzdx) < EPSILON && std::abs(dzdy) < EPSILON)
+                    {
+                        slopeMap->value[row][col] = 0.0;
+                        aspectMap->value[row][col] = 0.0;
+                        continue;
+                    }
 
-                // slope
-                const double slopeRad = std::atan(std::sqrt(dzdx*dzdx + dzdy*dzdy));
+                    // slope
+                    const double slopeRad = std::atan(std::sqrt(dzdx*dzdx + dzdy*dzdy));
 
-                slopeMap->value[row][col] = float(slopeRad * RAD_TO_DEG);
+                    slopeMap->value[row][col] = float(slopeRad * RAD_TO_DEG);
 
-                // aspect
-                double aspect = std::atan2(dzdy, -dzdx);
+                    // aspect
+                    double aspect = std::atan2(dzdy, -dzdx);
 
-                // convert to GIS compass (0 = North, clockwise)
-                aspect = 90.0 - aspect * RAD_TO_DEG;
-                if (aspect < 0)
-                    aspect += 360.0;
+                    // convert to GIS compass (0 = North, clockwise)
+                    aspect = 90.0 - aspect * RAD_TO_DEG;
+                    if (aspect < 0)
+                        aspect += 360.0;
 
-                aspectMap->value[row][col] = (float)aspect;
+                    aspectMap->value[row][col] = (float)aspect;
+                }
             }
         }
 
-        gis::updateMinMaxRasterGrid(slopeMap);
-        gis::updateMinMaxRasterGrid(aspectMap);
+        gis::updateMinMaxRasterGrid(slopeMap, isParallelComputing);
+        gis::updateMinMaxRasterGrid(aspectMap, isParallelComputing);
 
         slopeMap->isLoaded = true;
         aspectMap->isLoaded = true;
@@ -1328,31 +1677,33 @@ namespace gis
     {
         if (outputMap == nullptr || map1 == nullptr) return false;
         if (! (*(map1->header) == *(outputMap->header))) return false;
+        if (map1->data() == nullptr || outputMap->data() == nullptr) return false;
+        if (myOperation == operationDivide && myValue == 0.f) return false;
+
+        const float* input = map1->data();
+        float* output = outputMap->data();
+        float flag = map1->header->flag;
+        size_t nrCells = outputMap->getNrCells();
 
-        for (int row=0; row<outputMap->header->nrRows; row++)
-            for (int col=0; col<outputMap->header->nrCols; col++)
+        for (size_t i = 0; i < nrCells; i++)
+        {
+            float x = input[i];
+            if (! isEqual(x, flag))
             {
-                if (! isEqual(map1->value[row][col], map1->header->flag))
-                {
-                    if (myOperation == operationMin)
-                        outputMap->value[row][col] = MINVALUE(map1->value[row][col], myValue);
-                    else if (myOperation == operationMax)
-                        outputMap->value[row][col] = MAXVALUE(map1->value[row][col], myValue);
-                    else if (myOperation == operationSum)
-                        outputMap->value[row][col] = (map1->value[row][col] + myValue);
-                    else if (myOperation == operationSubtract)
-                        outputMap->value[row][col] = (map1->value[row][col] - myValue);
-                    else if (myOperation == operationProduct)
-                        outputMap->value[row][col] = (map1->value[row][col] * myValue);
-                    else if (myOperation == operationDivide)
-                    {
-                        if (myValue != 0.f)
-                            outputMap->value[row][col] = (map1->value[row][col] / myValue);
-                        else
-                            return false;
-                    }
-                }
+                if (myOperation == operationMin)
+                    output[i] = MINVALUE(x, myValue);
+                else if (myOperation == operationMax)
+                    output[i] = MAXVALUE(x, myValue);
+                else if (myOperation == operationSum)
+                    output[i] = (x + myValue);
+                else if (myOperation == operationSubtract)
+                    output[i] = (x - myValue);
+                else if (myOperation == operationProduct)
+                    output[i] = (x * myValue);
+                else if (myOperation == operationDivide)
+                    output[i] = (x / myValue);
             }
+        }
 
         return true;
     }
@@ -1554,18 +1905,20 @@ namespace gis
     }
 
 
-    bool prevailingMap(const Crit3DRasterGrid& inputMap,  Crit3DRasterGrid *outputMap)
+    bool prevailingMap(const Crit3DRasterGrid& inputMap,  Crit3DRasterGrid *outputMap, bool isParallelComputing)
     {
-        int i, j;
-        float value;
-        double x, y;
-        int inputRow, inputCol;
         int dim = 3;
-
-        std::vector <float> valuesList;
         double step = outputMap->header->cellSize / (2*dim+1);
 
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
         for (int row = 0; row < outputMap->header->nrRows ; row++)
+        {
+            int i, j;
+            float value;
+            double x, y;
+            int inputRow, inputCol;
+            std::vector <float> valuesList;
+
             for (int col = 0; col < outputMap->header->nrCols; col++)
             {
                 /*! center */
@@ -1587,6 +1940,7 @@ namespace gis
                 else
                     outputMap->value[row][col] = prevailingValue(valuesList);
             }
+        }
 
         return true;
     }
@@ -1675,6 +2029,184 @@ namespace gis
     }
 
 
+    /*!
+     * \brief getDecimatedGrid
+     * average of the grid on a coarser grid (cellSize * factor) with the same upper left corner
+     */
+    bool getDecimatedGrid(const Crit3DRasterGrid& grid, int factor, Crit3DRasterGrid* outGrid)
+    {
+        if (! grid.isLoaded || factor < 1)
+            return false;
+
+        Crit3DRasterHeader header = *(grid.header);
+        header.cellSize = grid.header->cellSize * factor;
+        header.invCellSize = 1. / header.cellSize;
+        header.nrRows = (grid.header->nrRows + factor - 1) / factor;
+        header.nrCols = (grid.header->nrCols + factor - 1) / factor;
+        header.llCorner.y = grid.header->llCorner.y + grid.header->nrRows * grid.header->cellSize
+                            - header.nrRows * header.cellSize;
+
+        if (factor == 1)
+            return outGrid->copyGrid(grid);
+
+        resampleGrid(grid, outGrid, &header, aggrAverage, 0);
+        return true;
+    }
+
+
+    /*!
+     * \brief topographicDistanceMapSweep
+     * same result of topographicDistanceMap (maximum elevation above the lower end of the path)
+     * computed by a wavefront from the point: the cells are processed by square rings of increasing distance,
+     * the maximum elevation along the path of each cell is obtained incrementally from the two cells
+     * of the previous ring crossed by the path (linear interpolation).
+     * sweepDem is the DEM used for the paths: it can be a decimated DEM (see getDecimatedGrid) to reduce the computation time
+     */
+    bool topographicDistanceMapSweep(const Crit3DPoint& myPoint, const Crit3DRasterGrid& dem,
+                                     const Crit3DRasterGrid& sweepDem, Crit3DRasterGrid* myMap)
+    {
+        if (! dem.isLoaded || ! sweepDem.isLoaded)
+            return false;
+
+        const Crit3DRasterHeader& header = *(sweepDem.header);
+        const float flag = header.flag;
+        int nrRows = header.nrRows;
+        int nrCols = header.nrCols;
+
+        // point position on the sweep grid (it may be outside)
+        int pointRow = (nrRows - 1) - int(floor((myPoint.utm.y - header.llCorner.y) / header.cellSize));
+        int pointCol = int(floor((myPoint.utm.x - header.llCorner.x) / header.cellSize));
+
+        // maximum elevation along the path to the point (point cell excluded)
+        std::vector<float> maxZ(size_t(nrRows) * size_t(nrCols), flag);
+
+        auto getMaxZ = [&](int row, int col) -> float
+        {
+            if (row < 0 || row >= nrRows || col < 0 || col >= nrCols)
+                return flag;
+            return maxZ[size_t(row) * size_t(nrCols) + size_t(col)];
+        };
+
+        // interpolation between two cells of the previous ring
+        auto interpolateMaxZ = [&](int row1, int col1, int row2, int col2, float weight) -> float
+        {
+            float z1 = getMaxZ(row1, col1);
+            if (weight <= 0) return z1;
+
+            float z2 = getMaxZ(row2, col2);
+            if (isEqual(z1, flag)) return z2;
+            if (isEqual(z2, flag)) return z1;
+            return z1 + weight * (z2 - z1);
+        };
+
+        auto updateCell = [&](int row, int col)
+        {
+            int dRow = row - pointRow;
+            int dCol = col - pointCol;
+            int distance = MAXVALUE(abs(dRow), abs(dCol));
+            float pathZ;
+
+            if (abs(dRow) >= abs(dCol))
+            {
+                double pos = pointCol + double(dCol) * (distance - 1) / distance;
+                int col1 = int(floor(pos));
+                int prevRow = row - (dRow > 0 ? 1 : -1);
+                pathZ = interpolateMaxZ(prevRow, col1, prevRow, col1 + 1, float(pos - col1));
+            }
+            else
+            {
+                double pos = pointRow + double(dRow) * (distance - 1) / distance;
+                int row1 = int(floor(pos));
+                int prevCol = col - (dCol > 0 ? 1 : -1);
+                pathZ = interpolateMaxZ(row1, prevCol, row1 + 1, prevCol, float(pos - row1));
+            }
+
+            float z = sweepDem.value[row][col];
+            if (! isEqual(z, flag) && (isEqual(pathZ, flag) || z > pathZ))
+                pathZ = z;
+
+            maxZ[size_t(row) * size_t(nrCols) + size_t(col)] = pathZ;
+        };
+
+        int maxDistance = MAXVALUE(MAXVALUE(abs(pointRow), abs(nrRows - 1 - pointRow)),
+                                   MAXVALUE(abs(pointCol), abs(nrCols - 1 - pointCol)));
+
+        // first ring inside the grid
+        int firstDistance = MAXVALUE(MAXVALUE(pointRow - (nrRows - 1), -pointRow),
+                                     MAXVALUE(pointCol - (nrCols - 1), -pointCol));
+        firstDistance = MAXVALUE(firstDistance, 1);
+
+        for (int d = firstDistance; d <= maxDistance; d++)
+        {
+            int firstRow = MAXVALUE(pointRow - d, 0);
+            int lastRow = MINVALUE(pointRow + d, nrRows - 1);
+            int firstCol = MAXVALUE(pointCol - d, 0);
+            int lastCol = MINVALUE(pointCol + d, nrCols - 1);
+
+            for (int row = firstRow; row <= lastRow; row++)
+            {
+                if (row == pointRow - d || row == pointRow + d)
+                {
+                    for (int col = firstCol; col <= lastCol; col++)
+                        updateCell(row, col);
+                }
+                else
+                {
+                    if (pointCol - d >= 0)
+                        updateCell(row, pointCol - d);
+                    if (pointCol + d < nrCols)
+                        updateCell(row, pointCol + d);
+                }
+            }
+        }
+
+        // the elevation of the point position is a path sample when the cell is lower
+        float pointDemZ = dem.getValueFromXY(myPoint.utm.x, myPoint.utm.y);
+        float stepMeter = float(dem.header->cellSize);
+
+        myMap->initializeGrid(dem);
+
+        for (int row = 0; row < dem.header->nrRows; row++)
+        {
+            for (int col = 0; col < dem.header->nrCols; col++)
+            {
+                float demValue = dem.value[row][col];
+                if (isEqual(demValue, dem.header->flag))
+                {
+                    myMap->value[row][col] = myMap->header->flag;
+                    continue;
+                }
+
+                double x, y;
+                dem.getXY(row, col, x, y);
+                float distance = computeDistance(float(x), float(y), float(myPoint.utm.x), float(myPoint.utm.y));
+                if (distance < stepMeter)
+                {
+                    myMap->value[row][col] = 0;
+                    continue;
+                }
+
+                float lowerZ = MINVALUE(demValue, float(myPoint.z));
+
+                int sweepRow, sweepCol;
+                sweepDem.getRowCol(x, y, sweepRow, sweepCol);
+                float pathZ = getMaxZ(sweepRow, sweepCol);
+                if (isEqual(pathZ, flag))
+                    pathZ = demValue;
+                else
+                    pathZ = MAXVALUE(pathZ, demValue);
+
+                if (demValue < float(myPoint.z) && ! isEqual(pointDemZ, dem.header->flag))
+                    pathZ = MAXVALUE(pathZ, pointDemZ);
+
+                myMap->value[row][col] = MAXVALUE(0.f, pathZ - lowerZ);
+            }
+        }
+
+        return true;
+    }
+
+
     double closestDistanceFromGrid(Crit3DPoint myPoint, const gis::Crit3DRasterGrid& dem)
     {
         float demValue = gis::getValueFromXY(dem, myPoint.utm.x, myPoint.utm.y);
@@ -1716,97 +2248,21 @@ namespace gis
     }
 
 
+    /*!
+     * \brief resampleGrid
+     * resamples oldGrid on newHeader (see Crit3DResamplePlan, to resample many rasters with the same headers)
+     */
     void resampleGrid(const gis::Crit3DRasterGrid& oldGrid, gis::Crit3DRasterGrid* newGrid,
                       gis::Crit3DRasterHeader* newHeader, aggregationMethod elab, float nodataRatioThreshold)
     {
         *(newGrid->header) = *newHeader;
 
-        double resampleFactor = newGrid->header->cellSize / oldGrid.header->cellSize;
-
-        int row, col, tmpRow, tmpCol, nrValues;
-        gis::Crit3DPoint myLL, myUR;
-        std::vector<float> values;
-
-        newGrid->initializeGrid();
-
-        for (row = 0; row < newGrid->header->nrRows; row++)
-            for (col = 0; col < newGrid->header->nrCols; col++)
-            {
-                // initialize
-                newGrid->value[row][col] = newGrid->header->flag;
-                float value = NODATA;
-
-                if (resampleFactor <= 1. || elab == aggrCenter)
-                {
-                    double x, y;
-                    newGrid->getXY(row, col, x, y);
-                    oldGrid.getRowCol(x, y, tmpRow, tmpCol);
-                    if (! gis::isOutOfGridRowCol(tmpRow, tmpCol, oldGrid))
-                    {
-                        float tmpValue = oldGrid.value[tmpRow][tmpCol];
-                        if (! isEqual(tmpValue, oldGrid.header->flag))
-                            value = tmpValue;
-                    }
-                }
-                else
-                {
-                    int nrStep = int(floor(resampleFactor)) + 1;
-                    double step = newGrid->header->cellSize / nrStep;
-                    double halfStep = step * 0.5;
-
-                    double x0, y0;
-                    newGrid->getXY(row, col, x0, y0);
-                    myLL.utm.x = x0 - (newGrid->header->cellSize / 2) + halfStep;
-                    myLL.utm.y = y0 - (newGrid->header->cellSize / 2) + halfStep;
-                    myUR.utm.x = x0 + (newGrid->header->cellSize / 2) - halfStep;
-                    myUR.utm.y = y0 + (newGrid->header->cellSize / 2) - halfStep;
-
-                    values.clear();
-                    int maxNrValues = 0;
-                    for (int i = 0; i < nrStep; i++)
-                    {
-                        double x = myLL.utm.x + step * i;
-                        for (int j = 0; j < nrStep; j++)
-                        {
-                            double y = myLL.utm.y + step * j;
-                            float tmpValue = gis::getValueFromXY(oldGrid, x, y);
-                            if (! isEqual(tmpValue, oldGrid.header->flag))
-                            {
-                                values.push_back(tmpValue);
-                            }
-                            maxNrValues++;
-                        }
-                    }
-                    nrValues = int(values.size());
-
-                    if (maxNrValues > 0)
-                    {
-                        if ((float(nrValues) / float(maxNrValues)) > nodataRatioThreshold)
-                        {
-                            if (elab == aggrAverage)
-                                value = statistics::mean(values);
-                            else if (elab == aggrMedian)
-                                value = sorting::percentile(values, nrValues, 50, true);
-                            else if (elab == aggrPrevailing)
-                            {
-                                int nrMissing = maxNrValues - nrValues;
-                                if (nrMissing < nrValues)
-                                {
-                                    value = prevailingValue(values);
-                                }
-                            }
-                        }
-                    }
-                }
-
-                if (! isEqual(value, NODATA))
-                {
-                    newGrid->value[row][col] = value;
-                }
-            }
-
-        gis::updateMinMaxRasterGrid(newGrid);
-        newGrid->isLoaded = true;
+        Crit3DResamplePlan plan;
+        if (! plan.initialize(*(oldGrid.header), *newHeader)
+            || ! plan.apply(oldGrid, *newGrid, elab, nodataRatioThreshold, false))
+        {
+            newGrid->initializeGrid(newHeader->flag);
+        }
     }
 
 
@@ -1841,7 +2297,7 @@ namespace gis
                     }
                 }
 
-        updateMinMaxRasterGrid(outGrid);
+        updateMinMaxRasterGrid(outGrid, false);
         outGrid->setMapTime(Crit3DTime(Crit3DDate(1,1,myYear), 0));
 
         return true;
@@ -1916,35 +2372,18 @@ namespace gis
         header.llCorner.x = refHeader->llCorner.x + refHeader->cellSize * firstCol;
         header.llCorner.y = refHeader->llCorner.y + refHeader->cellSize * (refHeader->nrRows - lastRow - 1);
 
-        // Initialize output raster.
-        if (! outputRaster->initializeGrid(header))
+        // Copy the clipped portion of the reference raster.
+        // Cells outside the mask are equal to the output flag.
+        Crit3DRasterExpression expression;
+        expression.ifElse(expression.unary(exprIsValid, expression.input("mask")), expression.input("ref"), expression.noData());
+
+        std::string errorStr;
+        if (! expression.evaluate({{"ref", refRaster}, {"mask", maskRaster}}, header, *outputRaster, false, errorStr))
         {
             outputRaster->clear();
             return false;
         }
 
-        // Copy the clipped portion of the reference raster.
-        // Cells outside the mask remain equal to the output flag.
-        for (long row = firstRow; row <= lastRow; ++row)
-        {
-            for (long col = firstCol; col <= lastCol; ++col)
-            {
-                const long outputRow = row - firstRow;
-                const long outputCol = col - firstCol;
-
-                gis::getUtmXYFromRowCol(refRaster->header, row, col, &x, &y);
-
-                const float maskValue = maskRaster->getValueFromXY(x, y);
-
-                if (! isEqual(maskValue, maskHeader->flag))
-                {
-                    outputRaster->value[outputRow][outputCol] = refRaster->value[row][col];
-                }
-            }
-        }
-
-        gis::updateMinMaxRasterGrid(outputRaster);
-
         return true;
     }
 
@@ -2019,7 +2458,7 @@ namespace gis
         // clean memory
         tmpRaster->clear();
 
-        gis::updateMinMaxRasterGrid(outputRaster);
+        gis::updateMinMaxRasterGrid(outputRaster, false);
         return true;
     }
 */
@@ -2031,25 +2470,11 @@ namespace gis
         if (refRaster == nullptr || maskRaster == nullptr || outputRaster == nullptr)
             return false;
 
-        outputRaster->initializeGrid(*(refRaster->header));
-
-        double x, y;
-        float maskValue;
-        for (long row = 0; row < refRaster->header->nrRows; row++)
-        {
-            for (long col = 0; col < refRaster->header->nrCols; col++)
-            {
-                gis::getUtmXYFromRowCol(refRaster->header, row, col, &x, &y);
-                maskValue = maskRaster->getValueFromXY(x, y);
-                if (! isEqual(maskValue, maskRaster->header->flag))
-                    outputRaster->value[row][col] = maskValue;
-                else
-                    outputRaster->value[row][col] = refRaster->value[row][col];
-            }
-        }
+        Crit3DRasterExpression expression;
+        expression.binary(exprCoalesce, expression.input("mask"), expression.input("ref"));
 
-        gis::updateMinMaxRasterGrid(outputRaster);
-        return true;
+        std::string errorStr;
+        return expression.evaluate({{"ref", refRaster}, {"mask", maskRaster}}, *(refRaster->header), *outputRaster, false, errorStr);
     }
 
 
@@ -2058,29 +2483,20 @@ namespace gis
         if (refRaster == nullptr || outputRaster == nullptr)
             return false;
 
-        outputRaster->initializeGrid(*(refRaster->header));
+        // values outside [minValue, maxValue]
+        Crit3DRasterExpression expression;
+        Crit3DRasterExpression::node ref = expression.input("ref");
+        Crit3DRasterExpression::node isOutside = expression.binary(exprOr, expression.binary(exprLess, ref, expression.constant(minValue)),
+                                                                   expression.binary(exprGreater, ref, expression.constant(maxValue)));
+        expression.ifElse(isOutside, ref, expression.noData());
 
-        for (long row = 0; row < refRaster->header->nrRows; row++)
-        {
-            for (long col = 0; col < refRaster->header->nrCols; col++)
-            {
-                float value = refRaster->value[row][col];
-                if (! isEqual(value, refRaster->header->flag))
-                {
-                    if (value < minValue || value > maxValue)
-                    {
-                        outputRaster->value[row][col] = value;
-                    }
-                }
-            }
-        }
-
-        return true;
+        std::string errorStr;
+        return expression.evaluate({{"ref", refRaster}}, *(refRaster->header), *outputRaster, false, errorStr);
     }
 
 
     // return nr of valid cells and avg value
-    bool rasterSummary(Crit3DRasterGrid *myGrid, int &nrValids, float &avgValue, std::string &error)
+    bool rasterSummary(Crit3DRasterGrid *myGrid, int &nrValids, float &avgValue, bool isParallelComputing, std::string &error)
     {
         // initialize
         nrValids = NODATA;
@@ -2092,48 +2508,32 @@ namespace gis
             return false;
         }
 
-        // list of valid values
-        float myValue;
-        std::vector <float> validValues;
-        for (int row = 0; row < myGrid->header->nrRows; row++)
+        Crit3DRasterStatistics statistics;
+        bool isParallel = isParallelComputing && (myGrid->getNrCells() >= RASTER_STATISTICS_PARALLEL_CELLS);
+        if (! statistics.compute(*myGrid, isParallel))
         {
-            for (int col = 0; col < myGrid->header->nrCols; col++)
-            {
-                myValue = myGrid->value[row][col];
-
-                if (! isEqual(myValue, myGrid->header->flag)  && ! isEqual(myValue, NODATA))
-                {
-                    validValues.push_back(myValue);
-                }
-            }
+            error = "The raster is null or hasn't been loaded correctly.";
+            return false;
         }
 
-        nrValids = int(validValues.size());
-        avgValue = statistics::mean(validValues);
-
-        validValues.clear();
+        nrValids = int(statistics.nrValues);
+        if (statistics.nrValues > 0)
+            avgValue = float(statistics.mean);
 
         return true;
     }
 
 
     // assume integer values (categories)
-    std::vector<int> extractUniqueValues(const Crit3DRasterGrid& raster)
+    std::vector<int> extractUniqueValues(const Crit3DRasterGrid& raster, bool isParallelComputing)
     {
-        std::set<int> uniqueValues;
-        int flagInt = int(raster.header->flag);
+        Crit3DRasterStatistics statistics;
+        statistics.setUniqueValues(true);
 
-        for (int row = 0; row < raster.header->nrRows; row++)
-        {
-            for (int col = 0; col < raster.header->nrCols; col++)
-            {
-                int valueInt = int(raster.value[row][col]);
-                if (valueInt != flagInt)
-                uniqueValues.insert(valueInt);
-            }
-        }
+        bool isParallel = isParallelComputing && (raster.getNrCells() >= RASTER_STATISTICS_PARALLEL_CELLS);
+        statistics.compute(raster, isParallel);
 
-        return std::vector<int>(uniqueValues.begin(), uniqueValues.end());
+        return statistics.uniqueValues;
     }
 
 
@@ -2247,7 +2647,7 @@ namespace gis
             }
         }
 
-        updateMinMaxRasterGrid(outputRaster);
+        updateMinMaxRasterGrid(outputRaster, false);
 
         return true;
     }
@@ -2342,7 +2742,7 @@ namespace gis
             }
         }
 
-        updateMinMaxRasterGrid(outputRaster);
+        updateMinMaxRasterGrid(outputRaster, false);
 
         return true;
     }
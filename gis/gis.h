@@ -3,6 +3,7 @@
 
     #include <vector>
     #include <string>
+    #include <memory>
 
     #ifndef CRIT3DCOLOR_H
         #include "color.h"
@@ -14,10 +15,18 @@
         #include "statistics.h"
     #endif
 
+    // alignment of the raster values (bytes)
+    #define RASTER_DATA_ALIGNMENT 64
+
+    // points converted by each task of the batch coordinate conversions
+    #define UTM_BATCH_BLOCKSIZE 1024
+
     enum operationType {operationMin, operationMax, operationSum, operationSubtract, operationProduct, operationDivide};
 
     namespace gis
     {
+        class Crit3DMappedFile;
+
         class  Crit3DPixel {
         public:
             int x;
@@ -154,8 +163,22 @@
         };
 
 
+        /*!
+         * \brief The Crit3DRasterGrid class
+         * the values are stored in a single contiguous buffer (row major, aligned to RASTER_DATA_ALIGNMENT bytes):
+         * value[row] are the pointers to the rows, data() is the whole buffer and stride() the distance between two rows.
+         * The buffer can also be a copy-on-write view of a raster file (mapFloatData)
+         */
         class Crit3DRasterGrid
         {
+        private:
+            float* _data;
+            size_t _stride;
+            std::shared_ptr<Crit3DMappedFile> _mappedFile;
+
+            bool allocateData();
+            void freeData();
+
         public:
             Crit3DRasterHeader* header;
             Crit3DColorScale* colorScale;
@@ -196,6 +219,14 @@
 
             Crit3DTime getMapTime() const;
             void setMapTime(const Crit3DTime &value);
+
+            float* data() { return _data; }
+            const float* data() const { return _data; }
+            size_t stride() const { return _stride; }
+            size_t getNrCells() const { return size_t(header->nrRows) * _stride; }
+
+            bool mapFloatData(const std::string &fileName, size_t offset);
+            bool isMapped() const { return _mappedFile != nullptr; }
         };
 
 
@@ -215,9 +246,9 @@
         double computeDistancePoint(Crit3DUtmPoint *p0, Crit3DUtmPoint *p1);
         std::vector<float> computeEuclideanDistanceStation2Area(std::vector<std::vector<int>>& cells,std::vector<std::vector<int>>& stations);
         std::vector<int> computeMetropolisDistanceStation2Area(std::vector<std::vector<int>>& cells,std::vector<std::vector<int>>& stations);
-        bool updateMinMaxRasterGrid(Crit3DRasterGrid *rasterGrid);
+        bool updateMinMaxRasterGrid(Crit3DRasterGrid *rasterGrid, bool isParallelComputing);
         void convertFlagToNodata(Crit3DRasterGrid& myGrid);
-        bool updateColorScale(Crit3DRasterGrid* rasterGrid, int row0, int col0, int row1, int col1);
+        bool updateColorScale(Crit3DRasterGrid* rasterGrid, int row0, int col0, int row1, int col1, bool isParallelComputing);
 
         void getRowColFromXY(const Crit3DRasterHeader& myHeader, double x, double y, int *row, int *col);
         void getRowColFromXY(const Crit3DRasterHeader& myHeader, double x, double y, int& row, int& col);
@@ -261,9 +292,22 @@
         void latLonToUtm(double lat, double lon,double *utmEasting,double *utmNorthing,int *zoneNumber);
         void latLonToUtmForceZone(int zoneNumber, double lat, double lon, double *utmEasting, double *utmNorthing);
         void utmToLatLon(int zoneNumber, double referenceLat, double utmEasting, double utmNorthing, double *lat, double *lon);
+
+        void latLonToUtm(const double *lat, const double *lon, double *utmEasting, double *utmNorthing, int *zoneNumber,
+                         size_t nrPoints, bool isParallelComputing);
+        void latLonToUtmForceZone(int zoneNumber, const double *lat, const double *lon, double *utmEasting, double *utmNorthing,
+                                  size_t nrPoints, bool isParallelComputing);
+        void utmToLatLon(int zoneNumber, double referenceLat, const double *utmEasting, const double *utmNorthing,
+                         double *lat, double *lon, size_t nrPoints, bool isParallelComputing);
+        void getLatLonFromUtm(const Crit3DGisSettings& gisSettings, const std::vector<Crit3DUtmPoint> &utmPoints,
+                              std::vector<Crit3DGeoPoint> &geoPoints, bool isParallelComputing);
+        void getUtmFromLatLon(int zoneNumber, const std::vector<Crit3DGeoPoint> &geoPoints,
+                              std::vector<Crit3DUtmPoint> &utmPoints, bool isParallelComputing);
+
         bool isValidUtmTimeZone(int utmZone, int timeZone);
 
-        bool openRaster(const std::string fileName, Crit3DRasterGrid *rasterGrid, int currentUtmZone, std::string &errorStr);
+        bool openRaster(const std::string fileName, Crit3DRasterGrid *rasterGrid, int currentUtmZone,
+                        bool isParallelComputing, std::string &errorStr);
 
         bool readEsriGridFlt(const std::string &fileName, Crit3DRasterGrid* rasterGrid, std::string &errorStr);
         bool readEsriGridAscii(const std::string &fileName, gis::Crit3DRasterGrid *rasterGrid, std::string &errorStr);
@@ -277,7 +321,7 @@
         bool mapAlgebra(Crit3DRasterGrid* myMap1, Crit3DRasterGrid* myMap2, Crit3DRasterGrid *outputMap, operationType myOperation);
         bool mapAlgebra(Crit3DRasterGrid* myMap1, float myValue, Crit3DRasterGrid *outputMap, operationType myOperation);
 
-        bool prevailingMap(const Crit3DRasterGrid& inputMap,  Crit3DRasterGrid *outputMap);
+        bool prevailingMap(const Crit3DRasterGrid& inputMap,  Crit3DRasterGrid *outputMap, bool isParallelComputing);
         float prevailingValue(const std::vector<float> &valueList);
 
         bool clipRasterWithRaster(const Crit3DRasterGrid* refRaster, const Crit3DRasterGrid* maskRaster, Crit3DRasterGrid* outputRaster);
@@ -289,10 +333,10 @@
 
         bool computeLatLonMaps(const gis::Crit3DRasterGrid& rasterGrid,
                                gis::Crit3DRasterGrid* latMap, gis::Crit3DRasterGrid* lonMap,
-                               const gis::Crit3DGisSettings& gisSettings);
+                               const gis::Crit3DGisSettings& gisSettings, bool isParallelComputing);
 
         bool computeSlopeAspectMaps(const gis::Crit3DRasterGrid& dem,
-                               gis::Crit3DRasterGrid* slopeMap, gis::Crit3DRasterGrid* aspectMap);
+                               gis::Crit3DRasterGrid* slopeMap, gis::Crit3DRasterGrid* aspectMap, bool isParallelComputing);
 
         bool getGeoExtentsFromUTMHeader(const Crit3DGisSettings& mySettings,
                                         Crit3DRasterHeader *utmHeader, Crit3DLatLonHeader *latLonHeader);
@@ -302,6 +346,9 @@
         float topographicDistance(float x1, float y1, float z1, float x2, float y2, float z2, float distance,
                                   const gis::Crit3DRasterGrid& dem);
         bool topographicDistanceMap(Crit3DPoint myPoint, const gis::Crit3DRasterGrid& dem, Crit3DRasterGrid* myMap);
+        bool topographicDistanceMapSweep(const Crit3DPoint& myPoint, const Crit3DRasterGrid& dem,
+                                         const Crit3DRasterGrid& sweepDem, Crit3DRasterGrid* myMap);
+        bool getDecimatedGrid(const Crit3DRasterGrid& grid, int factor, Crit3DRasterGrid* outGrid);
         double closestDistanceFromGrid(Crit3DPoint myPoint, const gis::Crit3DRasterGrid& dem);
         bool compareGrids(const gis::Crit3DRasterGrid& first, const gis::Crit3DRasterGrid& second);
         void resampleGrid(const gis::Crit3DRasterGrid& oldGrid, gis::Crit3DRasterGrid* newGrid,
@@ -309,7 +356,7 @@
         bool temporalYearlyInterpolation(const gis::Crit3DRasterGrid& firstGrid, const gis::Crit3DRasterGrid& secondGrid,
                                          int myYear, float minValue, float maxValue, gis::Crit3DRasterGrid* outGrid);
 
-        bool rasterSummary(Crit3DRasterGrid *myGrid, int &nrValids, float &avgValue, std::string &error);
+        bool rasterSummary(Crit3DRasterGrid *myGrid, int &nrValids, float &avgValue, bool isParallelComputing, std::string &error);
 
         bool deleteRangeOfValuesRaster(gis::Crit3DRasterGrid* refRaster, float minValue, float maxValue, gis::Crit3DRasterGrid* outputRaster);
 
@@ -323,8 +370,12 @@
         bool writeEsriGridFlt(const std::string &fileName, Crit3DRasterGrid* myGrid, std::string &errorStr);
 
         bool readRasterFloatData(const std::string &fileName, Crit3DRasterGrid *rasterGrid, std::string &errorStr);
+        bool readRasterStatistics(const std::string &dataFileName, const Crit3DRasterHeader &header,
+                                  float &minimum, float &maximum);
+        bool writeRasterStatistics(const std::string &dataFileName, const Crit3DRasterHeader &header,
+                                   float minimum, float maximum, std::string &errorStr);
 
-        std::vector<int> extractUniqueValues(const Crit3DRasterGrid& raster);
+        std::vector<int> extractUniqueValues(const Crit3DRasterGrid& raster, bool isParallelComputing);
     }
 
 
@@ -26,16 +26,39 @@ win32:{
     TARGET = gis
 }
 
+# parallel computing settings
+include($$absolute_path(../parallel.pri))
+
 INCLUDEPATH += ../mathFunctions ../crit3dDate
 
 SOURCES += gis.cpp \
     color.cpp \
+    compressedRaster.cpp \
     geoMap.cpp \
     gisIO.cpp \
+    mappedFile.cpp \
+    rasterExpression.cpp \
+    rasterStatistics.cpp \
+    rasterStream.cpp \
+    resamplePlan.cpp \
+    summedAreaTable.cpp \
+    terrainCache.cpp \
+    tiledRaster.cpp \
+    topographicDistanceStore.cpp \
     watershed.cpp
 
 HEADERS += gis.h \
     color.h \
+    compressedRaster.h \
     gisIO.h \
     geoMap.h \
+    mappedFile.h \
+    rasterExpression.h \
+    rasterStatistics.h \
+    rasterStream.h \
+    resamplePlan.h \
+    summedAreaTable.h \
+    terrainCache.h \
+    tiledRaster.h \
+    topographicDistanceStore.h \
     watershed.h
@@ -10,10 +10,15 @@
 #include <vector>
 #include <iostream>
 #include <cctype>
+#include <sys/stat.h>
 
 #include "commonConstants.h"
 #include "basicMath.h"
 #include "gis.h"
+#include "mappedFile.h"
+#include "tiledRaster.h"
+#include "compressedRaster.h"
+#include "rasterStream.h"
 
 using namespace std;
 
@@ -392,6 +397,16 @@ bool readRasterRow(FILE* file,
 }
 
 
+bool isNativeFloatData(const RasterFileInfo& fileInfo)
+{
+    const bool fileLittle =
+        (fileInfo.byteOrder == ByteOrder::LittleEndian);
+
+    return fileInfo.dataType == RasterDataType::Float32
+           && fileLittle == isLittleEndianHost();
+}
+
+
 bool readRasterBinaryData(const string& fileName,
                           gis::Crit3DRasterGrid* rasterGrid,
                           const RasterFileInfo& fileInfo,
@@ -413,6 +428,16 @@ bool readRasterBinaryData(const string& fileName,
         return false;
     }
 
+    // the file layout is the memory layout: the grid is a view of the file
+    if (isNativeFloatData(fileInfo))
+    {
+        if (rasterGrid->mapFloatData(fileName, fileInfo.headerOffset))
+        {
+            rasterGrid->isLoaded = true;
+            return true;
+        }
+    }
+
     if (!rasterGrid->initializeGrid())
     {
         errorStr = "Memory error: file too big.";
@@ -981,6 +1006,164 @@ bool readEsriBilProjection(const std::string& fileName, int &utmZone, std::strin
 }
 
 
+/*!
+ * \brief getStatisticsFileName
+ * the statistics file has the name of the data file, with extension .stx
+ */
+static string getStatisticsFileName(const string& dataFileName)
+{
+    const size_t dotPosition = dataFileName.find_last_of('.');
+    const size_t separatorPosition = dataFileName.find_last_of("/\\");
+
+    if (dotPosition == string::npos ||
+        (separatorPosition != string::npos && dotPosition < separatorPosition))
+        return dataFileName + ".stx";
+
+    return dataFileName.substr(0, dotPosition) + ".stx";
+}
+
+
+static bool getFileStatus(const string& fileName, time_t& modificationTime, uint64_t& fileSize)
+{
+    struct stat fileStat;
+    if (stat(fileName.c_str(), &fileStat) != 0)
+        return false;
+
+    modificationTime = fileStat.st_mtime;
+    fileSize = uint64_t(fileStat.st_size);
+    return true;
+}
+
+
+/*!
+ * \brief getRasterHeaderHash
+ * 64 bit hash (FNV-1a) of the header values: the statistics file refers only to the same raster geometry
+ */
+static uint64_t getRasterHeaderHash(const Crit3DRasterHeader& header)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    auto addBytes = [&hash](const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    };
+
+    addBytes(&header.nrRows, sizeof(header.nrRows));
+    addBytes(&header.nrCols, sizeof(header.nrCols));
+    addBytes(&header.cellSize, sizeof(header.cellSize));
+    addBytes(&header.llCorner.x, sizeof(header.llCorner.x));
+    addBytes(&header.llCorner.y, sizeof(header.llCorner.y));
+    addBytes(&header.flag, sizeof(header.flag));
+
+    return hash;
+}
+
+
+/*!
+ * \brief readRasterStatistics
+ * reads minimum and maximum of the raster from the statistics file (band min max, as ESRI .stx)
+ * the second line stores size of the data file and hash of the header:
+ * the statistics are valid only if both match and the file is not older than the data file
+ */
+bool readRasterStatistics(const string& dataFileName, const Crit3DRasterHeader& header, float& minimum, float& maximum)
+{
+    const string statisticsFileName = getStatisticsFileName(dataFileName);
+
+    time_t dataTime, statisticsTime;
+    uint64_t dataSize, statisticsSize;
+    if (! getFileStatus(dataFileName, dataTime, dataSize)
+        || ! getFileStatus(statisticsFileName, statisticsTime, statisticsSize)
+        || statisticsTime < dataTime)
+        return false;
+
+    ifstream file(statisticsFileName);
+    int band;
+    float minValue, maxValue;
+    string key;
+    uint64_t fileSize, headerHash;
+    if (! (file >> band >> minValue >> maxValue >> key >> fileSize >> headerHash)
+        || band != 1 || minValue > maxValue || key != "crit3d"
+        || fileSize != dataSize || headerHash != getRasterHeaderHash(header))
+        return false;
+
+    minimum = minValue;
+    maximum = maxValue;
+    return true;
+}
+
+
+/*!
+ * \brief updateMinMaxFromStatistics
+ * minimum, maximum and color scale of a grid just read: from the statistics file if it is valid,
+ * because the scan of a mapped grid would load all the pages of the file
+ */
+static void updateMinMaxFromStatistics(const string& dataFileName, Crit3DRasterGrid* rasterGrid)
+{
+    float minimum, maximum;
+    if (! readRasterStatistics(dataFileName, *(rasterGrid->header), minimum, maximum))
+    {
+        updateMinMaxRasterGrid(rasterGrid, false);
+        return;
+    }
+
+    rasterGrid->minimum = minimum;
+    rasterGrid->maximum = maximum;
+
+    if (! rasterGrid->colorScale->isFixedRange())
+    {
+        rasterGrid->colorScale->setRange(minimum, maximum);
+    }
+}
+
+
+/*!
+ * \brief writeRasterStatistics
+ * writes minimum and maximum of the raster in the statistics file,
+ * after the data file has been written
+ */
+bool writeRasterStatistics(const string& dataFileName, const Crit3DRasterHeader& header,
+                           float minimum, float maximum, string& errorStr)
+{
+    const string statisticsFileName = getStatisticsFileName(dataFileName);
+
+    time_t dataTime;
+    uint64_t dataSize;
+    if (! getFileStatus(dataFileName, dataTime, dataSize))
+    {
+        errorStr = "Error reading file: " + dataFileName;
+        return false;
+    }
+
+    // no valid values
+    if (isEqual(minimum, NODATA) || isEqual(maximum, NODATA))
+    {
+        remove(statisticsFileName.c_str());
+        return true;
+    }
+
+    ofstream file(statisticsFileName);
+    if (! file.is_open())
+    {
+        errorStr = "Error writing file: " + statisticsFileName;
+        return false;
+    }
+
+    file.precision(9);
+    file << 1 << " " << minimum << " " << maximum << "\n";
+    file << "crit3d " << dataSize << " " << getRasterHeaderHash(header) << "\n";
+
+    if (! file.good())
+    {
+        errorStr = "Error writing file: " + statisticsFileName;
+        return false;
+    }
+
+    return true;
+}
+
+
 bool isBigEndianSystem()
 {
     const uint16_t value = 0x0102;
@@ -1147,19 +1330,26 @@ bool readEsriGridBil(const std::string& fileName, Crit3DRasterGrid* rasterGrid,
         return false;
     }
 
-    if (!rasterGrid->initializeGrid())
-    {
-        errorStr = "Memory error: file too big.";
-        return false;
-    }
+    // native float32: the grid is a view of the file
+    const bool isNativeFloat = (bilInfo.nBits == 32 && bilInfo.pixelType == "FLOAT"
+                                && (bilInfo.byteOrder == 'M') == isBigEndianSystem());
 
-    if (!readRasterBilData(fileName + ".bil", rasterGrid, bilInfo, errorStr))
+    if (! isNativeFloat || ! rasterGrid->mapFloatData(fileName + ".bil", 0))
     {
-        rasterGrid->clear();
-        return false;
+        if (!rasterGrid->initializeGrid())
+        {
+            errorStr = "Memory error: file too big.";
+            return false;
+        }
+
+        if (!readRasterBilData(fileName + ".bil", rasterGrid, bilInfo, errorStr))
+        {
+            rasterGrid->clear();
+            return false;
+        }
     }
 
-    gis::updateMinMaxRasterGrid(rasterGrid);
+    updateMinMaxFromStatistics(fileName + ".bil", rasterGrid);
     rasterGrid->isLoaded = true;
 
     return true;
@@ -1470,6 +1660,9 @@ bool writeEsriGridHeader(const string& fileName,
         return false;
     }
 
+    // UTM coordinates need more than the default 6 significant digits
+    file.precision(15);
+
     file << "ncols         "
          << header->nrCols << '\n';
 
@@ -1507,27 +1700,25 @@ bool writeEsriGridHeader(const string& fileName,
 }
 
 
-bool writeEsriGridFlt(const string& fileName,
-                      Crit3DRasterGrid* rasterGrid,
-                      string& errorStr)
+/*!
+ * \brief writeRasterFloatData
+ * writes the values in a temporary file which then replaces dataFileName:
+ * the old file is never truncated, the grids mapped on it keep viewing the old data.
+ * Minimum and maximum are computed while writing and saved in the statistics file
+ */
+static bool writeRasterFloatData(const string& dataFileName,
+                                 const Crit3DRasterGrid* rasterGrid,
+                                 string& errorStr)
 {
-    errorStr.clear();
-
-    if (rasterGrid == nullptr || rasterGrid->header == nullptr)
-    {
-        errorStr = "Invalid raster grid.";
-        return false;
-    }
+    const string tmpFileName = dataFileName + ".tmp";
 
-    const string outputFileName = fileName + ".flt";
-
-    FILE* file = fopen(outputFileName.c_str(), "wb");
+    FILE* file = fopen(tmpFileName.c_str(), "wb");
 
     if (file == nullptr)
     {
         errorStr =
             "Error writing file: " +
-            outputFileName +
+            tmpFileName +
             "\n" +
             strerror(errno);
 
@@ -1536,12 +1727,18 @@ bool writeEsriGridFlt(const string& fileName,
 
     const int nRows = rasterGrid->header->nrRows;
     const int nCols = rasterGrid->header->nrCols;
+    const float flag = rasterGrid->header->flag;
+
+    float minimum = NODATA;
+    float maximum = NODATA;
 
     for (int row = 0; row < nRows; ++row)
     {
+        const float* values = rasterGrid->value[row];
+
         const size_t written =
             fwrite(
-                rasterGrid->value[row],
+                values,
                 sizeof(float),
                 static_cast<size_t>(nCols),
                 file);
@@ -1555,20 +1752,71 @@ bool writeEsriGridFlt(const string& fileName,
                 ".";
 
             fclose(file);
+            remove(tmpFileName.c_str());
             return false;
         }
+
+        for (int col = 0; col < nCols; ++col)
+        {
+            const float value = values[col];
+            if (isEqual(value, flag) || isEqual(value, NODATA))
+                continue;
+
+            if (isEqual(minimum, NODATA))
+            {
+                minimum = value;
+                maximum = value;
+            }
+            else
+            {
+                minimum = std::min(minimum, value);
+                maximum = std::max(maximum, value);
+            }
+        }
     }
 
     if (fclose(file) != 0)
     {
         errorStr =
             "Error closing file: " +
-            outputFileName;
+            tmpFileName;
 
+        remove(tmpFileName.c_str());
         return false;
     }
 
-    return true;
+    // the old statistics would be valid for the new data written in the same second
+    remove(getStatisticsFileName(dataFileName).c_str());
+
+    if (! replaceFile(tmpFileName, dataFileName))
+    {
+        errorStr =
+            "Error replacing file: " +
+            dataFileName +
+            "\n" +
+            strerror(errno);
+
+        remove(tmpFileName.c_str());
+        return false;
+    }
+
+    return writeRasterStatistics(dataFileName, *(rasterGrid->header), minimum, maximum, errorStr);
+}
+
+
+bool writeEsriGridFlt(const string& fileName,
+                      Crit3DRasterGrid* rasterGrid,
+                      string& errorStr)
+{
+    errorStr.clear();
+
+    if (rasterGrid == nullptr || rasterGrid->header == nullptr)
+    {
+        errorStr = "Invalid raster grid.";
+        return false;
+    }
+
+    return writeRasterFloatData(fileName + ".flt", rasterGrid, errorStr);
 }
 
 
@@ -1638,7 +1886,7 @@ bool readEsriGridFlt(const string& fileName, Crit3DRasterGrid* rasterGrid, strin
         return false;
     }
 
-    gis::updateMinMaxRasterGrid(rasterGrid);
+    updateMinMaxFromStatistics(dataFileName, rasterGrid);
     rasterGrid->isLoaded = true;
 
     return true;
@@ -1678,13 +1926,88 @@ bool readEnviGrid(const string fileName, Crit3DRasterGrid* rasterGrid,
         return false;
     }
 
-    updateMinMaxRasterGrid(rasterGrid);
+    updateMinMaxFromStatistics(dataFileName, rasterGrid);
     rasterGrid->isLoaded = true;
 
     return true;
 }
 
 
+/*!
+ * \brief readRasterFileLayout
+ * reads the header of a binary raster (.flt, .bil, .img) and the position and type of its values,
+ * for reading windows of the raster (Crit3DRasterWindowReader)
+ */
+bool readRasterFileLayout(const string& fileName, int currentUtmZone, Crit3DRasterHeader* header,
+                          Crit3DRasterFileLayout& layout, string& errorStr)
+{
+    errorStr.clear();
+
+    if (header == nullptr || fileName.size() <= 4)
+    {
+        errorStr = "Wrong filename.";
+        return false;
+    }
+
+    const string extension = lowerCase(fileName.substr(fileName.size() - 4));
+    const string fileNameWithoutExt = fileName.substr(0, fileName.size() - 4);
+
+    layout.dataFileName = fileName;
+
+    if (extension == ".flt")
+    {
+        if (! readEsriFloatHeader(fileNameWithoutExt, header, errorStr))
+            return false;
+
+        layout.dataOffset = 0;
+        layout.nrBytes = 4;
+        layout.isFloat = true;
+        layout.isSwapBytes = ! isLittleEndianHost();
+        return true;
+    }
+
+    if (extension == ".img")
+    {
+        RasterFileInfo fileInfo;
+        if (! readEnviHeader(fileNameWithoutExt, header, currentUtmZone, fileInfo, errorStr))
+            return false;
+
+        layout.dataOffset = fileInfo.headerOffset;
+        layout.isFloat = (fileInfo.dataType == RasterDataType::Float32);
+        layout.nrBytes = (fileInfo.dataType == RasterDataType::UInt8 ? 1 : (fileInfo.dataType == RasterDataType::Int16 ? 2 : 4));
+        layout.isSwapBytes = ((fileInfo.byteOrder == ByteOrder::BigEndian) == isLittleEndianHost());
+        return true;
+    }
+
+    if (extension == ".bil")
+    {
+        EsriBilInfo bilInfo;
+        if (! readEsriBilHeader(fileNameWithoutExt, header, bilInfo, errorStr))
+            return false;
+
+        int utmZone;
+        if (! readEsriBilProjection(fileNameWithoutExt, utmZone, errorStr))
+            return false;
+
+        if (utmZone != currentUtmZone)
+        {
+            errorStr = "UTM zone: " + std::to_string(utmZone) + "\n" +
+                       "is different from current UTM zone: " + std::to_string(currentUtmZone);
+            return false;
+        }
+
+        layout.dataOffset = 0;
+        layout.nrBytes = bilInfo.nBits / 8;
+        layout.isFloat = (bilInfo.nBits == 32 && bilInfo.pixelType == "FLOAT");
+        layout.isSwapBytes = ((bilInfo.byteOrder == 'M') != isBigEndianSystem());
+        return true;
+    }
+
+    errorStr = "Format allowed: .flt, .bil, .img, .tgr";
+    return false;
+}
+
+
 bool readEsriGridAscii(const string& fileName, Crit3DRasterGrid* rasterGrid, string& errorStr)
 {
     errorStr.clear();
@@ -1967,7 +2290,8 @@ bool readEsriGridAscii(const string& fileName, Crit3DRasterGrid* rasterGrid, str
 }
 
 
-bool openRaster(const string fileName, Crit3DRasterGrid* rasterGrid, int currentUtmZone, string& errorStr)
+bool openRaster(const string fileName, Crit3DRasterGrid* rasterGrid, int currentUtmZone,
+                bool isParallelComputing, string& errorStr)
 {
     errorStr.clear();
 
@@ -2007,7 +2331,17 @@ bool openRaster(const string fileName, Crit3DRasterGrid* rasterGrid, int current
         return readEnviGrid(fileNameWithoutExt, rasterGrid, currentUtmZone, errorStr);
     }
 
-    errorStr = "Format allowed: .flt, .asc, .bil, .img";
+    if (extension == ".tgr")
+    {
+        return readTiledRaster(fileName, rasterGrid, errorStr);
+    }
+
+    if (extension == ".cgr")
+    {
+        return readCompressedRaster(fileName, rasterGrid, isParallelComputing, errorStr);
+    }
+
+    errorStr = "Format allowed: .flt, .asc, .bil, .img, .tgr, .cgr";
 
     return false;
 }
@@ -2027,22 +2361,8 @@ bool writeEnviGrid(string fileName,
         return false;
     }
 
-    const string imgFileName =
-        fileName + ".img";
-
-    FILE* file =
-        fopen(imgFileName.c_str(), "wb");
-
-    if (file == nullptr)
-    {
-        error =
-            "Error writing file: " +
-            imgFileName +
-            "\n" +
-            strerror(errno);
-
+    if (! writeRasterFloatData(fileName + ".img", rasterGrid, error))
         return false;
-    }
 
     const int nRows =
         rasterGrid->header->nrRows;
@@ -2050,37 +2370,6 @@ bool writeEnviGrid(string fileName,
     const int nCols =
         rasterGrid->header->nrCols;
 
-    for (int row = 0; row < nRows; ++row)
-    {
-        const size_t written =
-            fwrite(
-                rasterGrid->value[row],
-                sizeof(float),
-                static_cast<size_t>(nCols),
-                file);
-
-        if (written !=
-            static_cast<size_t>(nCols))
-        {
-            error =
-                "Error writing ENVI raster data "
-                "at row " +
-                to_string(row) + ".";
-
-            fclose(file);
-            return false;
-        }
-    }
-
-    if (fclose(file) != 0)
-    {
-        error =
-            "Error closing file: " +
-            imgFileName;
-
-        return false;
-    }
-
     const string headerFileName =
         fileName + ".hdr";
 
@@ -2097,6 +2386,8 @@ bool writeEnviGrid(string fileName,
         return false;
     }
 
+    headerFile.precision(15);
+
     headerFile << "ENVI\n";
     headerFile << "description = {raster grid}\n";
 
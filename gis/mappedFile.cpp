@@ -0,0 +1,178 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <cstdio>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+
+namespace gis
+{
+    Crit3DMappedFile::Crit3DMappedFile()
+    {
+        _data = nullptr;
+        _dataSize = 0;
+        #ifdef _WIN32
+            _fileHandle = nullptr;
+            _mapHandle = nullptr;
+        #else
+            _fileDescriptor = -1;
+        #endif
+    }
+
+
+    Crit3DMappedFile::~Crit3DMappedFile()
+    {
+        close();
+    }
+
+
+    void Crit3DMappedFile::close()
+    {
+        #ifdef _WIN32
+            if (_data != nullptr)
+                UnmapViewOfFile(_data);
+            if (_mapHandle != nullptr)
+                CloseHandle(_mapHandle);
+            if (_fileHandle != nullptr)
+                CloseHandle(_fileHandle);
+            _fileHandle = nullptr;
+            _mapHandle = nullptr;
+        #else
+            if (_data != nullptr)
+                munmap(_data, _dataSize);
+            if (_fileDescriptor != -1)
+                ::close(_fileDescriptor);
+            _fileDescriptor = -1;
+        #endif
+
+        _data = nullptr;
+        _dataSize = 0;
+    }
+
+
+    /*!
+     * \brief open
+     * maps the whole file in copy-on-write mode: the pages are read on demand,
+     * a modified page becomes a private copy and the file is never written.
+     * The file can be renamed or removed while it is mapped (see replaceFile)
+     */
+    bool Crit3DMappedFile::open(const std::string &fileName, std::string &errorStr)
+    {
+        close();
+
+        #ifdef _WIN32
+            _fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (_fileHandle == INVALID_HANDLE_VALUE)
+            {
+                _fileHandle = nullptr;
+                errorStr = "Error in opening file: " + fileName;
+                return false;
+            }
+
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(_fileHandle, &fileSize);
+            _dataSize = size_t(fileSize.QuadPart);
+
+            if (_dataSize > 0)
+            {
+                _mapHandle = CreateFileMappingA(_fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+                if (_mapHandle != nullptr)
+                    _data = static_cast<char*>(MapViewOfFile(_mapHandle, FILE_MAP_COPY, 0, 0, 0));
+            }
+        #else
+            _fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+            if (_fileDescriptor == -1)
+            {
+                errorStr = "Error in opening file: " + fileName;
+                return false;
+            }
+
+            struct stat fileStat;
+            if (fstat(_fileDescriptor, &fileStat) == 0 && fileStat.st_size > 0)
+            {
+                _dataSize = size_t(fileStat.st_size);
+                void* ptr = mmap(nullptr, _dataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fileDescriptor, 0);
+                if (ptr != MAP_FAILED)
+                    _data = static_cast<char*>(ptr);
+            }
+        #endif
+
+        if (_data == nullptr)
+        {
+            close();
+            errorStr = "Error in mapping file: " + fileName;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief replaceFile
+     * renames newFileName to fileName, replacing the old file without truncating it:
+     * the grids mapped on the old file keep viewing the old data
+     */
+    bool replaceFile(const std::string &newFileName, const std::string &fileName)
+    {
+        #ifdef _WIN32
+            if (MoveFileExA(newFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+                return true;
+
+            // a mapped file cannot be replaced, but it can be renamed and then removed:
+            // it is deleted when its last view is closed
+            const std::string oldFileName = fileName + ".old";
+            DeleteFileA(oldFileName.c_str());
+            if (! MoveFileExA(fileName.c_str(), oldFileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+                return false;
+
+            if (! MoveFileExA(newFileName.c_str(), fileName.c_str(), 0))
+            {
+                MoveFileExA(oldFileName.c_str(), fileName.c_str(), 0);
+                return false;
+            }
+
+            DeleteFileA(oldFileName.c_str());
+            return true;
+        #else
+            return std::rename(newFileName.c_str(), fileName.c_str()) == 0;
+        #endif
+    }
+}
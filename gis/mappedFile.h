@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+    #include <string>
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DMappedFile class
+         * copy-on-write memory mapping of a whole file (read only on disk)
+         */
+        class Crit3DMappedFile
+        {
+        private:
+            char* _data;
+            size_t _dataSize;
+            #ifdef _WIN32
+                void* _fileHandle;
+                void* _mapHandle;
+            #else
+                int _fileDescriptor;
+            #endif
+
+        public:
+            Crit3DMappedFile();
+            ~Crit3DMappedFile();
+
+            Crit3DMappedFile(const Crit3DMappedFile&) = delete;
+            Crit3DMappedFile& operator = (const Crit3DMappedFile&) = delete;
+
+            bool open(const std::string &fileName, std::string &errorStr);
+            void close();
+
+            bool isOpen() const { return _data != nullptr; }
+            char* data() const { return _data; }
+            size_t size() const { return _dataSize; }
+        };
+
+        bool replaceFile(const std::string &newFileName, const std::string &fileName);
+    }
+
+
+#endif // MAPPEDFILE_H
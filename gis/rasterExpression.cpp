@@ -0,0 +1,659 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "rasterExpression.h"
+
+
+namespace gis
+{
+    // missing values are NaN during the evaluation: arithmetic propagates them without tests
+    static const float MISSING = std::numeric_limits<float>::quiet_NaN();
+
+
+    Crit3DRasterExpression::Crit3DRasterExpression()
+    {
+        _root = -1;
+    }
+
+
+    void Crit3DRasterExpression::clear()
+    {
+        _nodes.clear();
+        _inputNames.clear();
+        _root = -1;
+    }
+
+
+    // the arguments are always added before the node: the nodes are evaluated in order
+    Crit3DRasterExpression::node Crit3DRasterExpression::addNode(expressionOperator op, node a, node b, node c)
+    {
+        Node newNode;
+        newNode.op = op;
+        newNode.value = 0;
+        newNode.input = -1;
+        newNode.arg[0] = a;
+        newNode.arg[1] = b;
+        newNode.arg[2] = c;
+
+        _nodes.push_back(newNode);
+        _root = node(_nodes.size()) - 1;
+        return _root;
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::constant(float value)
+    {
+        node n = addNode(exprConstant);
+        _nodes[unsigned(n)].value = value;
+        return n;
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::noData()
+    {
+        return addNode(exprNoData);
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::input(const std::string &name)
+    {
+        auto it = std::find(_inputNames.begin(), _inputNames.end(), name);
+        int index = int(it - _inputNames.begin());
+        if (it == _inputNames.end())
+            _inputNames.push_back(name);
+
+        node n = addNode(exprInput);
+        _nodes[unsigned(n)].input = index;
+        return n;
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::unary(expressionOperator op, node a)
+    {
+        return addNode(op, a);
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::binary(expressionOperator op, node a, node b)
+    {
+        return addNode(op, a, b);
+    }
+
+
+    Crit3DRasterExpression::node Crit3DRasterExpression::ifElse(node condition, node a, node b)
+    {
+        return addNode(exprIfElse, condition, a, b);
+    }
+
+
+    // the operations of mapAlgebra
+    Crit3DRasterExpression::node Crit3DRasterExpression::operation(operationType myOperation, node a, node b)
+    {
+        switch (myOperation)
+        {
+        case operationMin:
+            return binary(exprMin, a, b);
+        case operationMax:
+            return binary(exprMax, a, b);
+        case operationSum:
+            return binary(exprAdd, a, b);
+        case operationSubtract:
+            return binary(exprSubtract, a, b);
+        case operationProduct:
+            return binary(exprMultiply, a, b);
+        case operationDivide:
+            return binary(exprDivide, a, b);
+        }
+
+        return noData();
+    }
+
+
+    /*!
+     * \brief The ExpressionParser class
+     * recursive descent parser, from the lowest precedence:
+     * ||  &&  comparisons  + -  * /  unary -  (numbers, names, functions, parentheses)
+     */
+    class ExpressionParser
+    {
+    public:
+        typedef Crit3DRasterExpression::node node;
+
+        ExpressionParser(const std::string &text, Crit3DRasterExpression &expression)
+            : _text(text), _pos(0), _expression(expression) {}
+
+        bool parse(std::string &errorStr)
+        {
+            node root = parseOr();
+            skipSpaces();
+            if (root >= 0 && _pos < _text.size())
+                setError("unexpected '" + _text.substr(_pos, 1) + "'");
+
+            if (! _error.empty())
+            {
+                errorStr = "Wrong expression: " + _error + " at position " + std::to_string(_pos);
+                return false;
+            }
+
+            _expression.setRoot(root);
+            return true;
+        }
+
+    private:
+        const std::string &_text;
+        size_t _pos;
+        Crit3DRasterExpression &_expression;
+        std::string _error;
+
+        void setError(const std::string &error)
+        {
+            if (_error.empty())
+                _error = error;
+        }
+
+        void skipSpaces()
+        {
+            while (_pos < _text.size() && isspace(static_cast<unsigned char>(_text[_pos])))
+                _pos++;
+        }
+
+        bool match(const std::string &token)
+        {
+            skipSpaces();
+            if (_text.compare(_pos, token.size(), token) != 0)
+                return false;
+
+            _pos += token.size();
+            return true;
+        }
+
+        node parseOr()
+        {
+            node a = parseAnd();
+            while (a >= 0 && match("||"))
+            {
+                node b = parseAnd();
+                a = (b >= 0) ? _expression.binary(exprOr, a, b) : -1;
+            }
+            return a;
+        }
+
+        node parseAnd()
+        {
+            node a = parseComparison();
+            while (a >= 0 && match("&&"))
+            {
+                node b = parseComparison();
+                a = (b >= 0) ? _expression.binary(exprAnd, a, b) : -1;
+            }
+            return a;
+        }
+
+        node parseComparison()
+        {
+            node a = parseSum();
+            if (a < 0)
+                return a;
+
+            // the two chars operators first
+            static const std::vector<std::pair<std::string, expressionOperator>> comparisons =
+                { {"<=", exprLessEqual}, {">=", exprGreaterEqual}, {"==", exprEqual}, {"!=", exprNotEqual},
+                  {"<", exprLess}, {">", exprGreater} };
+
+            for (const auto &comparison : comparisons)
+            {
+                if (match(comparison.first))
+                {
+                    node b = parseSum();
+                    return (b >= 0) ? _expression.binary(comparison.second, a, b) : -1;
+                }
+            }
+
+            return a;
+        }
+
+        node parseSum()
+        {
+            node a = parseProduct();
+            while (a >= 0)
+            {
+                expressionOperator op;
+                if (match("+"))
+                    op = exprAdd;
+                else if (match("-"))
+                    op = exprSubtract;
+                else
+                    break;
+
+                node b = parseProduct();
+                a = (b >= 0) ? _expression.binary(op, a, b) : -1;
+            }
+            return a;
+        }
+
+        node parseProduct()
+        {
+            node a = parseUnary();
+            while (a >= 0)
+            {
+                expressionOperator op;
+                if (match("*"))
+                    op = exprMultiply;
+                else if (match("/"))
+                    op = exprDivide;
+                else
+                    break;
+
+                node b = parseUnary();
+                a = (b >= 0) ? _expression.binary(op, a, b) : -1;
+            }
+            return a;
+        }
+
+        node parseUnary()
+        {
+            if (match("-"))
+            {
+                node a = parseUnary();
+                return (a >= 0) ? _expression.unary(exprNegate, a) : -1;
+            }
+
+            return parsePrimary();
+        }
+
+        node parsePrimary()
+        {
+            skipSpaces();
+            if (_pos >= _text.size())
+            {
+                setError("unexpected end");
+                return -1;
+            }
+
+            if (match("("))
+            {
+                node a = parseOr();
+                if (a >= 0 && ! match(")"))
+                {
+                    setError("missing ')'");
+                    return -1;
+                }
+                return a;
+            }
+
+            char c = _text[_pos];
+
+            // number
+            if (isdigit(static_cast<unsigned char>(c)) || c == '.')
+            {
+                const char* start = _text.c_str() + _pos;
+                char* end;
+                double value = strtod(start, &end);
+                if (end == start)
+                {
+                    setError("wrong number");
+                    return -1;
+                }
+                _pos += size_t(end - start);
+                return _expression.constant(float(value));
+            }
+
+            // name or function
+            if (isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                size_t start = _pos;
+                while (_pos < _text.size() && (isalnum(static_cast<unsigned char>(_text[_pos])) || _text[_pos] == '_'))
+                    _pos++;
+                std::string name = _text.substr(start, _pos - start);
+
+                if (! match("("))
+                {
+                    if (name == "nodata")
+                        return _expression.noData();
+
+                    return _expression.input(name);
+                }
+
+                return parseFunction(name);
+            }
+
+            setError("unexpected '" + std::string(1, c) + "'");
+            return -1;
+        }
+
+        node parseFunction(const std::string &name)
+        {
+            std::vector<node> args;
+            if (! match(")"))
+            {
+                do
+                {
+                    node a = parseOr();
+                    if (a < 0)
+                        return -1;
+                    args.push_back(a);
+                }
+                while (match(","));
+
+                if (! match(")"))
+                {
+                    setError("missing ')'");
+                    return -1;
+                }
+            }
+
+            static const std::map<std::string, expressionOperator> unaryFunctions =
+                { {"abs", exprAbs}, {"sqrt", exprSqrt}, {"isvalid", exprIsValid} };
+            static const std::map<std::string, expressionOperator> binaryFunctions =
+                { {"min", exprMin}, {"max", exprMax}, {"coalesce", exprCoalesce} };
+
+            if (name == "nodata" && args.empty())
+                return _expression.noData();
+
+            auto unaryIt = unaryFunctions.find(name);
+            if (unaryIt != unaryFunctions.end() && args.size() == 1)
+                return _expression.unary(unaryIt->second, args[0]);
+
+            auto binaryIt = binaryFunctions.find(name);
+            if (binaryIt != binaryFunctions.end() && args.size() == 2)
+                return _expression.binary(binaryIt->second, args[0], args[1]);
+
+            if (name == "ifelse" && args.size() == 3)
+                return _expression.ifElse(args[0], args[1], args[2]);
+
+            setError("wrong function " + name + " (" + std::to_string(args.size()) + " arguments)");
+            return -1;
+        }
+    };
+
+
+    bool Crit3DRasterExpression::parse(const std::string &text, std::string &errorStr)
+    {
+        clear();
+
+        ExpressionParser parser(text, *this);
+        if (! parser.parse(errorStr))
+        {
+            clear();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief The InputSampling struct
+     * how the cells of an input raster are read for the output grid:
+     * same grid or aligned grid with the same cell size (row/col offsets), or by coordinates
+     */
+    struct InputSampling
+    {
+        const Crit3DRasterGrid* grid;
+        bool isAligned;
+        int rowOffset;
+        int colOffset;
+    };
+
+
+    static InputSampling getInputSampling(const Crit3DRasterGrid* grid, const Crit3DRasterHeader &outputHeader)
+    {
+        InputSampling sampling;
+        sampling.grid = grid;
+        sampling.isAligned = false;
+        sampling.rowOffset = 0;
+        sampling.colOffset = 0;
+
+        const Crit3DRasterHeader &header = *(grid->header);
+        if (fabs(header.cellSize - outputHeader.cellSize) > outputHeader.cellSize * EPSILON)
+            return sampling;
+
+        double colOffset = (outputHeader.llCorner.x - header.llCorner.x) / header.cellSize;
+        double outputTop = outputHeader.llCorner.y + outputHeader.nrRows * outputHeader.cellSize;
+        double inputTop = header.llCorner.y + header.nrRows * header.cellSize;
+        double rowOffset = (inputTop - outputTop) / header.cellSize;
+
+        if (fabs(colOffset - round(colOffset)) > 0.001 || fabs(rowOffset - round(rowOffset)) > 0.001)
+            return sampling;
+
+        sampling.isAligned = true;
+        sampling.rowOffset = int(round(rowOffset));
+        sampling.colOffset = int(round(colOffset));
+        return sampling;
+    }
+
+
+    static void readInputRow(const InputSampling &sampling, const Crit3DRasterHeader &outputHeader, int row, float* values)
+    {
+        const Crit3DRasterGrid &grid = *(sampling.grid);
+        const float flag = grid.header->flag;
+        const int nrCols = outputHeader.nrCols;
+
+        if (sampling.isAligned)
+        {
+            int inputRow = row + sampling.rowOffset;
+            if (inputRow < 0 || inputRow >= grid.header->nrRows)
+            {
+                std::fill(values, values + nrCols, MISSING);
+                return;
+            }
+
+            const float* inputValues = grid.value[inputRow];
+            int firstCol = std::max(0, -sampling.colOffset);
+            int lastCol = std::min(nrCols, grid.header->nrCols - sampling.colOffset);
+
+            std::fill(values, values + std::min(firstCol, nrCols), MISSING);
+            for (int col = firstCol; col < lastCol; col++)
+            {
+                float value = inputValues[col + sampling.colOffset];
+                values[col] = isEqual(value, flag) ? MISSING : value;
+            }
+            if (lastCol < nrCols)
+                std::fill(values + std::max(lastCol, 0), values + nrCols, MISSING);
+        }
+        else
+        {
+            double y = outputHeader.llCorner.y + (outputHeader.nrRows - row - 0.5) * outputHeader.cellSize;
+            for (int col = 0; col < nrCols; col++)
+            {
+                double x = outputHeader.llCorner.x + (col + 0.5) * outputHeader.cellSize;
+                float value = grid.getValueFromXY(x, y);
+                values[col] = isEqual(value, flag) ? MISSING : value;
+            }
+        }
+    }
+
+
+    /*!
+     * \brief evaluate
+     * evaluate the expression on the cells of outputHeader, the output raster must not be an input
+     */
+    bool Crit3DRasterExpression::evaluate(const std::map<std::string, const Crit3DRasterGrid*> &inputs,
+                                          const Crit3DRasterHeader &outputHeader, Crit3DRasterGrid &outputGrid,
+                                          bool isParallelComputing, std::string &errorStr) const
+    {
+        if (isEmpty())
+        {
+            errorStr = "Empty expression.";
+            return false;
+        }
+
+        std::vector<InputSampling> samplings;
+        for (const std::string &name : _inputNames)
+        {
+            auto it = inputs.find(name);
+            if (it == inputs.end() || it->second == nullptr || it->second->data() == nullptr)
+            {
+                errorStr = "Missing raster: " + name;
+                return false;
+            }
+            if (it->second == &outputGrid)
+            {
+                errorStr = "The output raster can not be an input: " + name;
+                return false;
+            }
+
+            samplings.push_back(getInputSampling(it->second, outputHeader));
+        }
+
+        if (! outputGrid.initializeGrid(outputHeader))
+        {
+            errorStr = "Memory error: file too big.";
+            return false;
+        }
+
+        const int nrRows = outputHeader.nrRows;
+        const int nrCols = outputHeader.nrCols;
+        const size_t nrNodes = _nodes.size();
+        const float flag = outputHeader.flag;
+
+        #pragma omp parallel if (isParallelComputing)
+        {
+            // one row of values for each node
+            std::vector<float> buffer(nrNodes * size_t(nrCols));
+            auto nodeValues = [&buffer, nrCols](node n) { return buffer.data() + size_t(n) * size_t(nrCols); };
+
+            for (size_t n = 0; n < nrNodes; n++)
+            {
+                if (_nodes[n].op == exprConstant)
+                    std::fill(nodeValues(node(n)), nodeValues(node(n)) + nrCols, _nodes[n].value);
+                else if (_nodes[n].op == exprNoData)
+                    std::fill(nodeValues(node(n)), nodeValues(node(n)) + nrCols, MISSING);
+            }
+
+            #pragma omp for schedule(dynamic)
+            for (int row = 0; row < nrRows; row++)
+            {
+                for (size_t n = 0; n < nrNodes; n++)
+                {
+                    const Node &myNode = _nodes[n];
+                    float* out = nodeValues(node(n));
+                    const float* a = (myNode.arg[0] >= 0) ? nodeValues(myNode.arg[0]) : nullptr;
+                    const float* b = (myNode.arg[1] >= 0) ? nodeValues(myNode.arg[1]) : nullptr;
+                    const float* c = (myNode.arg[2] >= 0) ? nodeValues(myNode.arg[2]) : nullptr;
+
+                    switch (myNode.op)
+                    {
+                    case exprConstant: case exprNoData:
+                        break;
+                    case exprInput:
+                        readInputRow(samplings[unsigned(myNode.input)], outputHeader, row, out);
+                        break;
+                    case exprNegate:
+                        for (int i = 0; i < nrCols; i++) out[i] = -a[i];
+                        break;
+                    case exprAbs:
+                        for (int i = 0; i < nrCols; i++) out[i] = std::fabs(a[i]);
+                        break;
+                    case exprSqrt:
+                        for (int i = 0; i < nrCols; i++) out[i] = (a[i] >= 0) ? std::sqrt(a[i]) : MISSING;
+                        break;
+                    case exprIsValid:
+                        for (int i = 0; i < nrCols; i++) out[i] = std::isnan(a[i]) ? 0.f : 1.f;
+                        break;
+                    case exprAdd:
+                        for (int i = 0; i < nrCols; i++) out[i] = a[i] + b[i];
+                        break;
+                    case exprSubtract:
+                        for (int i = 0; i < nrCols; i++) out[i] = a[i] - b[i];
+                        break;
+                    case exprMultiply:
+                        for (int i = 0; i < nrCols; i++) out[i] = a[i] * b[i];
+                        break;
+                    case exprDivide:
+                        for (int i = 0; i < nrCols; i++) out[i] = (b[i] != 0.f) ? a[i] / b[i] : MISSING;
+                        break;
+                    case exprMin:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : std::min(a[i], b[i]);
+                        break;
+                    case exprMax:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : std::max(a[i], b[i]);
+                        break;
+                    case exprLess:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] < b[i]);
+                        break;
+                    case exprLessEqual:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] <= b[i]);
+                        break;
+                    case exprGreater:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] > b[i]);
+                        break;
+                    case exprGreaterEqual:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] >= b[i]);
+                        break;
+                    case exprEqual:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(isEqual(a[i], b[i]));
+                        break;
+                    case exprNotEqual:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(! isEqual(a[i], b[i]));
+                        break;
+                    case exprAnd:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] != 0.f && b[i] != 0.f);
+                        break;
+                    case exprOr:
+                        for (int i = 0; i < nrCols; i++) out[i] = (std::isnan(a[i]) || std::isnan(b[i])) ? MISSING : float(a[i] != 0.f || b[i] != 0.f);
+                        break;
+                    case exprCoalesce:
+                        for (int i = 0; i < nrCols; i++) out[i] = std::isnan(a[i]) ? b[i] : a[i];
+                        break;
+                    case exprIfElse:
+                        for (int i = 0; i < nrCols; i++) out[i] = std::isnan(a[i]) ? MISSING : ((a[i] != 0.f) ? b[i] : c[i]);
+                        break;
+                    }
+                }
+
+                const float* result = nodeValues(_root);
+                float* outputRow = outputGrid.value[row];
+                for (int i = 0; i < nrCols; i++)
+                    outputRow[i] = std::isnan(result[i]) ? flag : result[i];
+            }
+        }
+
+        updateMinMaxRasterGrid(&outputGrid, isParallelComputing);
+        return true;
+    }
+
+
+    bool evaluateRasterExpression(const std::string &text, const std::map<std::string, const Crit3DRasterGrid*> &inputs,
+                                  const Crit3DRasterHeader &outputHeader, Crit3DRasterGrid &outputGrid,
+                                  bool isParallelComputing, std::string &errorStr)
+    {
+        Crit3DRasterExpression expression;
+        if (! expression.parse(text, errorStr))
+            return false;
+
+        return expression.evaluate(inputs, outputHeader, outputGrid, isParallelComputing, errorStr);
+    }
+}
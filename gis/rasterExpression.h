@@ -0,0 +1,76 @@
+#ifndef RASTEREXPRESSION_H
+#define RASTEREXPRESSION_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    #include <map>
+
+    namespace gis
+    {
+        enum expressionOperator {exprConstant, exprNoData, exprInput,
+                                 exprNegate, exprAbs, exprSqrt, exprIsValid,
+                                 exprAdd, exprSubtract, exprMultiply, exprDivide, exprMin, exprMax,
+                                 exprLess, exprLessEqual, exprGreater, exprGreaterEqual, exprEqual, exprNotEqual,
+                                 exprAnd, exprOr, exprCoalesce, exprIfElse};
+
+        /*!
+         * \brief The Crit3DRasterExpression class
+         * expression over named rasters and constants, built with the node functions or parsed from text, e.g.
+         * "ifelse(isvalid(mask), min(dem * 0.5, 100), nodata)"
+         * The whole expression is evaluated in a single pass (parallel on rows, vectorized on columns).
+         * Nodata: a cell equal to the flag of its raster (or outside it) is missing, every operation
+         * with a missing operand is missing, except isvalid (0/1) and coalesce (first valid value).
+         * Division by zero is missing. Comparisons and logical operators return 0/1.
+         */
+        class Crit3DRasterExpression
+        {
+        public:
+            typedef int node;
+
+        private:
+            struct Node
+            {
+                expressionOperator op;
+                float value;
+                int input;
+                node arg[3];
+            };
+
+            std::vector<Node> _nodes;
+            std::vector<std::string> _inputNames;
+            node _root;
+
+            node addNode(expressionOperator op, node a = -1, node b = -1, node c = -1);
+
+        public:
+            Crit3DRasterExpression();
+
+            void clear();
+            bool isEmpty() const { return _root < 0; }
+
+            node constant(float value);
+            node noData();
+            node input(const std::string &name);
+            node unary(expressionOperator op, node a);
+            node binary(expressionOperator op, node a, node b);
+            node ifElse(node condition, node a, node b);
+            node operation(operationType myOperation, node a, node b);
+
+            void setRoot(node root) { _root = root; }
+            const std::vector<std::string>& getInputNames() const { return _inputNames; }
+
+            bool parse(const std::string &text, std::string &errorStr);
+
+            bool evaluate(const std::map<std::string, const Crit3DRasterGrid*> &inputs, const Crit3DRasterHeader &outputHeader,
+                          Crit3DRasterGrid &outputGrid, bool isParallelComputing, std::string &errorStr) const;
+        };
+
+        bool evaluateRasterExpression(const std::string &text, const std::map<std::string, const Crit3DRasterGrid*> &inputs,
+                                      const Crit3DRasterHeader &outputHeader, Crit3DRasterGrid &outputGrid,
+                                      bool isParallelComputing, std::string &errorStr);
+    }
+
+
+#endif // RASTEREXPRESSION_H
@@ -0,0 +1,273 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "rasterStatistics.h"
+
+#include <algorithm>
+#include <math.h>
+#include <unordered_set>
+
+
+namespace gis
+{
+    /*!
+     * partial statistics of a row: mean and m2 are computed from the differences
+     * from the first valid value of the row, to avoid the cancellation of the sum of squares
+     */
+    struct RowStatistics
+    {
+        long nrValues = 0;
+        float minimum = NODATA;
+        float maximum = NODATA;
+        double mean = 0;
+        double m2 = 0;                          // sum of the squared differences from the mean
+    };
+
+
+    template <bool isClassification>
+    static void computeRowStatistics(const float* rowValues, int col0, int col1, float flag, RowStatistics &s,
+                                     int nrHistogramBins, double histogramMinimum, double binsOnRange,
+                                     std::vector<long> &histogram, bool isUnique, std::unordered_set<int> &uniqueSet)
+    {
+        // categories: integer values of all the cells different from the flag (also NODATA)
+        if (isClassification && isUnique)
+        {
+            const int flagInt = int(flag);
+            for (int col = col0; col <= col1; col++)
+            {
+                int valueInt = int(rowValues[col]);
+                if (valueInt != flagInt)
+                    uniqueSet.insert(valueInt);
+            }
+        }
+
+        // first valid value
+        int firstCol = col0;
+        while (firstCol <= col1 && (isEqual(rowValues[firstCol], flag) || isEqual(rowValues[firstCol], NODATA)))
+            firstCol++;
+
+        if (firstCol > col1)
+            return;
+
+        const double shift = double(rowValues[firstCol]);
+        float minimum = rowValues[firstCol];
+        float maximum = rowValues[firstCol];
+        double sum = 0;
+        double sumSquares = 0;
+        long nrValues = 0;
+
+        // without branches on the valid values (random nodata cells)
+        for (int col = firstCol; col <= col1; col++)
+        {
+            float value = rowValues[col];
+            bool isValid = ! isEqual(value, flag) && ! isEqual(value, NODATA);
+
+            minimum = isValid ? std::min(minimum, value) : minimum;
+            maximum = isValid ? std::max(maximum, value) : maximum;
+
+            double delta = isValid ? double(value) - shift : 0.;
+            sum += delta;
+            sumSquares += delta * delta;
+            nrValues += isValid;
+
+            if (isClassification && isValid)
+            {
+                if (nrHistogramBins > 0)
+                {
+                    double position = (double(value) - histogramMinimum) * binsOnRange;
+                    if (position >= 0 && position <= nrHistogramBins)
+                    {
+                        int bin = std::min(int(position), nrHistogramBins - 1);
+                        histogram[unsigned(bin)]++;
+                    }
+                }
+            }
+        }
+
+        double meanDelta = sum / double(nrValues);
+        s.nrValues = nrValues;
+        s.minimum = minimum;
+        s.maximum = maximum;
+        s.mean = shift + meanDelta;
+        s.m2 = std::max(sumSquares - sum * meanDelta, 0.);
+    }
+
+
+    Crit3DRasterStatistics::Crit3DRasterStatistics()
+    {
+        _nrHistogramBins = 0;
+        _histogramMinimum = NODATA;
+        _histogramMaximum = NODATA;
+        _isUniqueValues = false;
+
+        initialize();
+    }
+
+
+    void Crit3DRasterStatistics::initialize()
+    {
+        nrValues = 0;
+        minimum = NODATA;
+        maximum = NODATA;
+        mean = NODATA;
+        variance = NODATA;
+
+        histogram.assign(unsigned(_nrHistogramBins), 0);
+        uniqueValues.clear();
+    }
+
+
+    /*!
+     * \brief setHistogram
+     * nrBins bins of equal width in [histogramMinimum, histogramMaximum] (the maximum is in the last bin),
+     * nrBins = 0: no histogram
+     */
+    void Crit3DRasterStatistics::setHistogram(int nrBins, float histogramMinimum, float histogramMaximum)
+    {
+        if (nrBins <= 0 || isEqual(histogramMinimum, NODATA) || isEqual(histogramMaximum, NODATA)
+            || histogramMaximum <= histogramMinimum)
+        {
+            nrBins = 0;
+        }
+
+        _nrHistogramBins = nrBins;
+        _histogramMinimum = histogramMinimum;
+        _histogramMaximum = histogramMaximum;
+        histogram.assign(unsigned(_nrHistogramBins), 0);
+    }
+
+
+    bool Crit3DRasterStatistics::compute(const Crit3DRasterGrid &raster, bool isParallelComputing)
+    {
+        return compute(raster, 0, 0, raster.header->nrRows - 1, raster.header->nrCols - 1, isParallelComputing);
+    }
+
+
+    /*!
+     * \brief compute
+     * statistics of the window [row0, row1] x [col0, col1] (limited to the raster)
+     * returns false if the raster has no values, true otherwise (also if there are no valid values: nrValues = 0)
+     */
+    bool Crit3DRasterStatistics::compute(const Crit3DRasterGrid &raster, int row0, int col0, int row1, int col1,
+                                         bool isParallelComputing)
+    {
+        initialize();
+
+        if (raster.data() == nullptr)
+            return false;
+
+        if (row0 > row1) std::swap(row0, row1);
+        if (col0 > col1) std::swap(col0, col1);
+        row0 = std::max(row0, 0);
+        col0 = std::max(col0, 0);
+        row1 = std::min(row1, raster.header->nrRows - 1);
+        col1 = std::min(col1, raster.header->nrCols - 1);
+        if (row1 < row0 || col1 < col0)
+            return true;
+
+        const float flag = raster.header->flag;
+        const int nrRows = row1 - row0 + 1;
+        const int nrHistogramBins = _nrHistogramBins;
+        const double binsOnRange = nrHistogramBins > 0 ? nrHistogramBins / (double(_histogramMaximum) - double(_histogramMinimum)) : 0;
+        const double histogramMinimum = double(_histogramMinimum);
+        const bool isUnique = _isUniqueValues;
+
+        std::vector<RowStatistics> rowStatistics;
+        rowStatistics.resize(unsigned(nrRows));
+        std::unordered_set<int> uniqueSet;
+
+        #pragma omp parallel if (isParallelComputing)
+        {
+            std::vector<long> threadHistogram(unsigned(nrHistogramBins), 0);
+            std::unordered_set<int> threadUniqueSet;
+
+            #pragma omp for schedule(dynamic, 16)
+            for (int i = 0; i < nrRows; i++)
+            {
+                const float* rowValues = raster.value[row0 + i];
+                RowStatistics &s = rowStatistics[unsigned(i)];
+
+                if (nrHistogramBins > 0 || isUnique)
+                    computeRowStatistics<true>(rowValues, col0, col1, flag, s, nrHistogramBins, histogramMinimum,
+                                               binsOnRange, threadHistogram, isUnique, threadUniqueSet);
+                else
+                    computeRowStatistics<false>(rowValues, col0, col1, flag, s, nrHistogramBins, histogramMinimum,
+                                                binsOnRange, threadHistogram, isUnique, threadUniqueSet);
+            }
+
+            #pragma omp critical
+            {
+                for (unsigned bin = 0; bin < unsigned(nrHistogramBins); bin++)
+                    histogram[bin] += threadHistogram[bin];
+
+                uniqueSet.insert(threadUniqueSet.begin(), threadUniqueSet.end());
+            }
+        }
+
+        // merge the rows in order (Chan et al. parallel variance)
+        double totalMean = 0;
+        double totalM2 = 0;
+        for (const RowStatistics &s : rowStatistics)
+        {
+            if (s.nrValues == 0)
+                continue;
+
+            if (nrValues == 0)
+            {
+                minimum = s.minimum;
+                maximum = s.maximum;
+                totalMean = s.mean;
+                totalM2 = s.m2;
+                nrValues = s.nrValues;
+                continue;
+            }
+
+            minimum = std::min(minimum, s.minimum);
+            maximum = std::max(maximum, s.maximum);
+
+            long n = nrValues + s.nrValues;
+            double delta = s.mean - totalMean;
+            totalMean += delta * double(s.nrValues) / double(n);
+            totalM2 += s.m2 + delta * delta * double(nrValues) * double(s.nrValues) / double(n);
+            nrValues = n;
+        }
+
+        if (nrValues > 0)
+            mean = totalMean;
+        if (nrValues > 1)
+            variance = totalM2 / double(nrValues - 1);
+
+        if (isUnique)
+        {
+            uniqueValues.assign(uniqueSet.begin(), uniqueSet.end());
+            std::sort(uniqueValues.begin(), uniqueValues.end());
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef RASTERSTATISTICS_H
+#define RASTERSTATISTICS_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    // rasters with less cells are always scanned by a single thread
+    #define RASTER_STATISTICS_PARALLEL_CELLS 262144
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DRasterStatistics class
+         * statistics of the valid values (not flag and not NODATA) of a raster or of a window,
+         * computed in a single parallel pass: count, minimum, maximum, mean, variance and optionally
+         * a fixed-bin histogram and the set of the unique integer values (categories: integer part of all
+         * the cells different from the integer flag, NODATA included, as extractUniqueValues has always done).
+         * The rows are reduced separately and merged in order: the result doesn't depend on the threads
+         */
+        class Crit3DRasterStatistics
+        {
+        private:
+            int _nrHistogramBins;
+            float _histogramMinimum;
+            float _histogramMaximum;
+            bool _isUniqueValues;
+
+        public:
+            long nrValues;
+            float minimum;
+            float maximum;
+            double mean;
+            double variance;                    // sample variance (n - 1), NODATA if less than 2 values
+
+            std::vector<long> histogram;        // values outside the histogram range are not counted
+            std::vector<int> uniqueValues;      // sorted
+
+            Crit3DRasterStatistics();
+
+            void initialize();
+
+            void setHistogram(int nrBins, float histogramMinimum, float histogramMaximum);
+            void setUniqueValues(bool isUniqueValues) { _isUniqueValues = isUniqueValues; }
+
+            int getNrHistogramBins() const { return _nrHistogramBins; }
+            float getHistogramMinimum() const { return _histogramMinimum; }
+            float getHistogramMaximum() const { return _histogramMaximum; }
+
+            bool compute(const Crit3DRasterGrid &raster, bool isParallelComputing);
+            bool compute(const Crit3DRasterGrid &raster, int row0, int col0, int row1, int col1, bool isParallelComputing);
+        };
+    }
+
+
+#endif // RASTERSTATISTICS_H
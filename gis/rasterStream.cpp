@@ -0,0 +1,722 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "rasterExpression.h"
+#include "mappedFile.h"
+#include "rasterStream.h"
+
+
+namespace gis
+{
+    static bool seekFile(FILE* file, uint64_t offset)
+    {
+    #ifdef _WIN32
+        return _fseeki64(file, int64_t(offset), SEEK_SET) == 0;
+    #else
+        return fseeko(file, off_t(offset), SEEK_SET) == 0;
+    #endif
+    }
+
+
+    // converts nrValues values of the file to float
+    static void decodeValues(const uint8_t* source, float* destination, int nrValues, const Crit3DRasterFileLayout &layout)
+    {
+        const size_t nrBytes = size_t(layout.nrBytes);
+        uint8_t bytes[4];
+
+        for (int i = 0; i < nrValues; i++)
+        {
+            const uint8_t* value = source + size_t(i) * nrBytes;
+            if (nrBytes == 1)
+            {
+                destination[i] = float(*value);
+                continue;
+            }
+
+            for (size_t k = 0; k < nrBytes; k++)
+                bytes[k] = layout.isSwapBytes ? value[nrBytes - 1 - k] : value[k];
+
+            if (nrBytes == 2)
+            {
+                int16_t intValue;
+                memcpy(&intValue, bytes, 2);
+                destination[i] = float(intValue);
+            }
+            else if (layout.isFloat)
+            {
+                memcpy(&destination[i], bytes, 4);
+            }
+            else
+            {
+                int32_t intValue;
+                memcpy(&intValue, bytes, 4);
+                destination[i] = float(intValue);
+            }
+        }
+    }
+
+
+    Crit3DRasterWindowReader::Crit3DRasterWindowReader()
+    {
+        _file = nullptr;
+    }
+
+
+    Crit3DRasterWindowReader::~Crit3DRasterWindowReader()
+    {
+        close();
+    }
+
+
+    void Crit3DRasterWindowReader::close()
+    {
+        if (_file != nullptr)
+        {
+            fclose(_file);
+            _file = nullptr;
+        }
+
+        _tiledRaster.close();
+        _buffer.clear();
+    }
+
+
+    /*!
+     * \brief open
+     * reads the header of the raster (.flt, .bil, .img, .tgr), the values are read by readWindow
+     */
+    bool Crit3DRasterWindowReader::open(const std::string &fileName, int currentUtmZone, std::string &errorStr)
+    {
+        close();
+        errorStr.clear();
+
+        std::string extension;
+        if (fileName.size() > 4)
+        {
+            extension = fileName.substr(fileName.size() - 4);
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        }
+
+        if (extension == ".tgr")
+        {
+            if (! _tiledRaster.open(fileName, errorStr))
+                return false;
+
+            _header = _tiledRaster.getHeader(0);
+            return true;
+        }
+
+        if (! readRasterFileLayout(fileName, currentUtmZone, &_header, _layout, errorStr))
+            return false;
+
+        if (_layout.nrBytes != 1 && _layout.nrBytes != 2 && _layout.nrBytes != 4)
+        {
+            errorStr = "Wrong data type: " + fileName;
+            return false;
+        }
+
+        _file = fopen(_layout.dataFileName.c_str(), "rb");
+        if (_file == nullptr)
+        {
+            errorStr = "Error opening raster file: " + _layout.dataFileName + "\n" + strerror(errno);
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief readWindow
+     * reads the cells [firstRow, firstRow + nrRows) x [firstCol, firstCol + nrCols), limited to the raster:
+     * outputGrid header is the window header. Returns false if the window is outside the raster
+     */
+    bool Crit3DRasterWindowReader::readWindow(int firstRow, int firstCol, int nrRows, int nrCols,
+                                              Crit3DRasterGrid &outputGrid, bool isParallelComputing)
+    {
+        if (_tiledRaster.isOpen())
+            return _tiledRaster.readWindow(0, firstRow, firstCol, nrRows, nrCols, outputGrid, isParallelComputing);
+
+        if (_file == nullptr)
+            return false;
+
+        int lastRow = std::min(firstRow + nrRows, _header.nrRows);
+        int lastCol = std::min(firstCol + nrCols, _header.nrCols);
+        firstRow = std::max(firstRow, 0);
+        firstCol = std::max(firstCol, 0);
+        if (firstRow >= lastRow || firstCol >= lastCol)
+            return false;
+
+        Crit3DRasterHeader windowHeader = _header;
+        windowHeader.nrRows = lastRow - firstRow;
+        windowHeader.nrCols = lastCol - firstCol;
+        windowHeader.llCorner.x = _header.llCorner.x + firstCol * _header.cellSize;
+        windowHeader.llCorner.y = _header.llCorner.y + (_header.nrRows - lastRow) * _header.cellSize;
+
+        if (! outputGrid.initializeGrid(windowHeader))
+            return false;
+
+        const size_t nrBytes = size_t(_layout.nrBytes);
+        const size_t rowBytes = size_t(windowHeader.nrCols) * nrBytes;
+        const bool isNativeFloat = (_layout.isFloat && nrBytes == 4 && ! _layout.isSwapBytes);
+        if (! isNativeFloat)
+            _buffer.resize(rowBytes);
+
+        for (int row = firstRow; row < lastRow; row++)
+        {
+            uint64_t offset = _layout.dataOffset + (uint64_t(row) * uint64_t(_header.nrCols) + uint64_t(firstCol)) * nrBytes;
+            float* destination = outputGrid.value[row - firstRow];
+
+            if (! seekFile(_file, offset))
+                return false;
+
+            if (isNativeFloat)
+            {
+                if (fread(destination, 1, rowBytes, _file) != rowBytes)
+                    return false;
+            }
+            else
+            {
+                if (fread(_buffer.data(), 1, rowBytes, _file) != rowBytes)
+                    return false;
+
+                decodeValues(_buffer.data(), destination, windowHeader.nrCols, _layout);
+            }
+        }
+
+        updateMinMaxRasterGrid(&outputGrid, isParallelComputing);
+        outputGrid.isLoaded = true;
+        return true;
+    }
+
+
+    Crit3DRasterStripWriter::Crit3DRasterStripWriter()
+    {
+        _file = nullptr;
+        _nrWrittenRows = 0;
+        _minimum = NODATA;
+        _maximum = NODATA;
+    }
+
+
+    Crit3DRasterStripWriter::~Crit3DRasterStripWriter()
+    {
+        // not closed: the old header and data files are left unchanged
+        if (_file != nullptr)
+        {
+            fclose(_file);
+            removeTemporaryFiles();
+        }
+    }
+
+
+    // the header is written in fileName.tmp.hdr, the data in fileName.flt.tmp
+    void Crit3DRasterStripWriter::removeTemporaryFiles()
+    {
+        remove((_fileName + ".tmp.hdr").c_str());
+        remove((_fileName + ".flt.tmp").c_str());
+    }
+
+
+    /*!
+     * \brief open
+     * writes the header and creates the data file in temporary files,
+     * which replace fileName.hdr and fileName.flt on close
+     */
+    bool Crit3DRasterStripWriter::open(const std::string &fileName, const Crit3DRasterHeader &header, std::string &errorStr)
+    {
+        if (_file != nullptr)
+        {
+            fclose(_file);
+            removeTemporaryFiles();
+            _file = nullptr;
+        }
+
+        _header = header;
+        _fileName = fileName;
+        _nrWrittenRows = 0;
+        _minimum = NODATA;
+        _maximum = NODATA;
+
+        if (! writeEsriGridHeader(fileName + ".tmp", &_header, errorStr))
+        {
+            removeTemporaryFiles();
+            return false;
+        }
+
+        // the old files are replaced on close (not truncated): the grids mapped on them keep viewing the old data
+        std::string tmpFileName = fileName + ".flt.tmp";
+
+        _file = fopen(tmpFileName.c_str(), "wb");
+        if (_file == nullptr)
+        {
+            errorStr = "Error writing file: " + tmpFileName + "\n" + strerror(errno);
+            removeTemporaryFiles();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief writeRows
+     * appends all the rows of strip (same columns of the raster, flag converted to the raster flag)
+     */
+    bool Crit3DRasterStripWriter::writeRows(const Crit3DRasterGrid &strip, std::string &errorStr)
+    {
+        if (_file == nullptr)
+        {
+            errorStr = "Raster file is not open: " + _fileName;
+            return false;
+        }
+
+        const int nrCols = _header.nrCols;
+        if (strip.header->nrCols != nrCols || _nrWrittenRows + strip.header->nrRows > _header.nrRows)
+        {
+            errorStr = "Wrong strip size: " + _fileName;
+            return false;
+        }
+
+        const bool isSameFlag = isEqual(strip.header->flag, _header.flag);
+        std::vector<float> rowValues;
+
+        for (int row = 0; row < strip.header->nrRows; row++)
+        {
+            const float* values = strip.value[row];
+            if (! isSameFlag)
+            {
+                rowValues.assign(values, values + nrCols);
+                std::replace(rowValues.begin(), rowValues.end(), strip.header->flag, _header.flag);
+                values = rowValues.data();
+            }
+
+            if (fwrite(values, sizeof(float), size_t(nrCols), _file) != size_t(nrCols))
+            {
+                errorStr = "Error writing raster data at row " + std::to_string(_nrWrittenRows) + ": " + _fileName;
+                return false;
+            }
+
+            for (int col = 0; col < nrCols; col++)
+            {
+                if (isEqual(values[col], _header.flag) || isEqual(values[col], NODATA))
+                    continue;
+
+                if (isEqual(_minimum, NODATA))
+                {
+                    _minimum = values[col];
+                    _maximum = values[col];
+                }
+                else
+                {
+                    _minimum = std::min(_minimum, values[col]);
+                    _maximum = std::max(_maximum, values[col]);
+                }
+            }
+
+            _nrWrittenRows++;
+        }
+
+        return true;
+    }
+
+
+    bool Crit3DRasterStripWriter::close(std::string &errorStr)
+    {
+        if (_file == nullptr)
+            return true;
+
+        const std::string dataFileName = _fileName + ".flt";
+        const std::string tmpFileName = dataFileName + ".tmp";
+
+        bool isOk = (fclose(_file) == 0);
+        _file = nullptr;
+
+        if (! isOk)
+        {
+            errorStr = "Error closing file: " + tmpFileName;
+            removeTemporaryFiles();
+            return false;
+        }
+
+        if (_nrWrittenRows != _header.nrRows)
+        {
+            errorStr = "Incomplete raster: " + _fileName;
+            removeTemporaryFiles();
+            return false;
+        }
+
+        // the old statistics would be valid for the new data written in the same second
+        std::string statisticsFileName = _fileName + ".stx";
+        remove(statisticsFileName.c_str());
+
+        if (! replaceFile(tmpFileName, dataFileName))
+        {
+            errorStr = "Error replacing file: " + dataFileName + "\n" + strerror(errno);
+            removeTemporaryFiles();
+            return false;
+        }
+
+        const std::string headerFileName = _fileName + ".hdr";
+        if (! replaceFile(_fileName + ".tmp.hdr", headerFileName))
+        {
+            errorStr = "Error replacing file: " + headerFileName + "\n" + strerror(errno);
+            removeTemporaryFiles();
+            return false;
+        }
+
+        return writeRasterStatistics(dataFileName, _header, _minimum, _maximum, errorStr);
+    }
+
+
+    // input cells covering the area of stripHeader, plus nrHaloCells on each side
+    static void getInputWindow(const Crit3DRasterHeader &inputHeader, const Crit3DRasterHeader &stripHeader, int nrHaloCells,
+                               int &firstRow, int &firstCol, int &nrRows, int &nrCols)
+    {
+        const double tolerance = 1e-6;
+        const double invCellSize = 1. / inputHeader.cellSize;
+        const double inputTop = inputHeader.llCorner.y + inputHeader.nrRows * inputHeader.cellSize;
+        const double stripTop = stripHeader.llCorner.y + stripHeader.nrRows * stripHeader.cellSize;
+        const double stripRight = stripHeader.llCorner.x + stripHeader.nrCols * stripHeader.cellSize;
+
+        firstRow = int(floor((inputTop - stripTop) * invCellSize + tolerance)) - nrHaloCells;
+        int lastRow = int(ceil((inputTop - stripHeader.llCorner.y) * invCellSize - tolerance)) + nrHaloCells;
+        firstCol = int(floor((stripHeader.llCorner.x - inputHeader.llCorner.x) * invCellSize + tolerance)) - nrHaloCells;
+        int lastCol = int(ceil((stripRight - inputHeader.llCorner.x) * invCellSize - tolerance)) + nrHaloCells;
+
+        nrRows = lastRow - firstRow;
+        nrCols = lastCol - firstCol;
+    }
+
+
+    // copies the values of source in destination (same cell size, aligned cells)
+    static void copyAlignedValues(const Crit3DRasterGrid &source, Crit3DRasterGrid &destination)
+    {
+        const double cellSize = destination.header->cellSize;
+        const double sourceTop = source.header->llCorner.y + source.header->nrRows * cellSize;
+        const double destinationTop = destination.header->llCorner.y + destination.header->nrRows * cellSize;
+        const int rowOffset = int(std::round((sourceTop - destinationTop) / cellSize));
+        const int colOffset = int(std::round((destination.header->llCorner.x - source.header->llCorner.x) / cellSize));
+
+        for (int row = 0; row < destination.header->nrRows; row++)
+        {
+            int sourceRow = row + rowOffset;
+            if (sourceRow < 0 || sourceRow >= source.header->nrRows)
+                continue;
+
+            for (int col = 0; col < destination.header->nrCols; col++)
+            {
+                int sourceCol = col + colOffset;
+                if (sourceCol < 0 || sourceCol >= source.header->nrCols)
+                    continue;
+
+                float value = source.value[sourceRow][sourceCol];
+                if (! isEqual(value, source.header->flag))
+                    destination.value[row][col] = value;
+            }
+        }
+    }
+
+
+    /*!
+     * \brief processRasterStrips
+     * block iterator for rasters larger than memory: the output area is processed in strips of nrStripRows rows,
+     * reading for each input only the window that covers the strip (plus nrHaloCells cells on each side,
+     * for neighbourhood operations) and appending the output strips to the output files (ESRI float).
+     * The memory used is proportional to the strip size
+     */
+    bool processRasterStrips(const std::vector<std::string> &inputFileNames, int currentUtmZone,
+                             const Crit3DRasterHeader &outputHeader, const std::vector<std::string> &outputFileNames,
+                             int nrStripRows, int nrHaloCells, const rasterStripOperation &operation,
+                             bool isParallelComputing, std::string &errorStr)
+    {
+        errorStr.clear();
+
+        if (nrStripRows < 1 || nrHaloCells < 0 || outputHeader.nrRows < 1 || outputHeader.nrCols < 1)
+        {
+            errorStr = "Wrong strip parameters.";
+            return false;
+        }
+
+        std::vector<Crit3DRasterWindowReader> readers(inputFileNames.size());
+        for (size_t i = 0; i < inputFileNames.size(); i++)
+        {
+            if (! readers[i].open(inputFileNames[i], currentUtmZone, errorStr))
+                return false;
+        }
+
+        std::vector<Crit3DRasterStripWriter> writers(outputFileNames.size());
+        for (size_t i = 0; i < outputFileNames.size(); i++)
+        {
+            if (! writers[i].open(outputFileNames[i], outputHeader, errorStr))
+                return false;
+        }
+
+        std::vector<Crit3DRasterGrid> inputWindows(inputFileNames.size());
+        std::vector<Crit3DRasterGrid> outputStrips(outputFileNames.size());
+        std::vector<const Crit3DRasterGrid*> inputList;
+        std::vector<Crit3DRasterGrid*> outputList;
+        for (size_t i = 0; i < inputWindows.size(); i++)
+            inputList.push_back(&inputWindows[i]);
+        for (size_t i = 0; i < outputStrips.size(); i++)
+            outputList.push_back(&outputStrips[i]);
+
+        for (int firstRow = 0; firstRow < outputHeader.nrRows; firstRow += nrStripRows)
+        {
+            Crit3DRasterHeader stripHeader = outputHeader;
+            stripHeader.nrRows = std::min(nrStripRows, outputHeader.nrRows - firstRow);
+            stripHeader.llCorner.y = outputHeader.llCorner.y
+                                     + (outputHeader.nrRows - firstRow - stripHeader.nrRows) * outputHeader.cellSize;
+
+            for (size_t i = 0; i < readers.size(); i++)
+            {
+                int windowFirstRow, windowFirstCol, windowNrRows, windowNrCols;
+                getInputWindow(readers[i].getHeader(), stripHeader, nrHaloCells,
+                               windowFirstRow, windowFirstCol, windowNrRows, windowNrCols);
+
+                if (! readers[i].readWindow(windowFirstRow, windowFirstCol, windowNrRows, windowNrCols,
+                                            inputWindows[i], isParallelComputing))
+                {
+                    // the strip is outside the input raster: a nodata cell
+                    Crit3DRasterHeader emptyHeader = readers[i].getHeader();
+                    emptyHeader.nrRows = 1;
+                    emptyHeader.nrCols = 1;
+                    emptyHeader.llCorner = stripHeader.llCorner;
+                    inputWindows[i].initializeGrid(emptyHeader);
+                }
+            }
+
+            for (size_t i = 0; i < outputStrips.size(); i++)
+            {
+                if (! outputStrips[i].initializeGrid(stripHeader))
+                {
+                    errorStr = "Memory error: strip too big.";
+                    return false;
+                }
+            }
+
+            if (! operation(stripHeader, firstRow, inputList, outputList))
+            {
+                errorStr = "Error in processing rows " + std::to_string(firstRow) + " - "
+                           + std::to_string(firstRow + stripHeader.nrRows - 1) + ".";
+                return false;
+            }
+
+            for (size_t i = 0; i < writers.size(); i++)
+            {
+                if (outputStrips[i].header->nrRows != stripHeader.nrRows || outputStrips[i].header->nrCols != stripHeader.nrCols)
+                {
+                    errorStr = "Wrong strip size: " + outputFileNames[i];
+                    return false;
+                }
+
+                if (! writers[i].writeRows(outputStrips[i], errorStr))
+                    return false;
+            }
+        }
+
+        for (size_t i = 0; i < writers.size(); i++)
+        {
+            if (! writers[i].close(errorStr))
+                return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief computeSlopeAspectMapsStream
+     * computeSlopeAspectMaps on strips with one halo cell: same result of the whole dem
+     */
+    bool computeSlopeAspectMapsStream(const std::string &demFileName, int currentUtmZone,
+                                      const std::string &slopeFileName, const std::string &aspectFileName,
+                                      int nrStripRows, bool isParallelComputing, std::string &errorStr)
+    {
+        Crit3DRasterWindowReader demReader;
+        if (! demReader.open(demFileName, currentUtmZone, errorStr))
+            return false;
+
+        Crit3DRasterHeader demHeader = demReader.getHeader();
+        demReader.close();
+
+        auto operation = [isParallelComputing](const Crit3DRasterHeader&, int,
+                                               const std::vector<const Crit3DRasterGrid*> &inputWindows,
+                                               const std::vector<Crit3DRasterGrid*> &outputStrips)
+        {
+            Crit3DRasterGrid slopeWindow, aspectWindow;
+            if (! computeSlopeAspectMaps(*inputWindows[0], &slopeWindow, &aspectWindow, isParallelComputing))
+                return false;
+
+            copyAlignedValues(slopeWindow, *outputStrips[0]);
+            copyAlignedValues(aspectWindow, *outputStrips[1]);
+            return true;
+        };
+
+        return processRasterStrips({demFileName}, currentUtmZone, demHeader, {slopeFileName, aspectFileName},
+                                   nrStripRows, 1, operation, isParallelComputing, errorStr);
+    }
+
+
+    /*!
+     * \brief evaluateRasterExpressionStream
+     * map algebra (see Crit3DRasterExpression) on raster files: inputFileNames associates
+     * the names of the expression to the files. The output is written in strips
+     */
+    bool evaluateRasterExpressionStream(const std::string &text, const std::map<std::string, std::string> &inputFileNames,
+                                        int currentUtmZone, const Crit3DRasterHeader &outputHeader,
+                                        const std::string &outputFileName, int nrStripRows,
+                                        bool isParallelComputing, std::string &errorStr)
+    {
+        Crit3DRasterExpression expression;
+        if (! expression.parse(text, errorStr))
+            return false;
+
+        const std::vector<std::string> &inputNames = expression.getInputNames();
+        std::vector<std::string> fileNames;
+        for (const std::string &name : inputNames)
+        {
+            auto it = inputFileNames.find(name);
+            if (it == inputFileNames.end())
+            {
+                errorStr = "Missing raster: " + name;
+                return false;
+            }
+            fileNames.push_back(it->second);
+        }
+
+        auto operation = [&expression, &inputNames, isParallelComputing](const Crit3DRasterHeader &stripHeader, int,
+                                                                         const std::vector<const Crit3DRasterGrid*> &inputWindows,
+                                                                         const std::vector<Crit3DRasterGrid*> &outputStrips)
+        {
+            std::map<std::string, const Crit3DRasterGrid*> inputs;
+            for (size_t i = 0; i < inputNames.size(); i++)
+                inputs[inputNames[i]] = inputWindows[i];
+
+            std::string expressionError;
+            return expression.evaluate(inputs, stripHeader, *outputStrips[0], isParallelComputing, expressionError);
+        };
+
+        return processRasterStrips(fileNames, currentUtmZone, outputHeader, {outputFileName},
+                                   nrStripRows, 0, operation, isParallelComputing, errorStr);
+    }
+
+
+    /*!
+     * \brief resampleGridStream
+     * resampleGrid of a raster file on outputHeader, written in strips
+     */
+    bool resampleGridStream(const std::string &inputFileName, int currentUtmZone, const Crit3DRasterHeader &outputHeader,
+                            aggregationMethod elab, float nodataRatioThreshold, const std::string &outputFileName,
+                            int nrStripRows, std::string &errorStr)
+    {
+        auto operation = [elab, nodataRatioThreshold](const Crit3DRasterHeader &stripHeader, int,
+                                                      const std::vector<const Crit3DRasterGrid*> &inputWindows,
+                                                      const std::vector<Crit3DRasterGrid*> &outputStrips)
+        {
+            Crit3DRasterHeader newHeader = stripHeader;
+            resampleGrid(*inputWindows[0], outputStrips[0], &newHeader, elab, nodataRatioThreshold);
+            return true;
+        };
+
+        return processRasterStrips({inputFileName}, currentUtmZone, outputHeader, {outputFileName},
+                                   nrStripRows, 1, operation, false, errorStr);
+    }
+
+
+    /*!
+     * \brief clipRasterWithRasterStream
+     * clipRasterWithRaster on raster files: the first pass finds the cells of the reference raster
+     * inside the mask, the second one writes them
+     */
+    bool clipRasterWithRasterStream(const std::string &refFileName, const std::string &maskFileName, int currentUtmZone,
+                                    const std::string &outputFileName, int nrStripRows,
+                                    bool isParallelComputing, std::string &errorStr)
+    {
+        Crit3DRasterWindowReader refReader;
+        if (! refReader.open(refFileName, currentUtmZone, errorStr))
+            return false;
+
+        const Crit3DRasterHeader refHeader = refReader.getHeader();
+        refReader.close();
+
+        // bounding box of the cells of the reference raster inside the mask
+        int firstRow = refHeader.nrRows;
+        int lastRow = -1;
+        int firstCol = refHeader.nrCols;
+        int lastCol = -1;
+
+        auto boundingBox = [&](const Crit3DRasterHeader &stripHeader, int stripFirstRow,
+                               const std::vector<const Crit3DRasterGrid*> &inputWindows,
+                               const std::vector<Crit3DRasterGrid*> &)
+        {
+            const Crit3DRasterGrid &maskWindow = *inputWindows[0];
+            for (int row = 0; row < stripHeader.nrRows; row++)
+            {
+                for (int col = 0; col < stripHeader.nrCols; col++)
+                {
+                    double x, y;
+                    getUtmXYFromRowCol(stripHeader, row, col, &x, &y);
+                    if (isEqual(maskWindow.getValueFromXY(x, y), maskWindow.header->flag))
+                        continue;
+
+                    firstRow = std::min(firstRow, stripFirstRow + row);
+                    lastRow = std::max(lastRow, stripFirstRow + row);
+                    firstCol = std::min(firstCol, col);
+                    lastCol = std::max(lastCol, col);
+                }
+            }
+            return true;
+        };
+
+        if (! processRasterStrips({maskFileName}, currentUtmZone, refHeader, {}, nrStripRows, 0,
+                                  boundingBox, isParallelComputing, errorStr))
+            return false;
+
+        if (lastRow < 0)
+        {
+            errorStr = "The mask does not overlap the raster.";
+            return false;
+        }
+
+        Crit3DRasterHeader header = refHeader;
+        header.nrRows = lastRow - firstRow + 1;
+        header.nrCols = lastCol - firstCol + 1;
+        header.llCorner.x = refHeader.llCorner.x + refHeader.cellSize * firstCol;
+        header.llCorner.y = refHeader.llCorner.y + refHeader.cellSize * (refHeader.nrRows - lastRow - 1);
+
+        return evaluateRasterExpressionStream("ifelse(isvalid(mask), ref, nodata)", {{"ref", refFileName}, {"mask", maskFileName}},
+                                              currentUtmZone, header, outputFileName, nrStripRows, isParallelComputing, errorStr);
+    }
+}
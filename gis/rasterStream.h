@@ -0,0 +1,130 @@
+#ifndef RASTERSTREAM_H
+#define RASTERSTREAM_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+    #ifndef TILEDRASTER_H
+        #include "tiledRaster.h"
+    #endif
+
+    #include <cstdio>
+    #include <functional>
+    #include <map>
+
+    #define RASTER_STREAM_STRIPROWS 512
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DRasterFileLayout struct
+         * position and type of the values of a binary raster file (rows from top to bottom)
+         */
+        struct Crit3DRasterFileLayout
+        {
+            std::string dataFileName;
+            size_t dataOffset = 0;
+            int nrBytes = 4;
+            bool isFloat = true;
+            bool isSwapBytes = false;
+        };
+
+        bool readRasterFileLayout(const std::string &fileName, int currentUtmZone, Crit3DRasterHeader *header,
+                                  Crit3DRasterFileLayout &layout, std::string &errorStr);
+
+
+        /*!
+         * \brief The Crit3DRasterWindowReader class
+         * reads windows of a raster file (.flt, .bil, .img, .tgr) without loading the whole raster
+         */
+        class Crit3DRasterWindowReader
+        {
+        private:
+            Crit3DRasterHeader _header;
+            Crit3DRasterFileLayout _layout;
+            FILE* _file;
+            Crit3DTiledRaster _tiledRaster;
+            std::vector<uint8_t> _buffer;
+
+        public:
+            Crit3DRasterWindowReader();
+            ~Crit3DRasterWindowReader();
+
+            Crit3DRasterWindowReader(const Crit3DRasterWindowReader&) = delete;
+            Crit3DRasterWindowReader& operator = (const Crit3DRasterWindowReader&) = delete;
+
+            bool open(const std::string &fileName, int currentUtmZone, std::string &errorStr);
+            void close();
+
+            bool isOpen() const { return _file != nullptr || _tiledRaster.isOpen(); }
+            const Crit3DRasterHeader& getHeader() const { return _header; }
+
+            bool readWindow(int firstRow, int firstCol, int nrRows, int nrCols,
+                            Crit3DRasterGrid &outputGrid, bool isParallelComputing);
+        };
+
+
+        /*!
+         * \brief The Crit3DRasterStripWriter class
+         * writes an ESRI float raster (.hdr, .flt) incrementally, in strips of rows from top to bottom.
+         * Header and data are written in temporary files which replace the .hdr and .flt files on close
+         */
+        class Crit3DRasterStripWriter
+        {
+        private:
+            Crit3DRasterHeader _header;
+            std::string _fileName;
+            FILE* _file;
+            int _nrWrittenRows;
+            float _minimum, _maximum;
+
+            void removeTemporaryFiles();
+
+        public:
+            Crit3DRasterStripWriter();
+            ~Crit3DRasterStripWriter();
+
+            Crit3DRasterStripWriter(const Crit3DRasterStripWriter&) = delete;
+            Crit3DRasterStripWriter& operator = (const Crit3DRasterStripWriter&) = delete;
+
+            bool open(const std::string &fileName, const Crit3DRasterHeader &header, std::string &errorStr);
+            bool writeRows(const Crit3DRasterGrid &strip, std::string &errorStr);
+            bool close(std::string &errorStr);
+
+            int getNrWrittenRows() const { return _nrWrittenRows; }
+        };
+
+
+        /*!
+         * operation on a strip: inputWindows cover the strip area plus the halo cells,
+         * outputStrips (one for each output file) are initialized with stripHeader (nodata values)
+         */
+        typedef std::function<bool(const Crit3DRasterHeader &stripHeader, int firstRow,
+                                   const std::vector<const Crit3DRasterGrid*> &inputWindows,
+                                   const std::vector<Crit3DRasterGrid*> &outputStrips)> rasterStripOperation;
+
+        bool processRasterStrips(const std::vector<std::string> &inputFileNames, int currentUtmZone,
+                                 const Crit3DRasterHeader &outputHeader, const std::vector<std::string> &outputFileNames,
+                                 int nrStripRows, int nrHaloCells, const rasterStripOperation &operation,
+                                 bool isParallelComputing, std::string &errorStr);
+
+        bool computeSlopeAspectMapsStream(const std::string &demFileName, int currentUtmZone,
+                                          const std::string &slopeFileName, const std::string &aspectFileName,
+                                          int nrStripRows, bool isParallelComputing, std::string &errorStr);
+
+        bool evaluateRasterExpressionStream(const std::string &text, const std::map<std::string, std::string> &inputFileNames,
+                                            int currentUtmZone, const Crit3DRasterHeader &outputHeader,
+                                            const std::string &outputFileName, int nrStripRows,
+                                            bool isParallelComputing, std::string &errorStr);
+
+        bool resampleGridStream(const std::string &inputFileName, int currentUtmZone, const Crit3DRasterHeader &outputHeader,
+                                aggregationMethod elab, float nodataRatioThreshold, const std::string &outputFileName,
+                                int nrStripRows, std::string &errorStr);
+
+        bool clipRasterWithRasterStream(const std::string &refFileName, const std::string &maskFileName, int currentUtmZone,
+                                        const std::string &outputFileName, int nrStripRows,
+                                        bool isParallelComputing, std::string &errorStr);
+    }
+
+
+#endif // RASTERSTREAM_H
@@ -0,0 +1,348 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "statistics.h"
+#include "resamplePlan.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+namespace gis
+{
+    Crit3DResamplePlan::Crit3DResamplePlan()
+    {
+        clear();
+    }
+
+
+    void Crit3DResamplePlan::clear()
+    {
+        _sourceHeader = Crit3DRasterHeader();
+        _outputHeader = Crit3DRasterHeader();
+        _nrSamples = 0;
+        _rows = ResampleAxis();
+        _cols = ResampleAxis();
+    }
+
+
+    /*!
+     * \brief initialize
+     * computes the source cells of each output column and row.
+     * Downsampling (output cell size greater than the source one): nrSamples x nrSamples sample points
+     * in each output cell, nrSamples = floor(resampleFactor) + 1, as in resampleGrid
+     */
+    bool Crit3DResamplePlan::initialize(const Crit3DRasterHeader &sourceHeader, const Crit3DRasterHeader &outputHeader)
+    {
+        clear();
+
+        if (sourceHeader.nrRows <= 0 || sourceHeader.nrCols <= 0
+            || outputHeader.nrRows <= 0 || outputHeader.nrCols <= 0)
+            return false;
+
+        _sourceHeader = sourceHeader;
+        _outputHeader = outputHeader;
+
+        const Crit3DRasterHeader &s = _sourceHeader;
+        const Crit3DRasterHeader &h = _outputHeader;
+
+        // cell centers
+        _cols.center.resize(unsigned(h.nrCols));
+        for (int col = 0; col < h.nrCols; col++)
+        {
+            double x = h.llCorner.x + h.cellSize * (double(col) + 0.5);
+            int sourceCol = int((x - s.llCorner.x) * s.invCellSize);
+            _cols.center[unsigned(col)] = (unsigned(sourceCol) < unsigned(s.nrCols)) ? sourceCol : -1;
+        }
+
+        _rows.center.resize(unsigned(h.nrRows));
+        for (int row = 0; row < h.nrRows; row++)
+        {
+            double y = h.llCorner.y + h.cellSize * (double(h.nrRows - row) - 0.5);
+            int sourceRow = (s.nrRows - 1) - int((y - s.llCorner.y) * s.invCellSize);
+            _rows.center[unsigned(row)] = (unsigned(sourceRow) < unsigned(s.nrRows)) ? sourceRow : -1;
+        }
+
+        double resampleFactor = h.cellSize / s.cellSize;
+        if (resampleFactor <= 1.)
+            return true;
+
+        // sample points: columns from left to right, rows from bottom to top
+        _nrSamples = int(floor(resampleFactor)) + 1;
+        double step = h.cellSize / _nrSamples;
+        double halfStep = step * 0.5;
+
+        _cols.firstRun.resize(unsigned(h.nrCols) + 1);
+        for (int col = 0; col < h.nrCols; col++)
+        {
+            _cols.firstRun[unsigned(col)] = int(_cols.runIndex.size());
+
+            double x0 = h.llCorner.x + h.cellSize * (double(col) + 0.5);
+            double xFirst = x0 - (h.cellSize / 2) + halfStep;
+            for (int i = 0; i < _nrSamples; i++)
+            {
+                double x = xFirst + step * i;
+                int sourceCol = int((x - s.llCorner.x) * s.invCellSize);
+                if (unsigned(sourceCol) >= unsigned(s.nrCols))
+                    continue;
+
+                if (int(_cols.runIndex.size()) > _cols.firstRun[unsigned(col)] && _cols.runIndex.back() == sourceCol)
+                {
+                    _cols.runWeight.back()++;
+                }
+                else
+                {
+                    _cols.runIndex.push_back(sourceCol);
+                    _cols.runWeight.push_back(1);
+                }
+            }
+        }
+        _cols.firstRun[unsigned(h.nrCols)] = int(_cols.runIndex.size());
+
+        _rows.firstRun.resize(unsigned(h.nrRows) + 1);
+        for (int row = 0; row < h.nrRows; row++)
+        {
+            _rows.firstRun[unsigned(row)] = int(_rows.runIndex.size());
+
+            double y0 = h.llCorner.y + h.cellSize * (double(h.nrRows - row) - 0.5);
+            double yFirst = y0 - (h.cellSize / 2) + halfStep;
+            for (int j = 0; j < _nrSamples; j++)
+            {
+                double y = yFirst + step * j;
+                int sourceRow = (s.nrRows - 1) - int((y - s.llCorner.y) * s.invCellSize);
+                if (unsigned(sourceRow) >= unsigned(s.nrRows))
+                    continue;
+
+                if (int(_rows.runIndex.size()) > _rows.firstRun[unsigned(row)] && _rows.runIndex.back() == sourceRow)
+                {
+                    _rows.runWeight.back()++;
+                }
+                else
+                {
+                    _rows.runIndex.push_back(sourceRow);
+                    _rows.runWeight.push_back(1);
+                }
+            }
+        }
+        _rows.firstRun[unsigned(h.nrRows)] = int(_rows.runIndex.size());
+
+        return true;
+    }
+
+
+    /*!
+     * \brief isCompatible
+     * true if the plan was computed for the same geometry (flags are not compared)
+     */
+    bool Crit3DResamplePlan::isCompatible(const Crit3DRasterHeader &sourceHeader, const Crit3DRasterHeader &outputHeader) const
+    {
+        if (isEmpty())
+            return false;
+
+        const Crit3DRasterHeader &s = _sourceHeader;
+        const Crit3DRasterHeader &h = _outputHeader;
+
+        return (sourceHeader.nrRows == s.nrRows && sourceHeader.nrCols == s.nrCols
+                && sourceHeader.cellSize == s.cellSize && sourceHeader.invCellSize == s.invCellSize
+                && sourceHeader.llCorner.x == s.llCorner.x && sourceHeader.llCorner.y == s.llCorner.y
+                && outputHeader.nrRows == h.nrRows && outputHeader.nrCols == h.nrCols
+                && outputHeader.cellSize == h.cellSize
+                && outputHeader.llCorner.x == h.llCorner.x && outputHeader.llCorner.y == h.llCorner.y);
+    }
+
+
+    /*!
+     * \brief aggregateCell
+     * aggregation of the sample points of an output cell (each source cell counts as many times as its samples).
+     * Median, 95th percentile and prevailing value are computed on the list of the samples in the order of
+     * resampleGrid, the other methods on the weighted values. Sum and integral are not defined on samples.
+     */
+    float Crit3DResamplePlan::aggregateCell(const Crit3DRasterGrid &sourceGrid, int row, int col, aggregationMethod elab,
+                                            float nodataRatioThreshold, std::vector<float> &values) const
+    {
+        const float sourceFlag = sourceGrid.header->flag;
+        const int firstColRun = _cols.firstRun[unsigned(col)];
+        const int lastColRun = _cols.firstRun[unsigned(col) + 1];
+        const int firstRowRun = _rows.firstRun[unsigned(row)];
+        const int lastRowRun = _rows.firstRun[unsigned(row) + 1];
+        const int maxNrValues = _nrSamples * _nrSamples;
+
+        if (elab == aggrMedian || elab == aggr95Perc || elab == aggrPrevailing)
+        {
+            values.clear();
+            for (int c = firstColRun; c < lastColRun; c++)
+            {
+                int sourceCol = _cols.runIndex[unsigned(c)];
+                for (int i = 0; i < _cols.runWeight[unsigned(c)]; i++)
+                {
+                    for (int r = firstRowRun; r < lastRowRun; r++)
+                    {
+                        float value = sourceGrid.value[_rows.runIndex[unsigned(r)]][sourceCol];
+                        if (! isEqual(value, sourceFlag))
+                            values.insert(values.end(), unsigned(_rows.runWeight[unsigned(r)]), value);
+                    }
+                }
+            }
+
+            int nrValues = int(values.size());
+            if ((float(nrValues) / float(maxNrValues)) <= nodataRatioThreshold || nrValues == 0)
+                return NODATA;
+
+            if (elab == aggrMedian)
+                return sorting::percentile(values, nrValues, 50, true);
+            else if (elab == aggr95Perc)
+                return sorting::percentile(values, nrValues, 95, true);
+            else
+            {
+                int nrMissing = maxNrValues - nrValues;
+                if (nrMissing < nrValues)
+                    return prevailingValue(values);
+                return NODATA;
+            }
+        }
+
+        if (elab != aggrAverage && elab != aggrStdDeviation && elab != aggrMin && elab != aggrMax)
+            return NODATA;
+
+        int nrValues = 0;
+        int nrAverageValues = 0;
+        double sum = 0;
+        double sumSquares = 0;
+        float minValue = NODATA;
+        float maxValue = NODATA;
+
+        for (int c = firstColRun; c < lastColRun; c++)
+        {
+            int sourceCol = _cols.runIndex[unsigned(c)];
+            int colWeight = _cols.runWeight[unsigned(c)];
+            for (int r = firstRowRun; r < lastRowRun; r++)
+            {
+                float value = sourceGrid.value[_rows.runIndex[unsigned(r)]][sourceCol];
+                if (isEqual(value, sourceFlag))
+                    continue;
+
+                int weight = colWeight * _rows.runWeight[unsigned(r)];
+                nrValues += weight;
+
+                if (isEqual(minValue, NODATA) || value < minValue)
+                    minValue = value;
+                if (isEqual(maxValue, NODATA) || value > maxValue)
+                    maxValue = value;
+
+                // as statistics::mean, values equal to NODATA are not averaged
+                if (! isEqual(value, NODATA))
+                {
+                    sum += double(value) * weight;
+                    sumSquares += double(value) * double(value) * weight;
+                    nrAverageValues += weight;
+                }
+            }
+        }
+
+        if (nrValues == 0 || (float(nrValues) / float(maxNrValues)) <= nodataRatioThreshold)
+            return NODATA;
+
+        if (elab == aggrMin)
+            return minValue;
+        if (elab == aggrMax)
+            return maxValue;
+
+        if (nrAverageValues == 0)
+            return NODATA;
+
+        double average = sum / double(nrAverageValues);
+        if (elab == aggrAverage)
+            return float(average);
+
+        // standard deviation of the samples
+        if (nrAverageValues < 2)
+            return NODATA;
+
+        double variance = (sumSquares - average * sum) / double(nrAverageValues - 1);
+        return float(sqrt(std::max(variance, 0.)));
+    }
+
+
+    /*!
+     * \brief apply
+     * resamples sourceGrid (with the source geometry of the plan) on the output header.
+     * Upsampling and aggrCenter: value of the source cell containing the output cell center
+     */
+    bool Crit3DResamplePlan::apply(const Crit3DRasterGrid &sourceGrid, Crit3DRasterGrid &outputGrid, aggregationMethod elab,
+                                   float nodataRatioThreshold, bool isParallelComputing) const
+    {
+        if (! isCompatible(*(sourceGrid.header), _outputHeader))
+            return false;
+
+        *(outputGrid.header) = _outputHeader;
+        if (! outputGrid.initializeGrid(_outputHeader.flag))
+            return false;
+
+        const bool isCenter = (_nrSamples == 0 || elab == aggrCenter);
+        const float sourceFlag = sourceGrid.header->flag;
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int row = 0; row < _outputHeader.nrRows; row++)
+        {
+            std::vector<float> values;
+            if (! isCenter && (elab == aggrMedian || elab == aggr95Perc || elab == aggrPrevailing))
+                values.reserve(unsigned(_nrSamples * _nrSamples));
+
+            for (int col = 0; col < _outputHeader.nrCols; col++)
+            {
+                float value = NODATA;
+
+                if (isCenter)
+                {
+                    int sourceRow = _rows.center[unsigned(row)];
+                    int sourceCol = _cols.center[unsigned(col)];
+                    if (sourceRow >= 0 && sourceCol >= 0)
+                    {
+                        float sourceValue = sourceGrid.value[sourceRow][sourceCol];
+                        if (! isEqual(sourceValue, sourceFlag))
+                            value = sourceValue;
+                    }
+                }
+                else
+                {
+                    value = aggregateCell(sourceGrid, row, col, elab, nodataRatioThreshold, values);
+                }
+
+                if (! isEqual(value, NODATA))
+                {
+                    outputGrid.value[row][col] = value;
+                }
+            }
+        }
+
+        updateMinMaxRasterGrid(&outputGrid, isParallelComputing);
+        outputGrid.isLoaded = true;
+
+        return true;
+    }
+}
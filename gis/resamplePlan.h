@@ -0,0 +1,55 @@
+#ifndef RESAMPLEPLAN_H
+#define RESAMPLEPLAN_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DResamplePlan class
+         * resampling of the rasters of a source header on an output header (same result of resampleGrid).
+         * The source cells of the output cells are computed once: the sample points of an output column (row)
+         * fall in a range of source columns (rows), stored as runs with the number of samples of each one
+         * (coverage weight). Applying the plan is a parallel gather on the output rows.
+         */
+        class Crit3DResamplePlan
+        {
+        private:
+            struct ResampleAxis
+            {
+                std::vector<int> center;        // source index of the cell center, -1 if outside
+                std::vector<int> firstRun;      // [nrCells + 1] index of the first run of each output cell
+                std::vector<int> runIndex;      // source index of each run
+                std::vector<int> runWeight;     // number of samples in the run
+            };
+
+            Crit3DRasterHeader _sourceHeader;
+            Crit3DRasterHeader _outputHeader;
+            int _nrSamples;                     // samples for each axis, 0: cell center only
+            ResampleAxis _rows;
+            ResampleAxis _cols;
+
+            float aggregateCell(const Crit3DRasterGrid &sourceGrid, int row, int col, aggregationMethod elab,
+                                float nodataRatioThreshold, std::vector<float> &values) const;
+
+        public:
+            Crit3DResamplePlan();
+
+            void clear();
+            bool isEmpty() const { return _cols.center.empty(); }
+
+            bool initialize(const Crit3DRasterHeader &sourceHeader, const Crit3DRasterHeader &outputHeader);
+
+            bool isCompatible(const Crit3DRasterHeader &sourceHeader, const Crit3DRasterHeader &outputHeader) const;
+
+            const Crit3DRasterHeader& getOutputHeader() const { return _outputHeader; }
+
+            bool apply(const Crit3DRasterGrid &sourceGrid, Crit3DRasterGrid &outputGrid, aggregationMethod elab,
+                       float nodataRatioThreshold, bool isParallelComputing) const;
+        };
+    }
+
+
+#endif // RESAMPLEPLAN_H
@@ -0,0 +1,218 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include <algorithm>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "summedAreaTable.h"
+
+#define SUMMEDAREA_COLUMN_BLOCK 256
+
+
+namespace gis
+{
+    Crit3DSummedAreaTable::Crit3DSummedAreaTable()
+    {
+        _nrRows = 0;
+        _nrCols = 0;
+    }
+
+
+    void Crit3DSummedAreaTable::clear()
+    {
+        _nrRows = 0;
+        _nrCols = 0;
+        _sum.clear();
+        _sum.shrink_to_fit();
+        _count.clear();
+        _count.shrink_to_fit();
+    }
+
+
+    /*!
+     * \brief initialize
+     * row prefix sums (parallel on rows), then column prefix sums (parallel on blocks of columns)
+     */
+    bool Crit3DSummedAreaTable::initialize(const Crit3DRasterGrid &raster, bool isParallelComputing)
+    {
+        clear();
+
+        if (! raster.isLoaded || raster.header->nrRows <= 0 || raster.header->nrCols <= 0)
+            return false;
+
+        _nrRows = raster.header->nrRows;
+        _nrCols = raster.header->nrCols;
+        const float flag = raster.header->flag;
+
+        _sum.resize(size_t(_nrRows + 1) * size_t(_nrCols + 1), 0);
+        _count.resize(_sum.size(), 0);
+
+        #pragma omp parallel for if (isParallelComputing)
+        for (int row = 0; row < _nrRows; row++)
+        {
+            double sum = 0;
+            uint32_t count = 0;
+            size_t index = getIndex(row + 1, 1);
+            for (int col = 0; col < _nrCols; col++, index++)
+            {
+                float value = raster.value[row][col];
+                if (! isEqual(value, flag))
+                {
+                    sum += double(value);
+                    count++;
+                }
+                _sum[index] = sum;
+                _count[index] = count;
+            }
+        }
+
+        int nrBlocks = (_nrCols + SUMMEDAREA_COLUMN_BLOCK - 1) / SUMMEDAREA_COLUMN_BLOCK;
+
+        #pragma omp parallel for if (isParallelComputing)
+        for (int block = 0; block < nrBlocks; block++)
+        {
+            int firstCol = block * SUMMEDAREA_COLUMN_BLOCK + 1;
+            int lastCol = std::min(firstCol + SUMMEDAREA_COLUMN_BLOCK, _nrCols + 1);
+            for (int row = 2; row <= _nrRows; row++)
+            {
+                size_t index = getIndex(row, firstCol);
+                size_t upper = getIndex(row - 1, firstCol);
+                for (int col = firstCol; col < lastCol; col++, index++, upper++)
+                {
+                    _sum[index] += _sum[upper];
+                    _count[index] += _count[upper];
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    // window limits (included) clipped to the grid, false if the window is outside
+    bool Crit3DSummedAreaTable::clipWindow(int &row0, int &col0, int &row1, int &col1) const
+    {
+        row0 = std::max(row0, 0);
+        col0 = std::max(col0, 0);
+        row1 = std::min(row1, _nrRows - 1);
+        col1 = std::min(col1, _nrCols - 1);
+
+        return (row0 <= row1 && col0 <= col1);
+    }
+
+
+    /*!
+     * \brief getSum
+     * sum of the valid values in the window [row0, row1] x [col0, col1], clipped to the grid
+     */
+    double Crit3DSummedAreaTable::getSum(int row0, int col0, int row1, int col1) const
+    {
+        if (! clipWindow(row0, col0, row1, col1))
+            return 0;
+
+        return _sum[getIndex(row1 + 1, col1 + 1)] - _sum[getIndex(row0, col1 + 1)]
+               - _sum[getIndex(row1 + 1, col0)] + _sum[getIndex(row0, col0)];
+    }
+
+
+    long Crit3DSummedAreaTable::getCount(int row0, int col0, int row1, int col1) const
+    {
+        if (! clipWindow(row0, col0, row1, col1))
+            return 0;
+
+        return long(_count[getIndex(row1 + 1, col1 + 1)] - _count[getIndex(row0, col1 + 1)]
+                    - _count[getIndex(row1 + 1, col0)] + _count[getIndex(row0, col0)]);
+    }
+
+
+    // mean of the valid values in the window, NODATA if there are no valid values
+    double Crit3DSummedAreaTable::getMean(int row0, int col0, int row1, int col1) const
+    {
+        long count = getCount(row0, col0, row1, col1);
+        if (count == 0)
+            return NODATA;
+
+        return getSum(row0, col0, row1, col1) / double(count);
+    }
+
+
+    /*!
+     * \brief getCircularWindow
+     * sum and number of the valid values in the circular window centered on (row, col),
+     * one horizontal span for each row (halfWidths: see getCircularWindowWidths)
+     */
+    void Crit3DSummedAreaTable::getCircularWindow(int row, int col, const std::vector<int> &halfWidths,
+                                                  double &sum, long &count) const
+    {
+        sum = 0;
+        count = 0;
+
+        int radius = int(halfWidths.size() / 2);
+        for (int i = 0; i < int(halfWidths.size()); i++)
+        {
+            int windowRow = row + i - radius;
+            if (windowRow < 0 || windowRow >= _nrRows || halfWidths[unsigned(i)] < 0)
+                continue;
+
+            int col0 = std::max(col - halfWidths[unsigned(i)], 0);
+            int col1 = std::min(col + halfWidths[unsigned(i)], _nrCols - 1);
+            if (col0 > col1)
+                continue;
+
+            sum += _sum[getIndex(windowRow + 1, col1 + 1)] - _sum[getIndex(windowRow, col1 + 1)]
+                   - _sum[getIndex(windowRow + 1, col0)] + _sum[getIndex(windowRow, col0)];
+
+            count += long(_count[getIndex(windowRow + 1, col1 + 1)] - _count[getIndex(windowRow, col1 + 1)]
+                          - _count[getIndex(windowRow + 1, col0)] + _count[getIndex(windowRow, col0)]);
+        }
+    }
+
+
+    /*!
+     * \brief getCircularWindowWidths
+     * half widths of the rows of the circular window of radius (cells): the cells (dRow, dCol)
+     * with computeDistance <= radius. halfWidths[dRow + int(radius)], empty if radius < 0
+     */
+    void getCircularWindowWidths(float radius, std::vector<int> &halfWidths)
+    {
+        halfWidths.clear();
+        if (radius < 0)
+            return;
+
+        int maxDelta = int(floor(radius));
+        halfWidths.resize(unsigned(2 * maxDelta + 1));
+
+        for (int dRow = -maxDelta; dRow <= maxDelta; dRow++)
+        {
+            int halfWidth = 0;
+            while (halfWidth < maxDelta && computeDistance(0, 0, dRow, halfWidth + 1) <= radius)
+                halfWidth++;
+
+            halfWidths[unsigned(dRow + maxDelta)] = halfWidth;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef SUMMEDAREATABLE_H
+#define SUMMEDAREATABLE_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    #include <cstdint>
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DSummedAreaTable class
+         * summed-area table (integral image) of a raster: sum and number of the valid values (not flag)
+         * of any rectangular window in O(1), of a circular window in O(radius)
+         */
+        class Crit3DSummedAreaTable
+        {
+        private:
+            int _nrRows;
+            int _nrCols;
+            std::vector<double> _sum;           // [nrRows + 1][nrCols + 1]: first row and column are zero
+            std::vector<uint32_t> _count;
+
+            size_t getIndex(int row, int col) const
+            { return size_t(row) * size_t(_nrCols + 1) + size_t(col); }
+
+            bool clipWindow(int &row0, int &col0, int &row1, int &col1) const;
+
+        public:
+            Crit3DSummedAreaTable();
+
+            bool initialize(const Crit3DRasterGrid &raster, bool isParallelComputing);
+            void clear();
+
+            bool isLoaded() const { return ! _sum.empty(); }
+            int getNrRows() const { return _nrRows; }
+            int getNrCols() const { return _nrCols; }
+
+            double getSum(int row0, int col0, int row1, int col1) const;
+            long getCount(int row0, int col0, int row1, int col1) const;
+            double getMean(int row0, int col0, int row1, int col1) const;
+
+            void getCircularWindow(int row, int col, const std::vector<int> &halfWidths, double &sum, long &count) const;
+        };
+
+        void getCircularWindowWidths(float radius, std::vector<int> &halfWidths);
+    }
+
+
+#endif // SUMMEDAREATABLE_H
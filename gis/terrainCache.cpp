@@ -0,0 +1,318 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#include <cstring>
+#include <fstream>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "mappedFile.h"
+#include "terrainCache.h"
+
+
+/*
+ * terrain cache file (native byte order): slope, aspect, latitude and longitude maps of a DEM
+ * magic "CRIT3DTC", version (int32)
+ * key: DEM hash (uint64), nrRows, nrCols (int32), cellSize, llCorner.x, llCorner.y (double), flag (float),
+ *      utmZone (int32), startLocation.latitude (double)
+ * minimum, maximum of the 4 maps (float)
+ * the 4 maps (float32, row major) starting at TERRAIN_CACHE_DATA_OFFSET,
+ * each one padded to a multiple of RASTER_DATA_ALIGNMENT: the maps are memory mapped when loaded
+*/
+
+static const char TERRAIN_CACHE_MAGIC[8] = {'C','R','I','T','3','D','T','C'};
+static const int32_t TERRAIN_CACHE_VERSION = 1;
+static const size_t TERRAIN_CACHE_DATA_OFFSET = 256;
+
+
+namespace gis
+{
+    struct TerrainCacheKey
+    {
+        uint64_t hash;
+        int32_t nrRows;
+        int32_t nrCols;
+        double cellSize;
+        double xll;
+        double yll;
+        float flag;
+        int32_t utmZone;
+        double referenceLatitude;
+    };
+
+
+    static TerrainCacheKey getTerrainCacheKey(const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings, bool isParallelComputing)
+    {
+        TerrainCacheKey key;
+        std::memset(&key, 0, sizeof(key));
+
+        key.hash = getRasterHash(dem, isParallelComputing);
+        key.nrRows = dem.header->nrRows;
+        key.nrCols = dem.header->nrCols;
+        key.cellSize = dem.header->cellSize;
+        key.xll = dem.header->llCorner.x;
+        key.yll = dem.header->llCorner.y;
+        key.flag = dem.header->flag;
+        key.utmZone = gisSettings.utmZone;
+        key.referenceLatitude = gisSettings.startLocation.latitude;
+
+        return key;
+    }
+
+
+    static size_t getPaddedSize(size_t nrBytes)
+    {
+        return (nrBytes + RASTER_DATA_ALIGNMENT - 1) / RASTER_DATA_ALIGNMENT * RASTER_DATA_ALIGNMENT;
+    }
+
+
+    static inline uint64_t mixHash(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+
+    /*!
+     * \brief getRasterHash
+     * 64 bit hash of the raster values: rows are hashed in parallel and combined in order
+     */
+    uint64_t getRasterHash(const Crit3DRasterGrid &rasterGrid, bool isParallelComputing)
+    {
+        const int nrRows = rasterGrid.header->nrRows;
+        const int nrCols = rasterGrid.header->nrCols;
+
+        std::vector<uint64_t> rowHash(size_t(std::max(nrRows, 0)), 0);
+
+        #pragma omp parallel for if (isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            const float* values = rasterGrid.value[row];
+            uint64_t h = 0x9e3779b97f4a7c15ULL;
+            int col = 0;
+            for (; col + 1 < nrCols; col += 2)
+            {
+                uint64_t word;
+                std::memcpy(&word, values + col, sizeof(word));
+                h = (h ^ word) * 0x100000001b3ULL;
+            }
+            if (col < nrCols)
+            {
+                uint32_t word;
+                std::memcpy(&word, values + col, sizeof(word));
+                h = (h ^ word) * 0x100000001b3ULL;
+            }
+
+            rowHash[size_t(row)] = mixHash(h);
+        }
+
+        uint64_t hash = mixHash(uint64_t(nrRows) << 32 | uint32_t(nrCols));
+        for (uint64_t h : rowHash)
+            hash = mixHash(hash ^ h) + 0x9e3779b97f4a7c15ULL;
+
+        return hash;
+    }
+
+
+    static bool loadTerrainCache(const std::string &fileName, const TerrainCacheKey &key, const Crit3DRasterGrid &dem,
+                                 const std::vector<Crit3DRasterGrid*> &maps)
+    {
+
+        std::ifstream inFile(fileName, std::ios::binary);
+        if (! inFile.is_open())
+            return false;
+
+        char magic[8];
+        int32_t version;
+        TerrainCacheKey fileKey;
+        float minMax[8];
+
+        inFile.read(magic, sizeof(magic));
+        inFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+        inFile.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+        inFile.read(reinterpret_cast<char*>(minMax), sizeof(minMax));
+        if (! inFile.good() || std::memcmp(magic, TERRAIN_CACHE_MAGIC, sizeof(magic)) != 0 || version != TERRAIN_CACHE_VERSION)
+            return false;
+        inFile.close();
+
+        if (std::memcmp(&key, &fileKey, sizeof(key)) != 0)
+            return false;
+
+        size_t blockSize = getPaddedSize(size_t(key.nrRows) * size_t(key.nrCols) * sizeof(float));
+
+        for (size_t i = 0; i < maps.size(); i++)
+        {
+            *(maps[i]->header) = *(dem.header);
+            if (! maps[i]->mapFloatData(fileName, TERRAIN_CACHE_DATA_OFFSET + i * blockSize))
+            {
+                for (Crit3DRasterGrid* map : maps)
+                    map->clear();
+                return false;
+            }
+
+            maps[i]->minimum = minMax[2*i];
+            maps[i]->maximum = minMax[2*i + 1];
+            if (! maps[i]->colorScale->isFixedRange())
+                maps[i]->colorScale->setRange(maps[i]->minimum, maps[i]->maximum);
+
+            maps[i]->isLoaded = true;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief loadTerrainCache
+     * load the terrain maps if the cache file refers to the same DEM and gis settings.
+     * The maps are copy-on-write views of the file
+     */
+    bool loadTerrainCache(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                          Crit3DRasterGrid* slopeMap, Crit3DRasterGrid* aspectMap,
+                          Crit3DRasterGrid* latMap, Crit3DRasterGrid* lonMap, bool isParallelComputing)
+    {
+        if (fileName.empty() || ! dem.isLoaded)
+            return false;
+
+        TerrainCacheKey key = getTerrainCacheKey(dem, gisSettings, isParallelComputing);
+        return loadTerrainCache(fileName, key, dem, {slopeMap, aspectMap, latMap, lonMap});
+    }
+
+
+    static bool saveTerrainCache(const std::string &fileName, const TerrainCacheKey &key, const Crit3DRasterGrid &dem,
+                                 const std::vector<const Crit3DRasterGrid*> &maps, std::string &errorStr)
+    {
+        for (const Crit3DRasterGrid* map : maps)
+        {
+            if (! map->isLoaded || map->data() == nullptr || ! (*(map->header) == *(dem.header)))
+            {
+                errorStr = "Wrong terrain maps.";
+                return false;
+            }
+        }
+
+        float minMax[8];
+        for (size_t i = 0; i < maps.size(); i++)
+        {
+            minMax[2*i] = maps[i]->minimum;
+            minMax[2*i + 1] = maps[i]->maximum;
+        }
+
+        // the old file is replaced at the end (not truncated): an open view of it keeps its data
+        std::string tmpFileName = fileName + ".tmp";
+
+        std::ofstream outFile(tmpFileName, std::ios::binary | std::ios::trunc);
+        if (! outFile.is_open())
+        {
+            errorStr = "Error in writing file: " + tmpFileName;
+            return false;
+        }
+
+        std::vector<char> padding(TERRAIN_CACHE_DATA_OFFSET, 0);
+
+        outFile.write(TERRAIN_CACHE_MAGIC, sizeof(TERRAIN_CACHE_MAGIC));
+        outFile.write(reinterpret_cast<const char*>(&TERRAIN_CACHE_VERSION), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        outFile.write(reinterpret_cast<const char*>(minMax), sizeof(minMax));
+        outFile.write(padding.data(), std::streamsize(TERRAIN_CACHE_DATA_OFFSET - size_t(outFile.tellp())));
+
+        size_t nrBytes = maps[0]->getNrCells() * sizeof(float);
+        size_t blockSize = getPaddedSize(nrBytes);
+        for (const Crit3DRasterGrid* map : maps)
+        {
+            outFile.write(reinterpret_cast<const char*>(map->data()), std::streamsize(nrBytes));
+            outFile.write(padding.data(), std::streamsize(blockSize - nrBytes));
+        }
+
+        outFile.close();
+        if (outFile.fail())
+        {
+            remove(tmpFileName.c_str());
+            errorStr = "Error in writing file: " + tmpFileName;
+            return false;
+        }
+
+        if (! replaceFile(tmpFileName, fileName))
+        {
+            remove(tmpFileName.c_str());
+            errorStr = "Error in replacing file: " + fileName;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    bool saveTerrainCache(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                          const Crit3DRasterGrid &slopeMap, const Crit3DRasterGrid &aspectMap,
+                          const Crit3DRasterGrid &latMap, const Crit3DRasterGrid &lonMap,
+                          bool isParallelComputing, std::string &errorStr)
+    {
+        TerrainCacheKey key = getTerrainCacheKey(dem, gisSettings, isParallelComputing);
+        return saveTerrainCache(fileName, key, dem, {&slopeMap, &aspectMap, &latMap, &lonMap}, errorStr);
+    }
+
+
+    /*!
+     * \brief computeTerrainMaps
+     * slope, aspect, latitude and longitude maps of the DEM:
+     * loaded from the cache file if valid, otherwise computed and saved (if cacheFileName is not empty)
+     */
+    bool computeTerrainMaps(const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                            Crit3DRasterGrid* slopeMap, Crit3DRasterGrid* aspectMap,
+                            Crit3DRasterGrid* latMap, Crit3DRasterGrid* lonMap,
+                            const std::string &cacheFileName, bool isParallelComputing)
+    {
+        if (! dem.isLoaded)
+            return false;
+
+        TerrainCacheKey key;
+        if (! cacheFileName.empty())
+        {
+            key = getTerrainCacheKey(dem, gisSettings, isParallelComputing);
+            if (loadTerrainCache(cacheFileName, key, dem, {slopeMap, aspectMap, latMap, lonMap}))
+                return true;
+        }
+
+        if (! computeLatLonMaps(dem, latMap, lonMap, gisSettings, isParallelComputing)
+            || ! computeSlopeAspectMaps(dem, slopeMap, aspectMap, isParallelComputing))
+            return false;
+
+        if (! cacheFileName.empty())
+        {
+            // the cache is optional (e.g. read only folder)
+            std::string errorStr;
+            saveTerrainCache(cacheFileName, key, dem, {slopeMap, aspectMap, latMap, lonMap}, errorStr);
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TERRAINCACHE_H
+#define TERRAINCACHE_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+
+    #include <cstdint>
+
+    namespace gis
+    {
+        uint64_t getRasterHash(const Crit3DRasterGrid &rasterGrid, bool isParallelComputing);
+
+        bool loadTerrainCache(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                              Crit3DRasterGrid* slopeMap, Crit3DRasterGrid* aspectMap,
+                              Crit3DRasterGrid* latMap, Crit3DRasterGrid* lonMap, bool isParallelComputing);
+
+        bool saveTerrainCache(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                              const Crit3DRasterGrid &slopeMap, const Crit3DRasterGrid &aspectMap,
+                              const Crit3DRasterGrid &latMap, const Crit3DRasterGrid &lonMap,
+                              bool isParallelComputing, std::string &errorStr);
+
+        bool computeTerrainMaps(const Crit3DRasterGrid &dem, const Crit3DGisSettings &gisSettings,
+                                Crit3DRasterGrid* slopeMap, Crit3DRasterGrid* aspectMap,
+                                Crit3DRasterGrid* latMap, Crit3DRasterGrid* lonMap,
+                                const std::string &cacheFileName, bool isParallelComputing);
+    }
+
+
+#endif // TERRAINCACHE_H
@@ -0,0 +1,510 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "compressedRaster.h"
+#include "tiledRaster.h"
+
+
+/*
+ * file format (native byte order)
+ * magic "CRIT3DTR", version
+ * nrRows, nrCols, tileSize, nrLevels (int32)
+ * cellSize, llCorner.x, llCorner.y (double), flag (float)    [level 0]
+ * tile table: offsets (uint64) and sizes (uint32) of the tiles of all the levels
+ * (level by level, row major), tiles compressed without loss (see compressFloatBlock)
+ * level k: cellSize * 2^k, same upper left corner, nrRows = ceil(nrRows(k-1) / 2)
+*/
+
+static const char TILED_RASTER_MAGIC[8] = {'C','R','I','T','3','D','T','R'};
+static const int32_t TILED_RASTER_VERSION = 2;
+
+
+namespace gis
+{
+    static Crit3DRasterHeader getLevelHeader(const Crit3DRasterHeader &header, int level)
+    {
+        Crit3DRasterHeader levelHeader = header;
+
+        double topY = header.llCorner.y + header.nrRows * header.cellSize;
+        for (int i = 0; i < level; i++)
+        {
+            levelHeader.nrRows = (levelHeader.nrRows + 1) / 2;
+            levelHeader.nrCols = (levelHeader.nrCols + 1) / 2;
+            levelHeader.cellSize *= 2;
+        }
+
+        levelHeader.invCellSize = 1. / levelHeader.cellSize;
+        levelHeader.llCorner.y = topY - levelHeader.nrRows * levelHeader.cellSize;
+
+        return levelHeader;
+    }
+
+
+    static int getNrLevels(int nrRows, int nrCols, int tileSize)
+    {
+        int nrLevels = 1;
+        while (std::max(nrRows, nrCols) > tileSize && nrLevels < TILED_RASTER_MAXLEVELS)
+        {
+            nrRows = (nrRows + 1) / 2;
+            nrCols = (nrCols + 1) / 2;
+            nrLevels++;
+        }
+
+        return nrLevels;
+    }
+
+
+    /*!
+     * \brief computeOverview
+     * next overview level: average of the valid values of each 2x2 block
+     */
+    static void computeOverview(const std::vector<float> &values, int nrRows, int nrCols, float flag,
+                                std::vector<float> &overview, bool isParallelComputing)
+    {
+        int nrOverviewRows = (nrRows + 1) / 2;
+        int nrOverviewCols = (nrCols + 1) / 2;
+        overview.resize(size_t(nrOverviewRows) * size_t(nrOverviewCols));
+
+        #pragma omp parallel for if (isParallelComputing)
+        for (int row = 0; row < nrOverviewRows; row++)
+        {
+            for (int col = 0; col < nrOverviewCols; col++)
+            {
+                double sum = 0;
+                int nrValues = 0;
+                for (int r = 2*row; r < std::min(2*row + 2, nrRows); r++)
+                {
+                    for (int c = 2*col; c < std::min(2*col + 2, nrCols); c++)
+                    {
+                        float value = values[size_t(r) * size_t(nrCols) + size_t(c)];
+                        if (! isEqual(value, flag))
+                        {
+                            sum += value;
+                            nrValues++;
+                        }
+                    }
+                }
+
+                overview[size_t(row) * size_t(nrOverviewCols) + size_t(col)] = (nrValues > 0) ? float(sum / nrValues) : flag;
+            }
+        }
+    }
+
+
+    Crit3DTiledRaster::Crit3DTiledRaster()
+    {
+        _tileSize = 0;
+    }
+
+
+    void Crit3DTiledRaster::close()
+    {
+        _file.close();
+
+        _tileSize = 0;
+        _levelHeader.clear();
+        _nrTileRows.clear();
+        _nrTileCols.clear();
+        _firstTile.clear();
+        _tileOffset.clear();
+        _tileBytes.clear();
+    }
+
+
+    bool Crit3DTiledRaster::open(const std::string &fileName, std::string &errorStr)
+    {
+        close();
+
+        if (! _file.open(fileName, errorStr))
+            return false;
+
+        const char* data = _file.data();
+        size_t dataSize = _file.size();
+
+        // header
+        size_t pos = 0;
+        auto readData = [data, dataSize, &pos](void* ptr, size_t size)
+        {
+            if (pos + size > dataSize)
+                return false;
+            std::memcpy(ptr, data + pos, size);
+            pos += size;
+            return true;
+        };
+
+        char magic[8];
+        int32_t version, nrRows, nrCols, tileSize, nrLevels;
+        double cellSize, xll, yll;
+        float flag;
+
+        if (! readData(magic, sizeof(magic)) || std::memcmp(magic, TILED_RASTER_MAGIC, sizeof(magic)) != 0
+            || ! readData(&version, sizeof(version)) || version != TILED_RASTER_VERSION
+            || ! readData(&nrRows, sizeof(int32_t)) || ! readData(&nrCols, sizeof(int32_t))
+            || ! readData(&tileSize, sizeof(int32_t)) || ! readData(&nrLevels, sizeof(int32_t))
+            || ! readData(&cellSize, sizeof(double)) || ! readData(&xll, sizeof(double))
+            || ! readData(&yll, sizeof(double)) || ! readData(&flag, sizeof(float))
+            || nrRows <= 0 || nrCols <= 0 || tileSize <= 0 || cellSize <= 0
+            || nrLevels <= 0 || nrLevels > TILED_RASTER_MAXLEVELS)
+        {
+            close();
+            errorStr = "Wrong tiled raster file: " + fileName;
+            return false;
+        }
+
+        Crit3DRasterHeader header;
+        header.nrRows = nrRows;
+        header.nrCols = nrCols;
+        header.cellSize = cellSize;
+        header.llCorner.x = xll;
+        header.llCorner.y = yll;
+        header.flag = flag;
+
+        _tileSize = tileSize;
+
+        size_t nrTiles = 0;
+        for (int level = 0; level < nrLevels; level++)
+        {
+            Crit3DRasterHeader levelHeader = getLevelHeader(header, level);
+            _levelHeader.push_back(levelHeader);
+            _nrTileRows.push_back((levelHeader.nrRows + tileSize - 1) / tileSize);
+            _nrTileCols.push_back((levelHeader.nrCols + tileSize - 1) / tileSize);
+            _firstTile.push_back(nrTiles);
+            nrTiles += size_t(_nrTileRows.back()) * size_t(_nrTileCols.back());
+        }
+
+        _tileOffset.resize(nrTiles);
+        _tileBytes.resize(nrTiles);
+        if (! readData(_tileOffset.data(), nrTiles * sizeof(uint64_t))
+            || ! readData(_tileBytes.data(), nrTiles * sizeof(uint32_t)))
+        {
+            close();
+            errorStr = "Wrong tiled raster file: " + fileName;
+            return false;
+        }
+
+        for (size_t i = 0; i < nrTiles; i++)
+        {
+            if (_tileOffset[i] + _tileBytes[i] > dataSize)
+            {
+                close();
+                errorStr = "Wrong tiled raster file: " + fileName;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief getLevelFromCellSize
+     * return the coarsest level with cell size not greater than cellSize
+     */
+    int Crit3DTiledRaster::getLevelFromCellSize(double cellSize) const
+    {
+        int level = 0;
+        while (level + 1 < getNrLevels() && _levelHeader[unsigned(level + 1)].cellSize <= cellSize * (1 + EPSILON))
+            level++;
+
+        return level;
+    }
+
+
+    /*!
+     * \brief readWindow
+     * read a window (clipped at the grid borders) of a level, decompressing only the overlapped tiles
+     */
+    bool Crit3DTiledRaster::readWindow(int level, int firstRow, int firstCol, int nrRows, int nrCols,
+                                       Crit3DRasterGrid &outputGrid, bool isParallelComputing) const
+    {
+        if (! isOpen() || level < 0 || level >= getNrLevels())
+            return false;
+
+        const Crit3DRasterHeader &levelHeader = _levelHeader[unsigned(level)];
+
+        int lastRow = std::min(firstRow + nrRows, levelHeader.nrRows);
+        int lastCol = std::min(firstCol + nrCols, levelHeader.nrCols);
+        firstRow = std::max(firstRow, 0);
+        firstCol = std::max(firstCol, 0);
+        if (firstRow >= lastRow || firstCol >= lastCol)
+            return false;
+
+        Crit3DRasterHeader windowHeader = levelHeader;
+        windowHeader.nrRows = lastRow - firstRow;
+        windowHeader.nrCols = lastCol - firstCol;
+        windowHeader.llCorner.x = levelHeader.llCorner.x + firstCol * levelHeader.cellSize;
+        windowHeader.llCorner.y = levelHeader.llCorner.y + (levelHeader.nrRows - lastRow) * levelHeader.cellSize;
+
+        if (! outputGrid.initializeGrid(windowHeader))
+            return false;
+
+        int nrTileCols = _nrTileCols[unsigned(level)];
+        int firstTileRow = firstRow / _tileSize;
+        int firstTileCol = firstCol / _tileSize;
+        int nrWindowTileCols = (lastCol - 1) / _tileSize - firstTileCol + 1;
+        int nrWindowTiles = ((lastRow - 1) / _tileSize - firstTileRow + 1) * nrWindowTileCols;
+
+        int isError = 0;
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int i = 0; i < nrWindowTiles; i++)
+        {
+            int tileRow = firstTileRow + i / nrWindowTileCols;
+            int tileCol = firstTileCol + i % nrWindowTileCols;
+            size_t tileIndex = _firstTile[unsigned(level)] + size_t(tileRow) * size_t(nrTileCols) + size_t(tileCol);
+
+            int tileFirstRow = tileRow * _tileSize;
+            int tileFirstCol = tileCol * _tileSize;
+            int tileNrRows = std::min(_tileSize, levelHeader.nrRows - tileFirstRow);
+            int tileNrCols = std::min(_tileSize, levelHeader.nrCols - tileFirstCol);
+
+            std::vector<float> tile(size_t(tileNrRows) * size_t(tileNrCols));
+            if (! decompressFloatBlock(_file.data() + _tileOffset[tileIndex], _tileBytes[tileIndex],
+                                       tileNrCols, levelHeader.flag, 0, tile))
+            {
+                #pragma omp atomic write
+                isError = 1;
+                continue;
+            }
+
+            int row0 = std::max(firstRow, tileFirstRow);
+            int row1 = std::min(lastRow, tileFirstRow + tileNrRows);
+            int col0 = std::max(firstCol, tileFirstCol);
+            int col1 = std::min(lastCol, tileFirstCol + tileNrCols);
+
+            for (int row = row0; row < row1; row++)
+            {
+                std::memcpy(&outputGrid.value[row - firstRow][col0 - firstCol],
+                            &tile[size_t(row - tileFirstRow) * size_t(tileNrCols) + size_t(col0 - tileFirstCol)],
+                            size_t(col1 - col0) * sizeof(float));
+            }
+        }
+
+        if (isError)
+        {
+            outputGrid.clear();
+            return false;
+        }
+
+        updateMinMaxRasterGrid(&outputGrid, isParallelComputing);
+        return true;
+    }
+
+
+    /*!
+     * \brief writeTiledRaster
+     * write the raster and its overview levels in a single tiled file
+     */
+    bool writeTiledRaster(const std::string &fileName, const Crit3DRasterGrid &rasterGrid, int tileSize,
+                          bool isParallelComputing, std::string &errorStr)
+    {
+        if (! rasterGrid.isLoaded || rasterGrid.header->nrRows <= 0 || rasterGrid.header->nrCols <= 0 || tileSize <= 0)
+        {
+            errorStr = "Wrong data for tiled raster file.";
+            return false;
+        }
+
+        // the old file is replaced at the end (not truncated): an open view of it keeps its data
+        std::string tmpFileName = fileName + ".tmp";
+
+        std::ofstream outFile(tmpFileName, std::ios::binary | std::ios::trunc);
+        if (! outFile.is_open())
+        {
+            errorStr = "Error in writing file: " + tmpFileName;
+            return false;
+        }
+
+        const Crit3DRasterHeader &header = *(rasterGrid.header);
+        int32_t nrRows = header.nrRows;
+        int32_t nrCols = header.nrCols;
+        int32_t tileSize32 = tileSize;
+        int32_t nrLevels = getNrLevels(nrRows, nrCols, tileSize);
+
+        outFile.write(TILED_RASTER_MAGIC, sizeof(TILED_RASTER_MAGIC));
+        outFile.write(reinterpret_cast<const char*>(&TILED_RASTER_VERSION), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrRows), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrCols), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&tileSize32), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrLevels), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&(header.cellSize)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.llCorner.x)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.llCorner.y)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(header.flag)), sizeof(float));
+
+        // tile table, written at the end
+        size_t tableSize = 0;
+        for (int level = 0; level < nrLevels; level++)
+        {
+            Crit3DRasterHeader levelHeader = getLevelHeader(header, level);
+            tableSize += size_t((levelHeader.nrRows + tileSize - 1) / tileSize) * size_t((levelHeader.nrCols + tileSize - 1) / tileSize);
+        }
+
+        std::streampos tablePosition = outFile.tellp();
+        std::vector<uint64_t> tileOffset(tableSize, 0);
+        std::vector<uint32_t> tileBytes(tableSize, 0);
+        outFile.write(reinterpret_cast<const char*>(tileOffset.data()), std::streamsize(tableSize * sizeof(uint64_t)));
+        outFile.write(reinterpret_cast<const char*>(tileBytes.data()), std::streamsize(tableSize * sizeof(uint32_t)));
+
+        // level 0
+        std::vector<float> values(rasterGrid.data(), rasterGrid.data() + rasterGrid.getNrCells());
+
+        size_t firstTile = 0;
+        for (int level = 0; level < nrLevels; level++)
+        {
+            Crit3DRasterHeader levelHeader = getLevelHeader(header, level);
+            int levelRows = levelHeader.nrRows;
+            int levelCols = levelHeader.nrCols;
+
+            if (level > 0)
+            {
+                std::vector<float> overview;
+                Crit3DRasterHeader previousHeader = getLevelHeader(header, level - 1);
+                computeOverview(values, previousHeader.nrRows, previousHeader.nrCols, header.flag, overview, isParallelComputing);
+                values.swap(overview);
+            }
+
+            int nrTileRows = (levelRows + tileSize - 1) / tileSize;
+            int nrTileCols = (levelCols + tileSize - 1) / tileSize;
+            int nrTiles = nrTileRows * nrTileCols;
+
+            std::vector<std::vector<char>> buffers(static_cast<size_t>(nrTiles));
+
+            #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+            for (int tile = 0; tile < nrTiles; tile++)
+            {
+                int firstRow = (tile / nrTileCols) * tileSize;
+                int firstCol = (tile % nrTileCols) * tileSize;
+                int lastRow = std::min(firstRow + tileSize, levelRows);
+                int lastCol = std::min(firstCol + tileSize, levelCols);
+
+                std::vector<float> tileValues;
+                tileValues.reserve(size_t(lastRow - firstRow) * size_t(lastCol - firstCol));
+                for (int row = firstRow; row < lastRow; row++)
+                {
+                    const float* rowValues = &values[size_t(row) * size_t(levelCols)];
+                    tileValues.insert(tileValues.end(), rowValues + firstCol, rowValues + lastCol);
+                }
+
+                compressFloatBlock(tileValues, lastCol - firstCol, header.flag, 0, buffers[unsigned(tile)]);
+            }
+
+            for (int tile = 0; tile < nrTiles; tile++)
+            {
+                size_t index = firstTile + size_t(tile);
+                tileOffset[index] = uint64_t(outFile.tellp());
+                tileBytes[index] = uint32_t(buffers[unsigned(tile)].size());
+                outFile.write(buffers[unsigned(tile)].data(), std::streamsize(buffers[unsigned(tile)].size()));
+            }
+
+            firstTile += size_t(nrTiles);
+        }
+
+        outFile.seekp(tablePosition);
+        outFile.write(reinterpret_cast<const char*>(tileOffset.data()), std::streamsize(tableSize * sizeof(uint64_t)));
+        outFile.write(reinterpret_cast<const char*>(tileBytes.data()), std::streamsize(tableSize * sizeof(uint32_t)));
+
+        outFile.close();
+        if (outFile.fail())
+        {
+            errorStr = "Error in writing file: " + tmpFileName;
+            remove(tmpFileName.c_str());
+            return false;
+        }
+
+        if (! replaceFile(tmpFileName, fileName))
+        {
+            errorStr = "Error in replacing file: " + fileName;
+            remove(tmpFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief readTiledRaster
+     * read the whole raster (level 0)
+     */
+    bool readTiledRaster(const std::string &fileName, Crit3DRasterGrid *rasterGrid, std::string &errorStr)
+    {
+        return readTiledRaster(fileName, 0, rasterGrid, errorStr);
+    }
+
+
+    /*!
+     * \brief readTiledRaster
+     * read the whole raster at the coarsest level with cell size not greater than cellSize
+     * (e.g. a proxy grid used at the resolution of the DEM)
+     */
+    bool readTiledRaster(const std::string &fileName, double cellSize, Crit3DRasterGrid *rasterGrid, std::string &errorStr)
+    {
+        if (rasterGrid == nullptr)
+        {
+            errorStr = "Invalid raster grid.";
+            return false;
+        }
+
+        rasterGrid->clear();
+
+        Crit3DTiledRaster tiledRaster;
+        if (! tiledRaster.open(fileName, errorStr))
+            return false;
+
+        int level = tiledRaster.getLevelFromCellSize(cellSize);
+        const Crit3DRasterHeader &header = tiledRaster.getHeader(level);
+        if (! tiledRaster.readWindow(level, 0, 0, header.nrRows, header.nrCols, *rasterGrid, false))
+        {
+            errorStr = "Error reading tiled raster: " + fileName;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief convertToTiledRaster
+     * convert a raster (.flt, .asc, .bil, .img) to the tiled format
+     */
+    bool convertToTiledRaster(const std::string &inputFileName, const std::string &outputFileName,
+                              int currentUtmZone, bool isParallelComputing, std::string &errorStr)
+    {
+        Crit3DRasterGrid rasterGrid;
+        if (! openRaster(inputFileName, &rasterGrid, currentUtmZone, isParallelComputing, errorStr))
+            return false;
+
+        return writeTiledRaster(outputFileName, rasterGrid, TILED_RASTER_TILESIZE, isParallelComputing, errorStr);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef TILEDRASTER_H
+#define TILEDRASTER_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+    #ifndef MAPPEDFILE_H
+        #include "mappedFile.h"
+    #endif
+
+    #include <cstdint>
+
+    #define TILED_RASTER_TILESIZE 256
+    #define TILED_RASTER_MAXLEVELS 12
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DTiledRaster class
+         * raster in a single tiled file (.tgr): each tile is compressed separately without loss (compressFloatBlock)
+         * and the file contains the overview levels (level k: cell size * 2^k, average of the valid values).
+         * The file is memory mapped: a window is read decompressing only the tiles that it overlaps
+         */
+        class Crit3DTiledRaster
+        {
+        private:
+            Crit3DMappedFile _file;
+            int _tileSize;
+            std::vector<Crit3DRasterHeader> _levelHeader;
+            std::vector<int> _nrTileRows;
+            std::vector<int> _nrTileCols;
+            std::vector<size_t> _firstTile;             // [level] index of the first tile in the table
+            std::vector<uint64_t> _tileOffset;
+            std::vector<uint32_t> _tileBytes;
+
+        public:
+            Crit3DTiledRaster();
+
+            Crit3DTiledRaster(const Crit3DTiledRaster&) = delete;
+            Crit3DTiledRaster& operator = (const Crit3DTiledRaster&) = delete;
+
+            bool open(const std::string &fileName, std::string &errorStr);
+            void close();
+
+            bool isOpen() const { return _file.isOpen(); }
+            int getTileSize() const { return _tileSize; }
+            int getNrLevels() const { return int(_levelHeader.size()); }
+            const Crit3DRasterHeader& getHeader(int level = 0) const { return _levelHeader[unsigned(level)]; }
+
+            int getLevelFromCellSize(double cellSize) const;
+
+            bool readWindow(int level, int firstRow, int firstCol, int nrRows, int nrCols,
+                            Crit3DRasterGrid &outputGrid, bool isParallelComputing) const;
+        };
+
+        bool writeTiledRaster(const std::string &fileName, const Crit3DRasterGrid &rasterGrid, int tileSize,
+                              bool isParallelComputing, std::string &errorStr);
+
+        bool readTiledRaster(const std::string &fileName, Crit3DRasterGrid *rasterGrid, std::string &errorStr);
+        bool readTiledRaster(const std::string &fileName, double cellSize, Crit3DRasterGrid *rasterGrid, std::string &errorStr);
+
+        bool convertToTiledRaster(const std::string &inputFileName, const std::string &outputFileName,
+                                  int currentUtmZone, bool isParallelComputing, std::string &errorStr);
+    }
+
+
+#endif // TILEDRASTER_H
@@ -0,0 +1,420 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <cstdio>
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "compressedRaster.h"
+#include "topographicDistanceStore.h"
+
+
+/*
+ * file format (native byte order)
+ * magic "CRIT3DTD", version
+ * nrRows, nrCols, tileSize, nrPoints (int32)
+ * cellSize, llCorner.x, llCorner.y (double), flag (float)
+ * point ids: length (int32) + chars
+ * tile table: offsets (uint64) and sizes (uint32) of nrPoints * nrTiles tiles (size 0: not available)
+ * tiles compressed without loss (see compressFloatBlock)
+*/
+
+static const char TD_STORE_MAGIC[8] = {'C','R','I','T','3','D','T','D'};
+static const int32_t TD_STORE_VERSION = 2;
+
+
+namespace gis
+{
+    Crit3DTopographicDistanceStore::Crit3DTopographicDistanceStore()
+    {
+        _tileSize = 0;
+        _nrTileRows = 0;
+        _nrTileCols = 0;
+
+        setMaxCacheSize(TD_STORE_CACHESIZE_MB);
+    }
+
+
+    Crit3DTopographicDistanceStore::~Crit3DTopographicDistanceStore()
+    {
+        close();
+    }
+
+
+    void Crit3DTopographicDistanceStore::close()
+    {
+        clearCache();
+        _file.close();
+
+        _fileName = "";
+        _pointId.clear();
+        _tileOffset.clear();
+        _tileBytes.clear();
+        _tileSize = 0;
+        _nrTileRows = 0;
+        _nrTileCols = 0;
+    }
+
+
+    bool Crit3DTopographicDistanceStore::open(const std::string &fileName, std::string &errorStr)
+    {
+        close();
+
+        if (! _file.open(fileName, errorStr))
+            return false;
+
+        const char* data = _file.data();
+        size_t dataSize = _file.size();
+
+        // header
+        size_t pos = 0;
+        auto readData = [data, dataSize, &pos](void* ptr, size_t size)
+        {
+            if (pos + size > dataSize)
+                return false;
+            std::memcpy(ptr, data + pos, size);
+            pos += size;
+            return true;
+        };
+
+        char magic[8];
+        int32_t version, nrRows, nrCols, tileSize, nrPoints;
+        double cellSize, xll, yll;
+        float flag;
+
+        if (! readData(magic, sizeof(magic)) || std::memcmp(magic, TD_STORE_MAGIC, sizeof(magic)) != 0
+            || ! readData(&version, sizeof(version)) || version != TD_STORE_VERSION
+            || ! readData(&nrRows, sizeof(int32_t)) || ! readData(&nrCols, sizeof(int32_t))
+            || ! readData(&tileSize, sizeof(int32_t)) || ! readData(&nrPoints, sizeof(int32_t))
+            || ! readData(&cellSize, sizeof(double)) || ! readData(&xll, sizeof(double))
+            || ! readData(&yll, sizeof(double)) || ! readData(&flag, sizeof(float))
+            || nrRows <= 0 || nrCols <= 0 || tileSize <= 0 || nrPoints < 0)
+        {
+            close();
+            errorStr = "Wrong topographic distance file: " + fileName;
+            return false;
+        }
+
+        _header.nrRows = nrRows;
+        _header.nrCols = nrCols;
+        _header.cellSize = cellSize;
+        _header.invCellSize = 1. / cellSize;
+        _header.llCorner.x = xll;
+        _header.llCorner.y = yll;
+        _header.flag = flag;
+
+        _tileSize = tileSize;
+        _nrTileRows = (nrRows + tileSize - 1) / tileSize;
+        _nrTileCols = (nrCols + tileSize - 1) / tileSize;
+
+        _pointId.resize(unsigned(nrPoints));
+        for (int i = 0; i < nrPoints; i++)
+        {
+            int32_t length;
+            if (! readData(&length, sizeof(length)) || length < 0 || pos + size_t(length) > dataSize)
+            {
+                close();
+                errorStr = "Wrong topographic distance file: " + fileName;
+                return false;
+            }
+
+            _pointId[unsigned(i)] = std::string(data + pos, size_t(length));
+            pos += size_t(length);
+        }
+
+        size_t nrTiles = size_t(nrPoints) * size_t(_nrTileRows) * size_t(_nrTileCols);
+        _tileOffset.resize(nrTiles);
+        _tileBytes.resize(nrTiles);
+        if (! readData(_tileOffset.data(), nrTiles * sizeof(uint64_t))
+            || ! readData(_tileBytes.data(), nrTiles * sizeof(uint32_t)))
+        {
+            close();
+            errorStr = "Wrong topographic distance file: " + fileName;
+            return false;
+        }
+
+        _fileName = fileName;
+        return true;
+    }
+
+
+    bool Crit3DTopographicDistanceStore::isPointAvailable(int pointIndex) const
+    {
+        if (pointIndex < 0 || pointIndex >= getNrPoints())
+            return false;
+
+        // the first tile is always written for the selected points
+        return _tileBytes[size_t(pointIndex) * size_t(_nrTileRows * _nrTileCols)] > 0;
+    }
+
+
+    /*!
+     * \brief setMaxCacheSize
+     * the cache size is divided evenly among the shards
+     */
+    void Crit3DTopographicDistanceStore::setMaxCacheSize(size_t nrMegaBytes)
+    {
+        size_t shardSize = nrMegaBytes * 1024 * 1024 / TD_STORE_NRSHARDS;
+        for (TileCacheShard &shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.maxSize = shardSize;
+        }
+    }
+
+
+    void Crit3DTopographicDistanceStore::clearCache()
+    {
+        for (TileCacheShard &shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.tiles.clear();
+            shard.lruList.clear();
+            shard.size = 0;
+        }
+    }
+
+
+    /*!
+     * \brief getCachedTile
+     * return the decompressed tile, loading it from the mapped file if it is not in cache.
+     * Only the shard of the tile is locked, the decompression is done outside the lock
+     */
+    Crit3DTopographicDistanceStore::tilePtr Crit3DTopographicDistanceStore::getCachedTile(int pointIndex, int tileIndex)
+    {
+        int nrTiles = _nrTileRows * _nrTileCols;
+        uint64_t key = uint64_t(pointIndex) * uint64_t(nrTiles) + uint64_t(tileIndex);
+        TileCacheShard &shard = _shards[key % TD_STORE_NRSHARDS];
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.tiles.find(key);
+            if (it != shard.tiles.end())
+            {
+                shard.lruList.splice(shard.lruList.begin(), shard.lruList, it->second.second);
+                return it->second.first;
+            }
+        }
+
+        if (_tileBytes[key] == 0)
+            return nullptr;
+
+        int tileRow = tileIndex / _nrTileCols;
+        int tileCol = tileIndex % _nrTileCols;
+        size_t nrTileRows = size_t(std::min(_tileSize, _header.nrRows - tileRow * _tileSize));
+        size_t nrTileCols = size_t(std::min(_tileSize, _header.nrCols - tileCol * _tileSize));
+
+        std::shared_ptr<std::vector<float>> tile = std::make_shared<std::vector<float>>(nrTileRows * nrTileCols);
+        if (_tileOffset[key] + _tileBytes[key] > _file.size()
+            || ! decompressFloatBlock(_file.data() + _tileOffset[key], _tileBytes[key], int(nrTileCols), _header.flag, 0, *tile))
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // loaded by another thread in the meantime
+        auto it = shard.tiles.find(key);
+        if (it != shard.tiles.end())
+            return it->second.first;
+
+        size_t tileSize = tile->size() * sizeof(float);
+        while (! shard.lruList.empty() && shard.size + tileSize > shard.maxSize)
+        {
+            auto last = shard.tiles.find(shard.lruList.back());
+            shard.size -= last->second.first->size() * sizeof(float);
+            shard.tiles.erase(last);
+            shard.lruList.pop_back();
+        }
+
+        shard.lruList.push_front(key);
+        shard.tiles[key] = std::make_pair(tilePtr(tile), shard.lruList.begin());
+        shard.size += tileSize;
+
+        return tile;
+    }
+
+
+    /*!
+     * \brief getValue
+     * return the topographic distance of the point in (x, y), NODATA if not available
+     */
+    float Crit3DTopographicDistanceStore::getValue(int pointIndex, double x, double y)
+    {
+        if (! isOpen() || pointIndex < 0 || pointIndex >= getNrPoints())
+            return NODATA;
+
+        if (isOutOfGridXY(x, y, &_header))
+            return NODATA;
+
+        int row, col;
+        getRowColFromXY(_header, x, y, &row, &col);
+
+        int tileRow = row / _tileSize;
+        int tileCol = col / _tileSize;
+        tilePtr tile = getCachedTile(pointIndex, tileRow * _nrTileCols + tileCol);
+        if (tile == nullptr)
+            return NODATA;
+
+        int nrTileCols = std::min(_tileSize, _header.nrCols - tileCol * _tileSize);
+        float value = (*tile)[size_t(row - tileRow * _tileSize) * size_t(nrTileCols) + size_t(col - tileCol * _tileSize)];
+
+        if (isEqual(value, _header.flag))
+            return NODATA;
+
+        return value;
+    }
+
+
+    /*!
+     * \brief writeTopographicDistanceStore
+     * compute the topographic distance maps of the selected points (topographicDistanceMapSweep on sweepDem,
+     * the same of the single maps) and write them in a single tiled file.
+     * The points are computed in parallel and written in order on a temporary file,
+     * that replaces the old store at the end
+     */
+    bool writeTopographicDistanceStore(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DRasterGrid &sweepDem,
+                                       const std::vector<Crit3DPoint> &points, const std::vector<std::string> &pointIds,
+                                       const std::vector<bool> &isSelected, int tileSize,
+                                       bool isParallelComputing, std::string &errorStr)
+    {
+        if (! dem.isLoaded || ! sweepDem.isLoaded || points.size() != pointIds.size()
+            || points.size() != isSelected.size() || tileSize <= 0)
+        {
+            errorStr = "Wrong data for topographic distance file.";
+            return false;
+        }
+
+        // written on a temporary file: the old store could be mapped
+        std::string tmpFileName = fileName + ".tmp";
+        std::ofstream outFile(tmpFileName, std::ios::binary | std::ios::trunc);
+        if (! outFile.is_open())
+        {
+            errorStr = "Error in writing file: " + fileName;
+            return false;
+        }
+
+        int32_t nrRows = dem.header->nrRows;
+        int32_t nrCols = dem.header->nrCols;
+        int32_t nrPoints = int32_t(points.size());
+        int nrTileRows = (nrRows + tileSize - 1) / tileSize;
+        int nrTileCols = (nrCols + tileSize - 1) / tileSize;
+        int nrTiles = nrTileRows * nrTileCols;
+
+        outFile.write(TD_STORE_MAGIC, sizeof(TD_STORE_MAGIC));
+        outFile.write(reinterpret_cast<const char*>(&TD_STORE_VERSION), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrRows), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrCols), sizeof(int32_t));
+        int32_t tileSize32 = tileSize;
+        outFile.write(reinterpret_cast<const char*>(&tileSize32), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&nrPoints), sizeof(int32_t));
+        outFile.write(reinterpret_cast<const char*>(&(dem.header->cellSize)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(dem.header->llCorner.x)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(dem.header->llCorner.y)), sizeof(double));
+        outFile.write(reinterpret_cast<const char*>(&(dem.header->flag)), sizeof(float));
+
+        for (int i = 0; i < nrPoints; i++)
+        {
+            int32_t length = int32_t(pointIds[unsigned(i)].size());
+            outFile.write(reinterpret_cast<const char*>(&length), sizeof(int32_t));
+            outFile.write(pointIds[unsigned(i)].data(), length);
+        }
+
+        // tile table, written at the end
+        std::streampos tablePosition = outFile.tellp();
+        size_t tableSize = size_t(nrPoints) * size_t(nrTiles);
+        std::vector<uint64_t> tileOffset(tableSize, 0);
+        std::vector<uint32_t> tileBytes(tableSize, 0);
+        outFile.write(reinterpret_cast<const char*>(tileOffset.data()), std::streamsize(tableSize * sizeof(uint64_t)));
+        outFile.write(reinterpret_cast<const char*>(tileBytes.data()), std::streamsize(tableSize * sizeof(uint32_t)));
+
+        // each thread keeps one map and its compressed tiles
+        #pragma omp parallel for schedule(dynamic) ordered if (isParallelComputing)
+        for (int i = 0; i < nrPoints; i++)
+        {
+            std::vector<std::vector<char>> buffers;
+            bool isComputed = false;
+
+            if (isSelected[unsigned(i)])
+            {
+                Crit3DRasterGrid myMap;
+                isComputed = topographicDistanceMapSweep(points[unsigned(i)], dem, sweepDem, &myMap);
+
+                if (isComputed)
+                {
+                    buffers.resize(unsigned(nrTiles));
+                    std::vector<float> values;
+
+                    for (int tile = 0; tile < nrTiles; tile++)
+                    {
+                        int firstRow = (tile / nrTileCols) * tileSize;
+                        int firstCol = (tile % nrTileCols) * tileSize;
+                        int lastRow = std::min(firstRow + tileSize, int(nrRows));
+                        int lastCol = std::min(firstCol + tileSize, int(nrCols));
+
+                        values.resize(size_t(lastRow - firstRow) * size_t(lastCol - firstCol));
+                        for (int row = firstRow; row < lastRow; row++)
+                        {
+                            std::memcpy(&values[size_t(row - firstRow) * size_t(lastCol - firstCol)],
+                                        &(myMap.value[row][firstCol]), size_t(lastCol - firstCol) * sizeof(float));
+                        }
+
+                        compressFloatBlock(values, lastCol - firstCol, myMap.header->flag, 0, buffers[unsigned(tile)]);
+                    }
+                }
+            }
+
+            #pragma omp ordered
+            {
+                if (isComputed)
+                {
+                    for (int tile = 0; tile < nrTiles; tile++)
+                    {
+                        size_t index = size_t(i) * size_t(nrTiles) + size_t(tile);
+                        tileOffset[index] = uint64_t(outFile.tellp());
+                        tileBytes[index] = uint32_t(buffers[unsigned(tile)].size());
+                        outFile.write(buffers[unsigned(tile)].data(), std::streamsize(buffers[unsigned(tile)].size()));
+                    }
+                }
+            }
+        }
+
+        outFile.seekp(tablePosition);
+        outFile.write(reinterpret_cast<const char*>(tileOffset.data()), std::streamsize(tableSize * sizeof(uint64_t)));
+        outFile.write(reinterpret_cast<const char*>(tileBytes.data()), std::streamsize(tableSize * sizeof(uint32_t)));
+
+        outFile.close();
+        if (outFile.fail() || ! replaceFile(tmpFileName, fileName))
+        {
+            std::remove(tmpFileName.c_str());
+            errorStr = "Error in writing file: " + fileName;
+            return false;
+        }
+
+        return true;
+    }
+}
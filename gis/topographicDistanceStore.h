@@ -0,0 +1,92 @@
+#ifndef TOPOGRAPHICDISTANCESTORE_H
+#define TOPOGRAPHICDISTANCESTORE_H
+
+    #ifndef GIS_H
+        #include "gis.h"
+    #endif
+    #ifndef MAPPEDFILE_H
+        #include "mappedFile.h"
+    #endif
+
+    #include <array>
+    #include <cstdint>
+    #include <list>
+    #include <memory>
+    #include <mutex>
+    #include <unordered_map>
+
+    #define TD_STORE_TILESIZE 256
+    #define TD_STORE_CACHESIZE_MB 512
+    #define TD_STORE_NRSHARDS 64
+
+    namespace gis
+    {
+        /*!
+         * \brief The Crit3DTopographicDistanceStore class
+         * topographic distance maps of all the meteo points in a single tiled file.
+         * Each tile of each point is compressed separately without loss (compressFloatBlock),
+         * the file is memory mapped and the tiles are decompressed on demand
+         * in a LRU cache of bounded size. Access is thread safe: the cache is split
+         * in shards with their own lock, so that threads reading different tiles don't wait each other.
+         */
+        class Crit3DTopographicDistanceStore
+        {
+        private:
+            std::string _fileName;
+            Crit3DRasterHeader _header;
+            int _tileSize;
+            int _nrTileRows;
+            int _nrTileCols;
+            std::vector<std::string> _pointId;
+            std::vector<uint64_t> _tileOffset;          // [point * nrTiles + tile]
+            std::vector<uint32_t> _tileBytes;
+
+            Crit3DMappedFile _file;
+
+            // LRU cache of decompressed tiles, split in shards by tile key
+            typedef std::shared_ptr<const std::vector<float>> tilePtr;
+            struct TileCacheShard
+            {
+                std::mutex mutex;
+                size_t maxSize = 0;
+                size_t size = 0;
+                std::list<uint64_t> lruList;
+                std::unordered_map<uint64_t, std::pair<tilePtr, std::list<uint64_t>::iterator>> tiles;
+            };
+            std::array<TileCacheShard, TD_STORE_NRSHARDS> _shards;
+
+            tilePtr getCachedTile(int pointIndex, int tileIndex);
+
+        public:
+            Crit3DTopographicDistanceStore();
+            ~Crit3DTopographicDistanceStore();
+
+            Crit3DTopographicDistanceStore(const Crit3DTopographicDistanceStore&) = delete;
+            Crit3DTopographicDistanceStore& operator = (const Crit3DTopographicDistanceStore&) = delete;
+
+            bool open(const std::string &fileName, std::string &errorStr);
+            void close();
+
+            bool isOpen() const { return _file.isOpen(); }
+            const Crit3DRasterHeader& getHeader() const { return _header; }
+            int getTileSize() const { return _tileSize; }
+            int getNrTileRows() const { return _nrTileRows; }
+            int getNrTileCols() const { return _nrTileCols; }
+            int getNrPoints() const { return int(_pointId.size()); }
+            std::string getPointId(int pointIndex) const { return _pointId[unsigned(pointIndex)]; }
+            bool isPointAvailable(int pointIndex) const;
+
+            void setMaxCacheSize(size_t nrMegaBytes);
+            void clearCache();
+
+            float getValue(int pointIndex, double x, double y);
+        };
+
+        bool writeTopographicDistanceStore(const std::string &fileName, const Crit3DRasterGrid &dem, const Crit3DRasterGrid &sweepDem,
+                                           const std::vector<Crit3DPoint> &points, const std::vector<std::string> &pointIds,
+                                           const std::vector<bool> &isSelected, int tileSize,
+                                           bool isParallelComputing, std::string &errorStr);
+    }
+
+
+#endif // TOPOGRAPHICDISTANCESTORE_H
@@ -1,7 +1,7 @@
 /*!
     \file watershed.cpp
 
-    \abstract functions to extract and remove spikes of river basins
+    \abstract functions to fill depressions, compute flow directions and extract river basins
 
     \copyright
     This file is part of CRITERIA3D.
@@ -27,7 +27,10 @@
 
 #include <math.h>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <queue>
+#include <unordered_map>
 #include <vector>
 
 #include "commonConstants.h"
@@ -38,97 +41,826 @@
 
 namespace gis
 {
+    // D8 neighbours: the opposite of direction i is 7 - i
+    static const int D8_ROW[8] = {-1,-1,-1, 0, 0, 1, 1, 1};
+    static const int D8_COL[8] = {-1, 0, 1,-1, 1,-1, 0, 1};
+
+    // temporary value of computeFlowDirections: cell without lower neighbours
+    #define D8_FLAT 9
+
+    // label of the cells draining outside the dem (fillDepressionsTiled)
+    #define LABEL_OUTSIDE 1
+
+
+    void getD8Offset(int direction, int &dRow, int &dCol)
+    {
+        if (direction < 0 || direction >= D8_OUTLET)
+        {
+            dRow = 0;
+            dCol = 0;
+            return;
+        }
+
+        dRow = D8_ROW[direction];
+        dCol = D8_COL[direction];
+    }
+
+
+    void Crit3DFlowDirectionGrid::initialize(const Crit3DRasterHeader &initHeader)
+    {
+        header = initHeader;
+        direction.assign(size_t(header.nrRows) * size_t(header.nrCols), D8_NODATA);
+    }
+
+
+    void Crit3DFlowDirectionGrid::clear()
+    {
+        direction.clear();
+        direction.shrink_to_fit();
+    }
+
+
+    D8Cell Crit3DFlowDirectionGrid::getDownstreamCell(int row, int col) const
+    {
+        D8Cell cell;
+        uint8_t d = getDirection(row, col);
+        if (d < D8_OUTLET)
+        {
+            cell.row = row + D8_ROW[d];
+            cell.col = col + D8_COL[d];
+        }
+
+        return cell;
+    }
+
+
+    struct FloodCell
+    {
+        float elevation;
+        size_t index;
+    };
+
+    struct FloodCellGreater
+    {
+        bool operator() (const FloodCell &a, const FloodCell &b) const
+        {
+            return a.elevation > b.elevation;
+        }
+    };
+
+    typedef std::priority_queue<FloodCell, std::vector<FloodCell>, FloodCellGreater> floodQueue;
+
+
+    // a valid cell is a drainage boundary if it is on the dem edge or next to a nodata cell
+    static bool isDrainageBoundary(const Crit3DRasterGrid& dem, int row, int col)
+    {
+        if (row == 0 || col == 0 || row == dem.header->nrRows-1 || col == dem.header->nrCols-1)
+            return true;
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (isEqual(dem.value[row + D8_ROW[i]][col + D8_COL[i]], dem.header->flag))
+                return true;
+        }
+
+        return false;
+    }
+
 
     /*!
-     * \brief extractBasin_singleStep
-     * extract a basin from a digital terrain model, starting from the closure point (xClosure, yClosure)
+     * \brief fillDepressions
+     * priority-flood depression filling (Barnes et al. 2014): the cells are flooded from the drainage boundary
+     * (dem edge and cells next to nodata) in order of elevation, a cell lower than its flooding cell is raised
+     * to its level and processed with a plain queue. O(n log n), where only the boundary of the flooded
+     * area is in the priority queue.
+     * isEpsilonGradient: the raised cells get the smallest increment (nextafter) over the flooding cell,
+     * so every cell has a lower neighbour; otherwise the depressions become flat areas
+     * (see computeFlowDirections)
      */
-    bool extractBasin_singleStep(Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
-                             double xClosure, double yClosure, std::string& errorStr)
+    bool fillDepressions(const Crit3DRasterGrid& dem, Crit3DRasterGrid& filledDem, bool isEpsilonGradient)
     {
-        // check closure point
-        const float refValue = dem.getValueFromXY(xClosure, yClosure);
-        if (isEqual(refValue, dem.header->flag))
+        if (! dem.isLoaded || ! filledDem.copyGrid(dem))
             return false;
 
-        // initialize new raster (basin)
-        Crit3DRasterGrid basinRaster;
-        basinRaster.initializeGrid(*dem.header);
+        const int nrRows = dem.header->nrRows;
+        const int nrCols = dem.header->nrCols;
+        const float flag = dem.header->flag;
+        float* z = filledDem.data();
 
-        // set first value
-        int rowClosure, colClosure;
-        dem.getRowCol(xClosure, yClosure, rowClosure, colClosure);
-        basinRaster.value[rowClosure][colClosure] = refValue;
+        std::vector<uint8_t> isClosed(filledDem.getNrCells(), 0);
+        floodQueue openQueue;
+        std::queue<size_t> pitQueue;
 
-        // initialize queue
-        std::vector<int> rowList, colList, newRowList, newColList;
-        rowList.push_back(rowClosure);
-        colList.push_back(colClosure);
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (! isEqual(z[i], flag) && isDrainageBoundary(dem, row, col))
+                {
+                    openQueue.push({z[i], i});
+                    isClosed[i] = 1;
+                }
+            }
+        }
 
-        // *** step 1: adds points with higher topographic elevation
+        while (! openQueue.empty() || ! pitQueue.empty())
+        {
+            size_t c;
+            if (! pitQueue.empty() && ! openQueue.empty() && openQueue.top().elevation == z[pitQueue.front()])
+            {
+                c = openQueue.top().index;
+                openQueue.pop();
+            }
+            else if (! pitQueue.empty())
+            {
+                c = pitQueue.front();
+                pitQueue.pop();
+            }
+            else
+            {
+                c = openQueue.top().index;
+                openQueue.pop();
+            }
 
-        float rasterValue, basinValue;
-        const int side = 3;
-        const float flag = basinRaster.header->flag;
+            int row = int(c / size_t(nrCols));
+            int col = int(c % size_t(nrCols));
+            float spillElevation = z[c];
+            if (isEpsilonGradient)
+                spillElevation = std::nextafter(spillElevation, std::numeric_limits<float>::max());
 
-        while (! rowList.empty())
+            for (int k = 0; k < 8; k++)
+            {
+                int r = row + D8_ROW[k];
+                int cl = col + D8_COL[k];
+                if (r < 0 || cl < 0 || r >= nrRows || cl >= nrCols)
+                    continue;
+
+                size_t n = size_t(r) * size_t(nrCols) + size_t(cl);
+                if (isClosed[n] || isEqual(z[n], flag))
+                    continue;
+
+                isClosed[n] = 1;
+                if (z[n] <= spillElevation)
+                {
+                    z[n] = spillElevation;
+                    pitQueue.push(n);
+                }
+                else
+                {
+                    openQueue.push({z[n], n});
+                }
+            }
+        }
+
+        updateMinMaxRasterGrid(&filledDem, false);
+        return true;
+    }
+
+
+    /*!
+     * \brief The Crit3DLabelEdges struct
+     * lowest spill elevation between two labels; the last edge is cached,
+     * since the same two areas usually meet along many cells
+     */
+    struct Crit3DLabelEdges
+    {
+        std::unordered_map<uint64_t, float> elevation;
+        uint64_t lastKey = 0;
+        float* lastElevation = nullptr;
+
+        void add(uint32_t label1, uint32_t label2, float spillElevation)
         {
-            for (size_t i=0; i < rowList.size(); ++i)
+            uint64_t key = (uint64_t(std::min(label1, label2)) << 32) | uint64_t(std::max(label1, label2));
+            if (key != lastKey || lastElevation == nullptr)
             {
-                const int row = rowList[i];
-                const int col = colList[i];
-                const float currentElevation = basinRaster.value[row][col];
-                if (! isEqual(currentElevation, flag))
+                auto it = elevation.emplace(key, spillElevation).first;
+                lastKey = key;
+                lastElevation = &(it->second);
+            }
+
+            if (spillElevation < *lastElevation)
+                *lastElevation = spillElevation;
+        }
+    };
+
+
+    // priority-flood of a single tile, seeded with all the cells of the tile perimeter
+    static void floodTile(const Crit3DRasterGrid& dem, float* z, std::vector<uint32_t> &label,
+                          int firstRow, int firstCol, int lastRow, int lastCol,
+                          uint32_t firstLabel, Crit3DLabelEdges &edges)
+    {
+        const size_t nrCols = size_t(dem.header->nrCols);
+        const float flag = dem.header->flag;
+        uint32_t nextLabel = firstLabel;
+
+        floodQueue openQueue;
+        std::queue<size_t> pitQueue;
+
+        for (int row = firstRow; row <= lastRow; row++)
+        {
+            for (int col = firstCol; col <= lastCol; col++)
+            {
+                size_t i = size_t(row) * nrCols + size_t(col);
+                if (isEqual(z[i], flag))
+                    continue;
+
+                bool isPerimeter = (row == firstRow || row == lastRow || col == firstCol || col == lastCol);
+                bool isBoundary = isDrainageBoundary(dem, row, col);
+                if (isPerimeter || isBoundary)
                 {
-                    for (int r = -side; r <= side; r++)
+                    label[i] = isBoundary ? LABEL_OUTSIDE : nextLabel++;
+                    openQueue.push({z[i], i});
+                }
+            }
+        }
+
+        while (! openQueue.empty() || ! pitQueue.empty())
+        {
+            size_t c;
+            if (! pitQueue.empty())
+            {
+                c = pitQueue.front();
+                pitQueue.pop();
+            }
+            else
+            {
+                c = openQueue.top().index;
+                openQueue.pop();
+            }
+
+            int row = int(c / nrCols);
+            int col = int(c % nrCols);
+
+            for (int k = 0; k < 8; k++)
+            {
+                int r = row + D8_ROW[k];
+                int cl = col + D8_COL[k];
+                if (r < firstRow || cl < firstCol || r > lastRow || cl > lastCol)
+                    continue;
+
+                size_t n = size_t(r) * nrCols + size_t(cl);
+                if (isEqual(z[n], flag))
+                    continue;
+
+                if (label[n] != 0)
+                {
+                    if (label[n] != label[c])
+                        edges.add(label[c], label[n], std::max(z[c], z[n]));
+                    continue;
+                }
+
+                label[n] = label[c];
+                if (z[n] <= z[c])
+                {
+                    z[n] = z[c];
+                    pitQueue.push(n);
+                }
+                else
+                {
+                    openQueue.push({z[n], n});
+                }
+            }
+        }
+    }
+
+
+    /*!
+     * \brief fillDepressionsTiled
+     * parallel priority-flood (Barnes 2016): each tile is flooded from its perimeter, labelling the cells
+     * with the perimeter cell that floods them and recording the lowest spill elevation between labels.
+     * The spill graph of the whole dem gives the level of each label, and each cell is raised to the level of its label.
+     * The result is the same of fillDepressions without epsilon gradient
+     */
+    bool fillDepressionsTiled(const Crit3DRasterGrid& dem, Crit3DRasterGrid& filledDem, int tileSize,
+                              bool isParallelComputing)
+    {
+        if (! dem.isLoaded || tileSize < 2 || ! filledDem.copyGrid(dem))
+            return false;
+
+        const int nrRows = dem.header->nrRows;
+        const int nrCols = dem.header->nrCols;
+        const float flag = dem.header->flag;
+        float* z = filledDem.data();
+
+        const int nrTileRows = (nrRows + tileSize - 1) / tileSize;
+        const int nrTileCols = (nrCols + tileSize - 1) / tileSize;
+        const int nrTiles = nrTileRows * nrTileCols;
+
+        // labels: 0 not flooded, LABEL_OUTSIDE drainage boundary, then one label for each perimeter cell
+        std::vector<uint32_t> firstLabel(size_t(nrTiles), 0);
+        uint32_t nrLabels = LABEL_OUTSIDE + 1;
+        for (int t = 0; t < nrTiles; t++)
+        {
+            int h = std::min(tileSize, nrRows - (t / nrTileCols) * tileSize);
+            int w = std::min(tileSize, nrCols - (t % nrTileCols) * tileSize);
+            firstLabel[unsigned(t)] = nrLabels;
+            nrLabels += uint32_t((h == 1 || w == 1) ? h * w : 2 * (h + w) - 4);
+        }
+
+        std::vector<uint32_t> label(filledDem.getNrCells(), 0);
+        std::vector<Crit3DLabelEdges> edges;
+        edges.resize(size_t(nrTiles));
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int t = 0; t < nrTiles; t++)
+        {
+            int firstRow = (t / nrTileCols) * tileSize;
+            int firstCol = (t % nrTileCols) * tileSize;
+            int lastRow = std::min(firstRow + tileSize, nrRows) - 1;
+            int lastCol = std::min(firstCol + tileSize, nrCols) - 1;
+
+            floodTile(dem, z, label, firstRow, firstCol, lastRow, lastCol, firstLabel[unsigned(t)], edges[unsigned(t)]);
+        }
+
+        // spill elevations between adjacent perimeter cells of different tiles
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int t = 0; t < nrTiles; t++)
+        {
+            int firstRow = (t / nrTileCols) * tileSize;
+            int firstCol = (t % nrTileCols) * tileSize;
+            int lastRow = std::min(firstRow + tileSize, nrRows) - 1;
+            int lastCol = std::min(firstCol + tileSize, nrCols) - 1;
+
+            for (int row = firstRow; row <= lastRow; row++)
+            {
+                int colStep = (row == firstRow || row == lastRow) ? 1 : std::max(1, lastCol - firstCol);
+                for (int col = firstCol; col <= lastCol; col += colStep)
+                {
+                    size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                    if (isEqual(z[i], flag))
+                        continue;
+
+                    for (int k = 0; k < 8; k++)
                     {
-                        for (int c = -side; c <= side; c++)
-                        {
-                            if (r != 0 || c != 0)
-                            {
-                                rasterValue = dem.getValueFromRowCol(row+r, col+c);
-                                if (! isEqual(rasterValue, dem.header->flag) && (rasterValue >= currentElevation))
-                                {
-                                    basinValue = basinRaster.getValueFromRowCol(row+r, col+c);
-                                    if (isEqual(basinValue, flag))
-                                    {
-                                        newRowList.push_back(row+r);
-                                        newColList.push_back(col+c);
-                                        basinRaster.value[row+r][col+c] = rasterValue;
-                                    }
-                                }
-                            }
-                        }
+                        int r = row + D8_ROW[k];
+                        int cl = col + D8_COL[k];
+                        if (r < 0 || cl < 0 || r >= nrRows || cl >= nrCols
+                            || (r >= firstRow && r <= lastRow && cl >= firstCol && cl <= lastCol))
+                            continue;
+
+                        size_t n = size_t(r) * size_t(nrCols) + size_t(cl);
+                        if (! isEqual(z[n], flag) && label[i] != label[n])
+                            edges[unsigned(t)].add(label[i], label[n], std::max(z[i], z[n]));
+                    }
+                }
+            }
+        }
+
+        // level of each label: lowest spill elevation on the paths to the drainage boundary
+        std::vector<std::vector<std::pair<uint32_t, float>>> graph(nrLabels);
+        for (int t = 0; t < nrTiles; t++)
+        {
+            for (const auto &edge : edges[unsigned(t)].elevation)
+            {
+                uint32_t label1 = uint32_t(edge.first >> 32);
+                uint32_t label2 = uint32_t(edge.first & 0xFFFFFFFF);
+                graph[label1].push_back(std::make_pair(label2, edge.second));
+                graph[label2].push_back(std::make_pair(label1, edge.second));
+            }
+            edges[unsigned(t)].elevation.clear();
+        }
+
+        std::vector<float> level(nrLabels, std::numeric_limits<float>::infinity());
+        level[LABEL_OUTSIDE] = -std::numeric_limits<float>::infinity();
+
+        floodQueue graphQueue;
+        graphQueue.push({level[LABEL_OUTSIDE], LABEL_OUTSIDE});
+        while (! graphQueue.empty())
+        {
+            FloodCell current = graphQueue.top();
+            graphQueue.pop();
+            if (current.elevation > level[current.index])
+                continue;
+
+            for (const auto &edge : graph[current.index])
+            {
+                float spillElevation = std::max(current.elevation, edge.second);
+                if (spillElevation < level[edge.first])
+                {
+                    level[edge.first] = spillElevation;
+                    graphQueue.push({spillElevation, edge.first});
+                }
+            }
+        }
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (label[i] > LABEL_OUTSIDE && level[label[i]] > z[i] && level[label[i]] < std::numeric_limits<float>::infinity())
+                    z[i] = level[label[i]];
+            }
+        }
+
+        updateMinMaxRasterGrid(&filledDem, isParallelComputing);
+        return true;
+    }
+
+
+    /*!
+     * \brief computeFlowDirections
+     * D8 steepest descent direction of each cell of dem (usually a filled dem).
+     * A cell without lower neighbours is an outlet if it is a drainage boundary or isResolveFlats is false,
+     * otherwise flat areas drain towards their nearest lower edge (breadth-first from the cells that already drain);
+     * closed depressions (dem not filled) are outlets
+     */
+    bool computeFlowDirections(const Crit3DRasterGrid& dem, Crit3DFlowDirectionGrid& flowDirection,
+                               bool isResolveFlats, bool isParallelComputing)
+    {
+        if (! dem.isLoaded)
+            return false;
+
+        flowDirection.initialize(*dem.header);
+
+        const int nrRows = dem.header->nrRows;
+        const int nrCols = dem.header->nrCols;
+        const float flag = dem.header->flag;
+        const float diagonalFactor = float(1. / std::sqrt(2.));
+        uint8_t* dir = flowDirection.direction.data();
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                const float z = dem.value[row][col];
+                if (isEqual(z, flag))
+                    continue;
+
+                float maxSlope = 0;
+                int bestDirection = -1;
+                bool isBoundary = false;
+
+                for (int k = 0; k < 8; k++)
+                {
+                    int r = row + D8_ROW[k];
+                    int c = col + D8_COL[k];
+                    if (r < 0 || c < 0 || r >= nrRows || c >= nrCols)
+                    {
+                        isBoundary = true;
+                        continue;
+                    }
+
+                    const float neighbour = dem.value[r][c];
+                    if (isEqual(neighbour, flag))
+                    {
+                        isBoundary = true;
+                        continue;
+                    }
+
+                    float slope = z - neighbour;
+                    if (D8_ROW[k] != 0 && D8_COL[k] != 0)
+                        slope *= diagonalFactor;
+
+                    if (slope > maxSlope)
+                    {
+                        maxSlope = slope;
+                        bestDirection = k;
+                    }
+                }
+
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (bestDirection >= 0)
+                    dir[i] = uint8_t(bestDirection);
+                else
+                    dir[i] = (isBoundary || ! isResolveFlats) ? D8_OUTLET : D8_FLAT;
+            }
+        }
+
+        if (! isResolveFlats)
+            return true;
+
+        // flat areas: first the cells next to a draining cell at the same elevation
+        const float* z = dem.data();
+        std::vector<size_t> flatList;
+        std::vector<uint8_t> flatDirection;
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (dir[i] != D8_FLAT)
+                    continue;
+
+                for (int k = 0; k < 8; k++)
+                {
+                    // flat cells are not on the dem edge
+                    size_t n = size_t(row + D8_ROW[k]) * size_t(nrCols) + size_t(col + D8_COL[k]);
+                    if (dir[n] <= D8_OUTLET && z[n] == z[i])
+                    {
+                        flatList.push_back(i);
+                        flatDirection.push_back(uint8_t(k));
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (size_t j = 0; j < flatList.size(); j++)
+            dir[flatList[j]] = flatDirection[j];
+
+        for (size_t j = 0; j < flatList.size(); j++)
+        {
+            size_t c = flatList[j];
+            int row = int(c / size_t(nrCols));
+            int col = int(c % size_t(nrCols));
+
+            for (int k = 0; k < 8; k++)
+            {
+                size_t n = size_t(row + D8_ROW[k]) * size_t(nrCols) + size_t(col + D8_COL[k]);
+                if (dir[n] == D8_FLAT && z[n] == z[c])
+                {
+                    dir[n] = uint8_t(7 - k);
+                    flatList.push_back(n);
+                }
+            }
+        }
+
+        // closed depressions
+        std::replace(flowDirection.direction.begin(), flowDirection.direction.end(), uint8_t(D8_FLAT), uint8_t(D8_OUTLET));
+
+        return true;
+    }
+
+
+    /*!
+     * \brief computeFlowAccumulation
+     * number of cells draining through each cell (the cell itself included).
+     * The cells are visited in topological order: a cell is processed when all its upstream cells are done
+     */
+    bool computeFlowAccumulation(const Crit3DFlowDirectionGrid& flowDirection, Crit3DRasterGrid& accumulation,
+                                 bool isParallelComputing)
+    {
+        if (! flowDirection.isLoaded() || ! accumulation.initializeGrid(flowDirection.header))
+            return false;
+
+        const int nrRows = flowDirection.header.nrRows;
+        const int nrCols = flowDirection.header.nrCols;
+        const size_t nrCells = flowDirection.direction.size();
+        const uint8_t* dir = flowDirection.direction.data();
+
+        long offset[8];
+        for (int k = 0; k < 8; k++)
+            offset[k] = D8_ROW[k] * long(nrCols) + D8_COL[k];
+
+        // number of upstream neighbours
+        std::vector<uint8_t> nrUpstream(nrCells, 0);
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (dir[i] == D8_NODATA)
+                    continue;
+
+                uint8_t count = 0;
+                for (int k = 0; k < 8; k++)
+                {
+                    int r = row + D8_ROW[k];
+                    int c = col + D8_COL[k];
+                    if (r >= 0 && c >= 0 && r < nrRows && c < nrCols && dir[size_t(long(i) + offset[k])] == 7 - k)
+                        count++;
+                }
+                nrUpstream[i] = count;
+            }
+        }
+
+        // each chain of cells is followed downstream until a cell with upstream cells still to be done
+        std::vector<uint32_t> nrDrainedCells(nrCells, 1);
+        for (size_t i = 0; i < nrCells; i++)
+        {
+            if (dir[i] == D8_NODATA || nrUpstream[i] != 0)
+                continue;
+
+            size_t c = i;
+            while (true)
+            {
+                nrUpstream[c] = D8_NODATA;
+
+                if (dir[c] >= D8_OUTLET)
+                    break;
+
+                size_t downstream = size_t(long(c) + offset[dir[c]]);
+                nrDrainedCells[downstream] += nrDrainedCells[c];
+
+                if (--nrUpstream[downstream] != 0)
+                    break;
+
+                c = downstream;
+            }
+        }
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            for (int col = 0; col < nrCols; col++)
+            {
+                size_t i = size_t(row) * size_t(nrCols) + size_t(col);
+                if (dir[i] != D8_NODATA)
+                    accumulation.value[row][col] = float(nrDrainedCells[i]);
+            }
+        }
+
+        updateMinMaxRasterGrid(&accumulation, isParallelComputing);
+        return true;
+    }
+
+
+    /*!
+     * \brief computeUpstreamArea
+     * marks in isUpstream (one value for each cell) the closure cell and all the cells draining into it,
+     * with a single upstream traversal of the flow directions
+     */
+    bool computeUpstreamArea(const Crit3DFlowDirectionGrid& flowDirection, int rowClosure, int colClosure,
+                             std::vector<uint8_t>& isUpstream)
+    {
+        const int nrRows = flowDirection.header.nrRows;
+        const int nrCols = flowDirection.header.nrCols;
+
+        if (! flowDirection.isLoaded() || rowClosure < 0 || colClosure < 0 || rowClosure >= nrRows || colClosure >= nrCols)
+            return false;
+
+        if (flowDirection.getDirection(rowClosure, colClosure) == D8_NODATA)
+            return false;
+
+        const uint8_t* dir = flowDirection.direction.data();
+        isUpstream.assign(flowDirection.direction.size(), 0);
+
+        std::vector<size_t> cellList;
+        size_t closure = size_t(rowClosure) * size_t(nrCols) + size_t(colClosure);
+        cellList.push_back(closure);
+        isUpstream[closure] = 1;
+
+        for (size_t j = 0; j < cellList.size(); j++)
+        {
+            int row = int(cellList[j] / size_t(nrCols));
+            int col = int(cellList[j] % size_t(nrCols));
+
+            for (int k = 0; k < 8; k++)
+            {
+                int r = row + D8_ROW[k];
+                int c = col + D8_COL[k];
+                if (r < 0 || c < 0 || r >= nrRows || c >= nrCols)
+                    continue;
+
+                size_t n = size_t(r) * size_t(nrCols) + size_t(c);
+                if (! isUpstream[n] && dir[n] == 7 - k)
+                {
+                    isUpstream[n] = 1;
+                    cellList.push_back(n);
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    // copies the dem values of the basin cells and deletes the empty frame
+    static bool getBasinRaster(const Crit3DRasterGrid& dem, const std::vector<uint8_t>& isUpstream,
+                               Crit3DRasterGrid& outputRaster, std::string& errorStr)
+    {
+        Crit3DRasterGrid basinRaster;
+        basinRaster.initializeGrid(*dem.header);
+
+        const size_t nrCols = size_t(dem.header->nrCols);
+        for (int row = 0; row < dem.header->nrRows; row++)
+        {
+            for (int col = 0; col < dem.header->nrCols; col++)
+            {
+                if (isUpstream[size_t(row) * nrCols + size_t(col)])
+                    basinRaster.value[row][col] = dem.value[row][col];
+            }
+        }
+
+        return resizeRasterCutEmptyFrame(&basinRaster, &outputRaster, errorStr);
+    }
+
+
+    /*!
+     * \brief extractBasin
+     * extract a basin from a digital terrain model, starting from the closure point (x, y)
+     */
+    bool extractBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
+                      double xClosure, double yClosure, std::string& errorStr)
+    {
+        // initialize basin raster with dem
+        Crit3DRasterGrid basinRaster;
+        basinRaster.copyGrid(dem);
+
+        int nrExtraction = 3;
+        for (int i = 0; i < nrExtraction; i++)
+        {
+            if (! extractBasin_singleStep(basinRaster, outputRaster, xClosure, yClosure, errorStr))
+                return false;
+
+            if (i < nrExtraction-1)
+                basinRaster.copyGrid(outputRaster);
+        }
+
+        return true;
+    }
+
+
+    /*!
+     * \brief extractBasin
+     * extract a basin from a digital terrain model, starting from the closure point (x, y):
+     * the depressions are filled and the basin is the upstream area of the closure cell.
+     * If nrSnapCells > 0 the closure point is first moved to the cell with the largest flow accumulation
+     * within nrSnapCells cells (e.g. a point digitized next to the stream); 0: the closure cell is used as it is
+     */
+    bool extractBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
+                      double xClosure, double yClosure, int nrSnapCells, bool isParallelComputing, std::string& errorStr)
+    {
+        int rowClosure, colClosure;
+        dem.getRowCol(xClosure, yClosure, rowClosure, colClosure);
+        if (dem.isOutOfGrid(rowClosure, colClosure) || isEqual(dem.value[rowClosure][colClosure], dem.header->flag))
+        {
+            errorStr = "The closure point is outside the DEM.";
+            return false;
+        }
+
+        // the tiled version gives the same result
+        Crit3DRasterGrid filledDem;
+        bool isFilled;
+        if (isParallelComputing)
+            isFilled = fillDepressionsTiled(dem, filledDem, WATERSHED_TILESIZE, true);
+        else
+            isFilled = fillDepressions(dem, filledDem, false);
+
+        if (! isFilled)
+        {
+            errorStr = "Error in filling the DEM depressions.";
+            return false;
+        }
+
+        Crit3DFlowDirectionGrid flowDirection;
+        computeFlowDirections(filledDem, flowDirection, true, isParallelComputing);
+        filledDem.clear();
+
+        int rowOutlet = rowClosure;
+        int colOutlet = colClosure;
+
+        if (nrSnapCells > 0)
+        {
+            Crit3DRasterGrid accumulation;
+            computeFlowAccumulation(flowDirection, accumulation, isParallelComputing);
+
+            float maxAccumulation = accumulation.value[rowClosure][colClosure];
+            for (int r = rowClosure - nrSnapCells; r <= rowClosure + nrSnapCells; r++)
+            {
+                for (int c = colClosure - nrSnapCells; c <= colClosure + nrSnapCells; c++)
+                {
+                    if (! accumulation.isOutOfGrid(r, c) && ! isEqual(accumulation.value[r][c], accumulation.header->flag)
+                        && accumulation.value[r][c] > maxAccumulation)
+                    {
+                        maxAccumulation = accumulation.value[r][c];
+                        rowOutlet = r;
+                        colOutlet = c;
                     }
                 }
             }
-
-            rowList.swap(newRowList);
-            colList.swap(newColList);
-            newRowList.clear();
-            newColList.clear();
         }
 
-        rowList.clear();
-        colList.clear();
-
-        // *** step 2: add terrain depressions
+        std::vector<uint8_t> isUpstream;
+        if (! computeUpstreamArea(flowDirection, rowOutlet, colOutlet, isUpstream))
+        {
+            errorStr = "The closure point is outside the DEM.";
+            return false;
+        }
 
-        addTerrainDepressions(dem, basinRaster);
+        return getBasinRaster(dem, isUpstream, outputRaster, errorStr);
+    }
 
-        // *** step 3: clean the basin
 
-        // 3.1) remove points relating to other basins
-        cleanBasin_simple(dem, basinRaster, xClosure, yClosure);
+    /*!
+    * \brief cleanBasin
+    * Keeps only cells draining to closure point (strict D8 directions of dem, without filling:
+    * the cells without lower neighbours, flat areas included, have no receiver)
+    */
+    bool cleanBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
+                    double xClosure, double yClosure)
+    {
+        int rowClosure, colClosure;
+        dem.getRowCol(xClosure, yClosure, rowClosure, colClosure);
+        if (dem.isOutOfGrid(rowClosure, colClosure))
+            return false;
 
-        // 3.2) remove disconnected areas
-        removeDisconnectedAreas(basinRaster, rowClosure, colClosure);
+        Crit3DFlowDirectionGrid flowDirection;
+        if (! computeFlowDirections(dem, flowDirection, false, false))
+            return false;
 
-        // 3.3) delete empty frames and copy the output raster
-        if (! resizeRasterCutEmptyFrame(&basinRaster, &outputRaster, errorStr))
+        std::vector<uint8_t> isUpstream;
+        if (! computeUpstreamArea(flowDirection, rowClosure, colClosure, isUpstream))
             return false;
 
-        return true;
+        std::string errorStr;
+        return getBasinRaster(dem, isUpstream, outputRaster, errorStr);
     }
 
 
@@ -332,6 +1064,99 @@ namespace gis
     }
 
 
+    /*!
+     * \brief extractBasin_singleStep
+     * extract a basin from a digital terrain model, starting from the closure point (xClosure, yClosure)
+     */
+    bool extractBasin_singleStep(Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
+                             double xClosure, double yClosure, std::string& errorStr)
+    {
+        // check closure point
+        const float refValue = dem.getValueFromXY(xClosure, yClosure);
+        if (isEqual(refValue, dem.header->flag))
+            return false;
+
+        // initialize new raster (basin)
+        Crit3DRasterGrid basinRaster;
+        basinRaster.initializeGrid(*dem.header);
+
+        // set first value
+        int rowClosure, colClosure;
+        dem.getRowCol(xClosure, yClosure, rowClosure, colClosure);
+        basinRaster.value[rowClosure][colClosure] = refValue;
+
+        // initialize queue
+        std::vector<int> rowList, colList, newRowList, newColList;
+        rowList.push_back(rowClosure);
+        colList.push_back(colClosure);
+
+        // *** step 1: adds points with higher topographic elevation
+
+        float rasterValue, basinValue;
+        const int side = 3;
+        const float flag = basinRaster.header->flag;
+
+        while (! rowList.empty())
+        {
+            for (size_t i=0; i < rowList.size(); ++i)
+            {
+                const int row = rowList[i];
+                const int col = colList[i];
+                const float currentElevation = basinRaster.value[row][col];
+                if (! isEqual(currentElevation, flag))
+                {
+                    for (int r = -side; r <= side; r++)
+                    {
+                        for (int c = -side; c <= side; c++)
+                        {
+                            if (r != 0 || c != 0)
+                            {
+                                rasterValue = dem.getValueFromRowCol(row+r, col+c);
+                                if (! isEqual(rasterValue, dem.header->flag) && (rasterValue >= currentElevation))
+                                {
+                                    basinValue = basinRaster.getValueFromRowCol(row+r, col+c);
+                                    if (isEqual(basinValue, flag))
+                                    {
+                                        newRowList.push_back(row+r);
+                                        newColList.push_back(col+c);
+                                        basinRaster.value[row+r][col+c] = rasterValue;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            rowList.swap(newRowList);
+            colList.swap(newColList);
+            newRowList.clear();
+            newColList.clear();
+        }
+
+        rowList.clear();
+        colList.clear();
+
+        // *** step 2: add terrain depressions
+
+        addTerrainDepressions(dem, basinRaster);
+
+        // *** step 3: clean the basin
+
+        // 3.1) remove points relating to other basins
+        cleanBasin_simple(dem, basinRaster, xClosure, yClosure);
+
+        // 3.2) remove disconnected areas
+        removeDisconnectedAreas(basinRaster, rowClosure, colClosure);
+
+        // 3.3) delete empty frames and copy the output raster
+        if (! resizeRasterCutEmptyFrame(&basinRaster, &outputRaster, errorStr))
+            return false;
+
+        return true;
+    }
+
+
     /*!
     * \brief cleanBasin
     * removes points relating to other basins, starting from closure point
@@ -397,209 +1222,6 @@ namespace gis
     }
 
 
-    /*!
-     * \brief extractBasin
-     * extract a basin from a digital terrain model, starting from the closure point (x, y)
-     */
-    bool extractBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
-                      double xClosure, double yClosure, std::string& errorStr)
-    {
-        // initialize basin raster with dem
-        Crit3DRasterGrid basinRaster;
-        basinRaster.copyGrid(dem);
-
-        int nrExtraction = 3;
-        for (int i = 0; i < nrExtraction; i++)
-        {
-            if (! extractBasin_singleStep(basinRaster, outputRaster, xClosure, yClosure, errorStr))
-                return false;
-
-            if (i < nrExtraction-1)
-                basinRaster.copyGrid(outputRaster);
-        }
-
-        return true;
-    }
-
-
-    // returns downstream receiver cell using D8 steepest descent
-    static D8Cell computeFlowDirectionD8(const Crit3DRasterGrid& dem, int row, int col)
-    {
-        float center = dem.getValueFromRowCol(row, col);
-
-        if (isEqual(center, dem.header->flag))
-            return {};
-
-        static const int dr[8] = {-1,-1,-1, 0,0, 1,1,1};
-        static const int dc[8] = {-1, 0, 1,-1,1,-1,0,1};
-
-        float bestSlope = 0.f;
-        D8Cell bestCell;
-
-        for (int i = 0; i < 8; ++i)
-        {
-            int nr = row + dr[i];
-            int nc = col + dc[i];
-
-            if (nr < 0 || nc < 0 ||
-                nr >= dem.header->nrRows ||
-                nc >= dem.header->nrCols)
-            {
-                continue;
-            }
-
-            float neigh = dem.getValueFromRowCol(nr, nc);
-
-            if (isEqual(neigh, dem.header->flag))
-                continue;
-
-            double dist =
-                (dr[i] != 0 && dc[i] != 0)
-                    ? dem.header->cellSize * std::sqrt(2.0)
-                    : dem.header->cellSize;
-
-            float slope = (center - neigh) / float(dist);
-
-            if (slope > bestSlope)
-            {
-                bestSlope = slope;
-                bestCell.row = nr;
-                bestCell.col = nc;
-            }
-        }
-
-        return bestCell;
-    }
-
-
-    /*!
-    * \brief cleanBasin
-    * Keeps only cells draining to closure point
-    */
-    bool cleanBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
-                    double xClosure, double yClosure)
-    {
-        const int nrRows = dem.header->nrRows;
-        const int nrCols = dem.header->nrCols;
-
-        // ---------------------------------------------------------
-        // 1. check closure cell
-        // ---------------------------------------------------------
-        int closureRow, closureCol;
-
-        dem.getRowCol(xClosure, yClosure,
-                      closureRow, closureCol);
-
-        if (closureRow < 0 || closureCol < 0 ||
-            closureRow >= nrRows || closureCol >= nrCols)
-        {
-            return false;
-        }
-
-        // initialize basin
-        gis::Crit3DRasterGrid basinRaster;
-        basinRaster.copyGrid(dem);
-
-        // ---------------------------------------------------------
-        // 2. compute downstream receiver for each cell
-        // ---------------------------------------------------------
-
-        std::vector<std::vector<D8Cell>> flow(
-            nrRows,
-            std::vector<D8Cell>(nrCols));
-
-        for (int r = 0; r < nrRows; ++r)
-        {
-            for (int c = 0; c < nrCols; ++c)
-            {
-                if (! isEqual(basinRaster.value[r][c],
-                             basinRaster.header->flag))
-                {
-                    flow[r][c] =
-                        computeFlowDirectionD8(dem, r, c);
-                }
-            }
-        }
-
-        // ---------------------------------------------------------
-        // 3. reverse adjacency list
-        //    (who drains into me?)
-        // ---------------------------------------------------------
-
-        std::vector<std::vector<std::vector<Cell>>> upstream(
-            nrRows,
-            std::vector<std::vector<Cell>>(nrCols));
-
-        for (int r = 0; r < nrRows; ++r)
-        {
-            for (int c = 0; c < nrCols; ++c)
-            {
-                D8Cell dst = flow[r][c];
-
-                if (dst.isValid())
-                {
-                    upstream[dst.row][dst.col]
-                        .push_back({r, c});
-                }
-            }
-        }
-
-        // ---------------------------------------------------------
-        // 4. upstream flood-fill from closure
-        // ---------------------------------------------------------
-
-        std::vector<std::vector<bool>> keep(
-            nrRows,
-            std::vector<bool>(nrCols, false));
-
-        std::queue<Cell> q;
-
-        q.push({closureRow, closureCol});
-        keep[closureRow][closureCol] = true;
-
-        while (!q.empty())
-        {
-            Cell current = q.front();
-            q.pop();
-
-            for (const Cell& up :
-                 upstream[current.row][current.col])
-            {
-                if (!keep[up.row][up.col])
-                {
-                    keep[up.row][up.col] = true;
-                    q.push(up);
-                }
-            }
-        }
-
-        // ---------------------------------------------------------
-        // 5. remove cells outside watershed
-        // ---------------------------------------------------------
-
-        for (int r = 0; r < nrRows; ++r)
-        {
-            for (int c = 0; c < nrCols; ++c)
-            {
-                if (! keep[r][c])
-                {
-                    basinRaster.value[r][c] =
-                        basinRaster.header->flag;
-                }
-            }
-        }
-
-        // delete empty frame
-        std::string errorStr;
-        if (! resizeRasterCutEmptyFrame(&basinRaster, &outputRaster, errorStr))
-        {
-            return false;
-        }
-
-        return true;
-    }
-
-
     bool computeWaterRunoffPath(const Crit3DRasterGrid& inputRaster, Crit3DRasterGrid& outputRaster, double xStart, double yStart)
     {
         outputRaster.initializeGrid(inputRaster);
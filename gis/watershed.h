@@ -3,6 +3,12 @@
 
     #include "gis.h"
 
+    #include <cstdint>
+
+    #define D8_OUTLET 8
+    #define D8_NODATA 255
+    #define WATERSHED_TILESIZE 1024
+
     struct D8Cell
     {
         int row = -1;
@@ -23,7 +29,43 @@
 
     namespace gis
     {
-        static D8Cell computeFlowDirectionD8(const Crit3DRasterGrid& dem, int row, int col);
+        /*!
+         * \brief The Crit3DFlowDirectionGrid class
+         * D8 flow directions, one byte for each cell: index of the downstream neighbour (0-7, see getD8Offset),
+         * D8_OUTLET if the cell has no downstream cell, D8_NODATA outside the dem
+         */
+        class Crit3DFlowDirectionGrid
+        {
+        public:
+            Crit3DRasterHeader header;
+            std::vector<uint8_t> direction;
+
+            void initialize(const Crit3DRasterHeader &initHeader);
+            void clear();
+
+            bool isLoaded() const { return ! direction.empty(); }
+
+            uint8_t getDirection(int row, int col) const
+            { return direction[size_t(row) * size_t(header.nrCols) + size_t(col)]; }
+
+            D8Cell getDownstreamCell(int row, int col) const;
+        };
+
+        void getD8Offset(int direction, int &dRow, int &dCol);
+
+        bool fillDepressions(const Crit3DRasterGrid& dem, Crit3DRasterGrid& filledDem, bool isEpsilonGradient);
+
+        bool fillDepressionsTiled(const Crit3DRasterGrid& dem, Crit3DRasterGrid& filledDem, int tileSize,
+                                  bool isParallelComputing);
+
+        bool computeFlowDirections(const Crit3DRasterGrid& dem, Crit3DFlowDirectionGrid& flowDirection,
+                                   bool isResolveFlats, bool isParallelComputing);
+
+        bool computeFlowAccumulation(const Crit3DFlowDirectionGrid& flowDirection, Crit3DRasterGrid& accumulation,
+                                     bool isParallelComputing);
+
+        bool computeUpstreamArea(const Crit3DFlowDirectionGrid& flowDirection, int rowClosure, int colClosure,
+                                 std::vector<uint8_t>& isUpstream);
 
         bool cleanBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& basinMask,
                         double xClosure, double yClosure);
@@ -40,6 +82,10 @@
 
         bool extractBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
                           double xClosure, double yClosure, std::string &errorStr);
+
+        bool extractBasin(const Crit3DRasterGrid& dem, Crit3DRasterGrid& outputRaster,
+                          double xClosure, double yClosure, int nrSnapCells, bool isParallelComputing,
+                          std::string &errorStr);
     }
 
 
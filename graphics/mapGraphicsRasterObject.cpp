@@ -373,14 +373,14 @@ bool RasterObject::drawRaster(gis::Crit3DRasterGrid *myRaster, QPainter* myPaint
         if (this->isLatLon)
         {
             // lat lon raster
-            gis::updateColorScale(myRaster, window);
+            gis::updateColorScale(myRaster, window, true);
         }
         else
         {
             // UTM raster
             gis::Crit3DRasterWindow* utmWindow = new gis::Crit3DRasterWindow();
             gis::getUtmWindow(this->latLonHeader, *(myRaster->header), window, utmWindow, this->utmZone);
-            gis::updateColorScale(myRaster, *utmWindow);
+            gis::updateColorScale(myRaster, *utmWindow, true);
         }
         roundColorScale(myRaster->colorScale, 4, true);
     }
@@ -349,7 +349,7 @@ bool RasterUtmObject::drawRaster(QPainter* painter)
 
     if (! colorScale->isFixedRange())
     {
-        gis::updateColorScale(raster, rasterWindow);
+        gis::updateColorScale(raster, rasterWindow, true);
         roundColorScale(colorScale, 4, true);
     }
 
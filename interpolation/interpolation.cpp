@@ -29,6 +29,7 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <omp.h>
 
 #include "commonConstants.h"
@@ -38,6 +39,8 @@
 #include "basicMath.h"
 #include "meteoPoint.h"
 #include "gis.h"
+#include "topographicDistanceStore.h"
+#include "stationDistanceCache.h"
 #include "spatialControl.h"
 #include "interpolationPoint.h"
 #include "interpolation.h"
@@ -229,22 +232,8 @@ std::vector<float> computeDistances(meteoVariable myVar, const std::vector <Crit
                 int kh = interpolationSettings.getTopoDist_Kh();
                 if (kh != 0)
                 {
-                    topoDistance = NODATA;
-                    if (myPoints[i].topographicDistance != nullptr)
-                    {
-                        if (! gis::isOutOfGridXY(x, y, myPoints[i].topographicDistance->header))
-                        {
-                            int row, col;
-                            gis::getRowColFromXY(*(myPoints[i].topographicDistance->header), x, y, &row, &col);
-                            topoDistance = myPoints[i].topographicDistance->value[row][col];
-                        }
-                    }
-
-                    if (isEqual(topoDistance, NODATA))
-                        topoDistance = topographicDistance(x, y, z, float(myPoints[i].point->utm.x),
-                                                           float(myPoints[i].point->utm.y),
-                                                           float(myPoints[i].point->z), distance[i],
-                                                           *(interpolationSettings.getCurrentDEM()));
+                    topoDistance = getPointTopographicDistance(myPoints[i].topographicDistance, myPoints[i].index,
+                                                               *(myPoints[i].point), x, y, z, distance[i], interpolationSettings);
                 }
 
                 distance[i] += (kh * topoDistance);
@@ -256,9 +245,56 @@ std::vector<float> computeDistances(meteoVariable myVar, const std::vector <Crit
 }
 
 
+/*!
+ * \brief getPointTopographicDistance
+ * topographic distance of (x, y, z) from a point: read from the point map or from the store,
+ * otherwise computed on the current DEM. distance is the euclidean distance
+ */
+float getPointTopographicDistance(const gis::Crit3DRasterGrid* pointMap, int pointIndex, const gis::Crit3DPoint &point,
+                                  float x, float y, float z, float distance, const Crit3DInterpolationSettings &interpolationSettings)
+{
+    float topoDistance = NODATA;
+
+    if (pointMap != nullptr)
+    {
+        if (! gis::isOutOfGridXY(x, y, pointMap->header))
+        {
+            int row, col;
+            gis::getRowColFromXY(*(pointMap->header), x, y, &row, &col);
+            topoDistance = pointMap->value[row][col];
+        }
+    }
+    else if (interpolationSettings.getTopographicDistanceStore() != nullptr
+             && interpolationSettings.getTopographicDistanceStore()->isOpen())
+    {
+        topoDistance = interpolationSettings.getTopographicDistanceStore()->getValue(pointIndex, x, y);
+    }
+
+    if (isEqual(topoDistance, NODATA))
+        topoDistance = topographicDistance(x, y, z, float(point.utm.x), float(point.utm.y), float(point.z),
+                                           distance, *(interpolationSettings.getCurrentDEM()));
+
+    return topoDistance;
+}
+
+
 bool neighbourhoodVariability(meteoVariable myVar, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                               const Crit3DInterpolationSettings &interpolationSettings, float x, float y, float z, int maxNrPoints,
                               float &devSt, float &avgDeltaZ, float &minDistance)
+{
+    std::vector<int> neighbourIndex;
+    return neighbourhoodVariability(myVar, interpolationPoints, interpolationSettings, x, y, z, maxNrPoints,
+                                    devSt, avgDeltaZ, minDistance, neighbourIndex);
+}
+
+
+/*!
+ * \brief neighbourhoodVariability
+ * as above, neighbourIndex are the indexes of the points of the neighbourhood
+ */
+bool neighbourhoodVariability(meteoVariable myVar, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                              const Crit3DInterpolationSettings &interpolationSettings, float x, float y, float z, int maxNrPoints,
+                              float &devSt, float &avgDeltaZ, float &minDistance, std::vector<int> &neighbourIndex)
 {
     vector <Crit3DInterpolationDataPoint> validPoints;
     vector <float> validDistances;
@@ -266,6 +302,10 @@ bool neighbourhoodVariability(meteoVariable myVar, std::vector<Crit3DInterpolati
     vector <float> distances = computeDistances(myVar, interpolationPoints, interpolationSettings, x, y, z, true);
     int nrValidPoints = sortPointsByDistance(maxNrPoints, interpolationPoints, distances, validPoints, validDistances);
 
+    neighbourIndex.resize(unsigned(nrValidPoints));
+    for (int i = 0; i < nrValidPoints; i++)
+        neighbourIndex[unsigned(i)] = validPoints[unsigned(i)].index;
+
     if (nrValidPoints <= 1)
         return false;
 
@@ -868,17 +908,17 @@ float shepardSearchNeighbour(const std::vector<Crit3DInterpolationDataPoint> &in
 }
 
 
-float shepardIdw(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std::vector <float> &distances,
-                 Crit3DInterpolationSettings &interpolationSettings, float x, float y)
+bool shepardIdwWeights(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std::vector <float> &distances,
+                       Crit3DInterpolationSettings &interpolationSettings, float x, float y,
+                       std::vector <Crit3DInterpolationDataPoint> &shepardPoints, std::vector <double> &weight)
 {
-    std::vector <Crit3DInterpolationDataPoint> shepardPoints;
     std::vector <float> shepardDistances;
 
     float radius = shepardSearchNeighbour(myPoints, distances, interpolationSettings, shepardPoints, shepardDistances);
 
     unsigned int i, j;
-    double weightSum, radius_27_4, radius_3, tmp, cosine, result;
-    std::vector <double> weight, t, S;
+    double weightSum, radius_27_4, radius_3, tmp, cosine;
+    std::vector <double> t, S;
 
     unsigned int nrValid = unsigned(shepardPoints.size());
 
@@ -908,7 +948,7 @@ float shepardIdw(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std
         }
 
     if (weightSum == 0)
-        return NODATA;
+        return false;
 
     // including direction
     for (i=0; i < nrValid; i++)
@@ -937,18 +977,31 @@ float shepardIdw(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std
     for (i=0; i < nrValid; i++)
         weight[i] /= weightSum;
 
-    result = 0;
-    for (i=0; i < nrValid; i++)
+    return true;
+}
+
+
+float shepardIdw(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std::vector <float> &distances,
+                 Crit3DInterpolationSettings &interpolationSettings, float x, float y)
+{
+    std::vector <Crit3DInterpolationDataPoint> shepardPoints;
+    std::vector <double> weight;
+
+    if (! shepardIdwWeights(myPoints, distances, interpolationSettings, x, y, shepardPoints, weight))
+        return NODATA;
+
+    double result = 0;
+    for (unsigned int i=0; i < shepardPoints.size(); i++)
         result += weight[i] * shepardPoints[i].value;
 
     return (float)result;
 }
 
 
-float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoints, std::vector <float> &myDistances,
-                         Crit3DInterpolationSettings &interpolationSettings, float radius, float y, float x)
+bool modifiedShepardIdwWeights(const std::vector <Crit3DInterpolationDataPoint> &myPoints, std::vector <float> &myDistances,
+                               Crit3DInterpolationSettings &interpolationSettings, float radius, float y, float x,
+                               std::vector <Crit3DInterpolationDataPoint> &shepardPoints, std::vector <double> &weight)
 {
-    std::vector <Crit3DInterpolationDataPoint> shepardPoints;
     std::vector <float> shepardDistances;
 
     if (isEqual(radius, NODATA))
@@ -965,10 +1018,11 @@ float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoi
     }
 
     if (shepardPoints.empty())
-        return NODATA;
+        return false;
 
     std::size_t nrPoints = shepardPoints.size();
-    std::vector<double> weight(nrPoints), t(nrPoints, 0.0), s(nrPoints, 0.0);
+    std::vector<double> t(nrPoints, 0.0), s(nrPoints, 0.0);
+    weight.resize(nrPoints);
 
     double weightSum = 0.0;
     for (std::size_t i=0; i < nrPoints; ++i)
@@ -981,7 +1035,7 @@ float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoi
     }
 
     if (weightSum == 0.0)
-        return NODATA;
+        return false;
 
     // direction
     double invWeightSum = 1.0 / weightSum;
@@ -1020,8 +1074,21 @@ float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoi
     for (std::size_t i=0; i < nrPoints; ++i)
         weight[i] *= invWeightSumFinal;
 
+    return true;
+}
+
+
+float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoints, std::vector <float> &myDistances,
+                         Crit3DInterpolationSettings &interpolationSettings, float radius, float y, float x)
+{
+    std::vector <Crit3DInterpolationDataPoint> shepardPoints;
+    std::vector <double> weight;
+
+    if (! modifiedShepardIdwWeights(myPoints, myDistances, interpolationSettings, radius, y, x, shepardPoints, weight))
+        return NODATA;
+
     double result = 0.0;
-    for (std::size_t i=0; i < nrPoints; ++i)
+    for (std::size_t i=0; i < shepardPoints.size(); ++i)
         result += weight[i]*shepardPoints[i].value;
 
     return float(result);
@@ -1170,6 +1237,26 @@ bool localSelection(const std::vector <Crit3DInterpolationDataPoint> &inputPoint
 }
 
 
+/*!
+ * \brief isSamePointList
+ * the two lists contain the same points (index) in the same order
+ */
+bool isSamePointList(const std::vector<Crit3DInterpolationDataPoint> &firstPoints,
+                     const std::vector<Crit3DInterpolationDataPoint> &secondPoints)
+{
+    if (firstPoints.size() != secondPoints.size())
+        return false;
+
+    for (size_t i = 0; i < firstPoints.size(); i++)
+    {
+        if (firstPoints[i].index != secondPoints[i].index)
+            return false;
+    }
+
+    return true;
+}
+
+
 bool checkPrecipitationZero(const std::vector<Crit3DInterpolationDataPoint> &myPoints, float precThreshold, int &nrValidData)
 {
     nrValidData = 0;
@@ -1829,6 +1916,107 @@ bool macroAreaDetrending(const Crit3DMacroArea &myArea, meteoVariable myVar,
 }
 
 
+/*!
+ * \brief glocalAreasDetrending
+ * detrending of the points of each macro area with its own fitting, areas are independent (computed in parallel).
+ * areaSettings are copies of the settings without the macro areas (cell lists), with the fitting of the area
+ */
+bool glocalAreasDetrending(meteoVariable myVar, Crit3DInterpolationSettings &interpolationSettings,
+                           Crit3DMeteoSettings* meteoSettings, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                           const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
+                           bool isGrid, bool isParallelComputing,
+                           std::vector<Crit3DInterpolationSettings> &areaSettings,
+                           std::vector<std::vector <Crit3DInterpolationDataPoint>> &areaPoints)
+{
+    int elevationPos = NODATA;
+    for (unsigned int pos=0; pos < interpolationSettings.getCurrentCombination().getProxySize(); pos++)
+    {
+        if (getProxyPragaName(interpolationSettings.getProxy(pos)->getName()) == proxyHeight)
+            elevationPos = pos;
+    }
+
+    // copy of the settings without the cell lists
+    std::vector<Crit3DMacroArea> macroAreasTmp;
+    interpolationSettings.swapMacroAreas(macroAreasTmp);
+    Crit3DInterpolationSettings lightSettings = interpolationSettings;
+    interpolationSettings.swapMacroAreas(macroAreasTmp);
+    lightSettings.setParallelComputing(interpolationSettings.isParallelComputing() && ! isParallelComputing);
+
+    const std::vector<Crit3DMacroArea> &macroAreas = interpolationSettings.getMacroAreas();
+    int nrAreas = int(macroAreas.size());
+
+    areaSettings.assign(unsigned(nrAreas), lightSettings);
+    areaPoints.clear();
+    areaPoints.resize(unsigned(nrAreas));
+
+    bool isOk = true;
+
+    // each thread stops at its first error (isOk is private in the loop and combined at the end)
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) reduction(&&:isOk)
+    for (int i = 0; i < nrAreas; i++)
+    {
+        int nrCells = isGrid ? macroAreas[i].getAreaCellsGridSize() : macroAreas[i].getAreaCellsDemSize();
+        if (! isOk || nrCells == 0)
+            continue;
+
+        if (! macroAreaDetrending(macroAreas[i], myVar, areaSettings[i], meteoSettings, meteoPoints,
+                                 interpolationPoints, areaPoints[i], elevationPos))
+            isOk = false;
+    }
+
+    return isOk;
+}
+
+
+/*!
+ * \brief getGlocalCellAreas
+ * inverted index of the cell lists of the macro areas: areas and weights of the cell i
+ * are in cellArea and cellWeight, from cellStart[i] to cellStart[i+1] (areas in increasing order)
+ */
+void getGlocalCellAreas(const Crit3DInterpolationSettings &interpolationSettings, bool isGrid, size_t nrCells,
+                        std::vector<unsigned> &cellStart, std::vector<int> &cellArea, std::vector<float> &cellWeight)
+{
+    const std::vector<Crit3DMacroArea> &macroAreas = interpolationSettings.getMacroAreas();
+
+    cellStart.assign(nrCells + 1, 0);
+
+    // count
+    for (size_t i = 0; i < macroAreas.size(); i++)
+    {
+        const std::vector<float> &areaCells = isGrid ? macroAreas[i].getAreaCellsGrid() : macroAreas[i].getAreaCellsDEM();
+        for (size_t k = 0; k < areaCells.size(); k += 2)
+        {
+            size_t cell = size_t(areaCells[k]);
+            if (cell < nrCells)
+                cellStart[cell + 1]++;
+        }
+    }
+
+    for (size_t cell = 0; cell < nrCells; cell++)
+        cellStart[cell + 1] += cellStart[cell];
+
+    cellArea.resize(cellStart[nrCells]);
+    cellWeight.resize(cellStart[nrCells]);
+
+    // fill
+    std::vector<unsigned> position(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < macroAreas.size(); i++)
+    {
+        const std::vector<float> &areaCells = isGrid ? macroAreas[i].getAreaCellsGrid() : macroAreas[i].getAreaCellsDEM();
+        for (size_t k = 0; k < areaCells.size(); k += 2)
+        {
+            size_t cell = size_t(areaCells[k]);
+            if (cell >= nrCells)
+                continue;
+
+            unsigned index = position[cell]++;
+            cellArea[index] = int(i);
+            cellWeight[index] = areaCells[k + 1];
+        }
+    }
+}
+
+
 bool multipleDetrendingMain(std::vector <Crit3DInterpolationDataPoint> &myPoints,
                             Crit3DInterpolationSettings &interpolationSettings, meteoVariable myVar, std::string &errorStr)
 {
@@ -1926,12 +2114,14 @@ bool multipleDetrendingElevationFitting(int elevationPos, std::vector <Crit3DInt
     if (isWeighted)
     {
         R2 = interpolation::bestFittingMarquardt_nDimension(*(myFunc.target<double(*)(double, std::vector<double>&)>()), 4, parametersMin, parametersMax, parameters, parametersDelta,
-                                                                  1000, 0.002, 0.005, predictors, predictands, weights,firstGuessCombinations);
+                                                                  1000, 0.002, 0.005, predictors, predictands, weights,firstGuessCombinations,
+                                                                  interpolationSettings.isParallelComputing());
     }
     else
     {
         R2 = interpolation::bestFittingMarquardt_nDimension(*(myFunc.target<double(*)(double, std::vector<double>&)>()), 4, parametersMin, parametersMax, parameters, parametersDelta,
-                                                                  1000, 0.002, 0.005, predictors, predictands,firstGuessCombinations);
+                                                                  1000, 0.002, 0.005, predictors, predictands,firstGuessCombinations,
+                                                                  interpolationSettings.isParallelComputing());
     }
 
     interpolationSettings.getProxy(elevationPos)->setRegressionR2(float(R2));
@@ -2239,10 +2429,10 @@ void detrendingOtherProxies(int elevationPos, std::vector<Crit3DInterpolationDat
 bool glocalDetrendingFitting(const std::vector<Crit3DInterpolationDataPoint> &myPoints,
                              Crit3DInterpolationSettings &interpolationSettings,  meteoVariable myVar, std::string& errorStr)
 {
-    std::vector<Crit3DInterpolationDataPoint> subsetPoints;
-    std::vector<Crit3DMacroArea> macroAreas = interpolationSettings.getMacroAreas();
+    // the macro areas are moved out of the settings: the copies of each thread do not contain the cell lists
+    std::vector<Crit3DMacroArea> macroAreas;
+    interpolationSettings.swapMacroAreas(macroAreas);
     int areasNr = int(macroAreas.size());
-    int i = 0;
 
     int elevationPos = NODATA;
     for (unsigned int pos=0; pos < interpolationSettings.getSelectedCombination().getProxySize(); pos++)
@@ -2251,55 +2441,74 @@ bool glocalDetrendingFitting(const std::vector<Crit3DInterpolationDataPoint> &my
             elevationPos = pos;
     }
 
-    //create the subset of points starting from the meteopoints vector saved in every macro area
-    for (i = 0; i < areasNr; i++) //ATTENZIONE INDICI ?
+    // the fitting of each area is independent: the areas are fitted in parallel (the restarts of each fitting are serial)
+    bool isParallelComputing = interpolationSettings.isParallelComputing();
+    Crit3DInterpolationSettings areaSettings = interpolationSettings;
+    areaSettings.setParallelComputing(isParallelComputing && areasNr == 1);
+    bool isOk = true;
+
+    // all the areas are fitted, isOk is false if any fitting fails (errorStr is the error of one of them)
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(areaSettings) reduction(&&:isOk)
+    for (int i = 0; i < areasNr; i++) //ATTENZIONE INDICI ?
     {
         std::vector<int> temp = macroAreas[i].getMeteoPoints();
-        if (! temp.empty())
+        if (temp.empty())
+            continue;
+
+        //create the subset of points starting from the meteopoints vector saved in the macro area
+        std::vector<Crit3DInterpolationDataPoint> subsetPoints;
+        for (unsigned int l = 0; l < temp.size(); l++)
         {
-            std::vector<Crit3DInterpolationDataPoint> subsetPoints;
-            for (unsigned int l = 0; l < temp.size(); l++)
-            {
+            for (unsigned int k = 0; k < myPoints.size(); k++)
+                if (myPoints[k].index == temp[l])
+                {
+                    subsetPoints.push_back(myPoints[k]);
+                    break;
+                }
+        }
 
-                for (unsigned int k = 0; k < myPoints.size(); k++)
-                    if (myPoints[k].index == temp[l])
-                    {
-                        subsetPoints.push_back(myPoints[k]);
-                        break;
-                    }
-            }
+        areaSettings.setCurrentCombination(areaSettings.getSelectedCombination());
+        areaSettings.clearFitting();
 
-            interpolationSettings.setCurrentCombination(interpolationSettings.getSelectedCombination());
-            interpolationSettings.clearFitting();
+        std::string areaErrorStr;
+        bool isAreaOk = true;
 
-            //fitting and elevation detrending (necessary for the fitting of other proxies)
-            if (elevationPos != NODATA && interpolationSettings.getSelectedCombination().isProxyActive(elevationPos))
-            {
-                if (!multipleDetrendingElevationFitting(elevationPos, subsetPoints, interpolationSettings, myVar, errorStr, false)) return false;
-                if (interpolationSettings.getCurrentCombination().isProxySignificant(elevationPos)) detrendingElevation(elevationPos, subsetPoints, interpolationSettings);
-            }
-            if (!multipleDetrendingOtherProxiesFitting(elevationPos, subsetPoints, interpolationSettings, myVar, errorStr))
-                return false;
+        //fitting and elevation detrending (necessary for the fitting of other proxies)
+        if (elevationPos != NODATA && areaSettings.getSelectedCombination().isProxyActive(elevationPos))
+        {
+            isAreaOk = multipleDetrendingElevationFitting(elevationPos, subsetPoints, areaSettings, myVar, areaErrorStr, false);
+            if (isAreaOk && areaSettings.getCurrentCombination().isProxySignificant(elevationPos))
+                detrendingElevation(elevationPos, subsetPoints, areaSettings);
+        }
+        if (isAreaOk)
+            isAreaOk = multipleDetrendingOtherProxiesFitting(elevationPos, subsetPoints, areaSettings, myVar, areaErrorStr);
 
-            //save parameters and combination in the macro area
-            macroAreas[i].setParameters(interpolationSettings.getFittingParameters());
-            macroAreas[i].setCombination(interpolationSettings.getCurrentCombination());
+        if (! isAreaOk)
+        {
+            isOk = false;
+            #pragma omp critical
+            errorStr = areaErrorStr;
+            continue;
         }
-        subsetPoints.clear();
+
+        //save parameters and combination in the macro area
+        macroAreas[i].setParameters(areaSettings.getFittingParameters());
+        macroAreas[i].setCombination(areaSettings.getCurrentCombination());
     }
 
     //update macro areas in settings
-    interpolationSettings.setMacroAreas(macroAreas);
-    return true;
+    interpolationSettings.swapMacroAreas(macroAreas);
+    return isOk;
 }
 
 
-double goldenSectionSearch(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
-                           const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
-                           Crit3DInterpolationSettings &interpolationSettings,
-                           Crit3DMeteoSettings* meteoSettings, double a, double b)
+/*!
+ * \brief goldenSectionSearch
+ * minimum of errorFunction in [a, b] (golden section method), the evaluations are added to the Kh series
+ */
+double goldenSectionSearch(const std::function<double(double)> &errorFunction,
+                           Crit3DInterpolationSettings &interpolationSettings, double a, double b)
 {
-    // this function finds the minimum by means of golden section method
     double tol = 1;
     //const double phi = (1 + std::sqrt(5)) / 2;  // golden section
     double x1 = b - (b - a) / GOLDEN_SECTION;
@@ -2308,28 +2517,22 @@ double goldenSectionSearch(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &m
     while (std::abs(b - a) > tol && counter<100)
     {
         counter++;
-        if (topographicDistanceInternalFunction(myVar, meteoPoints, interpolationPoints,
-                                                interpolationSettings, meteoSettings, x1) <
-            topographicDistanceInternalFunction(myVar, meteoPoints, interpolationPoints,
-                                                interpolationSettings, meteoSettings, x2))
+        if (errorFunction(x1) < errorFunction(x2))
         {
             b = x2;
             x2 = x1;
             x1 = b - (b - a) / GOLDEN_SECTION;
-            interpolationSettings.addToKhSeries(float(x1), (float)topographicDistanceInternalFunction(myVar, meteoPoints,
-                                                    interpolationPoints, interpolationSettings, meteoSettings, x1));
+            interpolationSettings.addToKhSeries(float(x1), float(errorFunction(x1)));
         }
         else
         {
             a = x1;
             x1 = x2;
             x2 = a + (b - a) / GOLDEN_SECTION;
-            interpolationSettings.addToKhSeries(float(x2), (float)topographicDistanceInternalFunction(myVar,meteoPoints,
-                                                        interpolationPoints, interpolationSettings, meteoSettings, x2));
+            interpolationSettings.addToKhSeries(float(x2), float(errorFunction(x2)));
         }
     }
-    interpolationSettings.addToKhSeries(float((a + b) / 2), (float)topographicDistanceInternalFunction(myVar, meteoPoints,
-                                                   interpolationPoints, interpolationSettings, meteoSettings, (a + b) / 2));
+    interpolationSettings.addToKhSeries(float((a + b) / 2), float(errorFunction((a + b) / 2)));
 
     return (a + b) / 2;  // approximated minimum
 }
@@ -2344,26 +2547,193 @@ double topographicDistanceInternalFunction(meteoVariable myVar, std::vector<Crit
     int kh = int(khFloat);
 
     interpolationSettings.setTopoDist_Kh(kh);
-    if (computeResiduals(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings, true, true))
+    if (myVar != noMeteoVar)
     {
-        avgError = computeErrorCrossValidation(meteoPoints);
+        avgError = computeErrorCrossValidation(myVar, meteoPoints, interpolationPoints, interpolationSettings,
+                                               meteoSettings, true, true, NODATA);
     }
 
     return avgError;
 }
 
 
+/*!
+ * \brief getTopographicDistanceTargets
+ * meteo points used to evaluate the topographic distance (as topographicDistanceInternalFunction)
+ * with their current values: the optimization can then run when the meteo points hold another variable
+ */
+void getTopographicDistanceTargets(const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                   const Crit3DInterpolationSettings &interpolationSettings,
+                                   std::vector<int> &targetIndex, std::vector<float> &targetValue)
+{
+    targetIndex.clear();
+    targetValue.clear();
+
+    for (size_t i = 0; i < meteoPoints.size(); i++)
+    {
+        const Crit3DMeteoPoint &point = meteoPoints[i];
+        if (! point.active || ! point.isInsideDem || point.quality != quality::accepted || point.currentValue == NODATA)
+            continue;
+
+        if (! checkLapseRateCode(point.lapseRateCode, interpolationSettings.getUseLapseRateCode(), false))
+            continue;
+
+        targetIndex.push_back(int(i));
+        targetValue.push_back(point.currentValue);
+    }
+}
+
+
+/*!
+ * \brief topographicDistanceOptimize
+ * optimization of the topographic distance multiplier (Kh) on the station distances of the cache:
+ * each evaluation of the cross validation error is O(stations^2) arithmetic, and the evaluations
+ * of the same Kh are computed once. The meteo points are only read (position and proxy values),
+ * so the optimization of several variables can run in parallel.
+ * Returns false if the cache is not available for meteoPoints
+ */
+bool topographicDistanceOptimize(meteoVariable myVar, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                 const std::vector<int> &targetIndex, const std::vector<float> &targetValue,
+                                 const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                 Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings)
+{
+    Crit3DStationDistanceCache* distanceCache = interpolationSettings.getStationDistanceCache();
+    if (distanceCache == nullptr)
+        return false;
+
+    std::vector<int> pointIndex = targetIndex;
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+        pointIndex.push_back(interpolationPoints[i].index);
+
+    std::shared_ptr<const Crit3DStationDistances> distances = distanceCache->getDistances(meteoPoints, pointIndex,
+                                                                                         interpolationSettings, false);
+    if (distances == nullptr)
+        return false;
+
+    size_t nrPoints = distances->getNrPoints();
+    size_t nrTargets = targetIndex.size();
+
+    std::vector<size_t> sourcePosition(interpolationPoints.size());
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+        sourcePosition[i] = size_t(distances->position[unsigned(interpolationPoints[i].index)]);
+
+    std::vector<std::vector<double>> targetProxyValues(nrTargets);
+    for (size_t t = 0; t < nrTargets; t++)
+        targetProxyValues[t] = meteoPoints[unsigned(targetIndex[t])].getProxyValues();
+
+    bool isPrecipitation = (myVar == precipitation || myVar == dailyPrecipitation);
+    std::vector<float> pointDistances(interpolationPoints.size());
+    std::map<int, double> errorMap;
+
+    auto errorFunction = [&](double khFloat) -> double
+    {
+        int kh = int(khFloat);
+        auto it = errorMap.find(kh);
+        if (it != errorMap.end())
+            return it->second;
+
+        interpolationSettings.setTopoDist_Kh(kh);
+
+        std::vector <float> obsValues, estValues;
+        for (size_t t = 0; t < nrTargets; t++)
+        {
+            const Crit3DMeteoPoint &target = meteoPoints[unsigned(targetIndex[t])];
+            size_t first = size_t(distances->position[unsigned(targetIndex[t])]) * nrPoints;
+
+            for (size_t i = 0; i < interpolationPoints.size(); i++)
+            {
+                pointDistances[i] = distances->distance[first + sourcePosition[i]];
+                if (kh != 0)
+                    pointDistances[i] += (kh * distances->topographicDistance[first + sourcePosition[i]]);
+            }
+
+            float interpolatedValue = 0;
+            if (! isPrecipitation || ! interpolationSettings.getPrecipitationAllZero())
+            {
+                float residual = 0;
+                if (! interpolationSettings.getUseRetrendOnly())
+                    residual = interpolateDistances(interpolationPoints, pointDistances, interpolationSettings,
+                                                    float(target.point.utm.x), float(target.point.utm.y));
+
+                interpolatedValue = completeInterpolation(residual, interpolationSettings, meteoSettings,
+                                                          myVar, targetProxyValues[t]);
+            }
+
+            // as computeResiduals and computeErrorCrossValidation
+            float myValue = targetValue[t];
+            if (isPrecipitation)
+            {
+                if (myValue < meteoSettings->getRainfallThreshold())
+                    myValue = 0.;
+
+                if (interpolatedValue != NODATA && interpolatedValue < meteoSettings->getRainfallThreshold())
+                    interpolatedValue = 0.;
+            }
+
+            if (interpolatedValue != NODATA)
+            {
+                float residual = myValue - interpolatedValue;
+                obsValues.push_back(targetValue[t]);
+                estValues.push_back(targetValue[t] - residual);
+            }
+        }
+
+        double avgError = 0;
+        if (obsValues.empty())
+            avgError = NODATA;
+        else
+            avgError = statistics::meanAbsoluteError(obsValues, estValues);
+
+        errorMap[kh] = avgError;
+        return avgError;
+    };
+
+    interpolationSettings.initializeKhSeries();
+
+    double khMax = double(interpolationSettings.getTopoDist_maxKh());
+    double bestKh = goldenSectionSearch(errorFunction, interpolationSettings, 0, khMax);
+
+    interpolationSettings.setTopoDist_Kh(int(bestKh));
+
+    return true;
+}
+
+
 void topographicDistanceOptimize(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                                  const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                                  Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings)
 {
+    // cached station distances
+    std::vector<int> targetIndex;
+    std::vector<float> targetValue;
+    getTopographicDistanceTargets(meteoPoints, interpolationSettings, targetIndex, targetValue);
+
+    if (topographicDistanceOptimize(myVar, meteoPoints, targetIndex, targetValue, interpolationPoints,
+                                    interpolationSettings, meteoSettings))
+        return;
+
+    // the evaluations of the same Kh are computed once
+    std::map<int, double> errorMap;
+    auto errorFunction = [&](double khFloat) -> double
+    {
+        int kh = int(khFloat);
+        auto it = errorMap.find(kh);
+        if (it != errorMap.end())
+            return it->second;
+
+        double avgError = topographicDistanceInternalFunction(myVar, meteoPoints, interpolationPoints,
+                                                              interpolationSettings, meteoSettings, khFloat);
+        errorMap[kh] = avgError;
+        return avgError;
+    };
+
     interpolationSettings.initializeKhSeries();
 
     double bestKh = 0;
     double khMin = 0;
     double khMax = double(interpolationSettings.getTopoDist_maxKh());
 
-    bestKh = goldenSectionSearch(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings, khMin, khMax);
+    bestKh = goldenSectionSearch(errorFunction, interpolationSettings, khMin, khMax);
 
     interpolationSettings.setTopoDist_Kh(int(bestKh));
 
@@ -2392,45 +2762,86 @@ void topographicDistanceOptimize(meteoVariable myVar, std::vector<Crit3DMeteoPoi
 }
 
 
+/*!
+ * \brief optimalDetrending
+ * detrending with the proxy combination of minimum cross validation error.
+ * The combinations are evaluated in parallel, each one on its own copy of the settings;
+ * the evaluation of a combination stops as soon as its error is surely greater than the best one found so far.
+ * The best combination is the first one (lower index) of minimum error, whatever the number of threads
+ */
 void optimalDetrending(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                        std::vector<Crit3DInterpolationDataPoint> &outInterpolationPoints,
                        Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
                        Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime)
 {
-
-    std::vector <Crit3DInterpolationDataPoint> interpolationPoints;
-    int i, nrCombination, bestCombinationIndex;
-    float avgError, minError;
     size_t proxyNr = interpolationSettings.getProxyNr();
     Crit3DProxyCombination myCombination, bestCombination;
 
-    nrCombination = int(pow(2, double(proxyNr) + 1));
-
-    minError = NODATA;
-    bestCombinationIndex = 0;
+    int nrCombination = int(pow(2, double(proxyNr) + 1));
 
-    for (i=0; i < nrCombination; i++)
+    std::vector<int> combinationIndex;
+    for (int i = 0; i < nrCombination; i++)
     {
         if (interpolationSettings.getCombination(i, myCombination))
-        {
-            passDataToInterpolation(meteoPoints, interpolationPoints, interpolationSettings);
-            detrending(interpolationPoints, myCombination, interpolationSettings, climateParameters, myVar, myTime);
+            combinationIndex.push_back(i);
+    }
 
-            if (interpolationSettings.getUseTD() && getUseTdVar(myVar))
-                topographicDistanceOptimize(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings);
+    // the macro areas are not used here: lighter copies of the settings
+    std::vector<Crit3DMacroArea> macroAreas;
+    interpolationSettings.swapMacroAreas(macroAreas);
+
+    std::vector<float> combinationError(combinationIndex.size(), NODATA);
+    float minError = NODATA;
+    int nrValidCombinations = int(combinationIndex.size());
+    bool isParallelComputing = interpolationSettings.isParallelComputing();
 
-            if (computeResiduals(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings, interpolationSettings.getUseExcludeStationsOutsideDEM(), true))
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+    for (int k = 0; k < nrValidCombinations; k++)
+    {
+        Crit3DInterpolationSettings localSettings = interpolationSettings;
+        localSettings.setParallelComputing(false);
+        std::vector <Crit3DInterpolationDataPoint> interpolationPoints;
+        Crit3DProxyCombination localCombination;
+
+        localSettings.getCombination(combinationIndex[k], localCombination);
+        passDataToInterpolation(meteoPoints, interpolationPoints, localSettings);
+        detrending(interpolationPoints, localCombination, localSettings, climateParameters, myVar, myTime);
+
+        if (localSettings.getUseTD() && getUseTdVar(myVar))
+            topographicDistanceOptimize(myVar, meteoPoints, interpolationPoints, localSettings, meteoSettings);
+
+        float maxError;
+        #pragma omp critical (optimalDetrending)
+        maxError = minError;
+
+        float avgError = computeErrorCrossValidation(myVar, meteoPoints, interpolationPoints, localSettings, meteoSettings,
+                                                     localSettings.getUseExcludeStationsOutsideDEM(), true, maxError);
+        combinationError[k] = avgError;
+
+        if (! isEqual(avgError, NODATA))
+        {
+            #pragma omp critical (optimalDetrending)
             {
-                avgError = computeErrorCrossValidation(meteoPoints);
-                if (! isEqual(avgError, NODATA) && (isEqual(minError, NODATA) || avgError < minError))
-                {
+                if (isEqual(minError, NODATA) || avgError < minError)
                     minError = avgError;
-                    bestCombinationIndex = i;
-                }
             }
         }
     }
 
+    interpolationSettings.swapMacroAreas(macroAreas);
+
+    // first combination of minimum error
+    int bestCombinationIndex = 0;
+    float bestError = NODATA;
+    for (size_t k = 0; k < combinationIndex.size(); k++)
+    {
+        if (! isEqual(combinationError[k], NODATA) && (isEqual(bestError, NODATA) || combinationError[k] < bestError))
+        {
+            bestError = combinationError[k];
+            bestCombinationIndex = combinationIndex[k];
+        }
+    }
+
     if (interpolationSettings.getCombination(bestCombinationIndex, bestCombination))
     {
         passDataToInterpolation(meteoPoints, outInterpolationPoints, interpolationSettings);
@@ -2470,7 +2881,7 @@ bool preInterpolation(std::vector<Crit3DInterpolationDataPoint> &myPoints,
 
             if (interpolationSettings.getUseGlocalDetrending())
             {
-                glocalDetrendingFitting(myPoints, interpolationSettings, myVar, errorStr);
+                if (! glocalDetrendingFitting(myPoints, interpolationSettings, myVar, errorStr)) return false;
             }
             else
             {
@@ -2506,29 +2917,64 @@ float interpolate(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Cri
     if ((variable == precipitation || variable == dailyPrecipitation) && interpolationSettings.getPrecipitationAllZero())
         return 0.;
 
-    float result = NODATA;
+    float result = interpolateResidual(myPoints, interpolationSettings, variable, x, y, z, excludeSupplemental);
+
+    return completeInterpolation(result, interpolationSettings, meteoSettings, variable, proxyValues);
+}
+
+
+/*!
+ * \brief interpolateResidual
+ * spatial interpolation in (x, y, z) of the detrended values, without trend and limits of the variable
+ */
+float interpolateResidual(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Crit3DInterpolationSettings &interpolationSettings,
+                          meteoVariable variable, float x, float y, float z, bool excludeSupplemental)
+{
+    if (interpolationSettings.getUseRetrendOnly())
+        return 0;
 
     std::vector<float> distances = computeDistances(variable, myPoints, interpolationSettings, x, y, z, excludeSupplemental);
 
-    if (! interpolationSettings.getUseRetrendOnly())
+    return interpolateDistances(myPoints, distances, interpolationSettings, x, y);
+}
+
+
+/*!
+ * \brief interpolateDistances
+ * spatial interpolation in (x, y) of the detrended values, with the distances already computed
+ */
+float interpolateDistances(const std::vector<Crit3DInterpolationDataPoint>& myPoints, std::vector<float> &distances,
+                           Crit3DInterpolationSettings &interpolationSettings, float x, float y)
+{
+    float result = NODATA;
+
+    if (interpolationSettings.getInterpolationMethod() == idw)
     {
-        if (interpolationSettings.getInterpolationMethod() == idw)
-        {
-            result = inverseDistanceWeighted(myPoints, distances);
-        }
-        else if (interpolationSettings.getInterpolationMethod() == shepard)
-        {
-            result = shepardIdw(myPoints, distances, interpolationSettings, x, y);
-        }
-        else if (interpolationSettings.getInterpolationMethod() == shepard_modified)
-        {
-            float radius = NODATA;
-            if (interpolationSettings.getUseLocalDetrending()) radius = interpolationSettings.getLocalRadius();
-            result = modifiedShepardIdw(myPoints, distances, interpolationSettings, radius, x, y);
-        }
+        result = inverseDistanceWeighted(myPoints, distances);
     }
-    else result = 0;
+    else if (interpolationSettings.getInterpolationMethod() == shepard)
+    {
+        result = shepardIdw(myPoints, distances, interpolationSettings, x, y);
+    }
+    else if (interpolationSettings.getInterpolationMethod() == shepard_modified)
+    {
+        float radius = NODATA;
+        if (interpolationSettings.getUseLocalDetrending()) radius = interpolationSettings.getLocalRadius();
+        result = modifiedShepardIdw(myPoints, distances, interpolationSettings, radius, x, y);
+    }
+
+    return result;
+}
 
+
+/*!
+ * \brief completeInterpolation
+ * add the trend to the spatial interpolated value and check the limits of the variable
+ */
+float completeInterpolation(float result, Crit3DInterpolationSettings &interpolationSettings,
+                            Crit3DMeteoSettings* meteoSettings, meteoVariable variable,
+                            const std::vector<double> &proxyValues)
+{
     if (isEqual(result, NODATA))
         return NODATA;
 
@@ -2560,6 +3006,64 @@ float interpolate(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Cri
 }
 
 
+/*!
+ * \brief interpolationWeights
+ * weights of the spatial interpolation in (x, y), referred to the index of the data points.
+ * idw weights are not normalized, shepard weights are normalized on the neighbour points
+ */
+bool interpolationWeights(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Crit3DInterpolationSettings &interpolationSettings,
+                          meteoVariable variable, float x, float y, float z,
+                          std::vector<int> &pointIndex, std::vector<double> &pointWeight)
+{
+    pointIndex.clear();
+    pointWeight.clear();
+
+    std::vector<float> distances = computeDistances(variable, myPoints, interpolationSettings, x, y, z, true);
+
+    if (interpolationSettings.getInterpolationMethod() == idw)
+    {
+        for (std::size_t i = 0; i < myPoints.size(); ++i)
+        {
+            if (distances[i] > EPSILON)
+            {
+                // the same weight of inverseDistanceWeighted
+                double dist_km = static_cast<double>(distances[i]) / 10000.;
+                pointIndex.push_back(myPoints[i].index);
+                pointWeight.push_back(1.0 / (dist_km * dist_km * dist_km));
+            }
+        }
+
+        return (! pointIndex.empty());
+    }
+
+    std::vector <Crit3DInterpolationDataPoint> shepardPoints;
+    std::vector <double> weight;
+    bool isOk = false;
+
+    if (interpolationSettings.getInterpolationMethod() == shepard)
+    {
+        isOk = shepardIdwWeights(myPoints, distances, interpolationSettings, x, y, shepardPoints, weight);
+    }
+    else if (interpolationSettings.getInterpolationMethod() == shepard_modified)
+    {
+        float radius = NODATA;
+        if (interpolationSettings.getUseLocalDetrending()) radius = interpolationSettings.getLocalRadius();
+        isOk = modifiedShepardIdwWeights(myPoints, distances, interpolationSettings, radius, x, y, shepardPoints, weight);
+    }
+
+    if (! isOk)
+        return false;
+
+    for (std::size_t i = 0; i < shepardPoints.size(); ++i)
+    {
+        pointIndex.push_back(shepardPoints[i].index);
+        pointWeight.push_back(weight[i]);
+    }
+
+    return true;
+}
+
+
 bool getMultipleDetrendingValues(Crit3DInterpolationSettings &interpolationSettings, const std::vector<double> &allProxyValues,
                                  std::vector<double> &activeProxyValues,
                                  std::vector< std::function<double(double, std::vector<double>&)> > &myFunc,
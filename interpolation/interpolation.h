@@ -36,6 +36,8 @@
         #include "interpolationPoint.h"
     #endif
 
+    #include <functional>
+
     float getMinHeight(const std::vector <Crit3DInterpolationDataPoint> &myPoints, bool useLapseRateCode);
     float getMaxHeight(const std::vector <Crit3DInterpolationDataPoint> &myPoints, bool useLapseRateCode);
     float getZmin(const std::vector <Crit3DInterpolationDataPoint> &myPoints);
@@ -52,15 +54,22 @@
                                      const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                                      Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings);
 
+    bool topographicDistanceOptimize(meteoVariable myVar, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                     const std::vector<int> &targetIndex, const std::vector<float> &targetValue,
+                                     const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                     Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings);
+
+    void getTopographicDistanceTargets(const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                       const Crit3DInterpolationSettings &interpolationSettings,
+                                       std::vector<int> &targetIndex, std::vector<float> &targetValue);
+
     double topographicDistanceInternalFunction(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                                                const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                                                Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
                                                double khFloat);
 
-    double goldenSectionSearch(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
-                               const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
-                               Crit3DInterpolationSettings &interpolationSettings,
-                               Crit3DMeteoSettings* meteoSettings, double a, double b);
+    double goldenSectionSearch(const std::function<double(double)> &errorFunction,
+                               Crit3DInterpolationSettings &interpolationSettings, double a, double b);
 
     bool krigingEstimateVariogram(float *myDist, float *mySemiVar,int sizeMyVar, int nrMyPoints,float myMaxDistance,
                                   double *mySill, double *myNugget, double *myRange, double *mySlope,
@@ -69,17 +78,40 @@
 
     void clearInterpolationPoints();
     bool checkPrecipitationZero(const std::vector<Crit3DInterpolationDataPoint> &myPoints, float precThreshold, int &nrValidData);
+    bool isSamePointList(const std::vector<Crit3DInterpolationDataPoint> &firstPoints,
+                         const std::vector<Crit3DInterpolationDataPoint> &secondPoints);
 
     bool neighbourhoodVariability(meteoVariable myVar, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                                   const Crit3DInterpolationSettings &interpolationSettings, float x, float y, float z, int maxNrPoints,
                                   float &devSt, float &avgDeltaZ, float &minDistance);
+    bool neighbourhoodVariability(meteoVariable myVar, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                  const Crit3DInterpolationSettings &interpolationSettings, float x, float y, float z, int maxNrPoints,
+                                  float &devSt, float &avgDeltaZ, float &minDistance, std::vector<int> &neighbourIndex);
 
     float interpolate(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Crit3DInterpolationSettings &interpolationSettings,
                       Crit3DMeteoSettings *meteoSettings, meteoVariable variable, float x, float y, float z,
                       const std::vector<double> &proxyValues, bool excludeSupplemental);
 
+    float interpolateResidual(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Crit3DInterpolationSettings &interpolationSettings,
+                              meteoVariable variable, float x, float y, float z, bool excludeSupplemental);
+
+    float interpolateDistances(const std::vector<Crit3DInterpolationDataPoint>& myPoints, std::vector<float> &distances,
+                               Crit3DInterpolationSettings &interpolationSettings, float x, float y);
+
+    float completeInterpolation(float result, Crit3DInterpolationSettings &interpolationSettings,
+                                Crit3DMeteoSettings* meteoSettings, meteoVariable variable,
+                                const std::vector<double> &proxyValues);
+
+    bool interpolationWeights(const std::vector<Crit3DInterpolationDataPoint>& myPoints, Crit3DInterpolationSettings &interpolationSettings,
+                              meteoVariable variable, float x, float y, float z,
+                              std::vector<int> &pointIndex, std::vector<double> &pointWeight);
+
     float inverseDistanceWeighted(const std::vector<Crit3DInterpolationDataPoint> &pointList, const std::vector<float>& distances);
 
+    bool shepardIdwWeights(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std::vector <float> &distances,
+                           Crit3DInterpolationSettings &interpolationSettings, float x, float y,
+                           std::vector <Crit3DInterpolationDataPoint> &shepardPoints, std::vector <double> &weight);
+
     float shepardIdw(const std::vector <Crit3DInterpolationDataPoint>& myPoints, std::vector <float> &distances,
                      Crit3DInterpolationSettings &interpolationSettings, float x, float y);
 
@@ -89,6 +121,10 @@
                                  std::vector <Crit3DInterpolationDataPoint>& outputPoints,
                                  std::vector <float>& outputDistances);
 
+    bool modifiedShepardIdwWeights(const std::vector <Crit3DInterpolationDataPoint> &myPoints, std::vector<float> &myDistances,
+                                   Crit3DInterpolationSettings &interpolationSettings, float radius, float x, float y,
+                                   std::vector <Crit3DInterpolationDataPoint> &shepardPoints, std::vector <double> &weight);
+
     float modifiedShepardIdw(const std::vector <Crit3DInterpolationDataPoint> &myPoints, std::vector<float> &myDistances,
                              Crit3DInterpolationSettings &interpolationSettings, float radius, float x, float y);
 
@@ -112,6 +148,16 @@
                              const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                              std::vector <Crit3DInterpolationDataPoint> &subsetInterpolationPoints, int elevationPos);
 
+    bool glocalAreasDetrending(meteoVariable myVar, Crit3DInterpolationSettings &interpolationSettings,
+                               Crit3DMeteoSettings* meteoSettings, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                               const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
+                               bool isGrid, bool isParallelComputing,
+                               std::vector<Crit3DInterpolationSettings> &areaSettings,
+                               std::vector<std::vector <Crit3DInterpolationDataPoint>> &areaPoints);
+
+    void getGlocalCellAreas(const Crit3DInterpolationSettings &interpolationSettings, bool isGrid, size_t nrCells,
+                            std::vector<unsigned> &cellStart, std::vector<int> &cellArea, std::vector<float> &cellWeight);
+
     bool multipleDetrendingMain(std::vector <Crit3DInterpolationDataPoint> &myPoints,
                                 Crit3DInterpolationSettings &interpolationSettings, meteoVariable myVar, std::string &errorStr);
 
@@ -159,6 +205,9 @@
                                         const Crit3DInterpolationSettings &interpolationSettings,
                                         float x, float y, float z, bool excludeSupplemental);
 
+    float getPointTopographicDistance(const gis::Crit3DRasterGrid* pointMap, int pointIndex, const gis::Crit3DPoint &point,
+                                      float x, float y, float z, float distance, const Crit3DInterpolationSettings &interpolationSettings);
+
     bool localSelection(const std::vector<Crit3DInterpolationDataPoint> &inputPoints,
                         std::vector <Crit3DInterpolationDataPoint> &selectedPoints,
                         float x, float y, Crit3DInterpolationSettings &interpolationSettings, bool excludeSupplemental);
@@ -26,18 +26,27 @@ win32:{
     TARGET = interpolation
 }
 
+# parallel computing settings
+include($$absolute_path(../parallel.pri))
+
 INCLUDEPATH += ../crit3dDate ../mathFunctions ../gis ../meteo
 
 SOURCES += interpolation.cpp \
+    interpolationCache.cpp \
     interpolationSettings.cpp \
     interpolationPoint.cpp \
     kriging.cpp \
-    spatialControl.cpp
+    proxyCube.cpp \
+    spatialControl.cpp \
+    stationDistanceCache.cpp
 
 HEADERS += interpolation.h \
+    interpolationCache.h \
     interpolationSettings.h \
     interpolationPoint.h \
     kriging.h \
     interpolationConstants.h \
-    spatialControl.h
+    proxyCube.h \
+    spatialControl.h \
+    stationDistanceCache.h
 
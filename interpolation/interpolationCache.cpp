@@ -0,0 +1,424 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "interpolation.h"
+#include "interpolationCache.h"
+#include "proxyCube.h"
+
+
+Crit3DInterpolationCache::Crit3DInterpolationCache()
+{
+    clear();
+}
+
+
+void Crit3DInterpolationCache::clear()
+{
+    _dem = nullptr;
+    _method = idw;
+    _useTD = false;
+    _useLapseRateCode = false;
+    _kh = NODATA;
+    _boundingBoxArea = NODATA;
+    _indexPointCV = NODATA;
+
+    _pointIndex.clear();
+    _isCachedPoint.clear();
+    _cellIndex.clear();
+    _cellWeight.clear();
+}
+
+
+bool Crit3DInterpolationCache::isValidSettings(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                               const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable) const
+{
+    if (_method != interpolationSettings.getInterpolationMethod()
+        || _useLapseRateCode != interpolationSettings.getUseLapseRateCode())
+        return false;
+
+    bool useTD = (interpolationSettings.getUseTD() && getUseTdVar(variable));
+    if (_useTD != useTD || (useTD && _kh != interpolationSettings.getTopoDist_Kh()))
+        return false;
+
+    if (_method == idw)
+    {
+        for (size_t i = 0; i < interpolationPoints.size(); i++)
+        {
+            int index = interpolationPoints[i].index;
+            if (index < 0 || index >= int(_isCachedPoint.size()) || ! _isCachedPoint[unsigned(index)])
+                return false;
+        }
+
+        return true;
+    }
+
+    // shepard: same points and same search radius
+    if (interpolationPoints.size() != _pointIndex.size()
+        || ! isEqual(_boundingBoxArea, interpolationSettings.getPointsBoundingBoxArea())
+        || _indexPointCV != interpolationSettings.getIndexPointCV())
+        return false;
+
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+    {
+        if (interpolationPoints[i].index != _pointIndex[i])
+            return false;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief isValid
+ * the cache is valid if the DEM and the distance settings are unchanged
+ * and the current points are compatible with the cached ones (see the class description)
+ */
+bool Crit3DInterpolationCache::isValid(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                       const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                                       const gis::Crit3DRasterGrid &dem) const
+{
+    if (isEmpty() || _dem != &dem)
+        return false;
+
+    if (_cellIndex.size() != size_t(dem.header->nrRows) * size_t(dem.header->nrCols))
+        return false;
+
+    return isValidSettings(interpolationPoints, interpolationSettings, variable);
+}
+
+
+/*!
+ * \brief isValidPoints
+ * the same of isValid, for a cache initialized on target points
+ */
+bool Crit3DInterpolationCache::isValidPoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                             const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                                             size_t nrTargetPoints) const
+{
+    if (isEmpty() || _dem != nullptr || _cellIndex.size() != nrTargetPoints)
+        return false;
+
+    return isValidSettings(interpolationPoints, interpolationSettings, variable);
+}
+
+
+/*!
+ * \brief setCachedSettings
+ * save the points and the distance settings of the cache, used by isValidSettings
+ */
+void Crit3DInterpolationCache::setCachedSettings(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                                 const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable)
+{
+    int maxIndex = 0;
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+        maxIndex = MAXVALUE(maxIndex, interpolationPoints[i].index);
+
+    _pointIndex.resize(interpolationPoints.size());
+    _isCachedPoint.resize(unsigned(maxIndex + 1), false);
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+    {
+        _pointIndex[i] = interpolationPoints[i].index;
+        if (interpolationPoints[i].index >= 0)
+            _isCachedPoint[unsigned(interpolationPoints[i].index)] = true;
+    }
+
+    _method = interpolationSettings.getInterpolationMethod();
+    _useLapseRateCode = interpolationSettings.getUseLapseRateCode();
+    _useTD = (interpolationSettings.getUseTD() && getUseTdVar(variable));
+    _kh = interpolationSettings.getTopoDist_Kh();
+    _boundingBoxArea = interpolationSettings.getPointsBoundingBoxArea();
+    _indexPointCV = interpolationSettings.getIndexPointCV();
+}
+
+
+/*!
+ * \brief initialize
+ * compute neighbour points and weights of all the valid DEM cells
+ */
+bool Crit3DInterpolationCache::initialize(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                          Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                                          const gis::Crit3DRasterGrid &dem, bool isParallelComputing)
+{
+    clear();
+
+    if (interpolationPoints.empty() || dem.header->nrRows == 0)
+        return false;
+
+    // local detrending uses a different selection of points for each cell
+    if (interpolationSettings.getUseLocalDetrending() || interpolationSettings.getUseGlocalDetrending())
+        return false;
+
+    // check memory: idw weights all the points
+    if (interpolationSettings.getInterpolationMethod() == idw)
+    {
+        double nrWeights = double(dem.header->nrRows) * double(dem.header->nrCols) * double(interpolationPoints.size());
+        if (nrWeights > MAX_INTERPOLATION_CACHE_SIZE)
+            return false;
+    }
+
+    setCachedSettings(interpolationPoints, interpolationSettings, variable);
+
+    int nrRows = dem.header->nrRows;
+    int nrCols = dem.header->nrCols;
+    _cellIndex.resize(size_t(nrRows) * size_t(nrCols));
+    _cellWeight.resize(size_t(nrRows) * size_t(nrCols));
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+    for (long row = 0; row < nrRows; row++)
+    {
+        for (long col = 0; col < nrCols; col++)
+        {
+            float z = dem.value[row][col];
+            if (isEqual(z, dem.header->flag))
+                continue;
+
+            float x, y;
+            gis::getUtmXYFromRowColSinglePrecision(*(dem.header), row, col, &x, &y);
+
+            size_t cell = size_t(row) * size_t(nrCols) + size_t(col);
+            interpolationWeights(interpolationPoints, interpolationSettings, variable, x, y, z,
+                                 _cellIndex[cell], _cellWeight[cell]);
+        }
+    }
+
+    _dem = &dem;
+
+    return true;
+}
+
+
+/*!
+ * \brief initializePoints
+ * compute neighbour points and weights of a list of target points (i.e. output points)
+ */
+bool Crit3DInterpolationCache::initializePoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                                Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                                                const std::vector<gis::Crit3DPoint> &targetPoints, bool isParallelComputing)
+{
+    clear();
+
+    if (interpolationPoints.empty() || targetPoints.empty())
+        return false;
+
+    if (interpolationSettings.getUseLocalDetrending() || interpolationSettings.getUseGlocalDetrending())
+        return false;
+
+    if (interpolationSettings.getInterpolationMethod() == idw)
+    {
+        double nrWeights = double(targetPoints.size()) * double(interpolationPoints.size());
+        if (nrWeights > MAX_INTERPOLATION_CACHE_SIZE)
+            return false;
+    }
+
+    setCachedSettings(interpolationPoints, interpolationSettings, variable);
+
+    _cellIndex.resize(targetPoints.size());
+    _cellWeight.resize(targetPoints.size());
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+    for (long i = 0; i < long(targetPoints.size()); i++)
+    {
+        interpolationWeights(interpolationPoints, interpolationSettings, variable,
+                             float(targetPoints[i].utm.x), float(targetPoints[i].utm.y), float(targetPoints[i].z),
+                             _cellIndex[i], _cellWeight[i]);
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief interpolateCell
+ * weighted average of the cached neighbours of a cell (or target point), with the same results of interpolate
+ */
+float Crit3DInterpolationCache::interpolateCell(size_t cell, const std::vector<float> &pointValue,
+                                                const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                                Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                                meteoVariable variable, float x, float y, float z, const std::vector<double> &proxyValues) const
+{
+    const std::vector<int> &cellIndex = _cellIndex[cell];
+    const std::vector<double> &cellWeight = _cellWeight[cell];
+
+    double sum = 0;
+    double sumWeights = 0;
+    bool isMissing = false;
+
+    for (size_t i = 0; i < cellIndex.size(); i++)
+    {
+        float value = pointValue[unsigned(cellIndex[i])];
+        if (isEqual(value, NODATA))
+        {
+            isMissing = true;
+            continue;
+        }
+
+        sum += cellWeight[i] * value;
+        sumWeights += cellWeight[i];
+    }
+
+    if (_method != idw && isMissing)
+    {
+        // missing value of a neighbour
+        return interpolate(interpolationPoints, interpolationSettings, meteoSettings,
+                           variable, x, y, z, proxyValues, true);
+    }
+
+    float result = NODATA;
+    if (interpolationSettings.getUseRetrendOnly())
+        result = 0;
+    else if (sumWeights > 0)
+        result = float(sum / sumWeights);
+
+    return completeInterpolation(result, interpolationSettings, meteoSettings, variable, proxyValues);
+}
+
+
+/*!
+ * \brief interpolateGrid
+ * interpolate the current values of the points (already detrended) on the cached DEM, with the same results of interpolate
+ */
+bool Crit3DInterpolationCache::interpolateGrid(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                               Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                               meteoVariable variable, gis::Crit3DRasterGrid &outputGrid, bool isParallelComputing)
+{
+    if (isEmpty() || _dem == nullptr)
+        return false;
+
+    if (! outputGrid.initializeGrid(*_dem))
+        return false;
+
+    // current values, by point index
+    std::vector<float> pointValue(_isCachedPoint.size(), NODATA);
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+    {
+        pointValue[unsigned(interpolationPoints[i].index)] = interpolationPoints[i].value;
+    }
+
+    bool isPrecipitationZero = ((variable == precipitation || variable == dailyPrecipitation)
+                                && interpolationSettings.getPrecipitationAllZero());
+    bool isDetrending = getUseDetrendingVar(variable);
+    int nrCols = _dem->header->nrCols;
+
+    std::vector<double> proxyValues(interpolationSettings.getProxyNr());
+
+    // interpolate takes the settings by non-const reference: each thread works on its own copy
+    Crit3DInterpolationSettings localSettings = interpolationSettings;
+
+    Crit3DProxyCube* proxyCube = interpolationSettings.getProxyCube();
+    std::vector<unsigned> proxyMask;
+    bool useProxyCube = false;
+    if (isDetrending && proxyCube != nullptr)
+    {
+        if (! proxyCube->isValid(*(_dem->header), interpolationSettings, isParallelComputing))
+            proxyCube->initialize(*(_dem->header), interpolationSettings, isParallelComputing);
+
+        useProxyCube = proxyCube->getProxyMask(interpolationSettings, false, proxyMask);
+    }
+
+    #pragma omp parallel for if (isParallelComputing) firstprivate(proxyValues, localSettings)
+    for (long row = 0; row < _dem->header->nrRows; row++)
+    {
+        for (long col = 0; col < nrCols; col++)
+        {
+            float z = _dem->value[row][col];
+            if (isEqual(z, _dem->header->flag))
+                continue;
+
+            if (isPrecipitationZero)
+            {
+                outputGrid.value[row][col] = 0;
+                continue;
+            }
+
+            float x, y;
+            gis::getUtmXYFromRowColSinglePrecision(*(_dem->header), row, col, &x, &y);
+
+            if (useProxyCube)
+            {
+                proxyCube->getProxyValues(row, col, proxyMask, proxyValues);
+            }
+            else if (isDetrending)
+            {
+                getProxyValuesXY(x, y, localSettings, proxyValues);
+            }
+
+            size_t cell = size_t(row) * size_t(nrCols) + size_t(col);
+            outputGrid.value[row][col] = interpolateCell(cell, pointValue, interpolationPoints, localSettings,
+                                                         meteoSettings, variable, x, y, z, proxyValues);
+        }
+    }
+
+    return gis::updateMinMaxRasterGrid(&outputGrid, isParallelComputing);
+}
+
+
+/*!
+ * \brief interpolatePoints
+ * interpolate the current values of the points (already detrended) on the cached target points.
+ * targetProxyValues: proxy values of the target points [point * nrProxies + proxy]
+ */
+bool Crit3DInterpolationCache::interpolatePoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                                 Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                                 meteoVariable variable, const std::vector<gis::Crit3DPoint> &targetPoints,
+                                                 const std::vector<double> &targetProxyValues, std::vector<float> &outputValues,
+                                                 bool isParallelComputing)
+{
+    size_t nrProxies = interpolationSettings.getProxyNr();
+    if (isEmpty() || _dem != nullptr || _cellIndex.size() != targetPoints.size()
+        || targetProxyValues.size() != targetPoints.size() * nrProxies)
+        return false;
+
+    outputValues.assign(targetPoints.size(), NODATA);
+
+    std::vector<float> pointValue(_isCachedPoint.size(), NODATA);
+    for (size_t i = 0; i < interpolationPoints.size(); i++)
+    {
+        pointValue[unsigned(interpolationPoints[i].index)] = interpolationPoints[i].value;
+    }
+
+    if ((variable == precipitation || variable == dailyPrecipitation) && interpolationSettings.getPrecipitationAllZero())
+    {
+        outputValues.assign(targetPoints.size(), 0);
+        return true;
+    }
+
+    std::vector<double> proxyValues(nrProxies);
+    Crit3DInterpolationSettings localSettings = interpolationSettings;
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(proxyValues, localSettings)
+    for (long i = 0; i < long(targetPoints.size()); i++)
+    {
+        std::copy(targetProxyValues.begin() + i * nrProxies, targetProxyValues.begin() + (i+1) * nrProxies, proxyValues.begin());
+
+        outputValues[i] = interpolateCell(size_t(i), pointValue, interpolationPoints, localSettings, meteoSettings, variable,
+                                          float(targetPoints[i].utm.x), float(targetPoints[i].utm.y), float(targetPoints[i].z),
+                                          proxyValues);
+    }
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef INTERPOLATIONCACHE_H
+#define INTERPOLATIONCACHE_H
+
+    #ifndef INTERPOLATIONSETTINGS_H
+        #include "interpolationSettings.h"
+    #endif
+    #ifndef INTERPOLATIONPOINT_H
+        #include "interpolationPoint.h"
+    #endif
+
+    // max number of cached weights (about 12 bytes each)
+    #define MAX_INTERPOLATION_CACHE_SIZE 160000000
+
+    /*!
+     * \brief The Crit3DInterpolationCache class
+     * neighbour points and weights of the spatial interpolation for each DEM cell (or for each target point),
+     * computed once and reused for all the time steps of a series, or all the variables, with the same stations.
+     * idw weights don't depend on the other points: the cache is valid for any subset of the cached points
+     * and the weights are renormalized on the points of each step.
+     * shepard neighbourhoods depend on the whole set of points (search radius): the cache is valid
+     * only for the same points
+     */
+    class Crit3DInterpolationCache
+    {
+    private:
+        const gis::Crit3DRasterGrid* _dem;          // nullptr for target points
+        TInterpolationMethod _method;
+        bool _useTD;
+        bool _useLapseRateCode;
+        int _kh;
+        float _boundingBoxArea;
+        int _indexPointCV;
+
+        std::vector<int> _pointIndex;               // indices of the cached points, in the same order
+        std::vector<bool> _isCachedPoint;
+        std::vector<std::vector<int>> _cellIndex;
+        std::vector<std::vector<double>> _cellWeight;
+
+        bool isValidSettings(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                             const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable) const;
+
+        void setCachedSettings(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                               const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable);
+
+        float interpolateCell(size_t cell, const std::vector<float> &pointValue,
+                              const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                              Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                              meteoVariable variable, float x, float y, float z, const std::vector<double> &proxyValues) const;
+
+    public:
+        Crit3DInterpolationCache();
+
+        void clear();
+
+        bool isEmpty() const { return _cellIndex.empty(); }
+
+        bool isValid(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                     const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                     const gis::Crit3DRasterGrid &dem) const;
+
+        bool initialize(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                        Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                        const gis::Crit3DRasterGrid &dem, bool isParallelComputing);
+
+        bool interpolateGrid(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                             Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                             meteoVariable variable, gis::Crit3DRasterGrid &outputGrid, bool isParallelComputing);
+
+        bool isValidPoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                           const Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                           size_t nrTargetPoints) const;
+
+        bool initializePoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                              Crit3DInterpolationSettings &interpolationSettings, meteoVariable variable,
+                              const std::vector<gis::Crit3DPoint> &targetPoints, bool isParallelComputing);
+
+        bool interpolatePoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                               Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                               meteoVariable variable, const std::vector<gis::Crit3DPoint> &targetPoints,
+                               const std::vector<double> &targetProxyValues, std::vector<float> &outputValues,
+                               bool isParallelComputing);
+    };
+
+
+#endif // INTERPOLATIONCACHE_H
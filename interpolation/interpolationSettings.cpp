@@ -28,6 +28,7 @@
 #include "interpolationSettings.h"
 #include "basicMath.h"
 #include "commonConstants.h"
+#include "terrainCache.h"
 
 
 void Crit3DInterpolationSettings::setPrecipitationAllZero(bool value)
@@ -65,6 +66,21 @@ void Crit3DInterpolationSettings::setCurrentDEM(gis::Crit3DRasterGrid *value)
     currentDEM = value;
 }
 
+void Crit3DInterpolationSettings::setTopographicDistanceStore(gis::Crit3DTopographicDistanceStore *value)
+{
+    topographicDistanceStore = value;
+}
+
+void Crit3DInterpolationSettings::setProxyCube(Crit3DProxyCube *value)
+{
+    proxyCube = value;
+}
+
+void Crit3DInterpolationSettings::setStationDistanceCache(Crit3DStationDistanceCache *value)
+{
+    stationDistanceCache = value;
+}
+
 void Crit3DInterpolationSettings::setTopoDist_maxKh(int value)
 {
     topoDist_maxKh = value;
@@ -173,6 +189,11 @@ void Crit3DInterpolationSettings::setMinPointsLocalDetrending(int newMinPointsLo
     minPointsLocalDetrending = newMinPointsLocalDetrending;
 }
 
+void Crit3DInterpolationSettings::setMultiResolutionFactor(int newMultiResolutionFactor)
+{
+    multiResolutionFactor = (newMultiResolutionFactor > 1) ? newMultiResolutionFactor : 1;
+}
+
 std::vector<double> Crit3DInterpolationSettings::getProxyFittingParameters(int tempIndex)
 {
     if (tempIndex < int(fittingParameters.size()))
@@ -327,6 +348,8 @@ void Crit3DInterpolationSettings::clearFitting()
 
 Crit3DInterpolationSettings::Crit3DInterpolationSettings()
 {
+    // not reset by initialize(): it is an application setting
+    parallelComputing = false;
     initialize();
 }
 
@@ -343,6 +366,9 @@ void Crit3DInterpolationSettings::initializeProxy()
 void Crit3DInterpolationSettings::initialize()
 {
     currentDEM = nullptr;
+    topographicDistanceStore = nullptr;
+    proxyCube = nullptr;
+    stationDistanceCache = nullptr;
 	macroAreasMap = nullptr;
     interpolationMethod = idw;
     useThermalInversion = true;
@@ -373,6 +399,7 @@ void Crit3DInterpolationSettings::initialize()
     maxHeightInversion = 1000.;
     indexPointCV = NODATA;
     minPointsLocalDetrending = 20;
+    multiResolutionFactor = 1;
 
     Kh_series.clear();
     Kh_error_series.clear();
@@ -513,6 +540,23 @@ gis::Crit3DRasterGrid *Crit3DProxy::getGrid() const
 void Crit3DProxy::setGrid(gis::Crit3DRasterGrid *value)
 {
     grid = value;
+    isGridHashUpdated = false;
+}
+
+/*!
+ * \brief getGridHash
+ * hash of the grid values, computed at the first call after setGrid and then reused.
+ * If the grid values are modified in place, call resetGridHash
+ */
+uint64_t Crit3DProxy::getGridHash(bool isParallelComputing)
+{
+    if (! isGridHashUpdated)
+    {
+        gridHash = (grid != nullptr && grid->isLoaded) ? gis::getRasterHash(*grid, isParallelComputing) : 0;
+        isGridHashUpdated = true;
+    }
+
+    return gridHash;
 }
 
 std::string Crit3DProxy::getGridName() const
@@ -694,6 +738,8 @@ Crit3DProxy::Crit3DProxy()
     name = "";
     gridName = "";
     grid = new gis::Crit3DRasterGrid();
+    gridHash = 0;
+    isGridHashUpdated = false;
     forQualityControl = false;
 
     regressionR2 = NODATA;
@@ -869,7 +915,9 @@ void Crit3DProxyCombination::setAllSignificantToFalse()
 bool Crit3DInterpolationSettings::getCombination(int combinationInteger, Crit3DProxyCombination &outCombination)
 {
     outCombination = selectedCombination;
-    std::string binaryString = decimal_to_binary(unsigned(combinationInteger), int(getProxyNr()+1));
+    char* binaryChar = decimal_to_binary(unsigned(combinationInteger), int(getProxyNr()+1));
+    std::string binaryString = binaryChar;
+    delete [] binaryChar;
 
     int indexHeight = getIndexHeight();
 
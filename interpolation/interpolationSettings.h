@@ -10,6 +10,16 @@
     #endif
     #include "statistics.h"
 
+    #include <cstdint>
+
+    namespace gis
+    {
+        class Crit3DTopographicDistanceStore;
+    }
+
+    class Crit3DProxyCube;
+    class Crit3DStationDistanceCache;
+
 
     std::string getKeyStringInterpolationMethod(TInterpolationMethod value);
     std::string getKeyStringElevationFunction(TFittingFunction value);
@@ -21,6 +31,8 @@
         std::string name;
         std::string gridName;
         gis::Crit3DRasterGrid* grid;
+        uint64_t gridHash;                  // hash of the grid values, computed once after setGrid
+        bool isGridHashUpdated;
         std::string proxyTable;
         std::string proxyField;
         bool forQualityControl;
@@ -54,6 +66,8 @@
         void setName(const std::string &value);
         gis::Crit3DRasterGrid *getGrid() const;
         void setGrid(gis::Crit3DRasterGrid *value);
+        uint64_t getGridHash(bool isParallelComputing);
+        void resetGridHash() { isGridHashUpdated = false; }
         std::string getGridName() const;
         void setGridName(const std::string &value);
         void setRegressionR2(float myValue);
@@ -186,6 +200,9 @@
     {
     private:
         gis::Crit3DRasterGrid* currentDEM; //for TD
+        gis::Crit3DTopographicDistanceStore* topographicDistanceStore; //for TD
+        Crit3DProxyCube* proxyCube;
+        Crit3DStationDistanceCache* stationDistanceCache;
 		gis::Crit3DRasterGrid* macroAreasMap; //for glocal detrending
 
         TInterpolationMethod interpolationMethod;
@@ -205,11 +222,13 @@
         bool useDoNotRetrend;
         bool useRetrendOnly;
         int minPointsLocalDetrending;
+        int multiResolutionFactor;
         bool meteoGridUpscaleFromDem;
         aggregationMethod meteoGridAggrMethod;
 
         bool isKrigingReady;
         bool precipitationAllZero;
+        bool parallelComputing;
         float maxHeightInversion;
         float pointsBoundingBoxArea;
         float localRadius;
@@ -266,6 +285,10 @@
 
         bool getPrecipitationAllZero() const { return precipitationAllZero; }
 
+        // the fittings run their restarts in parallel only if this is set (false inside parallel loops)
+        bool isParallelComputing() const { return parallelComputing; }
+        void setParallelComputing(bool value) { parallelComputing = value; }
+
         float getMinRegressionR2() const { return minRegressionR2; }
 
         bool getUseLapseRateCode() const { return useLapseRateCode; }
@@ -274,6 +297,11 @@
 
         gis::Crit3DRasterGrid* getCurrentDEM() const { return currentDEM; }
 
+        gis::Crit3DTopographicDistanceStore* getTopographicDistanceStore() const { return topographicDistanceStore; }
+
+        Crit3DProxyCube* getProxyCube() const { return proxyCube; }
+        Crit3DStationDistanceCache* getStationDistanceCache() const { return stationDistanceCache; }
+
         std::vector<int> getMacroAreaNumber() const { return macroAreaNumbers; }
 
         gis::Crit3DRasterGrid* getMacroAreasMap() const { return macroAreasMap; }
@@ -294,6 +322,7 @@
         aggregationMethod getMeteoGridAggrMethod() const { return meteoGridAggrMethod; }
 
         int getMinPointsLocalDetrending() const { return minPointsLocalDetrending; }
+        int getMultiResolutionFactor() const { return multiResolutionFactor; }
 
         int getIndexPointCV() const { return indexPointCV; }
 
@@ -339,6 +368,7 @@
 		void setUseGlocalDetrending(bool myValue);
         void setMacroAreasMap(gis::Crit3DRasterGrid *value);
         void setMacroAreas(std::vector<Crit3DMacroArea> myAreas);
+        void swapMacroAreas(std::vector<Crit3DMacroArea> &myAreas) { macroAreas.swap(myAreas); }
         void pushMacroAreaNumber(int number);
 
         void clearMacroAreaNumber();
@@ -354,6 +384,9 @@
         void setShepardInitialRadius(float value);
         void setIndexPointCV(int value);
         void setCurrentDEM(gis::Crit3DRasterGrid *value);
+        void setTopographicDistanceStore(gis::Crit3DTopographicDistanceStore *value);
+        void setProxyCube(Crit3DProxyCube *value);
+        void setStationDistanceCache(Crit3DStationDistanceCache *value);
         void setTopoDist_maxKh(int value);
         void setTopoDist_Kh(int value);
         Crit3DProxyCombination getOptimalCombination() const;
@@ -377,6 +410,7 @@
         void setPointsBoundingBoxArea(float newPointsBoundingBoxArea);
         void setLocalRadius(float newLocalRadius);
         void setMinPointsLocalDetrending(int newMinPointsLocalDetrending);
+        void setMultiResolutionFactor(int newMultiResolutionFactor);
 
         std::vector<double> getProxyFittingParameters(int tempIndex);
         void setFittingParameters(const std::vector<std::vector <double>> &newFittingParameters);
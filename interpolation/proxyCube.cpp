@@ -0,0 +1,219 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+
+#include "commonConstants.h"
+#include "basicMath.h"
+#include "proxyCube.h"
+
+
+Crit3DProxyCube::Crit3DProxyCube()
+{
+    clear();
+}
+
+
+void Crit3DProxyCube::clear()
+{
+    _header = gis::Crit3DRasterHeader();
+    _nrProxies = 0;
+    _values.clear();
+    _proxyGrid.clear();
+    _proxyHeader.clear();
+    _proxyHash.clear();
+}
+
+
+/*!
+ * \brief getLoadedProxyGrid
+ * grid of the proxy i, nullptr if it is not loaded
+ */
+static const gis::Crit3DRasterGrid* getLoadedProxyGrid(Crit3DInterpolationSettings &interpolationSettings, unsigned i)
+{
+    const gis::Crit3DRasterGrid* proxyGrid = interpolationSettings.getProxy(i)->getGrid();
+    if (proxyGrid != nullptr && ! proxyGrid->isLoaded)
+        return nullptr;
+
+    return proxyGrid;
+}
+
+
+/*!
+ * \brief isValid
+ * the cube is valid if the target grid is the same and the proxy grids have the same header and values
+ * (the values are compared by the hash stored in the proxy: a grid can be reloaded in the same memory)
+ */
+bool Crit3DProxyCube::isValid(const gis::Crit3DRasterHeader &header, Crit3DInterpolationSettings &interpolationSettings,
+                              bool isParallelComputing) const
+{
+    if (isEmpty() || ! (_header == header) || _nrProxies != unsigned(interpolationSettings.getProxyNr()))
+        return false;
+
+    for (unsigned i = 0; i < _nrProxies; i++)
+    {
+        const gis::Crit3DRasterGrid* proxyGrid = getLoadedProxyGrid(interpolationSettings, i);
+
+        if (proxyGrid != _proxyGrid[i])
+            return false;
+
+        if (proxyGrid == nullptr)
+            continue;
+
+        if (! (*(proxyGrid->header) == _proxyHeader[i])
+            || interpolationSettings.getProxy(i)->getGridHash(isParallelComputing) != _proxyHash[i])
+            return false;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief initialize
+ * sample all the loaded proxies on the cell centers of the target grid
+ * (NODATA if the proxy grid is not loaded or has no value).
+ * The parallel loop reads only copies of the proxy headers and the values of the grids, not the settings
+ */
+bool Crit3DProxyCube::initialize(const gis::Crit3DRasterHeader &header, Crit3DInterpolationSettings &interpolationSettings,
+                                 bool isParallelComputing)
+{
+    clear();
+
+    unsigned nrProxies = unsigned(interpolationSettings.getProxyNr());
+    size_t nrCells = size_t(header.nrRows) * size_t(header.nrCols);
+    if (nrProxies == 0 || nrCells == 0)
+        return false;
+
+    if (double(nrCells) * nrProxies > MAX_PROXY_CUBE_SIZE)
+        return false;
+
+    _proxyGrid.resize(nrProxies, nullptr);
+    _proxyHeader.resize(nrProxies);
+    _proxyHash.resize(nrProxies, 0);
+    std::vector<float**> proxyValues(nrProxies, nullptr);
+
+    for (unsigned i = 0; i < nrProxies; i++)
+    {
+        const gis::Crit3DRasterGrid* proxyGrid = getLoadedProxyGrid(interpolationSettings, i);
+        if (proxyGrid != nullptr)
+        {
+            _proxyGrid[i] = proxyGrid;
+            _proxyHeader[i] = *(proxyGrid->header);
+            _proxyHash[i] = interpolationSettings.getProxy(i)->getGridHash(isParallelComputing);
+            proxyValues[i] = proxyGrid->value;
+        }
+    }
+
+    _values.resize(nrCells * nrProxies, NODATA);
+
+    const std::vector<gis::Crit3DRasterHeader> &proxyHeader = _proxyHeader;
+
+    #pragma omp parallel for if (isParallelComputing)
+    for (long row = 0; row < header.nrRows; row++)
+    {
+        for (long col = 0; col < header.nrCols; col++)
+        {
+            // same coordinates of the interpolation
+            float x, y;
+            gis::getUtmXYFromRowColSinglePrecision(header, row, col, &x, &y);
+
+            float* cellValues = &_values[(size_t(row) * size_t(header.nrCols) + size_t(col)) * nrProxies];
+            for (unsigned i = 0; i < nrProxies; i++)
+            {
+                if (proxyValues[i] == nullptr)
+                    continue;
+
+                // same of Crit3DRasterGrid::getValueFromXY
+                const gis::Crit3DRasterHeader &h = proxyHeader[i];
+                int proxyRow = (h.nrRows - 1) - int((double(y) - h.llCorner.y) * h.invCellSize);
+                int proxyCol = int((double(x) - h.llCorner.x) * h.invCellSize);
+                if (unsigned(proxyRow) >= unsigned(h.nrRows) || unsigned(proxyCol) >= unsigned(h.nrCols))
+                    continue;
+
+                float value = proxyValues[i][proxyRow][proxyCol];
+                if (value != h.flag)
+                    cellValues[i] = value;
+            }
+        }
+    }
+
+    _header = header;
+    _nrProxies = nrProxies;
+
+    return true;
+}
+
+
+/*!
+ * \brief getProxyMask
+ * indexes of the proxies to be read: active (and significant) in the current combination, with a loaded grid
+ */
+bool Crit3DProxyCube::getProxyMask(Crit3DInterpolationSettings &interpolationSettings, bool onlySignificant,
+                                   std::vector<unsigned> &proxyMask) const
+{
+    proxyMask.clear();
+    if (isEmpty())
+        return false;
+
+    Crit3DProxyCombination myCombination = interpolationSettings.getCurrentCombination();
+
+    for (unsigned i = 0; i < _nrProxies; i++)
+    {
+        if (_proxyGrid[i] == nullptr || ! myCombination.isProxyActive(i))
+            continue;
+
+        if (onlySignificant && ! myCombination.isProxySignificant(i))
+            continue;
+
+        proxyMask.push_back(i);
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief getProxyValues
+ * the same of getProxyValuesXY for the cell center: returns false if a masked proxy has no value
+ */
+bool Crit3DProxyCube::getProxyValues(int row, int col, const std::vector<unsigned> &proxyMask, std::vector<double> &proxyValues) const
+{
+    std::fill(proxyValues.begin(), proxyValues.end(), NODATA);
+
+    const float* cellValues = getCellValues(row, col);
+    bool proxyComplete = true;
+
+    for (unsigned i : proxyMask)
+    {
+        float value = cellValues[i];
+        if (isEqual(value, NODATA))
+            proxyComplete = false;
+        else
+            proxyValues[i] = value;
+    }
+
+    return proxyComplete;
+}
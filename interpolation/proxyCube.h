@@ -0,0 +1,55 @@
+#ifndef PROXYCUBE_H
+#define PROXYCUBE_H
+
+    #ifndef INTERPOLATIONSETTINGS_H
+        #include "interpolationSettings.h"
+    #endif
+
+    #include <cstdint>
+
+    // max number of values (4 bytes each)
+    #define MAX_PROXY_CUBE_SIZE 250000000
+
+    /*!
+     * \brief The Crit3DProxyCube class
+     * values of all the loaded proxies sampled once on the cells of a target grid,
+     * stored interleaved by cell: the proxy values of a cell are a contiguous block.
+     * The proxy mask (active and significant proxies) is computed once for each grid interpolation
+     */
+    class Crit3DProxyCube
+    {
+    private:
+        gis::Crit3DRasterHeader _header;
+        unsigned _nrProxies;
+        std::vector<float> _values;                             // [cell * nrProxies + proxy]
+
+        // source grids, to check the validity: header and hash of the values
+        std::vector<const gis::Crit3DRasterGrid*> _proxyGrid;
+        std::vector<gis::Crit3DRasterHeader> _proxyHeader;
+        std::vector<uint64_t> _proxyHash;
+
+    public:
+        Crit3DProxyCube();
+
+        void clear();
+
+        bool isEmpty() const { return _values.empty(); }
+        unsigned getNrProxies() const { return _nrProxies; }
+
+        bool isValid(const gis::Crit3DRasterHeader &header, Crit3DInterpolationSettings &interpolationSettings,
+                     bool isParallelComputing) const;
+
+        bool initialize(const gis::Crit3DRasterHeader &header, Crit3DInterpolationSettings &interpolationSettings,
+                        bool isParallelComputing);
+
+        bool getProxyMask(Crit3DInterpolationSettings &interpolationSettings, bool onlySignificant,
+                          std::vector<unsigned> &proxyMask) const;
+
+        const float* getCellValues(int row, int col) const
+        { return &_values[(size_t(row) * size_t(_header.nrCols) + size_t(col)) * _nrProxies]; }
+
+        bool getProxyValues(int row, int col, const std::vector<unsigned> &proxyMask, std::vector<double> &proxyValues) const;
+    };
+
+
+#endif // PROXYCUBE_H
@@ -99,60 +99,354 @@ float getSpatialThresholdVar(meteoVariable myVar, Crit3DMeteoSettings* meteoSett
 }
 
 
+/*!
+ * \brief computeResidual
+ * residual (observed - interpolated) of a single meteo point, NODATA if the point is not valid
+ */
+static float computeResidual(meteoVariable myVar, const Crit3DMeteoPoint &meteoPoint,
+                             const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                             Crit3DInterpolationSettings &interpolationSettings,
+                             Crit3DMeteoSettings* meteoSettings, bool excludeOutsideDem, bool excludeSupplemental)
+{
+    if (! meteoPoint.active)
+        return NODATA;
+
+    bool isValid = (! excludeSupplemental || checkLapseRateCode(meteoPoint.lapseRateCode, interpolationSettings.getUseLapseRateCode(), false));
+    isValid = (isValid && (! excludeOutsideDem || meteoPoint.isInsideDem));
+
+    if (! isValid || meteoPoint.quality != quality::accepted)
+        return NODATA;
+
+    std::vector <double> myProxyValues = meteoPoint.getProxyValues();
+    float myValue = meteoPoint.currentValue;
+
+    float interpolatedValue = interpolate(interpolationPoints, interpolationSettings, meteoSettings, myVar,
+                                          float(meteoPoint.point.utm.x),
+                                          float(meteoPoint.point.utm.y),
+                                          float(meteoPoint.point.z),
+                                          myProxyValues, false);
+
+    if (  myVar == precipitation || myVar == dailyPrecipitation)
+    {
+        if (myValue != NODATA)
+        {
+            if (myValue < meteoSettings->getRainfallThreshold())
+                myValue=0.;
+        }
+
+        if (interpolatedValue != NODATA)
+        {
+            if (interpolatedValue < meteoSettings->getRainfallThreshold())
+                interpolatedValue=0.;
+        }
+    }
+
+    // TODO derived var
+
+    if ((interpolatedValue != NODATA) && (myValue != NODATA))
+        return myValue - interpolatedValue;
+
+    return NODATA;
+}
+
+
 bool computeResiduals(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                       const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
                       Crit3DInterpolationSettings &interpolationSettings,
-                      Crit3DMeteoSettings* meteoSettings, bool excludeOutsideDem, bool excludeSupplemental)
+                      Crit3DMeteoSettings* meteoSettings, bool excludeOutsideDem, bool excludeSupplemental,
+                      bool isParallelComputing)
 {
 
     if (myVar == noMeteoVar) return false;
 
-    std::vector <double> myProxyValues;
-    bool isValid;
+    // interpolate takes the settings by non-const reference: each thread works on its own copy
+    Crit3DInterpolationSettings localSettings = interpolationSettings;
 
-    for (size_t i = 0; i < meteoPoints.size(); i++)
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings)
+    for (long i = 0; i < long(meteoPoints.size()); i++)
     {
-        myProxyValues = meteoPoints[i].getProxyValues();
+        meteoPoints[i].residual = computeResidual(myVar, meteoPoints[i], interpolationPoints, localSettings,
+                                                  meteoSettings, excludeOutsideDem, excludeSupplemental);
+    }
 
-        meteoPoints[i].residual = NODATA;
+    return true;
+}
 
-        if (meteoPoints[i].active)
+
+/*!
+ * \brief interpolateResidualWithoutPoint
+ * as interpolateResidual, excluding the point pointIndex (zero distance, as the station itself in the direct interpolation)
+ */
+static float interpolateResidualWithoutPoint(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                             Crit3DInterpolationSettings &interpolationSettings, meteoVariable myVar,
+                                             int pointIndex, float x, float y, float z)
+{
+    if (interpolationSettings.getUseRetrendOnly())
+        return 0;
+
+    std::vector<float> distances = computeDistances(myVar, interpolationPoints, interpolationSettings, x, y, z, true);
+    for (size_t k = 0; k < interpolationPoints.size(); k++)
+    {
+        if (interpolationPoints[k].index == pointIndex)
+            distances[k] = 0;
+    }
+
+    return interpolateDistances(interpolationPoints, distances, interpolationSettings, x, y);
+}
+
+
+/*!
+ * \brief interpolateMultiResolutionWithoutPoint
+ * value in (x, y, z) of the two levels interpolation (see interpolationRasterMultiResolution) without the point pointIndex:
+ * the residuals of the four surrounding coarse cells are interpolated without the point,
+ * upsampled by bilinear interpolation and retrended with the proxy values of (x, y, z)
+ */
+static float interpolateMultiResolutionWithoutPoint(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                                    Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                                    meteoVariable myVar, const gis::Crit3DRasterGrid &coarseDem, int pointIndex,
+                                                    float x, float y, float z, const std::vector<double> &proxyValues)
+{
+    if ((myVar == precipitation || myVar == dailyPrecipitation) && interpolationSettings.getPrecipitationAllZero())
+        return 0.;
+
+    const gis::Crit3DRasterHeader &coarseHeader = *(coarseDem.header);
+    const double coarseTop = coarseHeader.llCorner.y + coarseHeader.nrRows * coarseHeader.cellSize;
+
+    // bilinear interpolation between the centers of the coarse cells
+    double coarseCol = (x - coarseHeader.llCorner.x) / coarseHeader.cellSize - 0.5;
+    double coarseRow = (coarseTop - y) / coarseHeader.cellSize - 0.5;
+    int col0 = int(floor(coarseCol));
+    int row0 = int(floor(coarseRow));
+    double dx = coarseCol - col0;
+    double dy = coarseRow - row0;
+
+    double sumValues = 0;
+    double sumWeights = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
         {
-            isValid = (! excludeSupplemental || checkLapseRateCode(meteoPoints[i].lapseRateCode, interpolationSettings.getUseLapseRateCode(), false));
-            isValid = (isValid && (! excludeOutsideDem || meteoPoints[i].isInsideDem));
+            int r = row0 + i;
+            int c = col0 + j;
+            if (r < 0 || r >= coarseHeader.nrRows || c < 0 || c >= coarseHeader.nrCols)
+                continue;
+
+            float coarseZ = coarseDem.value[r][c];
+            if (isEqual(coarseZ, coarseHeader.flag))
+                continue;
+
+            float coarseX, coarseY;
+            gis::getUtmXYFromRowColSinglePrecision(coarseHeader, r, c, &coarseX, &coarseY);
+            float value = interpolateResidualWithoutPoint(interpolationPoints, interpolationSettings, myVar,
+                                                          pointIndex, coarseX, coarseY, coarseZ);
+            if (isEqual(value, NODATA))
+                continue;
+
+            double weight = (i == 0 ? 1 - dy : dy) * (j == 0 ? 1 - dx : dx);
+            sumValues += weight * value;
+            sumWeights += weight;
+        }
+    }
+
+    float residual;
+    if (sumWeights > EPSILON)
+        residual = float(sumValues / sumWeights);
+    else
+        residual = interpolateResidualWithoutPoint(interpolationPoints, interpolationSettings, myVar, pointIndex, x, y, z);
 
-            if (isValid && meteoPoints[i].quality == quality::accepted)
+    return completeInterpolation(residual, interpolationSettings, meteoSettings, myVar, proxyValues);
+}
+
+
+/*!
+ * \brief computeResidualsLeaveOneOut
+ * leave-one-out cross validation: each station is estimated without its own contribution.
+ * The spatial step already excludes the station (zero distance); when the trend is a single linear proxy
+ * (regressionGeneric) the regression is also recomputed without the station, removing it from the sums
+ * of the full fit (rank-one downdating). The other detrending cases keep the full fit, as computeResiduals.
+ * coarseDem: if not nullptr, the stations are estimated by the two levels interpolation on this coarse grid
+ * (the residuals of the coarse cells around the station are interpolated without the station).
+ * Stations are processed in parallel, each thread works on its own copy of settings and points.
+ */
+bool computeResidualsLeaveOneOut(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                 const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
+                                 Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                 const gis::Crit3DRasterGrid* coarseDem,
+                                 bool excludeOutsideDem, bool excludeSupplemental, bool isParallelComputing)
+{
+    if (myVar == noMeteoVar) return false;
+
+    // downdating is possible with a single active proxy fitted by regressionGeneric
+    int proxyPos = NODATA;
+    Crit3DProxyCombination myCombination = interpolationSettings.getCurrentCombination();
+
+    if (getUseDetrendingVar(myVar) && ! interpolationSettings.getUseMultipleDetrending()
+        && ! interpolationSettings.getUseBestDetrending() && myCombination.getActiveProxySize() == 1)
+    {
+        for (unsigned pos = 0; pos < interpolationSettings.getProxyNr(); pos++)
+        {
+            if (myCombination.isProxyActive(pos))
             {
-                float myValue = meteoPoints[i].currentValue;
+                if (getProxyPragaName(interpolationSettings.getProxyName(pos)) != proxyHeight || ! isThermal(myVar))
+                    proxyPos = int(pos);
+            }
+        }
+    }
 
-                float interpolatedValue = interpolate(interpolationPoints, interpolationSettings, meteoSettings, myVar,
-                                                      float(meteoPoints[i].point.utm.x),
-                                                      float(meteoPoints[i].point.utm.y),
-                                                      float(meteoPoints[i].point.z),
-                                                      myProxyValues, false);
+    // sums of the full regression, computed on the original (not detrended) values
+    std::vector <int> regressionIndex(meteoPoints.size(), NODATA);
+    std::vector <double> detrendFactor(interpolationPoints.size(), 0);
+    std::vector <double> originalValue(interpolationPoints.size());
+    double n = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0, sumYY = 0;
+    double fullSlope = 0;
+    float fullIntercept = NODATA, fullR2 = NODATA, fullRegressionSlope = NODATA;
+    bool fullSignificant = false;
 
-                if (  myVar == precipitation || myVar == dailyPrecipitation)
-                {
-                    if (myValue != NODATA)
-                    {
-                        if (myValue < meteoSettings->getRainfallThreshold())
-                            myValue=0.;
-                    }
+    for (size_t j = 0; j < interpolationPoints.size(); j++)
+        originalValue[j] = interpolationPoints[j].value;
 
-                    if (interpolatedValue != NODATA)
-                    {
-                        if (interpolatedValue < meteoSettings->getRainfallThreshold())
-                            interpolatedValue=0.;
-                    }
-                }
+    if (proxyPos != NODATA)
+    {
+        unsigned pos = unsigned(proxyPos);
+        Crit3DProxy* myProxy = interpolationSettings.getProxy(pos);
+        bool isHeight = (getProxyPragaName(myProxy->getName()) == proxyHeight);
+
+        fullRegressionSlope = myProxy->getRegressionSlope();
+        fullIntercept = myProxy->getRegressionIntercept();
+        fullR2 = myProxy->getRegressionR2();
+        fullSignificant = myCombination.isProxySignificant(pos);
+        if (fullSignificant)
+            fullSlope = fullRegressionSlope;
+
+        for (size_t j = 0; j < interpolationPoints.size(); j++)
+        {
+            float proxyValue = interpolationPoints[j].getProxyValue(pos);
+            if (isEqual(proxyValue, NODATA) || isEqual(interpolationPoints[j].value, NODATA))
+                continue;
 
-                // TODO derived var
+            // same detrending of detrendPoints
+            detrendFactor[j] = isHeight ? MAXVALUE(proxyValue, 0) : proxyValue;
+            originalValue[j] += fullSlope * detrendFactor[j];
 
-                if ((interpolatedValue != NODATA) && (myValue != NODATA))
-                {
-                    meteoPoints[i].residual = myValue - interpolatedValue;
-                }
+            if (interpolationPoints[j].isActive && (pos != interpolationSettings.getIndexHeight()
+                || checkLapseRateCode(interpolationPoints[j].lapseRateCode, interpolationSettings.getUseLapseRateCode(), true)))
+            {
+                int index = interpolationPoints[j].index;
+                if (index >= 0 && index < int(meteoPoints.size()))
+                    regressionIndex[unsigned(index)] = int(j);
+
+                n++;
+                sumX += proxyValue;
+                sumY += originalValue[j];
+                sumXX += double(proxyValue) * proxyValue;
+                sumXY += proxyValue * originalValue[j];
+                sumYY += originalValue[j] * originalValue[j];
+            }
+        }
+    }
+
+    float rainfallThreshold = meteoSettings->getRainfallThreshold();
+    Crit3DInterpolationSettings looSettings = interpolationSettings;
+    std::vector <Crit3DInterpolationDataPoint> looPoints = interpolationPoints;
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(looSettings, looPoints)
+    for (long i = 0; i < long(meteoPoints.size()); i++)
+    {
+        meteoPoints[i].residual = NODATA;
+
+        if (! meteoPoints[i].active || meteoPoints[i].quality != quality::accepted)
+            continue;
+
+        bool isValid = (! excludeSupplemental || checkLapseRateCode(meteoPoints[i].lapseRateCode, looSettings.getUseLapseRateCode(), false));
+        if (! isValid || (excludeOutsideDem && ! meteoPoints[i].isInsideDem))
+            continue;
+
+        // remove the station from the regression
+        int j = regressionIndex[unsigned(i)];
+        bool isDowndated = false;
+
+        if (j != NODATA)
+        {
+            double x = looPoints[unsigned(j)].getProxyValue(unsigned(proxyPos));
+            double y = originalValue[unsigned(j)];
+            double n1 = n - 1;
+            double sumX1 = sumX - x;
+            double sumY1 = sumY - y;
+            double covXY = (sumXY - x * y) - sumX1 * sumY1 / n1;
+            double varX = (sumXX - x * x) - sumX1 * sumX1 / n1;
+            double varY = (sumYY - y * y) - sumY1 * sumY1 / n1;
+
+            double slope = 0, intercept = 0, r2 = 0;
+            if (n1 >= MIN_REGRESSION_POINTS && varX > 0 && varY > 0)
+            {
+                slope = covXY / varX;
+                intercept = (sumY1 - slope * sumX1) / n1;
+                r2 = slope * covXY / varY;
             }
+
+            bool isSignificant = (n1 >= MIN_REGRESSION_POINTS && r2 >= looSettings.getMinRegressionR2());
+            double looSlope = isSignificant ? slope : 0;
+
+            Crit3DProxy* myProxy = looSettings.getProxy(unsigned(proxyPos));
+            myProxy->setRegressionSlope(float(slope));
+            myProxy->setRegressionIntercept(float(intercept));
+            myProxy->setLapseRateT0(float(intercept));
+            myProxy->setRegressionR2(float(r2));
+            looSettings.setSignificantCurrentCombination(unsigned(proxyPos), isSignificant);
+
+            for (size_t k = 0; k < looPoints.size(); k++)
+                looPoints[k].value = float(originalValue[k] - looSlope * detrendFactor[k]);
+
+            isDowndated = true;
+        }
+
+        std::vector <double> myProxyValues = meteoPoints[i].getProxyValues();
+        float myValue = meteoPoints[i].currentValue;
+
+        float interpolatedValue;
+        if (coarseDem == nullptr)
+        {
+            interpolatedValue = interpolate(looPoints, looSettings, meteoSettings, myVar,
+                                            float(meteoPoints[i].point.utm.x),
+                                            float(meteoPoints[i].point.utm.y),
+                                            float(meteoPoints[i].point.z),
+                                            myProxyValues, false);
+        }
+        else
+        {
+            interpolatedValue = interpolateMultiResolutionWithoutPoint(looPoints, looSettings, meteoSettings, myVar, *coarseDem, int(i),
+                                                                       float(meteoPoints[i].point.utm.x),
+                                                                       float(meteoPoints[i].point.utm.y),
+                                                                       float(meteoPoints[i].point.z),
+                                                                       myProxyValues);
+        }
+
+        // restore the full fit
+        if (isDowndated)
+        {
+            Crit3DProxy* myProxy = looSettings.getProxy(unsigned(proxyPos));
+            myProxy->setRegressionSlope(fullRegressionSlope);
+            myProxy->setRegressionIntercept(fullIntercept);
+            myProxy->setLapseRateT0(fullIntercept);
+            myProxy->setRegressionR2(fullR2);
+            looSettings.setSignificantCurrentCombination(unsigned(proxyPos), fullSignificant);
+
+            for (size_t k = 0; k < looPoints.size(); k++)
+                looPoints[k].value = interpolationPoints[k].value;
+        }
+
+        if (myVar == precipitation || myVar == dailyPrecipitation)
+        {
+            if (myValue != NODATA && myValue < rainfallThreshold)
+                myValue = 0.;
+
+            if (interpolatedValue != NODATA && interpolatedValue < rainfallThreshold)
+                interpolatedValue = 0.;
+        }
+
+        if ((interpolatedValue != NODATA) && (myValue != NODATA))
+        {
+            meteoPoints[i].residual = myValue - interpolatedValue;
         }
     }
 
@@ -164,72 +458,83 @@ bool computeResidualsLocalDetrending(meteoVariable myVar, const Crit3DTime &myTi
                                      std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                                      Crit3DInterpolationSettings &interpolationSettings,
                                      Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters,
-                                     bool excludeOutsideDem, bool excludeSupplemental)
+                                     bool excludeOutsideDem, bool excludeSupplemental, bool isParallelComputing)
 {
     if (myVar == noMeteoVar) return false;
 
-    std::vector <double> myProxyValues;
-    bool isValid;
-    std::string errorStdString;
+    // optimal detrending writes the residuals of all meteo points: serial only
+    isParallelComputing = (isParallelComputing && ! interpolationSettings.getUseBestDetrending());
 
-    for (size_t i = 0; i < meteoPoints.size(); i++)
+    bool isOk = true;
+    Crit3DInterpolationSettings localSettings = interpolationSettings;
+    // no nested parallel fittings
+    localSettings.setParallelComputing(interpolationSettings.isParallelComputing() && ! isParallelComputing);
+
+    // each thread stops at its first error (isOk is private in the loop and combined at the end)
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings) reduction(&&:isOk)
+    for (long i = 0; i < long(meteoPoints.size()); i++)
     {
-        myProxyValues = meteoPoints[i].getProxyValues();
+        std::vector <double> myProxyValues = meteoPoints[i].getProxyValues();
+        std::string errorStdString;
 
         meteoPoints[i].residual = NODATA;
 
-        if (meteoPoints[i].active)
+        if (! isOk || ! meteoPoints[i].active)
+            continue;
+
+        bool isValid = (! excludeSupplemental || checkLapseRateCode(meteoPoints[i].lapseRateCode, localSettings.getUseLapseRateCode(), false));
+        isValid = (isValid && (! excludeOutsideDem || meteoPoints[i].isInsideDem));
+
+        if (isValid && meteoPoints[i].quality == quality::accepted)
         {
+            float myValue = meteoPoints[i].currentValue;
 
-            isValid = (! excludeSupplemental || checkLapseRateCode(meteoPoints[i].lapseRateCode, interpolationSettings.getUseLapseRateCode(), false));
-            isValid = (isValid && (! excludeOutsideDem || meteoPoints[i].isInsideDem));
+            std::vector <Crit3DInterpolationDataPoint> subsetInterpolationPoints;
+            if (! localSelection(interpolationPoints, subsetInterpolationPoints, float(meteoPoints[i].point.utm.x),
+                                float(meteoPoints[i].point.utm.y), localSettings, false))
+            {
+                isOk = false;
+                continue;
+            }
 
-            if (isValid && meteoPoints[i].quality == quality::accepted)
+            if (! preInterpolation(subsetInterpolationPoints, localSettings, meteoSettings,
+                                  climateParameters, meteoPoints, myVar, myTime, errorStdString))
             {
-                float myValue = meteoPoints[i].currentValue;
-
-                bool excludeSupplemental = false;
-                std::vector <Crit3DInterpolationDataPoint> subsetInterpolationPoints;
-                if (! localSelection(interpolationPoints, subsetInterpolationPoints, float(meteoPoints[i].point.utm.x),
-                                    float(meteoPoints[i].point.utm.y), interpolationSettings, excludeSupplemental))
-                    return false;
-
-                if (! preInterpolation(subsetInterpolationPoints, interpolationSettings, meteoSettings,
-                                      climateParameters, meteoPoints, myVar, myTime, errorStdString))
-                    return false;
-
-                float interpolatedValue = interpolate(subsetInterpolationPoints, interpolationSettings, meteoSettings, myVar,
-                                                      float(meteoPoints[i].point.utm.x),
-                                                      float(meteoPoints[i].point.utm.y),
-                                                      float(meteoPoints[i].point.z),
-                                                      myProxyValues, false);
+                isOk = false;
+                continue;
+            }
 
-                if (  myVar == precipitation || myVar == dailyPrecipitation)
-                {
-                    if (myValue != NODATA)
-                    {
-                        if (myValue < meteoSettings->getRainfallThreshold())
-                            myValue=0.;
-                    }
+            float interpolatedValue = interpolate(subsetInterpolationPoints, localSettings, meteoSettings, myVar,
+                                                  float(meteoPoints[i].point.utm.x),
+                                                  float(meteoPoints[i].point.utm.y),
+                                                  float(meteoPoints[i].point.z),
+                                                  myProxyValues, false);
 
-                    if (interpolatedValue != NODATA)
-                    {
-                        if (interpolatedValue < meteoSettings->getRainfallThreshold())
-                            interpolatedValue=0.;
-                    }
+            if (  myVar == precipitation || myVar == dailyPrecipitation)
+            {
+                if (myValue != NODATA)
+                {
+                    if (myValue < meteoSettings->getRainfallThreshold())
+                        myValue=0.;
                 }
 
-                // TODO derived var
-
-                if ((interpolatedValue != NODATA) && (myValue != NODATA))
+                if (interpolatedValue != NODATA)
                 {
-                    meteoPoints[i].residual = myValue - interpolatedValue;
+                    if (interpolatedValue < meteoSettings->getRainfallThreshold())
+                        interpolatedValue=0.;
                 }
             }
+
+            // TODO derived var
+
+            if ((interpolatedValue != NODATA) && (myValue != NODATA))
+            {
+                meteoPoints[i].residual = myValue - interpolatedValue;
+            }
         }
     }
 
-    return true;
+    return isOk;
 }
 
 
@@ -333,98 +638,257 @@ float computeErrorCrossValidation(const std::vector<Crit3DMeteoPoint> &meteoPoin
 }
 
 
-bool spatialQualityControl(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
-                           Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
-                           Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime, std::string &errorStr)
+/*!
+ * \brief computeErrorCrossValidation
+ * mean absolute error of the residuals (as computeResiduals + computeErrorCrossValidation)
+ * without modifying the meteo points, so that it can be called concurrently with different settings.
+ * The computation stops and returns NODATA as soon as the error is surely greater than maxError
+ * (the partial sum divided by the maximum number of valid points); maxError = NODATA disables the check
+ */
+float computeErrorCrossValidation(meteoVariable myVar, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                  const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                  Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                  bool excludeOutsideDem, bool excludeSupplemental, float maxError)
 {
-    float stdDev, avgDeltaZ, minDist, myValue, myResidual;
-    std::vector <int> listIndex;
-    std::vector <float> listResiduals;
-    std::vector <Crit3DInterpolationDataPoint> myInterpolationPoints;
+    if (myVar == noMeteoVar) return NODATA;
+
+    size_t nrMaxValid = 0;
+    for (size_t i = 0; i < meteoPoints.size(); i++)
+    {
+        if (meteoPoints[i].active && meteoPoints[i].quality == quality::accepted)
+            nrMaxValid++;
+    }
+
+    // margin on the threshold: float sums in different order
+    double maxSum = NODATA;
+    if (! isEqual(maxError, NODATA))
+        maxSum = double(maxError) * (1. + 1.e-3) * double(nrMaxValid);
+
+    std::vector <float> obsValues, estValues;
+    double sumError = 0;
+
+    for (size_t i = 0; i < meteoPoints.size(); i++)
+    {
+        float value = meteoPoints[i].currentValue;
+        if (value == NODATA)
+            continue;
+
+        float residual = computeResidual(myVar, meteoPoints[i], interpolationPoints, interpolationSettings,
+                                         meteoSettings, excludeOutsideDem, excludeSupplemental);
+        if (residual == NODATA)
+            continue;
+
+        obsValues.push_back(value);
+        estValues.push_back(value - residual);
+
+        sumError += fabs(double(residual));
+        if (maxSum != NODATA && sumError > maxSum)
+            return NODATA;
+    }
+
+    if (obsValues.empty())
+        return NODATA;
+
+    return statistics::meanAbsoluteError(obsValues, estValues);
+}
+
+
+/*!
+ * \brief isSpatialSuspect
+ * the residual of the station is greater than the variability of its neighbourhood (neighbourIndex)
+ */
+static bool isSpatialSuspect(meteoVariable myVar, const Crit3DMeteoPoint &meteoPoint,
+                             std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                             const Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                             int maxNrPoints, std::vector<int> &neighbourIndex)
+{
+    float stdDev, avgDeltaZ, minDist;
+    if (! neighbourhoodVariability(myVar, interpolationPoints, interpolationSettings, float(meteoPoint.point.utm.x),
+                                  float(meteoPoint.point.utm.y), float(meteoPoint.point.z),
+                                  maxNrPoints, stdDev, avgDeltaZ, minDist, neighbourIndex))
+        return false;
+
+    float myValue = meteoPoint.currentValue;
+    stdDev = MAXVALUE(stdDev, myValue/100.f);
+
+    return (fabs(meteoPoint.residual) > getSpatialThresholdVar(myVar, meteoSettings, myValue, stdDev, 2, avgDeltaZ, minDist));
+}
 
-    if (passDataToInterpolation(meteoPoints, myInterpolationPoints, interpolationSettings))
+
+/*!
+ * \brief checkSuspectPoints
+ * the suspect stations are checked again with the trend computed without them:
+ * only the suspect values are re-interpolated (in parallel). interpolationPoints are the points of the new trend,
+ * wrongIndex are the indexes of the stations confirmed as wrong
+ */
+static bool checkSuspectPoints(const std::vector<int> &suspectIndex, meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
+                               std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                               Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                               Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime, int maxNrPoints,
+                               bool isParallelComputing, std::vector<int> &wrongIndex, std::string &errorStr)
+{
+    wrongIndex.clear();
+
+    for (int index : suspectIndex)
+        meteoPoints[unsigned(index)].quality = quality::wrong_spatial;
+
+    if (passDataToInterpolation(meteoPoints, interpolationPoints, interpolationSettings))
     {
-        // detrend
-        if (! preInterpolation(myInterpolationPoints, interpolationSettings, meteoSettings, climateParameters,
+        if (! preInterpolation(interpolationPoints, interpolationSettings, meteoSettings, climateParameters,
                               meteoPoints, myVar, myTime, errorStr))
         {
             return false;
         }
 
-        // compute residuals
-        if (! computeResiduals(myVar, meteoPoints, myInterpolationPoints, interpolationSettings, meteoSettings, false, false))
+        Crit3DInterpolationSettings localSettings = interpolationSettings;
+        localSettings.setParallelComputing(interpolationSettings.isParallelComputing() && ! isParallelComputing);
+
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings)
+        for (long i = 0; i < long(suspectIndex.size()); i++)
+        {
+            Crit3DMeteoPoint &myPoint = meteoPoints[unsigned(suspectIndex[i])];
+
+            float interpolatedValue = interpolate(interpolationPoints, localSettings, meteoSettings, myVar,
+                                                  float(myPoint.point.utm.x), float(myPoint.point.utm.y),
+                                                  float(myPoint.point.z), myPoint.getProxyValues(), false);
+
+            float myValue = myPoint.currentValue;
+            float myResidual = interpolatedValue - myValue;
+
+            float stdDev, avgDeltaZ, minDist;
+            if (neighbourhoodVariability(myVar, interpolationPoints, localSettings, float(myPoint.point.utm.x),
+                     float(myPoint.point.utm.y), float(myPoint.point.z),
+                     maxNrPoints, stdDev, avgDeltaZ, minDist))
+            {
+                if (fabs(myResidual) > getSpatialThresholdVar(myVar, meteoSettings, myValue, stdDev, 3, avgDeltaZ, minDist))
+                    myPoint.quality = quality::wrong_spatial;
+                else
+                    myPoint.quality = quality::accepted;
+            }
+            else
+                myPoint.quality = quality::accepted;
+        }
+    }
+
+    for (int index : suspectIndex)
+    {
+        if (meteoPoints[unsigned(index)].quality == quality::wrong_spatial)
+            wrongIndex.push_back(index);
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief spatialQualityControl
+ * the residual of each station is compared with the variability of its neighbourhood,
+ * the suspect stations are checked again with the trend computed without them (checkSuspectPoints).
+ * Then the check is repeated incrementally: only the stations whose neighbourhood included
+ * a new wrong station are checked again, with the residuals of the last trend,
+ * until no new wrong station is found. Stations are processed in parallel
+ */
+bool spatialQualityControl(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
+                           Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                           Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime,
+                           bool isParallelComputing, std::string &errorStr)
+{
+    const int nrPointsMax = 10;
+    std::vector <Crit3DInterpolationDataPoint> myInterpolationPoints;
+
+    if (! passDataToInterpolation(meteoPoints, myInterpolationPoints, interpolationSettings))
+        return true;
+
+    // detrend
+    if (! preInterpolation(myInterpolationPoints, interpolationSettings, meteoSettings, climateParameters,
+                          meteoPoints, myVar, myTime, errorStr))
+    {
+        return false;
+    }
+
+    // compute residuals
+    if (! computeResiduals(myVar, meteoPoints, myInterpolationPoints, interpolationSettings, meteoSettings,
+                          false, false, isParallelComputing))
+    {
+        errorStr = "Error in compute residuals.";
+        return false;
+    }
+
+    std::vector <int> isSuspect(meteoPoints.size(), 0);
+    std::vector <std::vector<int>> neighbourIndex(meteoPoints.size());
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+    for (long i = 0; i < long(meteoPoints.size()); i++)
+    {
+        if (meteoPoints[i].quality != quality::accepted)
+            continue;
+
+        if (isSpatialSuspect(myVar, meteoPoints[i], myInterpolationPoints, interpolationSettings, meteoSettings,
+                             nrPointsMax, neighbourIndex[unsigned(i)]))
+            isSuspect[unsigned(i)] = 1;
+    }
+
+    std::vector <int> listIndex;
+    for (size_t i = 0; i < meteoPoints.size(); i++)
+    {
+        if (isSuspect[i])
+            listIndex.push_back(int(i));
+    }
+
+    std::vector <int> wrongIndex;
+    std::vector <int> isNewWrong(meteoPoints.size(), 0);
+
+    while (! listIndex.empty())
+    {
+        if (! checkSuspectPoints(listIndex, myVar, meteoPoints, myInterpolationPoints, interpolationSettings, meteoSettings,
+                                climateParameters, myTime, nrPointsMax, isParallelComputing, wrongIndex, errorStr))
         {
-            errorStr = "Error in compute residuals.";
             return false;
         }
 
+        // stations whose neighbourhood included a new wrong station
+        std::fill(isNewWrong.begin(), isNewWrong.end(), 0);
+        for (int index : wrongIndex)
+            isNewWrong[unsigned(index)] = 1;
+
+        std::vector <int> candidateIndex;
         for (size_t i = 0; i < meteoPoints.size(); i++)
         {
-            if (meteoPoints[i].quality == quality::accepted)
+            if (meteoPoints[i].quality != quality::accepted)
+                continue;
+
+            for (int index : neighbourIndex[i])
             {
-                int nrPointsMax = 10;
-                if (neighbourhoodVariability(myVar, myInterpolationPoints, interpolationSettings, float(meteoPoints[i].point.utm.x),
-                         float(meteoPoints[i].point.utm.y),float(meteoPoints[i].point.z),
-                         nrPointsMax, stdDev, avgDeltaZ, minDist))
+                if (index >= 0 && isNewWrong[unsigned(index)])
                 {
-                    myValue = meteoPoints[i].currentValue;
-                    myResidual = meteoPoints[i].residual;
-                    stdDev = MAXVALUE(stdDev, myValue/100.f);
-                    if (fabs(myResidual) > getSpatialThresholdVar(myVar, meteoSettings, myValue, stdDev, 2, avgDeltaZ, minDist))
-                    {
-                        listIndex.push_back(int(i));
-                        meteoPoints[i].quality = quality::wrong_spatial;
-                    }
+                    candidateIndex.push_back(int(i));
+                    break;
                 }
             }
         }
 
-        if (listIndex.size() > 0)
-        {
-            if (passDataToInterpolation(meteoPoints, myInterpolationPoints, interpolationSettings))
-            {
-                if (! preInterpolation(myInterpolationPoints, interpolationSettings, meteoSettings, climateParameters,
-                                      meteoPoints, myVar, myTime, errorStr))
-                {
-                    return false;
-                }
-
-                float interpolatedValue;
-                for (size_t i=0; i < listIndex.size(); i++)
-                {
-                    interpolatedValue = interpolate(myInterpolationPoints, interpolationSettings, meteoSettings, myVar,
-                                            float(meteoPoints[listIndex[i]].point.utm.x),
-                                            float(meteoPoints[listIndex[i]].point.utm.y),
-                                            float(meteoPoints[listIndex[i]].point.z),
-                                            meteoPoints[i].getProxyValues(),
-                                            false);
-
-                    myValue = meteoPoints[listIndex[i]].currentValue;
+        // check again the candidates with the last trend (the residual is computed as in computeResidual)
+        std::fill(isSuspect.begin(), isSuspect.end(), 0);
+        Crit3DInterpolationSettings localSettings = interpolationSettings;
+        localSettings.setParallelComputing(interpolationSettings.isParallelComputing() && ! isParallelComputing);
 
-                    listResiduals.push_back(interpolatedValue - myValue);
-                }
-
-                for (size_t i=0; i < listIndex.size(); i++)
-                {
-                    int nrPointsMax = 10;
-                    if (neighbourhoodVariability(myVar, myInterpolationPoints, interpolationSettings, float(meteoPoints[listIndex[i]].point.utm.x),
-                             float(meteoPoints[listIndex[i]].point.utm.y),
-                             float(meteoPoints[listIndex[i]].point.z),
-                             nrPointsMax, stdDev, avgDeltaZ, minDist))
-                    {
-                        myResidual = listResiduals[i];
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings)
+        for (long k = 0; k < long(candidateIndex.size()); k++)
+        {
+            unsigned i = unsigned(candidateIndex[unsigned(k)]);
+            meteoPoints[i].residual = computeResidual(myVar, meteoPoints[i], myInterpolationPoints, localSettings,
+                                                      meteoSettings, false, false);
 
-                        myValue = meteoPoints[listIndex[i]].currentValue;
+            if (isSpatialSuspect(myVar, meteoPoints[i], myInterpolationPoints, localSettings, meteoSettings,
+                                 nrPointsMax, neighbourIndex[i]))
+                isSuspect[i] = 1;
+        }
 
-                        if (fabs(myResidual) > getSpatialThresholdVar(myVar, meteoSettings, myValue, stdDev, 3, avgDeltaZ, minDist))
-                            meteoPoints[listIndex[i]].quality = quality::wrong_spatial;
-                        else
-                            meteoPoints[listIndex[i]].quality = quality::accepted;
-                    }
-                    else
-                        meteoPoints[listIndex[i]].quality = quality::accepted;
-                }
-            }
+        listIndex.clear();
+        for (int index : candidateIndex)
+        {
+            if (isSuspect[unsigned(index)])
+                listIndex.push_back(index);
         }
     }
 
@@ -434,7 +898,8 @@ bool spatialQualityControl(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &m
 
 bool checkData(Crit3DQuality* myQuality, meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
             const Crit3DTime &myTime, Crit3DInterpolationSettings &spatialQualityInterpolationSettings,
-            Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters, bool checkSpatial, std::string &errorStr)
+            Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters, bool checkSpatial,
+            bool isParallelComputing, std::string &errorStr)
 {
     if (meteoPoints.empty())
         return false;
@@ -478,7 +943,7 @@ bool checkData(Crit3DQuality* myQuality, meteoVariable myVar, std::vector<Crit3D
                          && myVar != windVectorDirection && myVar != dailyWindVectorDirectionPrevailing)
         {
             if (! spatialQualityControl(myVar, meteoPoints, spatialQualityInterpolationSettings,
-                                       meteoSettings, climateParameters, myTime, errorStr))
+                                       meteoSettings, climateParameters, myTime, isParallelComputing, errorStr))
             {
                 return false;
             }
@@ -494,10 +959,10 @@ bool checkAndPassDataToInterpolation(Crit3DQuality* myQuality, meteoVariable myV
                                      const Crit3DTime &myTime, Crit3DInterpolationSettings &SQinterpolationSettings,
                                      Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings *meteoSettings,
                                      Crit3DClimateParameters *climateParameters, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
-                                     bool checkSpatial, std::string &errorStr)
+                                     bool checkSpatial, bool isParallelComputing, std::string &errorStr)
 {
     if (! checkData(myQuality, myVar, meteoPoints, myTime, SQinterpolationSettings,
-                   meteoSettings, climateParameters, checkSpatial, errorStr))
+                   meteoSettings, climateParameters, checkSpatial, isParallelComputing, errorStr))
         return false;
 
     // return true if at least one valid data
@@ -16,13 +16,14 @@
 
 bool checkData(Crit3DQuality* myQuality, meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                const Crit3DTime &myTime, Crit3DInterpolationSettings &spatialQualityInterpolationSettings,
-               Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters, bool checkSpatial, std::string &errorStr);
+               Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters, bool checkSpatial,
+               bool isParallelComputing, std::string &errorStr);
 
 bool checkAndPassDataToInterpolation(Crit3DQuality* myQuality, meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                                      const Crit3DTime &myTime, Crit3DInterpolationSettings &SQinterpolationSettings,
                                      Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings *meteoSettings,
                                      Crit3DClimateParameters *climateParameters, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
-                                     bool checkSpatial, std::string &errorStr);
+                                     bool checkSpatial, bool isParallelComputing, std::string &errorStr);
 
     bool passDataToInterpolation(const std::vector<Crit3DMeteoPoint> &meteoPoints,
                                  std::vector<Crit3DInterpolationDataPoint> &myInterpolationPoints,
@@ -31,13 +32,19 @@ bool checkAndPassDataToInterpolation(Crit3DQuality* myQuality, meteoVariable myV
     bool computeResiduals(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                           const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                           Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
-                          bool excludeOutsideDem, bool excludeSupplemental);
+                          bool excludeOutsideDem, bool excludeSupplemental, bool isParallelComputing);
+
+    bool computeResidualsLeaveOneOut(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                     const std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
+                                     Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                     const gis::Crit3DRasterGrid* coarseDem,
+                                     bool excludeOutsideDem, bool excludeSupplemental, bool isParallelComputing);
 
     bool computeResidualsLocalDetrending(meteoVariable myVar, const Crit3DTime &myTime, std::vector<Crit3DMeteoPoint> &meteoPoints,
                                          std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                                          Crit3DInterpolationSettings &interpolationSettings,
                                          Crit3DMeteoSettings* meteoSettings, Crit3DClimateParameters* climateParameters,
-                                         bool excludeOutsideDem, bool excludeSupplemental);
+                                         bool excludeOutsideDem, bool excludeSupplemental, bool isParallelComputing);
 
     bool computeResidualsGlocalDetrending(meteoVariable myVar, const Crit3DMacroArea &myArea, int elevationPos,
                                           std::vector<Crit3DMeteoPoint> &meteoPoints, std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
@@ -46,9 +53,15 @@ bool checkAndPassDataToInterpolation(Crit3DQuality* myQuality, meteoVariable myV
 
     float computeErrorCrossValidation(const std::vector<Crit3DMeteoPoint> &meteoPoints);
 
+    float computeErrorCrossValidation(meteoVariable myVar, const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                      const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                      Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
+                                      bool excludeOutsideDem, bool excludeSupplemental, float maxError);
+
     bool spatialQualityControl(meteoVariable myVar, std::vector<Crit3DMeteoPoint> &meteoPoints,
                                Crit3DInterpolationSettings &interpolationSettings, Crit3DMeteoSettings* meteoSettings,
-                               Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime, std::string &errorStr);
+                               Crit3DClimateParameters* climateParameters, const Crit3DTime &myTime,
+                               bool isParallelComputing, std::string &errorStr);
 
     float getSpatialThresholdVar(meteoVariable myVar, Crit3DMeteoSettings* meteoSettings,
                                  float value, float stdDev, int nrStdDev, float avgDeltaZ, float minDistance);
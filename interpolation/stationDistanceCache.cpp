@@ -0,0 +1,148 @@
+/*!
+    \copyright 2016 Fausto Tomei, Gabriele Antolini,
+    Alberto Pistocchi, Marco Bittelli, Antonio Volta, Laura Costantini
+
+    This file is part of CRITERIA3D.
+    CRITERIA3D has been developed under contract issued by A.R.P.A. Emilia-Romagna
+
+    CRITERIA3D is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    CRITERIA3D is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with CRITERIA3D.  If not, see <http://www.gnu.org/licenses/>.
+
+    contacts:
+    fausto.tomei@gmail.com
+    ftomei@arpae.it
+*/
+
+
+#include <algorithm>
+
+#include "commonConstants.h"
+#include "gis.h"
+#include "interpolation.h"
+#include "stationDistanceCache.h"
+
+
+Crit3DStationDistanceCache::Crit3DStationDistanceCache()
+{
+    _meteoPoints = nullptr;
+}
+
+
+void Crit3DStationDistanceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _distances.reset();
+}
+
+
+/*!
+ * \brief setMeteoPoints
+ * the cache refers to a single list of meteo points (the meteo points of the project);
+ * other lists (e.g. subsets of a macro area) are not cached
+ */
+void Crit3DStationDistanceCache::setMeteoPoints(const std::vector<Crit3DMeteoPoint>* meteoPoints)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _meteoPoints = meteoPoints;
+    _distances.reset();
+}
+
+
+/*!
+ * \brief getDistances
+ * returns the distances between all the points of pointIndex (meteo points indices),
+ * the missing points are added to the cache. Returns nullptr if meteoPoints is not the cached list
+ */
+std::shared_ptr<const Crit3DStationDistances> Crit3DStationDistanceCache::getDistances(const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                                                                       const std::vector<int> &pointIndex,
+                                                                                       const Crit3DInterpolationSettings &interpolationSettings,
+                                                                                       bool isParallelComputing)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_meteoPoints != &meteoPoints || interpolationSettings.getCurrentDEM() == nullptr)
+        return nullptr;
+
+    // the meteo points list has changed
+    if (_distances != nullptr && _distances->position.size() != meteoPoints.size())
+        _distances.reset();
+
+    std::vector<int> newIndex;
+    for (int index : pointIndex)
+    {
+        if (index < 0 || index >= int(meteoPoints.size()))
+            return nullptr;
+
+        if (_distances == nullptr || _distances->position[unsigned(index)] == NODATA)
+            newIndex.push_back(index);
+    }
+
+    if (newIndex.empty())
+        return _distances;
+
+    std::sort(newIndex.begin(), newIndex.end());
+    newIndex.erase(std::unique(newIndex.begin(), newIndex.end()), newIndex.end());
+
+    // the new points are appended: the positions of the cached points do not change
+    std::shared_ptr<Crit3DStationDistances> distances = std::make_shared<Crit3DStationDistances>();
+    size_t nrOldPoints = 0;
+    if (_distances != nullptr)
+    {
+        distances->pointIndex = _distances->pointIndex;
+        nrOldPoints = _distances->getNrPoints();
+    }
+    distances->pointIndex.insert(distances->pointIndex.end(), newIndex.begin(), newIndex.end());
+
+    size_t nrPoints = distances->getNrPoints();
+    distances->position.assign(meteoPoints.size(), NODATA);
+    for (size_t i = 0; i < nrPoints; i++)
+        distances->position[unsigned(distances->pointIndex[i])] = int(i);
+
+    distances->distance.resize(nrPoints * nrPoints);
+    distances->topographicDistance.resize(nrPoints * nrPoints);
+
+    const Crit3DStationDistances* oldDistances = _distances.get();
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+    for (long t = 0; t < long(nrPoints); t++)
+    {
+        const Crit3DMeteoPoint &target = meteoPoints[unsigned(distances->pointIndex[t])];
+        float x = float(target.point.utm.x);
+        float y = float(target.point.utm.y);
+        float z = float(target.point.z);
+
+        for (size_t s = 0; s < nrPoints; s++)
+        {
+            size_t i = size_t(t) * nrPoints + s;
+
+            if (size_t(t) < nrOldPoints && s < nrOldPoints)
+            {
+                distances->distance[i] = oldDistances->distance[size_t(t) * nrOldPoints + s];
+                distances->topographicDistance[i] = oldDistances->topographicDistance[size_t(t) * nrOldPoints + s];
+                continue;
+            }
+
+            int sourceIndex = distances->pointIndex[s];
+            const Crit3DMeteoPoint &source = meteoPoints[unsigned(sourceIndex)];
+
+            float distance = gis::computeDistance(x, y, float(source.point.utm.x), float(source.point.utm.y));
+            distances->distance[i] = distance;
+            distances->topographicDistance[i] = getPointTopographicDistance(source.topographicDistance, sourceIndex, source.point,
+                                                                            x, y, z, distance, interpolationSettings);
+        }
+    }
+
+    _distances = distances;
+
+    return _distances;
+}
@@ -0,0 +1,60 @@
+#ifndef STATIONDISTANCECACHE_H
+#define STATIONDISTANCECACHE_H
+
+    #ifndef METEOPOINT_H
+        #include "meteoPoint.h"
+    #endif
+    #ifndef INTERPOLATIONSETTINGS_H
+        #include "interpolationSettings.h"
+    #endif
+
+    #include <memory>
+    #include <mutex>
+
+    /*!
+     * \brief The Crit3DStationDistances struct
+     * euclidean and topographic distances between meteo points, computed at the position of the target point
+     * (as computeDistances does for a station): [targetPosition * nrPoints + sourcePosition]
+     */
+    struct Crit3DStationDistances
+    {
+        std::vector<int> position;              // [meteo point index], NODATA if not cached
+        std::vector<int> pointIndex;            // [position]
+        std::vector<float> distance;
+        std::vector<float> topographicDistance;
+
+        size_t getNrPoints() const { return pointIndex.size(); }
+    };
+
+
+    /*!
+     * \brief The Crit3DStationDistanceCache class
+     * station to station distances of the meteo points of the project, computed once
+     * and extended when a new station set needs more points.
+     * The distances are shared read-only (shared_ptr): a thread can keep using its copy
+     * while another one extends the cache. Access is thread safe.
+     */
+    class Crit3DStationDistanceCache
+    {
+    private:
+        const std::vector<Crit3DMeteoPoint>* _meteoPoints;
+        std::shared_ptr<const Crit3DStationDistances> _distances;
+        std::mutex _mutex;
+
+    public:
+        Crit3DStationDistanceCache();
+
+        Crit3DStationDistanceCache(const Crit3DStationDistanceCache&) = delete;
+        Crit3DStationDistanceCache& operator = (const Crit3DStationDistanceCache&) = delete;
+
+        void clear();
+        void setMeteoPoints(const std::vector<Crit3DMeteoPoint>* meteoPoints);
+
+        std::shared_ptr<const Crit3DStationDistances> getDistances(const std::vector<Crit3DMeteoPoint> &meteoPoints,
+                                                                   const std::vector<int> &pointIndex,
+                                                                   const Crit3DInterpolationSettings &interpolationSettings,
+                                                                   bool isParallelComputing);
+    };
+
+
+#endif // STATIONDISTANCECACHE_H
@@ -180,7 +180,7 @@
     char* decimal_to_binary(unsigned int n, int nrBits)
     {
        int d, count;
-       char *pointer = new char[unsigned(nrBits)];
+       char *pointer = new char[unsigned(nrBits) + 1];
 
        count = 0;
        for (short c = short(nrBits-1); c >= 0 ; c--)
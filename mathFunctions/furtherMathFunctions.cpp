@@ -1350,182 +1350,611 @@ namespace interpolation
      */
 
     /*!
-     *      BEST FITTING MARQUARDT
+     *      TEMPLATED MARQUARDT CORE
+     *  the model is a functor known at compile time (no std::function dispatch),
+     *  the jacobian and the normal equations are computed in place in buffers allocated once.
+     *  The arithmetic is the same of the previous routines (equivalent results)
      */
 
-
-    /*! bestFittingMarquardt for ELEVATION
-     *  fitting with WEIGHTS (local detrending)
-     */
-    double bestFittingMarquardt_nDimension(double (*func)(double, std::vector<double>&),
-                                           int nrMinima,
-                                           std::vector <double>& parametersMin, std::vector <double>& parametersMax,
-                                           std::vector <double>& parameters, std::vector <double>& parametersDelta,
-                                           int maxIterationsNr, double myEpsilon, double deltaR2,
-                                           std::vector <double>& x ,std::vector<double>& y,
-                                           std::vector<double>& weights, std::vector<std::vector<double>> firstGuessCombinations)
+    namespace
     {
-        int i,j;
-        int nrData = int(y.size());
-        int nrParameters = int(parameters.size());
+        // known proxy functions
+        struct lapseRatePiecewiseTwoFunctor
+        {
+            double operator()(double x, std::vector<double>& par) const { return lapseRatePiecewise_two(x, par); }
+        };
 
-        std::vector <double> bestParameters(nrParameters);
+        struct lapseRatePiecewiseThreeFunctor
+        {
+            double operator()(double x, std::vector<double>& par) const { return lapseRatePiecewise_three(x, par); }
+        };
 
-        double bestR2 = NODATA;
-        double bestRMSE = NODATA;
-        int RMSEindex = NODATA;
-        double R2, RMSE;
-        std::vector <double> R2Previous(nrMinima,NODATA);
-        std::vector<double> ySim(nrData);
+        struct lapseRatePiecewiseThreeFreeFunctor
+        {
+            double operator()(double x, std::vector<double>& par) const { return lapseRatePiecewise_three_free(x, par); }
+        };
 
-        //grigliato
-        for (int k = 0; k < (int)firstGuessCombinations.size(); k++)
+        struct genericFunctor
         {
-            parameters = firstGuessCombinations[k];
-            fittingMarquardt_nDimension(func,parametersMin,
-                                        parametersMax,parameters,
-                                        parametersDelta,maxIterationsNr,
-                                        myEpsilon,x,y,weights);
+            double (*func)(double, std::vector<double>&);
+            double operator()(double x, std::vector<double>& par) const { return func(x, par); }
+        };
 
-            for (i=0;i<nrData;i++)
+        // sum of linear proxies (functionLinear, functionLinear_intercept)
+        struct linearSumFunctor
+        {
+            std::vector<bool> hasIntercept;
+            double operator()(std::vector<double>& x, std::vector<std::vector<double>>& par) const
             {
-                ySim[i]= func(x[i], parameters);
+                double result = 0.0;
+                for (size_t i = 0; i < hasIntercept.size(); i++)
+                {
+                    if (hasIntercept[i])
+                        result += par[i][0] * x[i] + par[i][1];
+                    else
+                        result += par[i][0] * x[i];
+                }
+                return result;
             }
-            R2 = computeWeighted_R2(y,ySim,weights);
-            RMSE = computeWeighted_RMSE(y, ySim, weights);
+        };
 
-            if (isEqual(bestRMSE, NODATA) || RMSE < bestRMSE)
+        struct genericSumFunctor
+        {
+            double (*func)(std::vector<std::function<double(double, std::vector<double>&)>>&, std::vector<double>&, std::vector <std::vector <double>>&);
+            std::vector<std::function<double(double, std::vector<double>&)>>* myFunc;
+            double operator()(std::vector<double>& x, std::vector<std::vector<double>>& par) const { return func(*myFunc, x, par); }
+        };
+
+
+        template <class F>
+        double weightedSSE(const F& func, std::vector<double>& parameters,
+                           const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>* weights)
+        {
+            double sse = 0;
+            for (size_t i = 0; i < y.size(); i++)
             {
-                bestRMSE = RMSE;
-                RMSEindex = k;
+                double error = y[i] - func(x[i], parameters);
+                if (weights == nullptr)
+                    sse += error * error;
+                else
+                    sse += error * error * (*weights)[i] * (*weights)[i];
             }
+            return sse;
+        }
+
+
+        /*!
+         * \brief fittingMarquardtCore
+         * one dimension (elevation) fitting, weights == nullptr means no weights
+         */
+        template <class F>
+        bool fittingMarquardtCore(const F& func, const std::vector<double> &parametersMin, const std::vector<double> &parametersMax,
+                                  std::vector<double> &parameters, const std::vector<double> &parametersDelta,
+                                  int maxIterationsNr, double myEpsilon,
+                                  const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>* weights)
+        {
+            const double VFACTOR = 10;
+            int nrParameters = int(parameters.size());
+            int nrData = int(y.size());
+            size_t n = size_t(nrData);
+
+            std::vector<double> paramChange(nrParameters, 0);
+            std::vector<double> newParameters(nrParameters, 0);
+            std::vector<double> lambda(nrParameters, 0.01);
+
+            std::vector<double> g(nrParameters);
+            std::vector<double> a(size_t(nrParameters) * size_t(nrParameters));
+            std::vector<double> firstEst(n);
+            std::vector<double> P(size_t(nrParameters) * n);                  // jacobian
+            std::vector<double> weightsP(size_t(nrParameters) * n);
+
+            double mySSE = weightedSSE(func, parameters, x, y, weights);
+            double diffSSE, newSSE;
 
-            if (isEqual(bestR2, NODATA) || R2 > (bestR2 + deltaR2))
+            int iterationNr = 0;
+            do
             {
-                for (j=0; j<nrParameters; j++)
+                std::fill(g.begin(), g.end(), 0.);
+                std::fill(a.begin(), a.end(), 0.);
+
+                for (int i = 0; i < nrData; i++)
+                    firstEst[i] = func(x[i], parameters);
+
+                for (int k = 0; k < nrParameters; k++)
                 {
-                    bestParameters[j] = parameters[j];
+                    double* Pk = &P[size_t(k) * n];
+                    parameters[k] += parametersDelta[k];
+                    for (int j = 0; j < nrData; j++)
+                        Pk[j] = (func(x[j], parameters) - firstEst[j]) / parametersDelta[k];
+                    parameters[k] -= parametersDelta[k];
+
+                    double* weightsPk = &weightsP[size_t(k) * n];
+                    for (int j = 0; j < nrData; j++)
+                        weightsPk[j] = (weights == nullptr ? Pk[j] : (*weights)[j] * Pk[j]);
                 }
-                bestR2 = R2;
-            }
-        }
 
-        for (j=0; j<nrParameters; j++)
-        {
-            parameters[j] = bestParameters[j];
-        }
+                for (int i = 0; i < nrParameters; i++)
+                {
+                    const double* Pi = &P[size_t(i) * n];
+                    for (int j = i; j < nrParameters; j++)
+                    {
+                        const double* weightsPj = &weightsP[size_t(j) * n];
+                        double sum = 0;
+                        for (int k = 0; k < nrData; k++)
+                            sum += Pi[k] * weightsPj[k];
+                        a[i * nrParameters + j] = sum;
+                    }
 
-        if (bestR2 < 0)
-        {
-            parameters = firstGuessCombinations[RMSEindex];
-            fittingMarquardt_nDimension(func,parametersMin,
-                                        parametersMax,parameters,
-                                        parametersDelta,maxIterationsNr,
-                                        myEpsilon,x,y,weights);
-        }
-        return bestR2;
-    }
+                    double sum = 0;
+                    for (int k = 0; k < nrData; k++)
+                    {
+                        if (weights == nullptr)
+                            sum += Pi[k] * (y[k] - firstEst[k]);
+                        else
+                            sum += Pi[k] * (*weights)[k] * (y[k] - firstEst[k]);
+                    }
+                    g[i] = sum;
+                }
 
+                for (int k = 0; k < nrParameters; k++)
+                {
+                    a[k * nrParameters + k] += lambda[k] * a[k * nrParameters + k];
+                    for (int j = k+1; j < nrParameters; j++)
+                        a[j * nrParameters + k] = a[k * nrParameters + j];
+                }
 
-    /*! bestFittingMarquardt for ELEVATION
-     *  fitting with NO weights (glocal and multiple detrending)
-     */
-    double bestFittingMarquardt_nDimension(double (*func)(double, std::vector<double>&),
-                                           int nrMinima,
-                                           std::vector <double>& parametersMin, std::vector <double>& parametersMax,
-                                           std::vector <double>& parameters, std::vector <double>& parametersDelta,
-                                           int maxIterationsNr, double myEpsilon, double deltaR2,
-                                           std::vector <double>& x ,std::vector<double>& y,
-                                           std::vector<std::vector<double>> firstGuessCombinations)
-    {
-        int nrData = int(y.size());
-        int nrParameters = int(parameters.size());
+                // linear system resolution by matrix inversion
+                for (int j = 0; j < (nrParameters - 1); j++)
+                {
+                    double pivot = std::max(a[j * nrParameters + j], EPSILON);
+                    for (int i = j + 1 ; i < nrParameters; i++)
+                    {
+                        double mult = a[i * nrParameters + j] / pivot;
+                        for (int k = j + 1; k < nrParameters; k++)
+                            a[i * nrParameters + k] -= mult * a[j * nrParameters + k];
+                        g[i] -= mult * g[j];
+                    }
+                }
 
-        std::vector <double> bestParameters(nrParameters);
+                int last = nrParameters - 1;
+                paramChange[last] = g[last] / std::max(a[last * nrParameters + last], EPSILON);
 
-        double bestR2 = NODATA;
-        double bestRMSE = NODATA;
-        int RMSEindex = NODATA;
-        double R2, RMSE;
-        std::vector<double> R2Previous(nrMinima, NODATA);
-        std::vector<double> ySim(nrData);
+                for (int i = nrParameters - 2; i >= 0; i--)
+                {
+                    double top = g[i];
+                    for (int k = i + 1; k < nrParameters; k++)
+                        top -= a[i * nrParameters + k] * paramChange[k];
+                    paramChange[i] = top / std::max(a[i * nrParameters + i], EPSILON);
+                }
+
+                // change parameters
+                for (int j = 0; j < nrParameters; j++)
+                {
+                    newParameters[j] = parameters[j] + paramChange[j];
+                    if ((newParameters[j] > parametersMax[j]) && (lambda[j] < 1000))
+                    {
+                        newParameters[j] = parametersMax[j];
+                        lambda[j] *= VFACTOR;
+                    }
+                    if (newParameters[j] < parametersMin[j])
+                    {
+                        newParameters[j] = parametersMin[j];
+                        if (lambda[j] < 1000)
+                            lambda[j] *= VFACTOR;
+                    }
+                }
 
-        double maxZ = x.front();
+                newSSE = weightedSSE(func, newParameters, x, y, weights);
 
-        for (size_t k = 0; k < x.size(); k++)
-        {
-            // search max elevation
-            if (x[k] > maxZ) maxZ = x[k];
+                if (newSSE == NODATA)
+                    return false;
+
+                diffSSE = mySSE - newSSE;
+
+                if (diffSSE > 0)
+                {
+                    mySSE = newSSE;
+                    for (int j = 0; j < nrParameters; j++)
+                    {
+                        parameters[j] = newParameters[j];
+                        lambda[j] /= VFACTOR;
+                    }
+                }
+                else
+                {
+                    for (int j = 0; j < nrParameters; j++)
+                        lambda[j] *= VFACTOR;
+                }
+                iterationNr++;
+            } while (fabs(diffSSE) > myEpsilon && iterationNr <= maxIterationsNr);
+
+            return (fabs(diffSSE) <= myEpsilon);
         }
 
-        bool isValid = true;
 
-        for (int k = 0; k < int(firstGuessCombinations.size()); k++)
+        /*!
+         * \brief bestFittingMarquardtCore
+         * one dimension (elevation) fitting from all the first guess combinations.
+         * The restarts are independent and run in parallel if isParallelComputing (the caller passes false
+         * when it is already inside a parallel loop), the best one is selected in the original order
+         */
+        template <class F>
+        double bestFittingMarquardtCore(const F& func, const std::vector<double>& parametersMin, const std::vector<double>& parametersMax,
+                                        std::vector<double>& parameters, const std::vector<double>& parametersDelta,
+                                        int maxIterationsNr, double myEpsilon, double deltaR2,
+                                        const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>* weights,
+                                        const std::vector<std::vector<double>>& firstGuessCombinations, bool isParallelComputing)
         {
-            parameters = firstGuessCombinations[k];
-            fittingMarquardt_nDimension(func,parametersMin,
-                                        parametersMax,parameters,
-                                        parametersDelta,maxIterationsNr,
-                                        myEpsilon,x,y);
+            int nrCombinations = int(firstGuessCombinations.size());
+            int nrData = int(y.size());
+            int nrParameters = int(parameters.size());
+
+            std::vector<std::vector<double>> fittedParameters(nrCombinations);
+            std::vector<bool> isInRange(nrCombinations, true);
+            std::vector<double> R2(nrCombinations, NODATA);
+            std::vector<double> RMSE(nrCombinations, NODATA);
 
-            bool rangeFlag = true;
-            for (size_t i=0; i < parameters.size(); i++)
+            #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
+            for (int k = 0; k < nrCombinations; k++)
             {
-                if (parameters[i] < parametersMin[i] || parameters[i] > parametersMax[i])
+                std::vector<double> &kParameters = fittedParameters[k];
+                kParameters = firstGuessCombinations[k];
+                fittingMarquardtCore(func, parametersMin, parametersMax, kParameters, parametersDelta,
+                                     maxIterationsNr, myEpsilon, x, y, weights);
+
+                // no weights: the parameters must be inside the range
+                if (weights == nullptr)
+                {
+                    for (size_t i = 0; i < kParameters.size(); i++)
+                    {
+                        if (kParameters[i] < parametersMin[i] || kParameters[i] > parametersMax[i])
+                        {
+                            isInRange[k] = false;
+                            break;
+                        }
+                    }
+                    if (! isInRange[k])
+                        continue;
+                }
+
+                std::vector<double> ySim(nrData);
+                for (int i = 0; i < nrData; i++)
+                    ySim[i] = func(x[i], kParameters);
+
+                if (weights == nullptr)
+                {
+                    R2[k] = computeR2adjusted(y, ySim);
+                    RMSE[k] = computeRMSE(y, ySim);
+                }
+                else
                 {
-                    rangeFlag = false;
-                    break;
+                    R2[k] = computeWeighted_R2(y, ySim, *weights);
+                    RMSE[k] = computeWeighted_RMSE(y, ySim, *weights);
                 }
             }
 
-            if (! rangeFlag)
-                continue;
+            double maxZ = x.empty() ? NODATA : *std::max_element(x.begin(), x.end());
+
+            std::vector<double> bestParameters(nrParameters);
+            double bestR2 = NODATA;
+            double bestRMSE = NODATA;
+            int RMSEindex = NODATA;
+            bool isValid = true;
 
-            for (int i=0; i < nrData; i++)
+            for (int k = 0; k < nrCombinations; k++)
             {
-                ySim[i]= func(x[i], parameters);
+                if (! isInRange[k])
+                    continue;
+
+                if (isEqual(bestRMSE, NODATA) || RMSE[k] < bestRMSE)
+                {
+                    bestRMSE = RMSE[k];
+                    RMSEindex = k;
+                }
+
+                if (weights == nullptr && fittedParameters[k].size() > 4)
+                {
+                    // double inversion only: check whether second inversion point is above last available station
+                    isValid = ((fittedParameters[k][0] + fittedParameters[k][2]) < maxZ);
+                }
+
+                if (isEqual(bestR2, NODATA) || (R2[k] > (bestR2 + deltaR2) && isValid))
+                {
+                    for (int j = 0; j < nrParameters; j++)
+                        bestParameters[j] = fittedParameters[k][j];
+                    bestR2 = R2[k];
+                }
             }
 
-            R2 = computeR2adjusted(y,ySim);
-            RMSE = computeRMSE(y, ySim);
+            for (int j = 0; j < nrParameters; j++)
+                parameters[j] = bestParameters[j];
 
-            if (isEqual(bestRMSE, NODATA) || RMSE < bestRMSE)
+            if (bestR2 < 0 && RMSEindex != NODATA)
             {
-                bestRMSE = RMSE;
-                RMSEindex = k;
+                parameters = firstGuessCombinations[RMSEindex];
+                fittingMarquardtCore(func, parametersMin, parametersMax, parameters, parametersDelta,
+                                     maxIterationsNr, myEpsilon, x, y, weights);
             }
 
-            if (parameters.size() > 4)
+            return bestR2;
+        }
+
+
+        /*!
+         * \brief fittingMarquardtCore_nDimension
+         * multiple proxies fitting with weights (predictors with two parameters)
+         */
+        template <class F>
+        bool fittingMarquardtCore_nDimension(const F& func,
+                                             const std::vector<std::vector<double>> &parametersMin, const std::vector<std::vector<double>> &parametersMax,
+                                             std::vector<std::vector<double>> &parameters, const std::vector<std::vector<double>> &parametersDelta,
+                                             const std::vector<std::vector<int>> &correspondenceParametersTag,
+                                             int maxIterationsNr, double myEpsilon,
+                                             std::vector<std::vector<double>>& x, const std::vector<double>& y,
+                                             const std::vector<double>& weights)
+        {
+            const double VFACTOR = 10;
+            int nrPredictors = 0;
+            for (size_t k = 0; k < parameters.size(); k++)
+                if (parameters[k].size() == 2) nrPredictors++;
+
+            int nrData = int(y.size());
+            size_t n = size_t(nrData);
+            std::vector<int> nrParameters(nrPredictors);
+            std::vector<std::vector<double>> paramChange(nrPredictors);
+            std::vector<std::vector<double>> newParameters(parameters);
+            std::vector<std::vector<double>> lambda(nrPredictors);
+
+            int nrParametersTotal = 0;
+            for (int i = 0; i < nrPredictors; i++)
             {
-                // double inversion only: check whether second inversion point is above last available station
-                isValid = ((parameters[0] + parameters[2]) < maxZ);
+                nrParameters[i] = int(parameters[i].size());
+                paramChange[i].resize(nrParameters[i]);
+                lambda[i].resize(nrParameters[i], 0.01);
+                nrParametersTotal += nrParameters[i];
             }
+            if (nrParametersTotal == 0)
+                return false;
 
-            if (isEqual(bestR2, NODATA) || (R2 > (bestR2 + deltaR2) && isValid))
+            int m = nrParametersTotal;
+            std::vector<double> g(m);
+            std::vector<double> a(size_t(m) * size_t(m));
+            std::vector<double> firstEst(n);
+            std::vector<double> P(size_t(m) * n);                           // jacobian
+            std::vector<double> weightsP(size_t(m) * n);
+
+            auto computeSSE = [&](std::vector<std::vector<double>>& par)
             {
-                for (int j=0; j < nrParameters; j++)
+                double sse = 0;
+                for (int i = 0; i < nrData; i++)
                 {
-                    bestParameters[j] = parameters[j];
+                    double error = y[i] - func(x[i], par);
+                    sse += error * error * weights[i] * weights[i];
                 }
-                bestR2 = R2;
-            }
+                return sse;
+            };
+
+            double mySSE = computeSSE(parameters);
+            double diffSSE, newSSE;
+
+            int iterationNr = 0;
+            do
+            {
+                std::fill(g.begin(), g.end(), 0.);
+                std::fill(a.begin(), a.end(), 0.);
+
+                for (int i = 0; i < nrData; i++)
+                    firstEst[i] = func(x[i], parameters);
+
+                int counterDim = 0;
+                for (int i = 0; i < nrPredictors; i++)
+                {
+                    for (int k = 0; k < nrParameters[i]; k++)
+                    {
+                        double* Pc = &P[size_t(counterDim) * n];
+                        double* weightsPc = &weightsP[size_t(counterDim) * n];
+                        parameters[i][k] += parametersDelta[i][k];
+                        for (int j = 0; j < nrData; j++)
+                        {
+                            Pc[j] = (func(x[j], parameters) - firstEst[j]) / parametersDelta[i][k];
+                            weightsPc[j] = weights[j] * Pc[j];
+                        }
+                        parameters[i][k] -= parametersDelta[i][k];
+                        counterDim++;
+                    }
+                }
+
+                for (int i = 0; i < m; i++)
+                {
+                    const double* Pi = &P[size_t(i) * n];
+                    for (int j = i; j < m; j++)
+                    {
+                        const double* weightsPj = &weightsP[size_t(j) * n];
+                        double sum = 0;
+                        for (int k = 0; k < nrData; k++)
+                            sum += Pi[k] * weightsPj[k];
+                        a[i * m + j] = sum;
+                    }
+
+                    double sum = 0;
+                    for (int k = 0; k < nrData; k++)
+                        sum += Pi[k] * weights[k] * (y[k] - firstEst[k]);
+                    g[i] = sum;
+                }
+
+                counterDim = 0;
+                for (int i = 0; i < nrPredictors; i++)
+                {
+                    for (int k = 0; k < nrParameters[i]; k++)
+                    {
+                        a[counterDim * m + counterDim] += lambda[i][k] * a[counterDim * m + counterDim];
+                        for (int j = counterDim+1; j < m; j++)
+                            a[j * m + counterDim] = a[counterDim * m + j];
+                        counterDim++;
+                    }
+                }
+
+                // linear system resolution by matrix inversion
+                for (int j = 0; j < (m - 1); j++)
+                {
+                    double pivot = a[j * m + j];
+                    for (int i = j + 1 ; i < m; i++)
+                    {
+                        double mult = a[i * m + j] / pivot;
+                        for (int k = j + 1; k < m; k++)
+                            a[i * m + k] -= mult * a[j * m + k];
+                        g[i] -= mult * g[j];
+                    }
+                }
+
+                paramChange[nrPredictors - 1][nrParameters[nrPredictors-1]-1] = g[m - 1] / a[(m - 1) * m + (m - 1)];
+
+                for (int i = m - 2; i >= 0; i--)
+                {
+                    double top = g[i];
+                    for (int k = i + 1; k < m; k++)
+                        top -= a[i * m + k] * paramChange[correspondenceParametersTag[0][k]][correspondenceParametersTag[1][k]];
+                    paramChange[correspondenceParametersTag[0][i]][correspondenceParametersTag[1][i]] = top / a[i * m + i];
+                }
+
+                // change parameters
+                for (int i = 0; i < nrPredictors; i++)
+                {
+                    for (int j = 0; j < nrParameters[i]; j++)
+                    {
+                        newParameters[i][j] = parameters[i][j] + paramChange[i][j];
+                        if ((newParameters[i][j] > parametersMax[i][j]) && (lambda[i][j] < 1000))
+                        {
+                            newParameters[i][j] = parametersMax[i][j];
+                            lambda[i][j] *= VFACTOR;
+                        }
+                        if (newParameters[i][j] < parametersMin[i][j])
+                        {
+                            newParameters[i][j] = parametersMin[i][j];
+                            if (lambda[i][j] < 1000)
+                                lambda[i][j] *= VFACTOR;
+                        }
+                    }
+                }
+
+                newSSE = computeSSE(newParameters);
+
+                if (newSSE == NODATA)
+                    return false;
+
+                diffSSE = mySSE - newSSE;
+
+                if (diffSSE > 0)
+                {
+                    mySSE = newSSE;
+                    for (int i = 0; i < nrPredictors; i++)
+                    {
+                        for (int j = 0; j < nrParameters[i]; j++)
+                        {
+                            parameters[i][j] = newParameters[i][j];
+                            lambda[i][j] /= VFACTOR;
+                        }
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < nrPredictors; i++)
+                        for (int j = 0; j < nrParameters[i]; j++)
+                            lambda[i][j] *= VFACTOR;
+                }
+                iterationNr++;
+            } while (fabs(diffSSE) > myEpsilon && iterationNr <= maxIterationsNr);
+
+            return (fabs(diffSSE) <= myEpsilon);
         }
 
-        for (int j=0; j<nrParameters; j++)
+
+        // compile time dispatch of the known elevation functions
+        template <class Fitting>
+        auto dispatchElevationFunction(double (*func)(double, std::vector<double>&), Fitting fitting)
         {
-            parameters[j] = bestParameters[j];
+            if (func == lapseRatePiecewise_two)
+                return fitting(lapseRatePiecewiseTwoFunctor());
+            if (func == lapseRatePiecewise_three)
+                return fitting(lapseRatePiecewiseThreeFunctor());
+            if (func == lapseRatePiecewise_three_free)
+                return fitting(lapseRatePiecewiseThreeFreeFunctor());
+
+            return fitting(genericFunctor{func});
         }
 
-        if (bestR2 < 0 && (RMSEindex != NODATA))
+        // compile time dispatch of the sum of linear proxies
+        bool getLinearSumFunctor(double (*func)(std::vector<std::function<double(double, std::vector<double>&)>>&, std::vector<double>&, std::vector <std::vector <double>>&),
+                                 std::vector<std::function<double(double, std::vector<double>&)>>& myFunc,
+                                 linearSumFunctor& linearSum)
         {
-            parameters = firstGuessCombinations[RMSEindex];
-            fittingMarquardt_nDimension(func,parametersMin,
-                                        parametersMax,parameters,
-                                        parametersDelta,maxIterationsNr,
-                                        myEpsilon,x,y);
+            if (func != functionSum)
+                return false;
+
+            linearSum.hasIntercept.resize(myFunc.size());
+            for (size_t i = 0; i < myFunc.size(); i++)
+            {
+                double (* const* target)(double, std::vector<double>&) = myFunc[i].target<double(*)(double, std::vector<double>&)>();
+                if (target == nullptr)
+                    return false;
+                if (*target == functionLinear_intercept)
+                    linearSum.hasIntercept[i] = true;
+                else if (*target == functionLinear)
+                    linearSum.hasIntercept[i] = false;
+                else
+                    return false;
+            }
+
+            return true;
         }
+    }
+
+
+    /*!
+     *      BEST FITTING MARQUARDT
+     */
+
 
-        return bestR2;
+    /*! bestFittingMarquardt for ELEVATION
+     *  fitting with WEIGHTS (local detrending)
+     */
+    double bestFittingMarquardt_nDimension(double (*func)(double, std::vector<double>&),
+                                           int nrMinima,
+                                           std::vector <double>& parametersMin, std::vector <double>& parametersMax,
+                                           std::vector <double>& parameters, std::vector <double>& parametersDelta,
+                                           int maxIterationsNr, double myEpsilon, double deltaR2,
+                                           std::vector <double>& x ,std::vector<double>& y,
+                                           std::vector<double>& weights, std::vector<std::vector<double>> firstGuessCombinations,
+                                           bool isParallelComputing)
+    {
+        (void) nrMinima;
+
+        return dispatchElevationFunction(func, [&](const auto& myFunc)
+        {
+            return bestFittingMarquardtCore(myFunc, parametersMin, parametersMax, parameters, parametersDelta,
+                                            maxIterationsNr, myEpsilon, deltaR2, x, y, &weights, firstGuessCombinations, isParallelComputing);
+        });
+    }
+
+
+    /*! bestFittingMarquardt for ELEVATION
+     *  fitting with NO weights (glocal and multiple detrending)
+     */
+    double bestFittingMarquardt_nDimension(double (*func)(double, std::vector<double>&),
+                                           int nrMinima,
+                                           std::vector <double>& parametersMin, std::vector <double>& parametersMax,
+                                           std::vector <double>& parameters, std::vector <double>& parametersDelta,
+                                           int maxIterationsNr, double myEpsilon, double deltaR2,
+                                           std::vector <double>& x ,std::vector<double>& y,
+                                           std::vector<std::vector<double>> firstGuessCombinations, bool isParallelComputing)
+    {
+        (void) nrMinima;
+
+        return dispatchElevationFunction(func, [&](const auto& myFunc)
+        {
+            return bestFittingMarquardtCore(myFunc, parametersMin, parametersMax, parameters, parametersDelta,
+                                            maxIterationsNr, myEpsilon, deltaR2, x, y, nullptr, firstGuessCombinations, isParallelComputing);
+        });
     }
 
 
@@ -1745,206 +2174,17 @@ namespace interpolation
                                      std::vector <std::vector <double>>& x, std::vector<double>& y,
                                      std::vector<double>& weights)
     {
-        int i;
-        int nrPredictors = 0;
-
-        for (int k = 0; k < (int)parameters.size(); k++)
-            if (parameters[k].size() == 2) nrPredictors++;
-        int nrData = int(y.size());
-        double mySSE, diffSSE, newSSE;
-        static double VFACTOR = 10;
-        std::vector <int> nrParameters(nrPredictors);
-        std::vector <std::vector <double>> paramChange(nrPredictors);
-        std::vector <std::vector <double>> newParameters(nrPredictors);
-        std::vector <std::vector <double>> lambda(nrPredictors);
-
-        for (i=0; i<nrPredictors;i++)
+        linearSumFunctor linearSum;
+        if (getLinearSumFunctor(func, myFunc, linearSum))
         {
-            nrParameters[i]= int(parameters[i].size());
-            paramChange[i].resize(nrParameters[i]);
-            newParameters[i].resize(nrParameters[i]);
-            lambda[i].resize(nrParameters[i],0.01);
+            return fittingMarquardtCore_nDimension(linearSum, parametersMin, parametersMax, parameters, parametersDelta,
+                                                   correspondenceParametersTag, maxIterationsNr, myEpsilon, x, y, weights);
         }
 
-        mySSE = normGeneric_nDimension(func,myFunc, parameters, x, y, weights);
-
-        int iterationNr = 0;
-        do
-        {
-            //least squares function
-            int i,j,k;
-            double pivot, mult, top;
-            int nrParametersTotal = 0;
-            std::vector <int> nrParameters(nrPredictors);
-            for (i=0; i<nrPredictors;i++)
-            {
-                nrParameters[i] = int(parameters[i].size());
-                nrParametersTotal += nrParameters[i];
-            }
-
-            std::vector<double> g(nrParametersTotal,0);
-            //std::vector<double> z(nrParametersTotal);
-            std::vector<double> firstEst(nrData);
-            std::vector<std::vector<double>> a(nrParametersTotal, std::vector<double>(nrParametersTotal,0));
-            std::vector<std::vector<double>> P(nrParametersTotal, std::vector<double>(nrData));
-            std::vector<std::vector<double>> weightsP(nrParametersTotal, std::vector<double>(nrData));
-
-            // matrix P corresponds to the Jacobian
-            // first set of estimates
-            for (i = 0; i < nrData; i++)
-            {
-                firstEst[i] = func(myFunc,x[i], parameters);
-            }
-
-            // change parameters and compute derivatives
-            int counterDim = 0;
-            //double newEst;
-            for (i = 0; i < nrPredictors; i++)
-            {
-                for (k=0;k<nrParameters[i];k++)
-                {
-                    parameters[i][k] += parametersDelta[i][k];
-                    for (j = 0; j < nrData; j++)
-                    {
-
-                        //newEst = func(myFunc,x[j], parameters);
-                        P[counterDim][j] = (func(myFunc,x[j], parameters) - firstEst[j]) / parametersDelta[i][k];
-                    }
-                    parameters[i][k] -= parametersDelta[i][k];
-                    counterDim++;
-                }
-            }
-
-            for (i = 0; i < nrParametersTotal; i++)
-            {
-                for (k = 0; k < nrData; k++)
-                {
-                    weightsP[i][k] = weights[k]*P[i][k];
-                }
-            }
-
-            for (i = 0; i < nrParametersTotal; i++)
-            {
-                for (j = i; j < nrParametersTotal; j++)
-                {
-                    //a[i][j] = 0;
-                    for (k = 0; k < nrData; k++)
-                    {
-                        a[i][j] += ((P[i][k] * weightsP[j][k]));
-                    }
-                }
-                //z[i] = sqrt(a[i][i]) + EPSILON; //?
-            }
-
-            for (i = 0; i < nrParametersTotal; i++)
-            {
-                //g[i] = 0.;
-                for (k = 0 ; k < nrData ; k++)
-                {
-                    g[i] += P[i][k] * weights[k]* (y[k] - firstEst[k]); // added the weights
-                }
-                //g[i] /= z[i];
-                //for (j = i; j < nrParametersTotal; j++)
-                //{
-                //a[i][j] /= (z[i] * z[j]);
-                //}
-            }
-            counterDim = 0;
-            for (i = 0; i < nrPredictors; i++)
-            {
-                for (k=0;k<nrParameters[i];k++)
-                {
-                    a[counterDim][counterDim] += lambda[i][k]*a[counterDim][counterDim];
-                    for (j = counterDim+1; j < nrParametersTotal; j++)
-                    {
-                        a[j][counterDim] = a[counterDim][j];
-                    }
-                    counterDim++;
-                }
-            }
-            // linear system resolution by matrix inversion
-
-            for (j = 0; j < (nrParametersTotal - 1); j++)
-            {
-                pivot = a[j][j];
-                for (i = j + 1 ; i < nrParametersTotal; i++)
-                {
-                    mult = a[i][j] / pivot;
-                    for (k = j + 1; k < nrParametersTotal; k++)
-                    {
-                        a[i][k] -= mult * a[j][k];
-                    }
-                    g[i] -= mult * g[j];
-                }
-            }
-
-
-            paramChange[nrPredictors - 1][nrParameters[nrPredictors-1]-1] = g[nrParametersTotal - 1] / a[nrParametersTotal - 1][nrParametersTotal - 1];
-
-
-            for (i = nrParametersTotal - 2; i >= 0; i--)
-            {
-                top = g[i];
-                for (k = i + 1; k < nrParametersTotal; k++)
-                {
-                    top -= a[i][k] * paramChange[correspondenceParametersTag[0][k]][correspondenceParametersTag[1][k]];
-                }
-                paramChange[correspondenceParametersTag[0][i]][correspondenceParametersTag[1][i]] = top / a[i][i];
-            }
-
-            // change parameters
-            for (i = 0; i < nrPredictors; i++)
-            {
-                for (j=0; j<nrParameters[i]; j++)
-                {
-                    newParameters[i][j] = parameters[i][j] + paramChange[i][j];
-                    if ((newParameters[i][j] > parametersMax[i][j]) && (lambda[i][j] < 1000))
-                    {
-                        newParameters[i][j] = parametersMax[i][j];
-                        if (lambda[i][j] < 1000)
-                            lambda[i][j] *= VFACTOR;
-                    }
-                    if (newParameters[i][j] < parametersMin[i][j])
-                    {
-                        newParameters[i][j] = parametersMin[i][j];
-                        if (lambda[i][j] < 1000)
-                            lambda[i][j] *= VFACTOR;
-                    }
-                }
-            }
-            newSSE = normGeneric_nDimension(func, myFunc, newParameters, x, y, weights);
-
-            if (newSSE == NODATA)
-                return false;
-
-            diffSSE = mySSE - newSSE ;
-
-            if (diffSSE > 0)
-            {
-                mySSE = newSSE;
-                for (i=0; i<nrPredictors; i++)
-                {
-                    for (j=0; j<nrParameters[i]; j++)
-                    {
-                        parameters[i][j] = newParameters[i][j];
-                        lambda[i][j] /= VFACTOR;
-                    }
-                }
-            }
-            else
-            {
-                for(i = 0; i < nrPredictors; i++)
-                {
-                    for (j=0; j<nrParameters[i]; j++)
-                    {
-                        lambda[i][j] *= VFACTOR;
-                    }
-                }
-            }
-            iterationNr++;
-        } while (fabs(diffSSE) > myEpsilon && iterationNr <= maxIterationsNr);
-        return (fabs(diffSSE) <= myEpsilon);
-    }
+        genericSumFunctor genericSum{func, &myFunc};
+        return fittingMarquardtCore_nDimension(genericSum, parametersMin, parametersMax, parameters, parametersDelta,
+                                               correspondenceParametersTag, maxIterationsNr, myEpsilon, x, y, weights);
+    }
 
 
     /*!
@@ -1958,163 +2198,11 @@ namespace interpolation
                                      std::vector <double>& x, std::vector<double>& y,
                                      std::vector<double>& weights)
     {
-        int i,j,k;
-        double mySSE, diffSSE, newSSE;
-        static double VFACTOR = 10;
-        int nrParameters = int(parameters.size());
-        std::vector <double> paramChange(nrParameters,0);
-        std::vector <double> newParameters(nrParameters,0);
-        std::vector <double> lambda (nrParameters,0.01);
-        int nrData = int(y.size());
-
-        double error = 0;
-        mySSE = 0;
-        for (i = 0; i < nrData; i++)
+        return dispatchElevationFunction(func, [&](const auto& myFunc)
         {
-            error = y[i] - func(x[i], parameters);
-            mySSE += error * error * weights[i] * weights[i];
-        }
-        int iterationNr = 0;
-        do
-        {
-            double pivot, mult, top;
-            std::vector<double> g(nrParameters,0);
-            std::vector<double> firstEst(nrData);
-            std::vector<std::vector<double>> a(nrParameters, std::vector<double>(nrParameters,0));
-            std::vector<std::vector<double>> P(nrParameters, std::vector<double>(nrData));
-            std::vector<std::vector<double>> weightsP(nrParameters, std::vector<double>(nrData));
-
-            // matrix P corresponds to the Jacobian
-            // first set of estimates
-            for (i = 0; i < nrData; i++)
-            {
-                firstEst[i] = func(x[i], parameters);
-            }
-
-            // change parameters and compute derivatives
-            for (k=0;k<nrParameters;k++)
-            {
-                parameters[k] += parametersDelta[k];
-                for (j = 0; j < nrData; j++)
-                {
-                    P[k][j] = (func(x[j], parameters) - firstEst[j]) / parametersDelta[k];
-                }
-                parameters[k] -= parametersDelta[k];
-            }
-
-            for (i = 0; i < nrParameters; i++)
-            {
-                for (k = 0; k < nrData; k++)
-                {
-                    weightsP[i][k] = weights[k]*P[i][k];
-                }
-            }
-
-            for (i = 0; i < nrParameters; i++)
-            {
-                for (j = i; j < nrParameters; j++)
-                {
-                    //a[i][j] = 0;
-                    for (k = 0; k < nrData; k++)
-                    {
-                        a[i][j] += ((P[i][k] * weightsP[j][k]));
-                    }
-                }
-            }
-
-            for (i = 0; i < nrParameters; i++)
-            {
-                //g[i] = 0.;
-                for (k = 0 ; k < nrData ; k++)
-                {
-                    g[i] += P[i][k] * weights[k]* (y[k] - firstEst[k]);
-                }
-            }
-            for (k=0;k<nrParameters;k++)
-            {
-                a[k][k] += lambda[k]*a[k][k];
-                for (j = k+1; j < nrParameters; j++)
-                {
-                    a[j][k] = a[k][j];
-                }
-            }
-            // linear system resolution by matrix inversion
-
-            for (j = 0; j < (nrParameters - 1); j++)
-            {
-                pivot = std::max(a[j][j],EPSILON);
-                for (i = j + 1 ; i < nrParameters; i++)
-                {
-                    mult = a[i][j] / pivot;
-                    for (k = j + 1; k < nrParameters; k++)
-                    {
-                        a[i][k] -= mult * a[j][k];
-                    }
-                    g[i] -= mult * g[j];
-                }
-            }
-
-            paramChange[nrParameters -1] = g[nrParameters - 1] / std::max(a[nrParameters - 1][nrParameters - 1], EPSILON);
-
-            for (i = nrParameters - 2; i >= 0; i--)
-            {
-                top = g[i];
-                for (k = i + 1; k < nrParameters; k++)
-                {
-                    top -= a[i][k] * paramChange[k];
-                }
-                paramChange[i] = top / std::max(a[i][i], EPSILON);
-            }
-
-            // change parameters
-            for (j=0; j<nrParameters; j++)
-            {
-                newParameters[j] = parameters[j] + paramChange[j];
-                if ((newParameters[j] > parametersMax[j]) && (lambda[j] < 1000))
-                {
-                    newParameters[j] = parametersMax[j];
-                    if (lambda[j] < 1000)
-                        lambda[j] *= VFACTOR;
-                }
-                if (newParameters[j] < parametersMin[j])
-                {
-                    newParameters[j] = parametersMin[j];
-                    if (lambda[j] < 1000)
-                        lambda[j] *= VFACTOR;
-                }
-            }
-
-            newSSE = 0;
-            for (i = 0; i < nrData; i++)
-            {
-                error = y[i] - func(x[i], newParameters);
-                newSSE += error * error * weights[i] * weights[i];
-            }
-
-            if (newSSE == NODATA)
-                return false;
-
-            diffSSE = mySSE - newSSE ;
-
-            if (diffSSE > 0)
-            {
-                mySSE = newSSE;
-                for (j=0; j<nrParameters; j++)
-                {
-                    parameters[j] = newParameters[j];
-                    lambda[j] /= VFACTOR;
-                }
-            }
-            else
-            {
-                for (j=0; j<nrParameters; j++)
-                {
-                    lambda[j] *= VFACTOR;
-                }
-            }
-            iterationNr++;
-        } while (fabs(diffSSE) > myEpsilon && iterationNr <= maxIterationsNr);
-        return (fabs(diffSSE) <= myEpsilon);
+            return fittingMarquardtCore(myFunc, parametersMin, parametersMax, parameters, parametersDelta,
+                                        maxIterationsNr, myEpsilon, x, y, &weights);
+        });
     }
 
 
@@ -2128,158 +2216,11 @@ namespace interpolation
                                      int maxIterationsNr, double myEpsilon,
                                      std::vector <double>& x, std::vector<double>& y)
     {
-        int i,j,k;
-        double mySSE, diffSSE, newSSE;
-        static double VFACTOR = 10;
-        int nrParameters = int(parameters.size());
-        std::vector <double> paramChange(nrParameters,0);
-        std::vector <double> newParameters(nrParameters,0);
-        std::vector <double> lambda (nrParameters,0.01);
-        int nrData = int(y.size());
-
-        double error = 0;
-        mySSE = 0;
-        for (i = 0; i < nrData; i++)
-        {
-            error = y[i] - func(x[i], parameters);
-            mySSE += error * error;
-        }
-        int iterationNr = 0;
-        double pivot, mult, top;
-        std::vector<double> firstEst(nrData);
-        std::vector<std::vector<double>> P(nrParameters, std::vector<double>(nrData));
-        do
+        return dispatchElevationFunction(func, [&](const auto& myFunc)
         {
-
-            std::vector<double> g(nrParameters,0);
-
-            std::vector<std::vector<double>> a(nrParameters, std::vector<double>(nrParameters,0));
-
-            //std::vector<std::vector<double>> weightsP(nrParameters, std::vector<double>(nrData));
-
-            // matrix P corresponds to the Jacobian
-            // first set of estimates
-            for (i = 0; i < nrData; i++)
-            {
-                firstEst[i] = func(x[i], parameters);
-            }
-
-            // change parameters and compute derivatives
-            for (k=0;k<nrParameters;k++)
-            {
-                parameters[k] += parametersDelta[k];
-                for (j = 0; j < nrData; j++)
-                {
-                    P[k][j] = (func(x[j], parameters) - firstEst[j]) / parametersDelta[k];
-                }
-                parameters[k] -= parametersDelta[k];
-            }
-
-            for (i = 0; i < nrParameters; i++)
-            {
-                for (j = i; j < nrParameters; j++)
-                {
-                    //a[i][j] = 0;
-                    for (k = 0; k < nrData; k++)
-                    {
-                        a[i][j] += ((P[i][k] * P[j][k]));
-                    }
-                }
-            }
-
-            for (i = 0; i < nrParameters; i++)
-            {
-                //g[i] = 0.;
-                for (k = 0 ; k < nrData ; k++)
-                {
-                    g[i] += P[i][k] * (y[k] - firstEst[k]);
-                }
-            }
-            for (k=0;k<nrParameters;k++)
-            {
-                a[k][k] += lambda[k]*a[k][k];
-                for (j = k+1; j < nrParameters; j++)
-                {
-                    a[j][k] = a[k][j];
-                }
-            }
-            // linear system resolution by matrix inversion
-
-            for (j = 0; j < (nrParameters - 1); j++)
-            {
-                pivot = std::max(a[j][j],EPSILON);
-                for (i = j + 1 ; i < nrParameters; i++)
-                {
-                    mult = a[i][j] / pivot;
-                    for (k = j + 1; k < nrParameters; k++)
-                    {
-                        a[i][k] -= mult * a[j][k];
-                    }
-                    g[i] -= mult * g[j];
-                }
-            }
-
-            paramChange[nrParameters -1] = g[nrParameters - 1] / std::max(a[nrParameters - 1][nrParameters - 1], EPSILON);
-
-            for (i = nrParameters - 2; i >= 0; i--)
-            {
-                top = g[i];
-                for (k = i + 1; k < nrParameters; k++)
-                {
-                    top -= a[i][k] * paramChange[k];
-                }
-                paramChange[i] = top / std::max(a[i][i], EPSILON);
-            }
-
-            // change parameters
-            for (j=0; j<nrParameters; j++)
-            {
-                newParameters[j] = parameters[j] + paramChange[j];
-                if ((newParameters[j] > parametersMax[j]) && (lambda[j] < 1000))
-                {
-                    newParameters[j] = parametersMax[j];
-                    if (lambda[j] < 1000)
-                        lambda[j] *= VFACTOR;
-                }
-                if (newParameters[j] < parametersMin[j])
-                {
-                    newParameters[j] = parametersMin[j];
-                    if (lambda[j] < 1000)
-                        lambda[j] *= VFACTOR;
-                }
-            }
-
-            newSSE = 0;
-            for (i = 0; i < nrData; i++)
-            {
-                error = y[i] - func(x[i], newParameters);
-                newSSE += error * error;
-            }
-
-            if (newSSE == NODATA)
-                return false;
-
-            diffSSE = mySSE - newSSE ;
-
-            if (diffSSE > 0)
-            {
-                mySSE = newSSE;
-                for (j=0; j<nrParameters; j++)
-                {
-                    parameters[j] = newParameters[j];
-                    lambda[j] /= VFACTOR;
-                }
-            }
-            else
-            {
-                for (j=0; j<nrParameters; j++)
-                {
-                    lambda[j] *= VFACTOR;
-                }
-            }
-            iterationNr++;
-        } while (fabs(diffSSE) > myEpsilon && iterationNr <= maxIterationsNr);
-        return (fabs(diffSSE) <= myEpsilon);
+            return fittingMarquardtCore(myFunc, parametersMin, parametersMax, parameters, parametersDelta,
+                                        maxIterationsNr, myEpsilon, x, y, nullptr);
+        });
     }
 
 
@@ -170,13 +170,14 @@ enum estimatedFunction {FUNCTION_CODE_SPHERICAL, FUNCTION_CODE_LINEAR, FUNCTION_
                                                std::vector <double>& parameters, std::vector <double>& parametersDelta,
                                                int maxIterationsNr, double myEpsilon, double deltaR2,
                                                std::vector <double>& x , std::vector<double>& y,
-                                               std::vector<double>& weights, std::vector<std::vector<double> > firstGuessCombinations);
+                                               std::vector<double>& weights, std::vector<std::vector<double> > firstGuessCombinations,
+                                               bool isParallelComputing);
         double bestFittingMarquardt_nDimension(double (*func)(double, std::vector<double>&), int nrMinima,
                                                std::vector <double>& parametersMin, std::vector <double>& parametersMax,
                                                std::vector <double>& parameters, std::vector <double>& parametersDelta,
                                                int maxIterationsNr, double myEpsilon, double deltaR2,
                                                std::vector <double>& x , std::vector<double>& y,
-                                               std::vector<std::vector<double> > firstGuessCombinations);
+                                               std::vector<std::vector<double> > firstGuessCombinations, bool isParallelComputing);
 
         double normGeneric_nDimension(double (*func)(std::vector<std::function<double (double, std::vector<double> &)>> &, std::vector<double> &, std::vector <std::vector <double>>&),
                                       std::vector<std::function<double (double, std::vector<double> &)> > myFunc,
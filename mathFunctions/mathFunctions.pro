@@ -27,6 +27,9 @@ win32:{
     TARGET = mathFunctions
 }
 
+# parallel computing settings
+include($$absolute_path(../parallel.pri))
+
 
 HEADERS += \
     commonConstants.h \
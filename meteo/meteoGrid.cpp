@@ -228,7 +228,7 @@ bool Crit3DMeteoGrid::createRasterGrid()
 }
 
 
-std::vector<std::vector<Crit3DMeteoPoint *> > Crit3DMeteoGrid::meteoPoints() const
+const std::vector<std::vector<Crit3DMeteoPoint *> >& Crit3DMeteoGrid::meteoPoints() const
 {
     return _meteoPoints;
 }
@@ -332,6 +332,49 @@ void Crit3DMeteoGrid::fillCurrentMonthlyValue(Crit3DDate date, meteoVariable var
             _meteoPoints[row][col]->currentValue = _meteoPoints[row][col]->getMeteoPointValueM(date, variable);
 }
 
+/*!
+ * \brief setCurrentValues
+ * write the values of the active cells (row-major order) as data of the variable and as current value
+ */
+void Crit3DMeteoGrid::setCurrentValues(const Crit3DTime &myTime, meteoVariable variable, frequencyType freq,
+                                       const std::vector<float> &values, bool isParallelComputing)
+{
+    int nrRows = _gridStructure.header().nrRows;
+    int nrCols = _gridStructure.header().nrCols;
+    if (values.size() != size_t(nrRows) * size_t(nrCols))
+        return;
+
+    #pragma omp parallel for if (isParallelComputing)
+    for (int row = 0; row < nrRows; row++)
+    {
+        for (int col = 0; col < nrCols; col++)
+        {
+            Crit3DMeteoPoint* myPoint = _meteoPoints[row][col];
+            if (! myPoint->active)
+                continue;
+
+            float value = values[size_t(row) * size_t(nrCols) + size_t(col)];
+
+            if (freq == hourly)
+            {
+                if (myPoint->nrObsDataDaysH == 0)
+                    myPoint->initializeObsDataH(1, 1, myTime.date);
+
+                myPoint->setMeteoPointValueH(myTime.date, myTime.getHour(), myTime.getMinutes(), variable, value);
+                myPoint->currentValue = value;
+            }
+            else if (freq == daily)
+            {
+                if (myPoint->nrObsDataDaysD == 0)
+                    myPoint->initializeObsDataD(1, myTime.date);
+
+                myPoint->setMeteoPointValueD(myTime.date, variable, value);
+                myPoint->currentValue = value;
+            }
+        }
+    }
+}
+
 void Crit3DMeteoGrid::fillMeteoRaster()
 {
     for (int i = 0; i < dataMeteoGrid.header->nrRows; i++)
@@ -540,13 +583,14 @@ bool Crit3DMeteoGrid::getIdFromLatLon(double lat, double lon, std::string* id)
     {
         if (_gridStructure.isUTM())
         {
+            double utmEasting;
+            double utmNorthing;
+            gis::latLonToUtmForceZone(_gisSettings.utmZone, lat, lon, &utmEasting, &utmNorthing);
+
             for (unsigned int row = 0; row < unsigned(_gridStructure.header().nrRows); row++)
             {
                 for (unsigned int col = 0; col < unsigned(_gridStructure.header().nrCols); col++)
                 {
-                    double utmEasting;
-                    double utmNorthing;
-                    gis::latLonToUtmForceZone(_gisSettings.utmZone, lat, lon, &utmEasting, &utmNorthing);
                     latitude = _meteoPoints[row][col]->point.utm.y;
                     longitude = _meteoPoints[row][col]->point.utm.x;
                     diffLat = fabs(utmNorthing-latitude);
@@ -1293,24 +1337,37 @@ void Crit3DMeteoGrid::saveRowColfromZone(gis::Crit3DRasterGrid* zoneGrid, std::v
     float value;
     double x, y;
     int myRow, myCol;
+    std::vector<double> utmX, utmY, lat, lon;
+    utmX.resize(unsigned(zoneGrid->header->nrCols));
+    utmY.resize(unsigned(zoneGrid->header->nrCols));
+    lat.resize(unsigned(zoneGrid->header->nrCols));
+    lon.resize(unsigned(zoneGrid->header->nrCols));
+
     for (int row = 0; row < zoneGrid->header->nrRows; row++)
     {
+        if (! _gridStructure.isUTM())
+        {
+            // batch conversion of the cell centers of the row
+            for (int col = 0; col < zoneGrid->header->nrCols; col++)
+            {
+                zoneGrid->getXY(row, col, utmX[unsigned(col)], utmY[unsigned(col)]);
+            }
+            gis::utmToLatLon(_gisSettings.utmZone, _gisSettings.startLocation.latitude, utmX.data(), utmY.data(),
+                             lat.data(), lon.data(), utmX.size(), false);
+        }
+
         for (int col = 0; col < zoneGrid->header->nrCols; col++)
         {
             value = zoneGrid->value[row][col];
             if (value != zoneGrid->header->flag)
             {
-                zoneGrid->getXY(row, col, x, y);
                 if (! _gridStructure.isUTM())
                 {
-                    double utmX = x;
-                    double utmY = y;
-                    double lat, lon;
-                    gis::getLatLonFromUtm(_gisSettings, utmX, utmY, &lat, &lon);
-                    gis::getRowColFromLonLat(_gridStructure.header(), lon, lat, &myRow, &myCol);
+                    gis::getRowColFromLonLat(_gridStructure.header(), lon[unsigned(col)], lat[unsigned(col)], &myRow, &myCol);
                 }
                 else
                 {
+                    zoneGrid->getXY(row, col, x, y);
                     dataMeteoGrid.getRowCol(x, y, myRow, myCol);
                 }
 
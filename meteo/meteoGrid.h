@@ -83,7 +83,7 @@
             Crit3DMeteoGridStructure gridStructure() const;
             void setGridStructure(const Crit3DMeteoGridStructure &gridStructure);
 
-            std::vector<std::vector<Crit3DMeteoPoint *>> meteoPoints() const;
+            const std::vector<std::vector<Crit3DMeteoPoint *>>& meteoPoints() const;
             void setMeteoPoints(const std::vector<std::vector<Crit3DMeteoPoint *> > &meteoPoints);
 
             Crit3DMeteoPoint& meteoPoint(unsigned row, unsigned col) const;
@@ -118,6 +118,8 @@
             void fillCurrentDailyValue(Crit3DDate date, meteoVariable variable, Crit3DMeteoSettings *meteoSettings);
             void fillCurrentHourlyValue(Crit3DDate date, int hour, int minute, meteoVariable variable);
             void fillCurrentMonthlyValue(Crit3DDate date, meteoVariable variable);
+            void setCurrentValues(const Crit3DTime &myTime, meteoVariable variable, frequencyType freq,
+                                  const std::vector<float> &values, bool isParallelComputing);
 
             bool findMeteoPointFromId(unsigned *row, unsigned *col, const std::string &code);
             bool existsMeteoPointFromId(const std::string& id);
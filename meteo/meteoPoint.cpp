@@ -1261,7 +1261,7 @@ float Crit3DMeteoPoint::getMeteoPointValue(const Crit3DTime& myTime, meteoVariab
         return NODATA;
 }
 
-float Crit3DMeteoPoint::getProxyValue(unsigned pos)
+float Crit3DMeteoPoint::getProxyValue(unsigned pos) const
 {
     if (pos < proxyValues.size())
         return proxyValues[pos];
@@ -1269,7 +1269,7 @@ float Crit3DMeteoPoint::getProxyValue(unsigned pos)
         return NODATA;
 }
 
-std::vector <double> Crit3DMeteoPoint::getProxyValues()
+std::vector <double> Crit3DMeteoPoint::getProxyValues() const
 {
     std::vector <double> myValues;
     for (unsigned int i=0; i < proxyValues.size(); i++)
@@ -167,8 +167,8 @@
             float getMeteoPointValueM(const Crit3DDate &myDate, meteoVariable myVar) const;
             bool setMeteoPointValueM(const Crit3DDate &myDate, meteoVariable myVar, float myValue);
 
-            float getProxyValue(unsigned pos);
-            std::vector<double> getProxyValues();
+            float getProxyValue(unsigned pos) const;
+            std::vector<double> getProxyValues() const;
 
             void setId(const std::string &myId) { id = myId; }
 
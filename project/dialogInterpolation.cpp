@@ -477,7 +477,8 @@ void ProxyDialog::selectGridFile()
     std::string errorStr;
     gis::Crit3DRasterGrid rasterGrid;
 
-    if (gis::openRaster(fileName, &rasterGrid, _project->gisSettings.utmZone, errorStr))
+    if (gis::openRaster(fileName, &rasterGrid, _project->gisSettings.utmZone,
+                        _project->isParallelComputing(), errorStr))
         _proxyGridName.setText(qFileName);
     else
     {
@@ -7,6 +7,7 @@
 #include "gis.h"
 #include "utilities.h"
 #include "interpolation.h"
+#include "proxyCube.h"
 #include "interpolationCmd.h"
 #include "interpolationSettings.h"
 
@@ -354,6 +355,22 @@ bool checkProxyGridSeries(Crit3DInterpolationSettings &interpolationSettings, co
 bool interpolationRaster(std::vector <Crit3DInterpolationDataPoint> &dataPoints, Crit3DInterpolationSettings &interpolationSettings,
                          Crit3DMeteoSettings* meteoSettings, gis::Crit3DRasterGrid* outputGrid,
                          gis::Crit3DRasterGrid& raster, meteoVariable variable, bool isParallelComputing)
+{
+    if (interpolationSettings.getMultiResolutionFactor() > 1
+        && ! interpolationSettings.getUseLocalDetrending() && ! interpolationSettings.getUseGlocalDetrending())
+    {
+        return interpolationRasterMultiResolution(dataPoints, interpolationSettings, meteoSettings, outputGrid,
+                                                  raster, variable, isParallelComputing);
+    }
+
+    return interpolationRasterDirect(dataPoints, interpolationSettings, meteoSettings, outputGrid,
+                                     raster, variable, isParallelComputing);
+}
+
+
+bool interpolationRasterDirect(std::vector <Crit3DInterpolationDataPoint> &dataPoints, Crit3DInterpolationSettings &interpolationSettings,
+                               Crit3DMeteoSettings* meteoSettings, gis::Crit3DRasterGrid* outputGrid,
+                               gis::Crit3DRasterGrid& raster, meteoVariable variable, bool isParallelComputing)
 {
     if (! outputGrid->initializeGrid(raster))
     {
@@ -369,6 +386,19 @@ bool interpolationRaster(std::vector <Crit3DInterpolationDataPoint> &dataPoints,
 
     std::vector<double> proxyValues(interpolationSettings.getProxyNr());
 
+    // proxy values sampled once on the output grid
+    bool isDetrending = getUseDetrendingVar(variable);
+    Crit3DProxyCube* proxyCube = interpolationSettings.getProxyCube();
+    std::vector<unsigned> proxyMask;
+    bool useProxyCube = false;
+    if (isDetrending && proxyCube != nullptr)
+    {
+        if (! proxyCube->isValid(*(outputGrid->header), interpolationSettings, isParallelComputing))
+            proxyCube->initialize(*(outputGrid->header), interpolationSettings, isParallelComputing);
+
+        useProxyCube = proxyCube->getProxyMask(interpolationSettings, false, proxyMask);
+    }
+
     #pragma omp parallel for if (isParallelComputing) firstprivate(proxyValues)
     for (long row = 0; row < outputGrid->header->nrRows ; row++)
     {
@@ -380,7 +410,11 @@ bool interpolationRaster(std::vector <Crit3DInterpolationDataPoint> &dataPoints,
                 float x, y;
                 gis::getUtmXYFromRowColSinglePrecision(*(outputGrid->header), row, col, &x, &y);
 
-                if (getUseDetrendingVar(variable))
+                if (useProxyCube)
+                {
+                    proxyCube->getProxyValues(row, col, proxyMask, proxyValues);
+                }
+                else if (isDetrending)
                 {
                     getProxyValuesXY(x, y, interpolationSettings, proxyValues);
                 }
@@ -391,11 +425,148 @@ bool interpolationRaster(std::vector <Crit3DInterpolationDataPoint> &dataPoints,
         }
     }
 
-    return gis::updateMinMaxRasterGrid(outputGrid);
+    return gis::updateMinMaxRasterGrid(outputGrid, isParallelComputing);
+}
+
+
+/*!
+ * \brief interpolationRasterMultiResolution
+ * two levels interpolation: the detrended residuals are interpolated on a coarse grid
+ * (cellSize * multiResolutionFactor), upsampled by bilinear interpolation on the output grid
+ * and retrended with the proxy values at full resolution.
+ * Cells without valid coarse neighbours are interpolated directly.
+ */
+bool interpolationRasterMultiResolution(std::vector <Crit3DInterpolationDataPoint> &dataPoints, Crit3DInterpolationSettings &interpolationSettings,
+                                        Crit3DMeteoSettings* meteoSettings, gis::Crit3DRasterGrid* outputGrid,
+                                        gis::Crit3DRasterGrid& raster, meteoVariable variable, bool isParallelComputing)
+{
+    if (! outputGrid->initializeGrid(raster))
+        return false;
+
+    gis::Crit3DRasterGrid coarseDem;
+    if (! gis::getDecimatedGrid(raster, interpolationSettings.getMultiResolutionFactor(), &coarseDem))
+        return false;
+
+    const gis::Crit3DRasterHeader& coarseHeader = *(coarseDem.header);
+    const float flag = outputGrid->header->flag;
+    bool isPrecipitationZero = (variable == precipitation || variable == dailyPrecipitation)
+                               && interpolationSettings.getPrecipitationAllZero();
+
+    // residuals on the coarse grid
+    gis::Crit3DRasterGrid coarseResidual;
+    coarseResidual.initializeGrid(coarseDem);
+
+    Crit3DInterpolationSettings localSettings = interpolationSettings;
+
+    if (! isPrecipitationZero)
+    {
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings)
+        for (long row = 0; row < coarseHeader.nrRows; row++)
+        {
+            for (long col = 0; col < coarseHeader.nrCols; col++)
+            {
+                float z = coarseDem.value[row][col];
+                if (isEqual(z, coarseHeader.flag))
+                    continue;
+
+                float x, y;
+                gis::getUtmXYFromRowColSinglePrecision(coarseHeader, row, col, &x, &y);
+                float residual = interpolateResidual(dataPoints, localSettings, variable, x, y, z, true);
+                if (! isEqual(residual, NODATA))
+                    coarseResidual.value[row][col] = residual;
+            }
+        }
+    }
+
+    // proxy values sampled once on the output grid
+    std::vector<double> proxyValues(interpolationSettings.getProxyNr());
+    bool isDetrending = getUseDetrendingVar(variable);
+    Crit3DProxyCube* proxyCube = interpolationSettings.getProxyCube();
+    std::vector<unsigned> proxyMask;
+    bool useProxyCube = false;
+    if (isDetrending && proxyCube != nullptr)
+    {
+        if (! proxyCube->isValid(*(outputGrid->header), interpolationSettings, isParallelComputing))
+            proxyCube->initialize(*(outputGrid->header), interpolationSettings, isParallelComputing);
+
+        useProxyCube = proxyCube->getProxyMask(interpolationSettings, false, proxyMask);
+    }
+
+    const double coarseTop = coarseHeader.llCorner.y + coarseHeader.nrRows * coarseHeader.cellSize;
+
+    #pragma omp parallel for schedule(dynamic) if (isParallelComputing) firstprivate(localSettings, proxyValues)
+    for (long row = 0; row < outputGrid->header->nrRows; row++)
+    {
+        for (long col = 0; col < outputGrid->header->nrCols; col++)
+        {
+            float z = raster.value[row][col];
+            if (isEqual(z, flag))
+                continue;
+
+            if (isPrecipitationZero)
+            {
+                outputGrid->value[row][col] = 0;
+                continue;
+            }
+
+            float x, y;
+            gis::getUtmXYFromRowColSinglePrecision(*(outputGrid->header), row, col, &x, &y);
+
+            // bilinear interpolation between the centers of the coarse cells
+            double coarseCol = (x - coarseHeader.llCorner.x) / coarseHeader.cellSize - 0.5;
+            double coarseRow = (coarseTop - y) / coarseHeader.cellSize - 0.5;
+            int col0 = int(floor(coarseCol));
+            int row0 = int(floor(coarseRow));
+            double dx = coarseCol - col0;
+            double dy = coarseRow - row0;
+
+            double sumValues = 0;
+            double sumWeights = 0;
+            for (int i = 0; i < 2; i++)
+            {
+                for (int j = 0; j < 2; j++)
+                {
+                    int r = row0 + i;
+                    int c = col0 + j;
+                    if (r < 0 || r >= coarseHeader.nrRows || c < 0 || c >= coarseHeader.nrCols)
+                        continue;
+
+                    float value = coarseResidual.value[r][c];
+                    if (isEqual(value, coarseHeader.flag))
+                        continue;
+
+                    double weight = (i == 0 ? 1 - dy : dy) * (j == 0 ? 1 - dx : dx);
+                    sumValues += weight * value;
+                    sumWeights += weight;
+                }
+            }
+
+            float residual;
+            if (sumWeights > EPSILON)
+                residual = float(sumValues / sumWeights);
+            else
+                residual = interpolateResidual(dataPoints, localSettings, variable, x, y, z, true);
+
+            if (useProxyCube)
+            {
+                proxyCube->getProxyValues(row, col, proxyMask, proxyValues);
+            }
+            else if (isDetrending)
+            {
+                getProxyValuesXY(x, y, localSettings, proxyValues);
+            }
+
+            outputGrid->value[row][col] = completeInterpolation(residual, localSettings, meteoSettings,
+                                                                variable, proxyValues);
+        }
+    }
+
+    return gis::updateMinMaxRasterGrid(outputGrid, isParallelComputing);
 }
 
 
-bool topographicIndex(const gis::Crit3DRasterGrid& DEM, std::vector <float> windowWidths, gis::Crit3DRasterGrid& outGrid)
+bool topographicIndex(const gis::Crit3DRasterGrid& DEM, std::vector <float> windowWidths, gis::Crit3DRasterGrid& outGrid,
+                      bool isParallelComputing)
 {
 
     if (! outGrid.initializeGrid(DEM))
@@ -406,78 +577,80 @@ bool topographicIndex(const gis::Crit3DRasterGrid& DEM, std::vector <float> wind
 
     float threshold = float(EPSILON);
 
-    float z, value, cellNr, cellDelta;
-    int r1, r2, c1, c2, windowRow, windowCol;
-    float higherSum, lowerSum, equalSum, weightSum;
-
     for (auto width : windowWidths)
     {
-        cellNr = round(width / DEM.header->cellSize);
+        float cellNr = round(width / DEM.header->cellSize);
+
+        // window cells and weights (the rank comparison with the central cell is not a window sum)
+        std::vector<int> windowRows, windowCols;
+        std::vector<float> windowWeights;
+        int maxDelta = int(cellNr);
+        for (int dRow = -maxDelta; dRow <= maxDelta; dRow++)
+        {
+            for (int dCol = -maxDelta; dCol <= maxDelta; dCol++)
+            {
+                if (dRow == 0 || dCol == 0)
+                    continue;
+
+                float cellDelta = gis::computeDistance(dRow, dCol, 0, 0);
+                if (cellDelta <= cellNr)
+                {
+                    windowRows.push_back(dRow);
+                    windowCols.push_back(dCol);
+                    windowWeights.push_back(1 - (cellDelta / cellNr));
+                }
+            }
+        }
 
+        #pragma omp parallel for schedule(dynamic) if (isParallelComputing)
         for (int row = 0; row < outGrid.header->nrRows ; row++)
         {
             for (int col = 0; col < outGrid.header->nrCols; col++)
             {
+                float z = DEM.value[row][col];
+                if (isEqual(z, DEM.header->flag))
+                    continue;
+
+                float higherSum = 0;
+                float lowerSum = 0;
+                float equalSum = 0;
+                float weightSum = 0;
 
-                z = DEM.value[row][col];
-                if (! isEqual(z, DEM.header->flag))
+                for (size_t i = 0; i < windowWeights.size(); i++)
                 {
-                    r1 = row - cellNr;
-                    r2 = row + cellNr;
-                    c1 = col - cellNr;
-                    c2 = col + cellNr;
+                    int windowRow = row + windowRows[i];
+                    int windowCol = col + windowCols[i];
+                    if (gis::isOutOfGridRowCol(windowRow, windowCol, DEM))
+                        continue;
 
-                    higherSum = 0;
-                    lowerSum = 0;
-                    equalSum = 0;
-                    weightSum = 0;
+                    float value = DEM.value[windowRow][windowCol];
+                    if (isEqual(value, DEM.header->flag))
+                        continue;
 
-                    for (windowRow = r1; windowRow <= r2; windowRow++)
-                    {
-                        for (windowCol = c1; windowCol <= c2; windowCol++)
-                        {
-                            if (! gis::isOutOfGridRowCol(windowRow, windowCol, DEM))
-                            {
-                                value = DEM.value[windowRow][windowCol];
-
-                                if (! isEqual(value, DEM.header->flag))
-                                {
-                                    if (windowRow != row && windowCol != col)
-                                    {
-                                        cellDelta = gis::computeDistance(windowRow, windowCol, row, col);
-
-                                        if (cellDelta <= cellNr)
-                                        {
-                                            float weight = 1 - (cellDelta / cellNr);
-
-                                            if (value - z > threshold)
-                                                higherSum += weight;
-                                            else if (value - z < -threshold)
-                                                lowerSum += weight;
-                                            else
-                                                equalSum += weight;
-
-                                            weightSum += weight;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
+                    float weight = windowWeights[i];
 
-                    if (weightSum > 0)
-                    {
-                        if (isEqual(outGrid.value[row][col], outGrid.header->flag))
-                            outGrid.value[row][col] = (lowerSum - higherSum - equalSum * 0.5) / weightSum;
-                        else
-                            outGrid.value[row][col] += (lowerSum - higherSum - equalSum * 0.5) / weightSum;
-                    }
+                    if (value - z > threshold)
+                        higherSum += weight;
+                    else if (value - z < -threshold)
+                        lowerSum += weight;
+                    else
+                        equalSum += weight;
+
+                    weightSum += weight;
+                }
+
+                if (weightSum > 0)
+                {
+                    if (isEqual(outGrid.value[row][col], outGrid.header->flag))
+                        outGrid.value[row][col] = (lowerSum - higherSum - equalSum * 0.5) / weightSum;
+                    else
+                        outGrid.value[row][col] += (lowerSum - higherSum - equalSum * 0.5) / weightSum;
                 }
             }
         }
     }
 
-    gis::updateMinMaxRasterGrid(&outGrid);
+    gis::updateMinMaxRasterGrid(&outGrid, isParallelComputing);
 
     return true;
 }
@@ -74,12 +74,21 @@
                              Crit3DMeteoSettings *meteoSettings, gis::Crit3DRasterGrid* outputGrid,
                              gis::Crit3DRasterGrid &raster, meteoVariable variable, bool isParallelComputing);
 
+    bool interpolationRasterDirect(std::vector <Crit3DInterpolationDataPoint> &dataPoints, Crit3DInterpolationSettings &interpolationSettings,
+                                   Crit3DMeteoSettings *meteoSettings, gis::Crit3DRasterGrid* outputGrid,
+                                   gis::Crit3DRasterGrid &raster, meteoVariable variable, bool isParallelComputing);
+
+    bool interpolationRasterMultiResolution(std::vector <Crit3DInterpolationDataPoint> &dataPoints, Crit3DInterpolationSettings &interpolationSettings,
+                                            Crit3DMeteoSettings *meteoSettings, gis::Crit3DRasterGrid* outputGrid,
+                                            gis::Crit3DRasterGrid &raster, meteoVariable variable, bool isParallelComputing);
+
     bool interpolateProxyGridSeries(const Crit3DProxyGridSeries& mySeries, QDate myDate, const gis::Crit3DRasterGrid& gridBase,
                                     gis::Crit3DRasterGrid *gridOut, QString &errorStr);
 
     bool modifiedInterpolateProxyGridSeries(const Crit3DProxyGridSeries& mySeries, QDate myDate, const gis::Crit3DRasterGrid& gridBase,
                                     gis::Crit3DRasterGrid *gridOut, QString &errorStr);
 
-    bool topographicIndex(const gis::Crit3DRasterGrid &DEM, std::vector <float> windowWidths, gis::Crit3DRasterGrid& outGrid);
+    bool topographicIndex(const gis::Crit3DRasterGrid &DEM, std::vector <float> windowWidths, gis::Crit3DRasterGrid& outGrid,
+                          bool isParallelComputing);
 
 #endif // INTERPOLATIONCMD_H
@@ -96,7 +96,7 @@ bool Crit3DDailyMeteoMaps::computeHSET0Map(gis::Crit3DGisSettings* gisSettings,
         }
     }
 
-    return gis::updateMinMaxRasterGrid(mapDailyET0HS);
+    return gis::updateMinMaxRasterGrid(mapDailyET0HS, false);
 }
 
 
@@ -267,7 +267,7 @@ bool Crit3DHourlyMeteoMaps::computeET0PMMap(const gis::Crit3DRasterGrid& DEM, Cr
             }
         }
 
-    return gis::updateMinMaxRasterGrid(this->mapHourlyET0);
+    return gis::updateMinMaxRasterGrid(this->mapHourlyET0, false);
 }
 
 
@@ -293,7 +293,7 @@ bool Crit3DHourlyMeteoMaps::computeLeafWetnessMap()
             }
         }
 
-    return gis::updateMinMaxRasterGrid(mapHourlyLeafW);
+    return gis::updateMinMaxRasterGrid(mapHourlyLeafW, false);
 }
 
 
@@ -317,7 +317,7 @@ bool Crit3DHourlyMeteoMaps::computeRelativeHumidityMap(gis::Crit3DRasterGrid* my
         }
     }
 
-    return gis::updateMinMaxRasterGrid(myRaster);
+    return gis::updateMinMaxRasterGrid(myRaster, false);
 }
 
 
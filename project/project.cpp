@@ -8,6 +8,11 @@
 #include "solarRadiation.h"
 #include "interpolationCmd.h"
 #include "interpolation.h"
+#include "interpolationCache.h"
+#include "resamplePlan.h"
+#include "summedAreaTable.h"
+#include "tiledRaster.h"
+#include "compressedRaster.h"
 #include "transmissivity.h"
 #include "utilities.h"
 #include "aggregation.h"
@@ -59,7 +64,10 @@ void Project::initializeProject()
     _projectName = "";
     _isProjectLoaded = false;
     _isRequestedExit = false;
-    _isParallelComputing = true;
+    setParallelComputing(true);
+    _topographicDistanceDecimation = 1;
+    _isCompressedRasterOutput = false;
+    _rasterQuantizationStep = 0;
     logFileName = "";
     errorString = "";
     errorType = ERROR_NONE;
@@ -772,12 +780,18 @@ bool Project::loadParameters(QString parametersFileName)
             if (parametersSettings->contains("min_points_local_detrending"))
                 interpolationSettings.setMinPointsLocalDetrending(parametersSettings->value("min_points_local_detrending").toInt());
 
+            if (parametersSettings->contains("multiResolutionFactor"))
+                interpolationSettings.setMultiResolutionFactor(parametersSettings->value("multiResolutionFactor").toInt());
+
             if (parametersSettings->contains("topographicDistanceMaxMultiplier"))
             {
                 interpolationSettings.setTopoDist_maxKh(parametersSettings->value("topographicDistanceMaxMultiplier").toInt());
                 qualityInterpolationSettings.setTopoDist_maxKh(parametersSettings->value("topographicDistanceMaxMultiplier").toInt());
             }
 
+            if (parametersSettings->contains("topographicDistanceDecimation"))
+                _topographicDistanceDecimation = std::max(1, parametersSettings->value("topographicDistanceDecimation").toInt());
+
             if (parametersSettings->contains("useDewPoint"))
                 interpolationSettings.setUseDewPoint(parametersSettings->value("useDewPoint").toBool());
 
@@ -1033,6 +1047,12 @@ void Project::clearMeteoPoints()
         }
     }
 
+    // the store is indexed by meteo point position
+    interpolationSettings.setTopographicDistanceStore(nullptr);
+    qualityInterpolationSettings.setTopographicDistanceStore(nullptr);
+    topographicDistanceStore.close();
+    stationDistanceCache.setMeteoPoints(nullptr);
+
     meteoPoints.clear();
 }
 
@@ -1097,7 +1117,7 @@ bool Project::loadDEM(const QString &fileName)
     QString completeFileName = getCompleteFileName(fileName, PATH_DEM);
 
     std::string errorStr;
-    bool isOk = gis::openRaster(completeFileName.toStdString(), &DEM, gisSettings.utmZone, errorStr);
+    bool isOk = gis::openRaster(completeFileName.toStdString(), &DEM, gisSettings.utmZone, isParallelComputing(), errorStr);
     closeLogInfo();
 
     if (! isOk)
@@ -1122,7 +1142,16 @@ bool Project::loadDEM(const QString &fileName)
     // initialize radiation maps (slope, aspect, lat/lon, transmissivity, etc.)
     if (radiationMaps != nullptr)
         radiationMaps->clear();
-    radiationMaps = new Crit3DRadiationMaps(DEM, gisSettings);
+    // the terrain cache is in the project folder (not next to the DEM)
+    QString terrainCacheFileName = "";
+    if (_projectPath != "")
+    {
+        QString terrainFolder = _projectPath + PATH_TERRAIN;
+        if (! QDir(terrainFolder).exists())
+            QDir().mkdir(terrainFolder);
+        terrainCacheFileName = terrainFolder + QFileInfo(completeFileName).completeBaseName() + ".terrain";
+    }
+    radiationMaps = new Crit3DRadiationMaps(DEM, gisSettings, terrainCacheFileName.toStdString(), _isParallelComputing);
 
     // initialize hourly meteo maps
     if (hourlyMeteoMaps != nullptr) hourlyMeteoMaps->clear();
@@ -1141,10 +1170,21 @@ bool Project::loadDEM(const QString &fileName)
     if (! updateProxy())
         return false;
 
-    // set interpolation settings DEM
+    // set interpolation settings DEM (the topographic distance store refers to the previous one)
+    interpolationSettings.setTopographicDistanceStore(nullptr);
+    qualityInterpolationSettings.setTopographicDistanceStore(nullptr);
+    topographicDistanceStore.close();
     interpolationSettings.setCurrentDEM(&DEM);
     qualityInterpolationSettings.setCurrentDEM(&DEM);
 
+    // proxy values on the DEM are sampled again at the first interpolation
+    proxyCube.clear();
+    interpolationSettings.setProxyCube(&proxyCube);
+
+    // station distances (topographic distance optimization) depend on the DEM
+    stationDistanceCache.clear();
+    interpolationSettings.setStationDistanceCache(&stationDistanceCache);
+
     // check points position with respect to DEM
     checkMeteoPointsDEM();
 
@@ -1240,6 +1280,7 @@ bool Project::loadMeteoPointsDB(QString fileName)
         checkMeteoPointsDEM();
     }
 
+    stationDistanceCache.setMeteoPoints(&meteoPoints);
     meteoPointsLoaded = true;
     logInfo("Meteo points DB = " + dbName);
 
@@ -1328,6 +1369,7 @@ bool Project::loadAggregationDBAsMeteoPoints(QString fileName)
         checkMeteoPointsDEM();
     }
 
+    stationDistanceCache.setMeteoPoints(&meteoPoints);
     meteoPointsLoaded = true;
     logInfo("Meteo points DB = " + dbName);
     closeLogInfo();
@@ -2208,10 +2250,21 @@ bool Project::loadProxyGrids()
                 return false;
             }*/
 
-            if (gis::readEsriGridFlt(fileName.toStdString(), proxyGrid, myError))
+            bool isLoaded;
+            if (fileName.endsWith(".tgr", Qt::CaseInsensitive))
+            {
+                // overview level at the DEM resolution: the proxy values are read on the DEM cells
+                double cellSize = DEM.isLoaded ? DEM.header->cellSize : 0;
+                isLoaded = gis::readTiledRaster(fileName.toStdString(), cellSize, proxyGrid, myError);
+            }
+            else
+                isLoaded = gis::readEsriGridFlt(fileName.toStdString(), proxyGrid, myError);
+
+            if (isLoaded)
             {
                 //cambiare
                 myProxy->setGrid(proxyGrid);
+                proxyCube.clear();
             }
             else
             {
@@ -2289,6 +2342,18 @@ bool Project::updateProxy()
 }
 
 bool Project::writeTopographicDistanceMaps(bool onlyWithData, bool showInfo)
+{
+    return writeTopographicDistanceMaps(onlyWithData, false, showInfo);
+}
+
+
+/*!
+ * \brief writeTopographicDistanceMaps
+ * compute the topographic distance maps of the active meteo points (only the points with data if onlyWithData)
+ * isStore: the maps are written in a single tiled file (see loadTopographicDistanceStore),
+ * otherwise in a ESRI grid for each point
+ */
+bool Project::writeTopographicDistanceMaps(bool onlyWithData, bool isStore, bool showInfo)
 {
     if (meteoPoints.size() == 0)
     {
@@ -2306,32 +2371,110 @@ bool Project::writeTopographicDistanceMaps(bool onlyWithData, bool showInfo)
     if (! QDir(mapsFolder).exists())
         QDir().mkdir(mapsFolder);
 
+    std::vector<bool> isSelected(meteoPoints.size(), false);
+    std::vector<int> pointList;
+    for (size_t i=0; i < meteoPoints.size(); i++)
+    {
+        if (!meteoPoints[i].active)
+            continue;
+
+        isSelected[i] = onlyWithData ? (meteoPointsDbHandler->existTable(meteoPoints[i], daily)
+                                        || meteoPointsDbHandler->existTable(meteoPoints[i], hourly))
+                                     : true;
+        if (isSelected[i])
+            pointList.push_back(int(i));
+    }
+
+    int nrPoints = int(pointList.size());
+    if (nrPoints == 0 && ! isStore)
+        return true;
+
+    // DEM of the sweep paths
+    gis::Crit3DRasterGrid sweepDem;
+    if (! gis::getDecimatedGrid(DEM, _topographicDistanceDecimation, &sweepDem))
+    {
+        logError("Wrong topographic distance decimation.");
+        return false;
+    }
+
+    std::string demName = QFileInfo(demFileName).baseName().toStdString();
+
+    if (isStore)
+    {
+        // all the meteo points are written (the store is indexed by position), only the selected ones are computed
+        std::vector<gis::Crit3DPoint> points(meteoPoints.size());
+        std::vector<std::string> pointIds(meteoPoints.size());
+        for (size_t i = 0; i < meteoPoints.size(); i++)
+        {
+            points[i] = meteoPoints[i].point;
+            pointIds[i] = meteoPoints[i].id;
+        }
+
+        if (showInfo)
+            setProgressBar("Computing topographic distance store...", 0);
+
+        // the old store is replaced: it must be opened again (see loadTopographicDistanceStore)
+        interpolationSettings.setTopographicDistanceStore(nullptr);
+        qualityInterpolationSettings.setTopographicDistanceStore(nullptr);
+        topographicDistanceStore.close();
+        stationDistanceCache.clear();
+
+        std::string fileName = mapsFolder.toStdString() + "TD_" + demName + ".tds";
+        std::string myError;
+        bool isOk = gis::writeTopographicDistanceStore(fileName, DEM, sweepDem, points, pointIds, isSelected,
+                                                       TD_STORE_TILESIZE, _isParallelComputing, myError);
+
+        if (showInfo)
+            closeProgressBar();
+
+        if (! isOk)
+        {
+            logError(QString::fromStdString(myError));
+            return false;
+        }
+
+        return true;
+    }
+
     QString infoStr = "Computing topographic distance maps...";
     int infoStep = 0;
     if (showInfo)
     {
-        infoStep = setProgressBar(infoStr, (int)meteoPoints.size());
+        infoStep = setProgressBar(infoStr, nrPoints);
     }
 
-    for (size_t i=0; i < meteoPoints.size(); i++)
-    {
-        if (showInfo && (i % infoStep == 0))
-            updateProgressBar(int(i));
+    int nrThreads = _isParallelComputing? std::min(omp_get_max_threads(), nrPoints) : 1;
+    std::vector<std::string> errorList(unsigned(nrPoints));
 
-        if (!meteoPoints[i].active)
-            continue;
+    #pragma omp parallel for schedule(dynamic) if(_isParallelComputing) num_threads(nrThreads)
+    for (int i = 0; i < nrPoints; i++)
+    {
+        int pointIndex = pointList[unsigned(i)];
+        gis::Crit3DRasterGrid myMap;
 
-        bool isSelected = onlyWithData ? (meteoPointsDbHandler->existTable(meteoPoints[i], daily)
-                                            || meteoPointsDbHandler->existTable(meteoPoints[i], hourly))
-                                       : true;
+        if (gis::topographicDistanceMapSweep(meteoPoints[pointIndex].point, DEM, sweepDem, &myMap))
+        {
+            std::string fileName = mapsFolder.toStdString() + "TD_" + demName + "_" + meteoPoints[pointIndex].id;
+            gis::writeEsriGrid(fileName, &myMap, errorList[unsigned(i)]);
+        }
 
-        if (isSelected && ! writeTopographicDistanceMap(int(i), DEM, mapsFolder))
-                return false;
+        // safe update
+        if (showInfo && omp_get_thread_num() == 0 && ((i*nrThreads) % infoStep) == 0)
+            updateProgressBar(i*nrThreads);
     }
 
     if(showInfo)
         closeProgressBar();
 
+    for (int i = 0; i < nrPoints; i++)
+    {
+        if (! errorList[unsigned(i)].empty())
+        {
+            logError(QString::fromStdString(errorList[unsigned(i)]));
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -2356,8 +2499,15 @@ bool Project::writeTopographicDistanceMap(int pointIndex, const gis::Crit3DRaste
     std::string myError;
     std::string fileName;
     gis::Crit3DRasterGrid myMap;
+    gis::Crit3DRasterGrid sweepDem;
+
+    if (! gis::getDecimatedGrid(demMap, _topographicDistanceDecimation, &sweepDem))
+    {
+        logError("Wrong topographic distance decimation.");
+        return false;
+    }
 
-    if (gis::topographicDistanceMap(meteoPoints[pointIndex].point, demMap, &myMap))
+    if (gis::topographicDistanceMapSweep(meteoPoints[pointIndex].point, demMap, sweepDem, &myMap))
     {
         fileName = pathTd.toStdString() + "TD_" + QFileInfo(demFileName).baseName().toStdString() + "_" + meteoPoints[pointIndex].id;
         if (! gis::writeEsriGrid(fileName, &myMap, myError))
@@ -2378,6 +2528,9 @@ bool Project::loadTopographicDistanceMaps(bool onlyWithData, bool showInfo)
         return false;
     }
 
+    // the station distances are read from the new maps
+    stationDistanceCache.clear();
+
     QString mapsFolder = _projectPath + PATH_TD;
     if (! QDir(mapsFolder).exists())
     {
@@ -2434,6 +2587,72 @@ bool Project::loadTopographicDistanceMaps(bool onlyWithData, bool showInfo)
 }
 
 
+/*!
+ * \brief loadTopographicDistanceStore
+ * open the topographic distance store of the current DEM (the tiles are loaded on demand).
+ * The store is created if missing or if it does not match the current meteo points
+ */
+bool Project::loadTopographicDistanceStore(bool onlyWithData, bool showInfo)
+{
+    if (meteoPoints.size() == 0)
+    {
+        logError(ERROR_STR_MISSING_DB);
+        return false;
+    }
+
+    if (! DEM.isLoaded)
+    {
+        logError(ERROR_STR_MISSING_DEM);
+        return false;
+    }
+
+    // the station distances are read from the new store
+    stationDistanceCache.clear();
+
+    QString fileName = _projectPath + PATH_TD + "TD_" + QFileInfo(demFileName).baseName() + ".tds";
+    std::string myError;
+
+    bool isUpdated = false;
+    if (QFile::exists(fileName) && topographicDistanceStore.open(fileName.toStdString(), myError))
+    {
+        const gis::Crit3DRasterHeader &header = topographicDistanceStore.getHeader();
+        isUpdated = (header == *(DEM.header) && topographicDistanceStore.getNrPoints() == int(meteoPoints.size()));
+
+        for (int i = 0; isUpdated && i < int(meteoPoints.size()); i++)
+        {
+            if (topographicDistanceStore.getPointId(i) != meteoPoints[unsigned(i)].id)
+                isUpdated = false;
+            else if (meteoPoints[unsigned(i)].active && ! topographicDistanceStore.isPointAvailable(i))
+            {
+                if (! onlyWithData || meteoPointsDbHandler->existTable(meteoPoints[unsigned(i)], daily)
+                                   || meteoPointsDbHandler->existTable(meteoPoints[unsigned(i)], hourly))
+                    isUpdated = false;
+            }
+        }
+    }
+
+    if (! isUpdated)
+    {
+        if (! writeTopographicDistanceMaps(onlyWithData, true, showInfo))
+            return false;
+
+        if (! topographicDistanceStore.open(fileName.toStdString(), myError))
+        {
+            logError(QString::fromStdString(myError));
+            return false;
+        }
+
+        if (showInfo)
+            logInfo(fileName + " successfully created!");
+    }
+
+    interpolationSettings.setTopographicDistanceStore(&topographicDistanceStore);
+    qualityInterpolationSettings.setTopographicDistanceStore(&topographicDistanceStore);
+
+    return true;
+}
+
+
 bool Project::writeGlocalWeightsMaps(float windowWidth)
 {
     //controlla se c'è mappa aree
@@ -2451,57 +2670,57 @@ bool Project::writeGlocalWeightsMaps(float windowWidth)
         QDir().mkdir(mapsFolder);
     }
 
-    std::vector<int> zoneCount(static_cast<std::size_t>(zoneGrid->maximum));
+    int nrZones = int(zoneGrid->maximum);
+    int nrRows = zoneGrid->header->nrRows;
+    int nrCols = zoneGrid->header->nrCols;
+
+    // circular window: each row is a span of the summed-area table
+    int cellNr = round(windowWidth / zoneGrid->header->cellSize);
+    std::vector<int> halfWidths;
+    gis::getCircularWindowWidths(float(cellNr), halfWidths);
 
     //create raster for each zone
-    std::vector <gis::Crit3DRasterGrid> zoneWeightMaps((unsigned int)(zoneGrid->maximum));
-    for (int i = 0; i < zoneGrid->maximum; i++)
+    std::vector <gis::Crit3DRasterGrid> zoneWeightMaps((unsigned int)(nrZones));
+    for (int i = 0; i < nrZones; i++)
         zoneWeightMaps[i].initializeGrid(*zoneGrid);
 
-    int cellNr = round(windowWidth / zoneGrid->header->cellSize);
+    // indicator of the zone (1/0, flag outside the zone grid): window sum = zone cells, count = valid cells
+    gis::Crit3DRasterGrid zoneIndicator;
+    zoneIndicator.initializeGrid(*zoneGrid);
+    gis::Crit3DSummedAreaTable zoneTable;
 
-    for (int zoneRow = 0; zoneRow < zoneGrid->header->nrRows; zoneRow++)
+    for (int i = 0; i < nrZones; i++)
     {
-        for (int zoneCol = 0; zoneCol < zoneGrid->header->nrCols; zoneCol++)
+        #pragma omp parallel for if (_isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
         {
-            if (isEqual(zoneGrid->value[zoneRow][zoneCol], zoneGrid->header->flag))
-                continue;
-
-            int cellCount = 0;
-
-            for (int j = 0; j < zoneGrid->maximum; j++)
-                zoneCount[j] = 0;
-
-            int r1 = zoneRow - cellNr;
-            int r2 = zoneRow + cellNr;
-            int c1 = zoneCol - cellNr;
-            int c2 = zoneCol + cellNr;
-
-            for(int windowRow = r1; windowRow <= r2; windowRow++)
+            for (int col = 0; col < nrCols; col++)
             {
-                for(int windowCol = c1; windowCol <= c2; windowCol++)
-                {
-                    if (gis::isOutOfGridRowCol(windowRow, windowCol, *zoneGrid))
-                        continue;
-
-                    int i = zoneGrid->value[windowRow][windowCol];
+                float zone = zoneGrid->value[row][col];
+                if (isEqual(zone, zoneGrid->header->flag))
+                    zoneIndicator.value[row][col] = zoneGrid->header->flag;
+                else
+                    zoneIndicator.value[row][col] = (int(zone) == i + 1) ? 1.f : 0.f;
+            }
+        }
 
-                    if (isEqual(i, zoneGrid->header->flag))
-                        continue;
+        zoneTable.initialize(zoneIndicator, _isParallelComputing);
 
-                    float cellDelta = gis::computeDistance(windowRow, windowCol, zoneRow, zoneCol);
+        #pragma omp parallel for schedule(dynamic) if (_isParallelComputing)
+        for (int row = 0; row < nrRows; row++)
+        {
+            double zoneCount;
+            long cellCount;
+            for (int col = 0; col < nrCols; col++)
+            {
+                if (isEqual(zoneGrid->value[row][col], zoneGrid->header->flag))
+                    continue;
 
-                    if (cellDelta <= cellNr)
-                    {
-                        cellCount++;
-                        zoneCount[i-1]++;
-                    }
-                }
-            }
+                zoneTable.getCircularWindow(row, col, halfWidths, zoneCount, cellCount);
 
-            for (int i = 0; i < zoneGrid->maximum; i++)
                 if (cellCount > 0)
-                    zoneWeightMaps[i].value[zoneRow][zoneCol] = float(zoneCount[i]) / float(cellCount);
+                    zoneWeightMaps[i].value[row][col] = float(zoneCount) / float(cellCount);
+            }
         }
     }
 
@@ -2889,6 +3108,11 @@ void Project::passGridTemperatureToHumidityPoints(Crit3DTime myTime, Crit3DMeteo
     }
 }
 
+/*!
+ * \brief interpolationOutputPoints
+ * interpolate a variable (already detrended) on the active output points inside outputGrid,
+ * points are processed in parallel (see interpolateTargetPoints)
+ */
 bool Project::interpolationOutputPoints(std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                                         gis::Crit3DRasterGrid *outputGrid, meteoVariable myVar)
 {
@@ -2905,32 +3129,336 @@ bool Project::interpolationOutputPoints(std::vector <Crit3DInterpolationDataPoin
     if (interpolationSettings.getUseMultipleDetrending())
         interpolationSettings.clearFitting();
 
-    std::vector <double> proxyValues;
-    proxyValues.resize(unsigned(interpolationSettings.getProxyNr()));
-
+    // active output points inside the grid
+    std::vector<unsigned> targetIndex;
+    std::vector<gis::Crit3DPoint> targetPoints;
     for (unsigned int i = 0; i < outputPoints.size(); i++)
     {
         if(!outputPoints[i].active)
             continue;
 
-        double x = outputPoints[i].utm.x;
-        double y = outputPoints[i].utm.y;
-        double z = outputPoints[i].z;
-
         int row, col;
-        outputGrid->getRowCol(x, y, row, col);
+        outputGrid->getRowCol(outputPoints[i].utm.x, outputPoints[i].utm.y, row, col);
         if (gis::isOutOfGridRowCol(row, col, *outputGrid))
             continue;
 
-        if (getUseDetrendingVar(myVar))
+        targetIndex.push_back(i);
+        targetPoints.push_back(outputPoints[i]);
+    }
+
+    if (targetPoints.empty())
+        return true;
+
+    size_t nrProxies = interpolationSettings.getProxyNr();
+    std::vector<double> targetProxyValues(targetPoints.size() * nrProxies, NODATA);
+    if (getUseDetrendingVar(myVar))
+    {
+        std::vector <double> proxyValues(nrProxies);
+        for (size_t i = 0; i < targetPoints.size(); i++)
         {
-            getProxyValuesXY(x, y, interpolationSettings, proxyValues);
+            getProxyValuesXY(float(targetPoints[i].utm.x), float(targetPoints[i].utm.y), interpolationSettings, proxyValues);
+            std::copy(proxyValues.begin(), proxyValues.end(), targetProxyValues.begin() + i * nrProxies);
         }
+    }
+
+    // a single variable: the neighbours are searched once anyway, no cache
+    std::vector<float> values;
+    interpolateTargetPoints(interpolationPoints, interpolationSettings, myVar, targetPoints, targetProxyValues, nullptr, values);
 
-        outputPoints[i].currentValue = interpolate(interpolationPoints, interpolationSettings,
-                                                    meteoSettings, myVar, x, y, z, proxyValues, true);
+    for (size_t i = 0; i < targetIndex.size(); i++)
+    {
+        gis::Crit3DOutputPoint &myPoint = outputPoints[targetIndex[i]];
+        myPoint.currentValue = values[i];
 
-        outputGrid->value[row][col] = outputPoints[i].currentValue;
+        int row, col;
+        outputGrid->getRowCol(myPoint.utm.x, myPoint.utm.y, row, col);
+        outputGrid->value[row][col] = myPoint.currentValue;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief interpolateTargetPoints
+ * interpolate the points (already detrended) on the target points, in parallel.
+ * The neighbours and weights of pointsCache are used if it is valid for these points and settings,
+ * otherwise each target point is interpolated from scratch.
+ * targetProxyValues: proxy values of the target points [point * nrProxies + proxy]
+ */
+void Project::interpolateTargetPoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                      Crit3DInterpolationSettings &mySettings, meteoVariable myVar,
+                                      const std::vector<gis::Crit3DPoint> &targetPoints, const std::vector<double> &targetProxyValues,
+                                      Crit3DInterpolationCache* pointsCache, std::vector<float> &values)
+{
+    if (pointsCache != nullptr && pointsCache->isValidPoints(interpolationPoints, mySettings, myVar, targetPoints.size()))
+    {
+        if (pointsCache->interpolatePoints(interpolationPoints, mySettings, meteoSettings, myVar, targetPoints,
+                                           targetProxyValues, values, _isParallelComputing))
+            return;
+    }
+
+    size_t nrProxies = mySettings.getProxyNr();
+    values.assign(targetPoints.size(), NODATA);
+    Crit3DInterpolationSettings localSettings = mySettings;
+    std::vector<double> proxyValues(nrProxies);
+
+    #pragma omp parallel for schedule(dynamic) if (_isParallelComputing) firstprivate(localSettings, proxyValues)
+    for (long i = 0; i < long(targetPoints.size()); i++)
+    {
+        std::copy(targetProxyValues.begin() + i * nrProxies, targetProxyValues.begin() + (i+1) * nrProxies, proxyValues.begin());
+        values[i] = interpolate(interpolationPoints, localSettings, meteoSettings, myVar,
+                                float(targetPoints[i].utm.x), float(targetPoints[i].utm.y),
+                                float(targetPoints[i].z), proxyValues, true);
+    }
+}
+
+
+/*!
+ * \brief interpolationOutputPointsVariables
+ * interpolate several variables on the output points at the same time step.
+ * Neighbour points and weights of each output point are computed once for all the variables
+ * with the same distance settings (idw: on the union of their stations, shepard: only for the same stations),
+ * points are processed in parallel.
+ * Solar radiation and local/glocal detrending use the path of interpolationDemMain.
+ * outputValues: [point * nrVariables + variable], NODATA for inactive points or outside the DEM
+ */
+bool Project::interpolationOutputPointsVariables(const std::vector<meteoVariable> &variables, const Crit3DTime &myTime,
+                                                 std::vector<float> &outputValues)
+{
+    if (! getComputeOnlyPoints()) return false;
+
+    if (outputPoints.empty())
+    {
+        errorString = "Missing output points.";
+        return false;
+    }
+
+    if (! DEM.isLoaded)
+    {
+        errorString = ERROR_STR_MISSING_DEM;
+        return false;
+    }
+
+    size_t nrVariables = variables.size();
+    outputValues.assign(outputPoints.size() * nrVariables, NODATA);
+
+    // active output points inside the DEM
+    std::vector<unsigned> targetIndex;
+    std::vector<gis::Crit3DPoint> targetPoints;
+    for (unsigned i = 0; i < outputPoints.size(); i++)
+    {
+        if (! outputPoints[i].active)
+            continue;
+
+        int row, col;
+        DEM.getRowCol(outputPoints[i].utm.x, outputPoints[i].utm.y, row, col);
+        if (gis::isOutOfGridRowCol(row, col, DEM))
+            continue;
+
+        targetIndex.push_back(i);
+        targetPoints.push_back(outputPoints[i]);
+    }
+
+    if (targetPoints.empty())
+        return true;
+
+    // values of all the loaded proxies, read once for all the variables
+    size_t nrProxies = interpolationSettings.getProxyNr();
+    std::vector<double> allProxyValues(targetPoints.size() * nrProxies, NODATA);
+    for (unsigned p = 0; p < nrProxies; p++)
+    {
+        gis::Crit3DRasterGrid* proxyGrid = interpolationSettings.getProxy(p)->getGrid();
+        if (proxyGrid == nullptr || ! proxyGrid->isLoaded)
+            continue;
+
+        #pragma omp parallel for if (_isParallelComputing)
+        for (long i = 0; i < long(targetPoints.size()); i++)
+        {
+            // single precision coordinates, as getProxyValuesXY
+            float value = gis::getValueFromXY(*proxyGrid, float(targetPoints[i].utm.x), float(targetPoints[i].utm.y));
+            if (! isEqual(value, proxyGrid->header->flag))
+                allProxyValues[i * nrProxies + p] = value;
+        }
+    }
+
+    // detrending of each variable
+    std::vector<bool> isBatch(nrVariables, false);
+    std::vector<Crit3DInterpolationSettings> varSettings(nrVariables);
+    std::vector<std::vector<Crit3DInterpolationDataPoint>> varPoints(nrVariables);
+    std::string errorStdStr;
+
+    // the topographic distance optimization (cached station distances) runs after, for all the variables together
+    std::vector<size_t> tdVariables;
+    std::vector<std::vector<int>> tdTargetIndex(nrVariables);
+    std::vector<std::vector<float>> tdTargetValue(nrVariables);
+
+    for (size_t v = 0; v < nrVariables; v++)
+    {
+        meteoVariable myVar = variables[v];
+        if (myVar == noMeteoVar)
+            continue;
+
+        bool isDetrending = getUseDetrendingVar(myVar);
+        if (myVar == globalIrradiance || (isDetrending && (interpolationSettings.getUseLocalDetrending()
+                                                         || interpolationSettings.getUseGlocalDetrending())))
+        {
+            for (size_t i = 0; i < outputPoints.size(); i++)
+                outputPoints[i].currentValue = NODATA;
+
+            gis::Crit3DRasterGrid myRaster;
+            if (interpolationDemMain(myVar, myTime, &myRaster))
+            {
+                for (size_t i = 0; i < targetIndex.size(); i++)
+                    outputValues[targetIndex[i] * nrVariables + v] = outputPoints[targetIndex[i]].currentValue;
+            }
+            continue;
+        }
+
+        if (interpolationSettings.getUseMultipleDetrending())
+            interpolationSettings.clearFitting();
+
+        if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime, qualityInterpolationSettings,
+                                              interpolationSettings, meteoSettings, &climateParameters, varPoints[v],
+                                              checkSpatialQuality, _isParallelComputing, errorStdStr))
+        {
+            logWarning("No data available: " + QString::fromStdString(getVariableString(myVar)));
+            continue;
+        }
+
+        bool isDeferredTD = (interpolationSettings.getUseTD() && getUseTdVar(myVar)
+                             && ! interpolationSettings.getUseBestDetrending()
+                             && interpolationSettings.getStationDistanceCache() != nullptr);
+
+        if (isDeferredTD)
+            interpolationSettings.setUseTD(false);
+
+        bool isOk = preInterpolation(varPoints[v], interpolationSettings, meteoSettings, &climateParameters,
+                                     meteoPoints, myVar, myTime, errorStdStr);
+
+        if (isDeferredTD)
+            interpolationSettings.setUseTD(true);
+
+        if (! isOk)
+        {
+            errorString = "Error in function preInterpolation:\n" + QString::fromStdString(errorStdStr);
+            return false;
+        }
+
+        varSettings[v] = interpolationSettings;
+        isBatch[v] = true;
+
+        if (isDeferredTD && ! (interpolationSettings.getPrecipitationAllZero()
+                               && (myVar == precipitation || myVar == dailyPrecipitation)))
+        {
+            getTopographicDistanceTargets(meteoPoints, interpolationSettings, tdTargetIndex[v], tdTargetValue[v]);
+            tdVariables.push_back(v);
+        }
+    }
+
+    if (! tdVariables.empty())
+    {
+        // station distances of all the variables, computed once
+        std::vector<int> pointIndex;
+        for (size_t v : tdVariables)
+        {
+            pointIndex.insert(pointIndex.end(), tdTargetIndex[v].begin(), tdTargetIndex[v].end());
+            for (size_t i = 0; i < varPoints[v].size(); i++)
+                pointIndex.push_back(varPoints[v][i].index);
+        }
+        stationDistanceCache.getDistances(meteoPoints, pointIndex, interpolationSettings, _isParallelComputing);
+
+        std::vector<int> isOptimized(tdVariables.size(), 0);
+
+        #pragma omp parallel for schedule(dynamic) if (_isParallelComputing)
+        for (long k = 0; k < long(tdVariables.size()); k++)
+        {
+            size_t v = tdVariables[k];
+            if (topographicDistanceOptimize(variables[v], meteoPoints, tdTargetIndex[v], tdTargetValue[v],
+                                            varPoints[v], varSettings[v], meteoSettings))
+                isOptimized[k] = 1;
+        }
+
+        for (size_t k = 0; k < tdVariables.size(); k++)
+        {
+            if (! isOptimized[k])
+                logWarning("Topographic distance not optimized: " + QString::fromStdString(getVariableString(variables[tdVariables[k]])));
+        }
+    }
+
+    // variables with the same distances share the neighbour points
+    std::vector<bool> isDone(nrVariables, false);
+    std::vector<double> proxyValues(targetPoints.size() * nrProxies);
+    std::vector<float> values;
+
+    for (size_t v = 0; v < nrVariables; v++)
+    {
+        if (! isBatch[v] || isDone[v])
+            continue;
+
+        Crit3DInterpolationSettings &settings = varSettings[v];
+        bool useTD = (settings.getUseTD() && getUseTdVar(variables[v]));
+
+        std::vector<size_t> group;
+        for (size_t w = v; w < nrVariables; w++)
+        {
+            if (! isBatch[w] || isDone[w])
+                continue;
+
+            bool useTD_w = (varSettings[w].getUseTD() && getUseTdVar(variables[w]));
+            if (varSettings[w].getInterpolationMethod() == settings.getInterpolationMethod()
+                && varSettings[w].getUseLapseRateCode() == settings.getUseLapseRateCode()
+                && useTD_w == useTD && (! useTD || varSettings[w].getTopoDist_Kh() == settings.getTopoDist_Kh())
+                && (settings.getInterpolationMethod() == idw || isSamePointList(varPoints[w], varPoints[v])))
+            {
+                group.push_back(w);
+                isDone[w] = true;
+            }
+        }
+
+        // union of the stations of the group (the same stations for shepard, whose neighbourhoods
+        // depend on the whole set of points)
+        std::vector<Crit3DInterpolationDataPoint> unionPoints;
+        std::vector<bool> isInUnion(meteoPoints.size(), false);
+        for (size_t w : group)
+        {
+            for (size_t i = 0; i < varPoints[w].size(); i++)
+            {
+                int index = varPoints[w][i].index;
+                if (index >= 0 && index < int(meteoPoints.size()) && ! isInUnion[unsigned(index)])
+                {
+                    unionPoints.push_back(varPoints[w][i]);
+                    isInUnion[unsigned(index)] = true;
+                }
+            }
+        }
+
+        Crit3DInterpolationCache pointsCache;
+        bool isCacheUsed = pointsCache.initializePoints(unionPoints, settings, variables[v], targetPoints, _isParallelComputing);
+
+        for (size_t w : group)
+        {
+            meteoVariable myVar = variables[w];
+            Crit3DProxyCombination myCombination = varSettings[w].getCurrentCombination();
+
+            // proxy values of the active proxies
+            for (size_t i = 0; i < targetPoints.size(); i++)
+            {
+                for (unsigned p = 0; p < nrProxies; p++)
+                {
+                    size_t k = i * nrProxies + p;
+                    proxyValues[k] = (getUseDetrendingVar(myVar) && myCombination.isProxyActive(p)) ? allProxyValues[k] : NODATA;
+                }
+            }
+
+            interpolateTargetPoints(varPoints[w], varSettings[w], myVar, targetPoints, proxyValues,
+                                    isCacheUsed ? &pointsCache : nullptr, values);
+
+            for (size_t i = 0; i < targetIndex.size(); i++)
+            {
+                outputValues[targetIndex[i] * nrVariables + w] = values[i];
+            }
+        }
     }
 
     return true;
@@ -3050,7 +3578,7 @@ bool Project::interpolationCv(meteoVariable myVar, const Crit3DTime& myTime)
     if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime,
                                          qualityInterpolationSettings, interpolationSettings, meteoSettings,
                                          &climateParameters, interpolationPoints,
-                                         checkSpatialQuality, errorStdStr))
+                                         checkSpatialQuality, _isParallelComputing, errorStdStr))
     {
         logError("No data available: " + QString::fromStdString(getVariableString(myVar)) + "\n" + QString::fromStdString(errorStdStr));
         return false;
@@ -3068,7 +3596,14 @@ bool Project::interpolationCv(meteoVariable myVar, const Crit3DTime& myTime)
 
     if (! interpolationSettings.getUseLocalDetrending() && ! interpolationSettings.getUseGlocalDetrending())
     {
-        if (! computeResiduals(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings, interpolationSettings.getUseExcludeStationsOutsideDEM(), true))
+        if (interpolationSettings.getMultiResolutionFactor() > 1)
+        {
+            // the maps use the two levels interpolation: both methods are validated
+            if (! computeMultiResolutionCrossValidation(myVar, myTime, interpolationPoints))
+                return false;
+        }
+        else if (! computeResidualsLeaveOneOut(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings,
+                                              nullptr, interpolationSettings.getUseExcludeStationsOutsideDEM(), true, _isParallelComputing))
             return false;
     }
     else if (interpolationSettings.getUseGlocalDetrending())
@@ -3097,7 +3632,7 @@ bool Project::interpolationCv(meteoVariable myVar, const Crit3DTime& myTime)
         }
 
         if (! computeResidualsLocalDetrending(myVar, myTime, meteoPoints, interpolationPoints,
-                                             interpolationSettings, meteoSettings, &climateParameters, true, true))
+                                             interpolationSettings, meteoSettings, &climateParameters, true, true, _isParallelComputing))
             return false;
     }
 
@@ -3110,6 +3645,101 @@ bool Project::interpolationCv(meteoVariable myVar, const Crit3DTime& myTime)
 
 
 
+/*!
+ * \brief interpolationMultiResolutionCheck
+ * leave-one-out cross validation of the two levels interpolation (multiResolutionFactor)
+ * and of the direct interpolation on the DEM, with the same stations and detrending.
+ * The statistics are saved in multiResolutionStatistics and crossValidationStatistics,
+ * the residuals of the meteo points are the ones of the direct interpolation
+ */
+bool Project::interpolationMultiResolutionCheck(meteoVariable myVar, const Crit3DTime& myTime)
+{
+    multiResolutionStatistics.initialize();
+
+    if (! checkInterpolation(myVar)) return false;
+
+    if (interpolationSettings.getMultiResolutionFactor() <= 1
+        || interpolationSettings.getUseLocalDetrending() || interpolationSettings.getUseGlocalDetrending())
+    {
+        logError("Multi resolution interpolation is not active (multiResolutionFactor > 1, no local or glocal detrending).");
+        return false;
+    }
+
+    std::vector <Crit3DInterpolationDataPoint> interpolationPoints;
+    std::string errorStdStr;
+
+    if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime,
+                                         qualityInterpolationSettings, interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
+                                         checkSpatialQuality, _isParallelComputing, errorStdStr))
+    {
+        logError("No data available: " + QString::fromStdString(getVariableString(myVar)) + "\n" + QString::fromStdString(errorStdStr));
+        return false;
+    }
+
+    if (interpolationSettings.getUseMultipleDetrending())
+        interpolationSettings.clearFitting();
+
+    if (! preInterpolation(interpolationPoints, interpolationSettings, meteoSettings,
+                         &climateParameters, meteoPoints, myVar, myTime, errorStdStr))
+    {
+        logError("Error in function preInterpolation:\n" + QString::fromStdString(errorStdStr));
+        return false;
+    }
+
+    return computeMultiResolutionCrossValidation(myVar, myTime, interpolationPoints);
+}
+
+
+/*!
+ * \brief computeMultiResolutionCrossValidation
+ * leave-one-out residuals of the two levels interpolation (multiResolutionStatistics)
+ * and then of the direct interpolation (meteo points residuals and crossValidationStatistics)
+ */
+bool Project::computeMultiResolutionCrossValidation(meteoVariable myVar, const Crit3DTime& myTime,
+                                                    const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints)
+{
+    gis::Crit3DRasterGrid coarseDem;
+    if (! gis::getDecimatedGrid(DEM, interpolationSettings.getMultiResolutionFactor(), &coarseDem))
+    {
+        logError("Wrong multi resolution factor.");
+        return false;
+    }
+
+    bool excludeOutsideDem = interpolationSettings.getUseExcludeStationsOutsideDEM();
+
+    if (! computeResidualsLeaveOneOut(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings,
+                                     &coarseDem, excludeOutsideDem, true, _isParallelComputing))
+        return false;
+
+    if (! computeStatisticsCrossValidation())
+        return false;
+
+    multiResolutionStatistics = crossValidationStatistics;
+    multiResolutionStatistics.setRefTime(myTime);
+
+    if (! computeResidualsLeaveOneOut(myVar, meteoPoints, interpolationPoints, interpolationSettings, meteoSettings,
+                                     nullptr, excludeOutsideDem, true, _isParallelComputing))
+        return false;
+
+    if (! computeStatisticsCrossValidation())
+        return false;
+
+    const Crit3DCrossValidationStatistics* cvStatistics[2] = {&crossValidationStatistics, &multiResolutionStatistics};
+    const QString methodName[2] = {"direct", "multi resolution (factor " + QString::number(interpolationSettings.getMultiResolutionFactor()) + ")"};
+    for (int i = 0; i < 2; i++)
+    {
+        logInfo("Cross validation of " + QString::fromStdString(getVariableString(myVar)) + ", " + methodName[i]
+                + ": MAE = " + QString::number(double(cvStatistics[i]->getMeanAbsoluteError()))
+                + " MBE = " + QString::number(double(cvStatistics[i]->getMeanBiasError()))
+                + " RMSE = " + QString::number(double(cvStatistics[i]->getRootMeanSquareError()))
+                + " NSE = " + QString::number(double(cvStatistics[i]->getNashSutcliffeEfficiency()))
+                + " R2 = " + QString::number(double(cvStatistics[i]->getR2())));
+    }
+
+    return true;
+}
+
+
 bool Project::interpolationDem(meteoVariable myVar, const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster)
 {
     std::vector <Crit3DInterpolationDataPoint> interpolationPoints;
@@ -3118,7 +3748,7 @@ bool Project::interpolationDem(meteoVariable myVar, const Crit3DTime& myTime, gi
     // check quality and pass data to interpolation
     if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime,
                                          qualityInterpolationSettings, interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
-                                         checkSpatialQuality, errorStdStr))
+                                         checkSpatialQuality, _isParallelComputing, errorStdStr))
     {
         errorString = "No data available: " + QString::fromStdString(getVariableString(myVar))
                       + "\n" + QString::fromStdString(errorStdStr);
@@ -3166,7 +3796,7 @@ bool Project::interpolationDemLocalDetrending(meteoVariable myVar, const Crit3DT
 
     if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime, qualityInterpolationSettings,
                                           interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
-                                            checkSpatialQuality, errorStdStr))
+                                            checkSpatialQuality, _isParallelComputing, errorStdStr))
     {
         errorString = "No data available: " + QString::fromStdString(getVariableString(myVar))
                       + "\n" + QString::fromStdString(errorStdStr);
@@ -3220,6 +3850,7 @@ bool Project::interpolationDemLocalDetrending(meteoVariable myVar, const Crit3DT
         }
 
         Crit3DInterpolationSettings myInterpolationSettings = interpolationSettings;
+        myInterpolationSettings.setParallelComputing(! _isParallelComputing);
         std::vector<double> proxyValues(myInterpolationSettings.getProxyNr());
 
         #pragma omp parallel for if(_isParallelComputing) firstprivate(myInterpolationSettings, proxyValues)
@@ -3254,7 +3885,7 @@ bool Project::interpolationDemLocalDetrending(meteoVariable myVar, const Crit3DT
             }
         }
 
-        if (! gis::updateMinMaxRasterGrid(myRaster))
+        if (! gis::updateMinMaxRasterGrid(myRaster, _isParallelComputing))
             return false;
     }
 
@@ -3275,7 +3906,7 @@ bool Project::interpolationDemGlocalDetrending(meteoVariable myVar, const Crit3D
 
     if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime, qualityInterpolationSettings,
                                             interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
-                                            checkSpatialQuality, errorStdStr))
+                                            checkSpatialQuality, _isParallelComputing, errorStdStr))
     {
         errorString = "No data available: " + QString::fromStdString(getVariableString(myVar))
                       + "\n" + QString::fromStdString(errorStdStr);
@@ -3310,74 +3941,104 @@ bool Project::interpolationDemGlocalDetrending(meteoVariable myVar, const Crit3D
             return false;
         }
 
-        //preparing to start a "global" interpolation for every single macro area
-        int elevationPos = NODATA;
-        for (unsigned int pos=0; pos < interpolationSettings.getCurrentCombination().getProxySize(); pos++)
+        // detrending of every single macro area (independent)
+        std::vector<Crit3DInterpolationSettings> areaSettings;
+        std::vector<std::vector<Crit3DInterpolationDataPoint>> areaPoints;
+        if (! glocalAreasDetrending(myVar, interpolationSettings, meteoSettings, meteoPoints, interpolationPoints,
+                                   false, _isParallelComputing, areaSettings, areaPoints))
         {
-            if (getProxyPragaName(interpolationSettings.getProxy(pos)->getName()) == proxyHeight)
-                elevationPos = pos;
+            errorString = "Error in glocal detrending of macro areas.";
+            return false;
         }
 
-        Crit3DInterpolationSettings myInterpolationSettings = interpolationSettings;
-        std::vector<double> proxyValues(myInterpolationSettings.getProxyNr());
+        // macro areas and weights of each cell
+        std::vector<unsigned> cellStart;
+        std::vector<int> cellArea;
+        std::vector<float> cellWeight;
+        getGlocalCellAreas(interpolationSettings, false, size_t(myHeader.nrRows) * size_t(myHeader.nrCols),
+                           cellStart, cellArea, cellWeight);
 
-        #pragma omp parallel for if (_isParallelComputing) firstprivate(myInterpolationSettings, proxyValues) shared(isOk)
-        for (int areaIndex = 0; areaIndex < myInterpolationSettings.getMacroAreasSize(); areaIndex++)
+        // significant proxies of each area
+        bool useProxyCube = false;
+        std::vector<std::vector<unsigned>> areaProxyMask(areaSettings.size());
+        Crit3DProxyCube* myProxyCube = interpolationSettings.getProxyCube();
+        if (myProxyCube != nullptr)
         {
-            if (!isOk)
-                continue;   // early skip if already failed
+            if (! myProxyCube->isValid(myHeader, interpolationSettings, _isParallelComputing))
+                myProxyCube->initialize(myHeader, interpolationSettings, _isParallelComputing);
 
-            // load macro area and its cells
-            Crit3DMacroArea macroArea = myInterpolationSettings.getMacroArea(areaIndex);
-            std::vector<float> areaCells = macroArea.getAreaCellsDEM();
-            std::vector<Crit3DInterpolationDataPoint> subsetInterpolationPoints;
-            double interpolatedValue = NODATA;
+            useProxyCube = true;
+            for (size_t i = 0; i < areaSettings.size(); i++)
+                useProxyCube = useProxyCube && myProxyCube->getProxyMask(areaSettings[i], true, areaProxyMask[i]);
+        }
 
-            if (areaCells.empty())
-                continue;
+        std::vector<double> proxyValues(interpolationSettings.getProxyNr());
 
-            macroAreaDetrending(macroArea, myVar, myInterpolationSettings, meteoSettings,
-                                meteoPoints, interpolationPoints, subsetInterpolationPoints, elevationPos);
+        // blend of the areas: single pass on the DEM
+        int isError = 0;
 
-            // calculate value for every cell
-            for (std::size_t cellIndex = 0; cellIndex < areaCells.size(); cellIndex = cellIndex + 2)
-            {
-                if (!isOk)
-                    break;   // early skip if already failed
+        #pragma omp parallel for schedule(dynamic) if (_isParallelComputing) firstprivate(areaSettings, proxyValues)
+        for (int row = 0; row < myHeader.nrRows; row++)
+        {
+            int isStopped;
+            #pragma omp atomic read
+            isStopped = isError;
+            if (isStopped)
+                continue;
 
-                int row = int(areaCells[cellIndex] / DEM.header->nrCols);
-                int col = int(areaCells[cellIndex]) % DEM.header->nrCols;
+            for (int col = 0; col < myHeader.nrCols; col++)
+            {
+                size_t cell = size_t(row) * size_t(myHeader.nrCols) + size_t(col);
+                if (cellStart[cell] == cellStart[cell + 1])
+                    continue;
 
                 float z = DEM.value[row][col];
-
                 if (isEqual(z, myHeader.flag))
                     continue;
 
                 double x, y;
                 gis::getUtmXYFromRowCol(myHeader, row, col, &x, &y);
 
-                if (! getSignificantProxyValuesXY(x, y, myInterpolationSettings, proxyValues))
+                float value = 0;
+                bool isValid = true;
+
+                for (unsigned k = cellStart[cell]; k < cellStart[cell + 1]; k++)
                 {
-                    myRaster->value[row][col] = NODATA;
-                    continue;
-                }
+                    int area = cellArea[k];
 
-                interpolatedValue = interpolate(subsetInterpolationPoints, myInterpolationSettings, meteoSettings,
-                                                myVar, x, y, z, proxyValues, true);
+                    bool isProxyComplete;
+                    if (useProxyCube)
+                        isProxyComplete = myProxyCube->getProxyValues(row, col, areaProxyMask[area], proxyValues);
+                    else
+                        isProxyComplete = getSignificantProxyValuesXY(x, y, areaSettings[area], proxyValues);
 
-                if (isEqual(interpolatedValue, NODATA))
-                    isOk = false; // cannot return directly; set flag instead
+                    if (! isProxyComplete)
+                    {
+                        isValid = false;
+                        break;
+                    }
 
-                // protect writes if same cell could be touched by multiple threads
-                #pragma omp critical
-                {
-                    if (isEqual(myRaster->value[row][col], NODATA))
-                        myRaster->value[row][col] = interpolatedValue * areaCells[cellIndex + 1];
-                    else
-                        myRaster->value[row][col] += interpolatedValue * areaCells[cellIndex + 1];
+                    double interpolatedValue = interpolate(areaPoints[area], areaSettings[area], meteoSettings,
+                                                           myVar, x, y, z, proxyValues, true);
+                    if (isEqual(interpolatedValue, NODATA))
+                    {
+                        #pragma omp atomic write
+                        isError = 1;
+                        isValid = false;
+                        break;
+                    }
+
+                    value += interpolatedValue * cellWeight[k];
                 }
+
+                if (isValid)
+                    myRaster->value[row][col] = value;
             }
         }
+
+        isOk = (isError == 0);
+        if (! isOk)
+            errorString = "Error in interpolation. Check the glocal related files, rewrite the weight maps, reload the project and try again.";
     }
 
     return isOk;
@@ -3419,7 +4080,7 @@ bool Project::interpolateDemRadiation(const Crit3DTime& myTime, gis::Crit3DRaste
     result = checkAndPassDataToInterpolation(quality, atmTransmissivity, meteoPoints,
                                           myTime, qualityInterpolationSettings, interpolationSettings,
                                           meteoSettings, &climateParameters,
-                                          interpolationPoints, checkSpatialQuality, errorStdStr);
+                                          interpolationPoints, checkSpatialQuality, _isParallelComputing, errorStdStr);
     if (! result)
     {
         logError("Error in function interpolateDemRadiation: not enough transmissivity data.");
@@ -3561,6 +4222,97 @@ bool Project::interpolationDemMain(meteoVariable myVar, const Crit3DTime& myTime
 }
 
 
+/*!
+ * \brief interpolationDemSeries
+ * interpolate on DEM all the time steps from firstTime to lastTime (hourly or daily, depending on the variable).
+ * Neighbour points and weights of the cells are computed once and reused for the steps with the same stations.
+ * Output maps are allocated here: the caller takes ownership
+ */
+bool Project::interpolationDemSeries(meteoVariable myVar, const Crit3DTime& firstTime, const Crit3DTime& lastTime,
+                                     std::vector<gis::Crit3DRasterGrid*> &rasterSeries)
+{
+    if (! checkInterpolation(myVar))
+        return false;
+
+    if (! checkGlocal(false)) return false;
+
+    int timeStep = 3600;
+    if (getVarFrequency(myVar) == daily)
+        timeStep = 86400;
+
+    // solar radiation and local/glocal detrending: each step is computed from scratch
+    bool isCacheUsed = (myVar != globalIrradiance && ! getComputeOnlyPoints());
+    if (getUseDetrendingVar(myVar) && (interpolationSettings.getUseLocalDetrending() || interpolationSettings.getUseGlocalDetrending()))
+        isCacheUsed = false;
+
+    Crit3DInterpolationCache interpolationCache;
+    std::string errorStdStr;
+
+    for (Crit3DTime myTime = firstTime; myTime <= lastTime; myTime = myTime.addSeconds(timeStep))
+    {
+        gis::Crit3DRasterGrid* myRaster = new gis::Crit3DRasterGrid();
+        rasterSeries.push_back(myRaster);
+
+        if (! isCacheUsed)
+        {
+            if (! interpolationDemMain(myVar, myTime, myRaster))
+                return false;
+
+            continue;
+        }
+
+        std::vector <Crit3DInterpolationDataPoint> interpolationPoints;
+
+        // check quality and pass data to interpolation
+        if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime,
+                                             qualityInterpolationSettings, interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
+                                             checkSpatialQuality, _isParallelComputing, errorStdStr))
+        {
+            errorString = "No data available: " + QString::fromStdString(getVariableString(myVar))
+                          + "\n" + QString::fromStdString(errorStdStr);
+            return false;
+        }
+
+        if (interpolationSettings.getUseMultipleDetrending())
+            interpolationSettings.clearFitting();
+
+        if (! preInterpolation(interpolationPoints, interpolationSettings, meteoSettings,
+                              &climateParameters, meteoPoints, myVar, myTime, errorStdStr))
+        {
+            errorString = "Error in function preInterpolation:\n" + QString::fromStdString(errorStdStr);
+            return false;
+        }
+
+        // new stations or changed settings: recompute the cache
+        if (! interpolationCache.isValid(interpolationPoints, interpolationSettings, myVar, DEM))
+        {
+            if (! interpolationCache.initialize(interpolationPoints, interpolationSettings, myVar, DEM, _isParallelComputing))
+            {
+                // cache not available (too many weights)
+                if (! interpolationRaster(interpolationPoints, interpolationSettings, meteoSettings, myRaster, DEM, myVar, _isParallelComputing))
+                {
+                    errorString = "Error in function interpolationRaster.";
+                    return false;
+                }
+
+                myRaster->setMapTime(myTime);
+                continue;
+            }
+        }
+
+        if (! interpolationCache.interpolateGrid(interpolationPoints, interpolationSettings, meteoSettings, myVar, *myRaster, _isParallelComputing))
+        {
+            errorString = "Error in function interpolateGrid.";
+            return false;
+        }
+
+        myRaster->setMapTime(myTime);
+    }
+
+    return true;
+}
+
+
 bool Project::meteoGridAggregateProxy(std::vector <gis::Crit3DRasterGrid*> &myGrids)
 {
     gis::Crit3DRasterGrid* proxyGrid;
@@ -3570,6 +4322,9 @@ bool Project::meteoGridAggregateProxy(std::vector <gis::Crit3DRasterGrid*> &myGr
     if (! meteoGridDbHandler->MeteoGridToRasterFlt(cellSize, gisSettings, meteoGridRaster))
         return false;
 
+    // proxy grids usually share the same header: the resampling plan is reused
+    gis::Crit3DResamplePlan resamplePlan;
+
     for (unsigned int i=0; i < interpolationSettings.getProxyNr(); i++)
     {
         if(!interpolationSettings.getCurrentCombination().isProxyActive(i))
@@ -3579,7 +4334,12 @@ bool Project::meteoGridAggregateProxy(std::vector <gis::Crit3DRasterGrid*> &myGr
 
         proxyGrid = interpolationSettings.getProxy(i)->getGrid();
         if (proxyGrid != nullptr && proxyGrid->isLoaded)
-            gis::resampleGrid(*proxyGrid, myGrid, meteoGridRaster.header, aggrAverage, 0);
+        {
+            if (! resamplePlan.isCompatible(*(proxyGrid->header), *(meteoGridRaster.header)))
+                resamplePlan.initialize(*(proxyGrid->header), *(meteoGridRaster.header));
+
+            resamplePlan.apply(*proxyGrid, *myGrid, aggrAverage, 0, isParallelComputing());
+        }
 
         myGrids.push_back(myGrid);
     }
@@ -3602,7 +4362,7 @@ bool Project::interpolationGrid(meteoVariable myVar, const Crit3DTime& myTime)
     // check quality and pass data to interpolation
     if (! checkAndPassDataToInterpolation(quality, myVar, meteoPoints, myTime, qualityInterpolationSettings,
                                           interpolationSettings, meteoSettings, &climateParameters, interpolationPoints,
-                                          checkSpatialQuality, errorStdStr))
+                                          checkSpatialQuality, _isParallelComputing, errorStdStr))
     {
         logError("No data available: " + QString::fromStdString(getVariableString(myVar)));
         return false;
@@ -3633,227 +4393,198 @@ bool Project::interpolationGrid(meteoVariable myVar, const Crit3DTime& myTime)
 
     frequencyType freq = getVarFrequency(myVar);
 
-    float myX, myY, myZ;
     std::vector <double> proxyValues;
     proxyValues.resize(unsigned(interpolationSettings.getProxyNr()));
 
-    float interpolatedValue = NODATA;
-    unsigned int i, proxyIndex;
-
     if (! interpolationSettings.getUseGlocalDetrending())
     {
-        for (unsigned col = 0; col < unsigned(meteoGridDbHandler->meteoGrid()->gridStructure().header().nrCols); col++)
-        {
-            for (unsigned row = 0; row < unsigned(meteoGridDbHandler->meteoGrid()->gridStructure().header().nrRows); row++)
-            {
-                if(!meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->active)
-                    continue;
+        const std::vector<std::vector<Crit3DMeteoPoint*>> &gridPoints = meteoGridDbHandler->meteoGrid()->meteoPoints();
+        int nrRows = meteoGridDbHandler->meteoGrid()->gridStructure().header().nrRows;
+        int nrCols = meteoGridDbHandler->meteoGrid()->gridStructure().header().nrCols;
 
-                myX = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.utm.x;
-                myY = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.utm.y;
-                myZ = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.z;
+        bool isDetrending = getUseDetrendingVar(myVar);
+        bool isLocalDetrending = (isDetrending && interpolationSettings.getUseLocalDetrending());
 
-                if (getUseDetrendingVar(myVar))
-                {
-                    /*proxyIndex = 0;
+        // optimal detrending writes the residuals of all meteo points: serial only
+        bool isParallel = (_isParallelComputing && ! (isLocalDetrending && interpolationSettings.getUseBestDetrending()));
 
-                    for (i = 0; i < interpolationSettings.getProxyNr(); i++)
-                    {
-                        proxyValues[i] = NODATA;
+        std::vector<float> gridValues(size_t(nrRows) * size_t(nrCols), NODATA);
+        Crit3DInterpolationSettings localSettings = interpolationSettings;
+        localSettings.setParallelComputing(_isParallelComputing && ! isParallel);
+        int isError = 0;
 
-                        if (!myCombination.isProxyActive(i))
-                            continue;
+        #pragma omp parallel for schedule(dynamic) if (isParallel) firstprivate(localSettings, proxyValues)
+        for (int row = 0; row < nrRows; row++)
+        {
+            int isStopped;
+            #pragma omp atomic read
+            isStopped = isError;
+            if (isStopped)
+                continue;
 
-                        if (proxyIndex < meteoGridProxies.size())
-                        {
-                            float proxyValue = gis::getValueFromXY(*meteoGridProxies[proxyIndex], myX, myY);
-                            if (proxyValue != meteoGridProxies[proxyIndex]->header->flag)
-                                proxyValues[i] = double(proxyValue);
-                        }
+            std::string localErrorStr;
+
+            for (int col = 0; col < nrCols; col++)
+            {
+                const Crit3DMeteoPoint* gridPoint = gridPoints[row][col];
+                if (! gridPoint->active)
+                    continue;
 
-                        proxyIndex++;
-                    }*/
+                float x = float(gridPoint->point.utm.x);
+                float y = float(gridPoint->point.utm.y);
+                float z = float(gridPoint->point.z);
 
-                    for (size_t p = 0; p < meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->proxyValues.size(); p++)
+                if (isDetrending)
+                {
+                    for (size_t p = 0; p < gridPoint->proxyValues.size(); p++)
                     {
-                        proxyValues[p] = (double(meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->proxyValues[p]));
+                        proxyValues[p] = double(gridPoint->proxyValues[p]);
                     }
+                }
 
-                    if (interpolationSettings.getUseLocalDetrending())
+                float value;
+                if (isLocalDetrending)
+                {
+                    std::vector <Crit3DInterpolationDataPoint> subsetInterpolationPoints;
+                    localSelection(interpolationPoints, subsetInterpolationPoints, x, y, localSettings, false); //CT supplementari usate anche in interpolate?
+                    if (! preInterpolation(subsetInterpolationPoints, localSettings, meteoSettings,
+                                          &climateParameters, meteoPoints, myVar, myTime, localErrorStr))
                     {
-                        std::vector <Crit3DInterpolationDataPoint> subsetInterpolationPoints;
-                        localSelection(interpolationPoints, subsetInterpolationPoints, myX, myY, interpolationSettings, false); //CT supplementari usate anche in interpolate?
-                        if (! preInterpolation(subsetInterpolationPoints, interpolationSettings, meteoSettings,
-                                              &climateParameters, meteoPoints, myVar, myTime, errorStdStr))
+                        #pragma omp critical
                         {
-                            logError("Error in function preInterpolation:\n" + QString::fromStdString(errorStdStr));
-                            return false;
+                            errorStdStr = localErrorStr;
                         }
-
-                        interpolatedValue = interpolate(subsetInterpolationPoints, interpolationSettings, meteoSettings, myVar, myX, myY, myZ, proxyValues, true);
-                    }
-                    else
-                    {
-                        interpolatedValue = interpolate(interpolationPoints, interpolationSettings, meteoSettings, myVar, myX, myY, myZ, proxyValues, true);
+                        #pragma omp atomic write
+                        isError = 1;
+                        break;
                     }
-                }
-                else
-                {
-                    interpolatedValue = interpolate(interpolationPoints, interpolationSettings, meteoSettings, myVar, myX, myY, myZ, proxyValues, true);
-                }
-
-                if (freq == hourly)
-                {
-                    if (meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->nrObsDataDaysH == 0)
-                        meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->initializeObsDataH(1, 1, myTime.date);
 
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->setMeteoPointValueH(myTime.date, myTime.getHour(), myTime.getMinutes(), myVar, float(interpolatedValue));
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = float(interpolatedValue);
+                    value = interpolate(subsetInterpolationPoints, localSettings, meteoSettings, myVar, x, y, z, proxyValues, true);
                 }
-                else if (freq == daily)
+                else
                 {
-                    if (meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->nrObsDataDaysD == 0)
-                        meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->initializeObsDataD(1, myTime.date);
-
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->setMeteoPointValueD(myTime.date, myVar, float(interpolatedValue));
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = float(interpolatedValue);
+                    value = interpolate(interpolationPoints, localSettings, meteoSettings, myVar, x, y, z, proxyValues, true);
                 }
 
+                gridValues[size_t(row) * size_t(nrCols) + size_t(col)] = value;
             }
         }
+
+        if (isError)
+        {
+            logError("Error in function preInterpolation:\n" + QString::fromStdString(errorStdStr));
+            return false;
+        }
+
+        meteoGridDbHandler->meteoGrid()->setCurrentValues(myTime, myVar, freq, gridValues, _isParallelComputing);
 	}
     else
     {
-        //set all cells to NODATA
-        for (unsigned col = 0; col < unsigned(meteoGridDbHandler->meteoGrid()->gridStructure().header().nrCols); col++)
-        {
-            for (unsigned row = 0; row < unsigned(meteoGridDbHandler->meteoGrid()->gridStructure().header().nrRows); row++)
-            {
-                if(!meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->active)
-                    continue;
+        const std::vector<std::vector<Crit3DMeteoPoint*>> &gridPoints = meteoGridDbHandler->meteoGrid()->meteoPoints();
+        int nrRows = meteoGridDbHandler->meteoGrid()->gridStructure().header().nrRows;
+        int nrCols = meteoGridDbHandler->meteoGrid()->gridStructure().header().nrCols;
+        bool isDetrending = getUseDetrendingVar(myVar);
 
-                if (freq == hourly)
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = NODATA;
-                else if (freq == daily)
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = NODATA;
-            }
+        // detrending of every single macro area (independent)
+        std::vector<Crit3DInterpolationSettings> areaSettings;
+        std::vector<std::vector<Crit3DInterpolationDataPoint>> areaPoints;
+        if (! glocalAreasDetrending(myVar, interpolationSettings, meteoSettings, meteoPoints, interpolationPoints,
+                                   true, _isParallelComputing, areaSettings, areaPoints))
+        {
+            errorString = "Error in glocal detrending of macro areas.";
+            return false;
         }
 
-        unsigned row, col;
-        std::vector<float> areaCells;
-        float myValue = NODATA;
+        // macro areas and weights of each cell
+        std::vector<unsigned> cellStart;
+        std::vector<int> cellArea;
+        std::vector<float> cellWeight;
+        getGlocalCellAreas(interpolationSettings, true, size_t(nrRows) * size_t(nrCols), cellStart, cellArea, cellWeight);
 
-        int elevationPos = NODATA;
-        for (unsigned int pos=0; pos < interpolationSettings.getCurrentCombination().getProxySize(); pos++)
+        // significant proxies of each area
+        std::vector<std::vector<unsigned>> areaProxyIndex(areaSettings.size());
+        for (size_t i = 0; i < areaSettings.size(); i++)
         {
-            if (getProxyPragaName(interpolationSettings.getProxy(pos)->getName()) == proxyHeight)
-                elevationPos = pos;
+            Crit3DProxyCombination areaCombination = areaSettings[i].getCurrentCombination();
+            for (unsigned p = 0; p < interpolationSettings.getProxyNr(); p++)
+            {
+                if (areaCombination.isProxySignificant(p))
+                    areaProxyIndex[i].push_back(p);
+            }
         }
 
-        for (int areaIndex = 0; areaIndex < interpolationSettings.getMacroAreasSize(); areaIndex++)
-        {
-            //load macro area and its cells
-            Crit3DMacroArea macroArea = interpolationSettings.getMacroArea(areaIndex);
-            areaCells = macroArea.getAreaCellsGrid();
-			std::vector<Crit3DInterpolationDataPoint> subsetInterpolationPoints;
+        // blend of the areas: single pass on the grid (cells without areas are NODATA)
+        std::vector<float> gridValues(size_t(nrRows) * size_t(nrCols), NODATA);
+        int isError = 0;
 
-            if (areaCells.empty())
+        #pragma omp parallel for schedule(dynamic) if (_isParallelComputing) firstprivate(areaSettings, proxyValues)
+        for (int row = 0; row < nrRows; row++)
+        {
+            int isStopped;
+            #pragma omp atomic read
+            isStopped = isError;
+            if (isStopped)
                 continue;
 
-            macroAreaDetrending(macroArea, myVar, interpolationSettings, meteoSettings, meteoPoints,
-                                interpolationPoints, subsetInterpolationPoints, elevationPos);
-            unsigned nrCols = meteoGridDbHandler->meteoGrid()->gridStructure().header().nrCols;
-            //calculate value for every cell
-            for (unsigned cellIndex = 0; cellIndex < areaCells.size(); cellIndex = cellIndex + 2)
+            for (int col = 0; col < nrCols; col++)
             {
-                row = unsigned(areaCells[cellIndex]/nrCols);
-                col = int(areaCells[cellIndex])%nrCols;
-
-                if(!meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->active)
+                const Crit3DMeteoPoint* gridPoint = gridPoints[row][col];
+                size_t cell = size_t(row) * size_t(nrCols) + size_t(col);
+                if (! gridPoint->active)
                     continue;
 
-                myX = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.utm.x;
-                myY = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.utm.y;
-                myZ = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->point.z;
+                float x = float(gridPoint->point.utm.x);
+                float y = float(gridPoint->point.utm.y);
+                float z = float(gridPoint->point.z);
+
+                float value = NODATA;
 
-                if(getUseDetrendingVar(myVar))
+                for (unsigned k = cellStart[cell]; k < cellStart[cell + 1]; k++)
                 {
-                    bool proxyFlag = true;
-                    proxyIndex = 0;
+                    int area = cellArea[k];
 
-                    for (i = 0; i < interpolationSettings.getProxyNr(); i++)
+                    if (isDetrending)
                     {
-                        proxyValues[i] = NODATA;
+                        // areas with incomplete proxies are skipped
+                        std::fill(proxyValues.begin(), proxyValues.end(), NODATA);
+                        bool isProxyComplete = true;
+                        for (unsigned p : areaProxyIndex[area])
+                        {
+                            proxyValues[p] = double(gridPoint->proxyValues[p]);
+                            if (isEqual(proxyValues[p], NODATA))
+                                isProxyComplete = false;
+                        }
 
-                        if(!interpolationSettings.getCurrentCombination().isProxySignificant(i))
+                        if (! isProxyComplete)
                             continue;
-
-                        /*if (proxyIndex < meteoGridProxies.size())
-                        {
-                            float proxyValue = gis::getValueFromXY(*meteoGridProxies[proxyIndex], myX, myY);
-                            if (proxyValue != meteoGridProxies[proxyIndex]->header->flag)
-                                proxyValues[i] = double(proxyValue);
-                            else
-                            {
-                                // CT utilizza la quota letta dalla griglia se il proxy value relativo alla quota è NODATA (è corretto?)
-                                if (getProxyPragaName(interpolationSettings.getProxy(i)->getName()) == proxyHeight && ! isEqual(myZ, NODATA))
-                                    proxyValues[i] = myZ;
-                                else
-                                    proxyFlag = false;
-                            }
-                        }*/
-
-
-                        proxyValues[i] = (double(meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->proxyValues[i]));
-
-                        if (isEqual(proxyValues[i], NODATA))
-                            proxyFlag = false;
-
-                        proxyIndex++;
                     }
 
-                    if (!proxyFlag)
-                        continue;
-
-                    double temp = interpolate(subsetInterpolationPoints, interpolationSettings, meteoSettings, myVar, myX, myY, myZ, proxyValues, true);
-                    if (isEqual(temp, NODATA))
+                    float interpolatedValue = interpolate(areaPoints[area], areaSettings[area], meteoSettings,
+                                                          myVar, x, y, z, proxyValues, true);
+                    if (isEqual(interpolatedValue, NODATA))
                     {
-                        errorString = "Error in interpolation. Check the glocal related files, rewrite the weight maps, reload the project and try again.";
-                        return false;
+                        #pragma omp atomic write
+                        isError = 1;
+                        break;
                     }
-                    interpolatedValue = interpolate(subsetInterpolationPoints, interpolationSettings, meteoSettings, myVar, myX, myY, myZ, proxyValues, true)
-                                    * areaCells[cellIndex + 1];
-                }
-
-                if (freq == hourly)
-                {
-                    if (meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->nrObsDataDaysH == 0)
-                        meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->initializeObsDataH(1, 1, myTime.date);
-
-                    myValue = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue;
 
-                    if (isEqual(myValue, NODATA))
-                        myValue = 0;
-
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->setMeteoPointValueH(myTime.date, myTime.getHour(), myTime.getMinutes(), myVar, float(interpolatedValue+myValue));
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = float(interpolatedValue+myValue);
+                    if (isEqual(value, NODATA))
+                        value = 0;
 
+                    value += interpolatedValue * cellWeight[k];
                 }
-                else if (freq == daily)
-                {
-                    if (meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->nrObsDataDaysD == 0)
-                        meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->initializeObsDataD(1, myTime.date);
-
-                    myValue = meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue;
-
-                    if (isEqual(myValue, NODATA))
-                        myValue = 0;
 
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->setMeteoPointValueD(myTime.date, myVar, float(interpolatedValue+myValue));
-                    meteoGridDbHandler->meteoGrid()->meteoPoints()[row][col]->currentValue = float(interpolatedValue+myValue);
-                }
+                gridValues[cell] = value;
             }
         }
+
+        if (isError)
+        {
+            errorString = "Error in interpolation. Check the glocal related files, rewrite the weight maps, reload the project and try again.";
+            return false;
+        }
+
+        meteoGridDbHandler->meteoGrid()->setCurrentValues(myTime, myVar, freq, gridValues, _isParallelComputing);
     }
 
     return true;
@@ -3983,6 +4714,8 @@ bool Project::loadProjectSettings(QString settingsFileName)
         logFileName = projectSettings->value("log_file").toString();
         _verboseStdoutLogging = projectSettings->value("verbose_stdout_log", "true").toBool();
         _currentTileMap = projectSettings->value("tile_map").toString();
+        _isCompressedRasterOutput = projectSettings->value("compressed_raster_output", "false").toBool();
+        _rasterQuantizationStep = std::max(0., projectSettings->value("raster_quantization_step", 0).toDouble());
     projectSettings->endGroup();
     return true;
 }
@@ -4025,6 +4758,11 @@ Crit3DCrossValidationStatistics Project::getCrossValidationStatistics() const
     return crossValidationStatistics;
 }
 
+Crit3DCrossValidationStatistics Project::getMultiResolutionStatistics() const
+{
+    return multiResolutionStatistics;
+}
+
 void Project::setCrossValidationStatistics(const Crit3DCrossValidationStatistics &newCrossValidationStatistics)
 {
     crossValidationStatistics = newCrossValidationStatistics;
@@ -4077,6 +4815,8 @@ void Project::saveProjectSettings()
 
     projectSettings->beginGroup("settings");
         projectSettings->setValue("parameters_file", getRelativePath(parametersFileName));
+        projectSettings->setValue("compressed_raster_output", _isCompressedRasterOutput);
+        projectSettings->setValue("raster_quantization_step", _rasterQuantizationStep);
     projectSettings->endGroup();
 
     projectSettings->sync();
@@ -4139,6 +4879,7 @@ void Project::saveInterpolationParameters()
         parametersSettings->setValue("topographicDistance", interpolationSettings.getUseTD());
         parametersSettings->setValue("localDetrending", interpolationSettings.getUseLocalDetrending());
         parametersSettings->setValue("topographicDistanceMaxMultiplier", QString::number(interpolationSettings.getTopoDist_maxKh()));
+        parametersSettings->setValue("topographicDistanceDecimation", QString::number(_topographicDistanceDecimation));
         parametersSettings->setValue("optimalDetrending", interpolationSettings.getUseBestDetrending());
         parametersSettings->setValue("multipleDetrending", interpolationSettings.getUseMultipleDetrending());
         parametersSettings->setValue("glocalDetrending", interpolationSettings.getUseGlocalDetrending());
@@ -4149,6 +4890,7 @@ void Project::saveInterpolationParameters()
         parametersSettings->setValue("thermalInversion", interpolationSettings.getUseThermalInversion());
         parametersSettings->setValue("minRegressionR2", QString::number(double(interpolationSettings.getMinRegressionR2())));
         parametersSettings->setValue("min_points_local_detrending", QString::number(int(interpolationSettings.getMinPointsLocalDetrending())));
+        parametersSettings->setValue("multiResolutionFactor", QString::number(interpolationSettings.getMultiResolutionFactor()));
         parametersSettings->setValue("glocalMapName", glocalMapName);
         parametersSettings->setValue("glocalPointsName", glocalPointsName);
     parametersSettings->endGroup();
@@ -5427,7 +6169,16 @@ bool Project::exportMeteoGridToRasterFlt(QString fileName, double cellSize)
 
     std::string myError = errorString.toStdString();
     QString fileWithoutExtension = QFileInfo(fileName).absolutePath() + QDir::separator() + QFileInfo(fileName).baseName();
-    if (! gis::writeEsriGrid(fileWithoutExtension.toStdString(), &myGrid, myError))
+
+    // compressed output (.cgr): lossless if the quantization step is 0
+    bool isOk;
+    if (_isCompressedRasterOutput)
+        isOk = gis::writeCompressedRaster(fileWithoutExtension.toStdString() + ".cgr", myGrid,
+                                          _rasterQuantizationStep, _isParallelComputing, myError);
+    else
+        isOk = gis::writeEsriGrid(fileWithoutExtension.toStdString(), &myGrid, myError);
+
+    if (! isOk)
     {
         errorString = QString::fromStdString(myError);
         return false;
@@ -6351,7 +7102,7 @@ bool Project::assignAltitudeToAggregationPoints()
     std::string fileNameStdStr = rasterFileName.toStdString() + ".flt";
     gis::Crit3DRasterGrid *aggregationRaster;
     aggregationRaster = new(gis::Crit3DRasterGrid);
-    if (! gis::openRaster(fileNameStdStr, aggregationRaster, gisSettings.utmZone, errorStr))
+    if (! gis::openRaster(fileNameStdStr, aggregationRaster, gisSettings.utmZone, isParallelComputing(), errorStr))
     {
         errorString = "Open raster failed: " + QString::fromStdString(errorStr);
         return false;
@@ -6360,7 +7111,9 @@ bool Project::assignAltitudeToAggregationPoints()
     // resample aggregation DEM
     gis::Crit3DRasterGrid *aggregationDEM;
     aggregationDEM = new(gis::Crit3DRasterGrid);
-    gis::resampleGrid(DEM, aggregationDEM, aggregationRaster->header, aggrAverage, 0.1f);
+    gis::Crit3DResamplePlan resamplePlan;
+    resamplePlan.initialize(*(DEM.header), *(aggregationRaster->header));
+    resamplePlan.apply(DEM, *aggregationDEM, aggrAverage, 0.1f, isParallelComputing());
 
     setProgressBar("Compute altitude..", (int)meteoPoints.size());
 
@@ -6450,6 +7203,9 @@ bool Project::assignAltitudeToMeteoPoints(double boundarySize)
         updateProgressBar(int(i));
     }
 
+    // the station distances depend on the altitude of the stations
+    stationDistanceCache.clear();
+
     return true;
 }
 
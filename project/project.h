@@ -44,6 +44,18 @@
     #ifndef WATERTABLE_H
         #include "waterTable.h"
     #endif
+    #ifndef TOPOGRAPHICDISTANCESTORE_H
+        #include "topographicDistanceStore.h"
+    #endif
+    #ifndef PROXYCUBE_H
+        #include "proxyCube.h"
+    #endif
+    #ifndef STATIONDISTANCECACHE_H
+        #include "stationDistanceCache.h"
+    #endif
+    #ifndef INTERPOLATIONCACHE_H
+        #include "interpolationCache.h"
+    #endif
 
     #ifndef _FSTREAM_
         #include <fstream>
@@ -87,6 +99,9 @@
         bool _isProjectLoaded;
         bool _isRequestedExit;
         bool _isParallelComputing;
+        int _topographicDistanceDecimation;
+        bool _isCompressedRasterOutput;
+        double _rasterQuantizationStep;
 
         FormInfo* _formLog;
 
@@ -152,8 +167,12 @@
         gis::Crit3DRasterGrid DEM;
 
         Crit3DInterpolationSettings interpolationSettings;
+        gis::Crit3DTopographicDistanceStore topographicDistanceStore;
+        Crit3DProxyCube proxyCube;
+        Crit3DStationDistanceCache stationDistanceCache;
         Crit3DInterpolationSettings qualityInterpolationSettings;
         Crit3DCrossValidationStatistics crossValidationStatistics;
+        Crit3DCrossValidationStatistics multiResolutionStatistics;
         std::vector<Crit3DCrossValidationStatistics> glocalCrossValidationStatistics;
 
         std::vector <Crit3DProxyGridSeries> proxyGridSeries;
@@ -204,7 +223,20 @@
         void setRequestedExit(bool value) {_isRequestedExit = value; }
 
         bool isParallelComputing() const { return _isParallelComputing; }
-        void setParallelComputing(bool value) {_isParallelComputing = value; }
+        void setParallelComputing(bool value)
+        {
+            _isParallelComputing = value;
+            interpolationSettings.setParallelComputing(value);
+            qualityInterpolationSettings.setParallelComputing(value);
+        }
+
+        int getTopographicDistanceDecimation() const { return _topographicDistanceDecimation; }
+        void setTopographicDistanceDecimation(int value) {_topographicDistanceDecimation = value; }
+
+        bool isCompressedRasterOutput() const { return _isCompressedRasterOutput; }
+        void setCompressedRasterOutput(bool value) { _isCompressedRasterOutput = value; }
+        double getRasterQuantizationStep() const { return _rasterQuantizationStep; }
+        void setRasterQuantizationStep(double value) { _rasterQuantizationStep = (value > 0) ? value : 0; }
 
         void setCurrentDate(QDate myDate);
         void setCurrentHour(int myHour);
@@ -287,8 +319,10 @@
         bool updateProxy();
         void checkMeteoPointsDEM();
         bool writeTopographicDistanceMaps(bool onlyWithData, bool showInfo);
+        bool writeTopographicDistanceMaps(bool onlyWithData, bool isStore, bool showInfo);
         bool writeTopographicDistanceMap(int pointIndex, const gis::Crit3DRasterGrid& demMap, QString pathTd);
         bool loadTopographicDistanceMaps(bool onlyWithData, bool showInfo);
+        bool loadTopographicDistanceStore(bool onlyWithData, bool showInfo);
         void passInterpolatedTemperatureToHumidityPoints(Crit3DTime myTime, Crit3DMeteoSettings *meteoSettings);
         void passGridTemperatureToHumidityPoints(Crit3DTime myTime, Crit3DMeteoSettings* meteoSettings);
         bool loadGlocalAreasMap();
@@ -304,12 +338,23 @@
         bool interpolationGrid(meteoVariable myVar, const Crit3DTime& myTime);
         bool interpolationDemMain(meteoVariable myVar, const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster);
         bool interpolationDem(meteoVariable myVar, const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster);
+        bool interpolationDemSeries(meteoVariable myVar, const Crit3DTime& firstTime, const Crit3DTime& lastTime,
+                                    std::vector<gis::Crit3DRasterGrid*> &rasterSeries);
         bool interpolationDemLocalDetrending(meteoVariable myVar, const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster);
         bool interpolationDemGlocalDetrending(meteoVariable myVar, const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster);
         bool interpolateDemRadiation(const Crit3DTime& myTime, gis::Crit3DRasterGrid *myRaster);
         bool interpolationOutputPoints(std::vector <Crit3DInterpolationDataPoint> &interpolationPoints,
                                        gis::Crit3DRasterGrid *outputGrid, meteoVariable myVar);
+        bool interpolationOutputPointsVariables(const std::vector<meteoVariable> &variables, const Crit3DTime &myTime,
+                                                std::vector<float> &outputValues);
+        void interpolateTargetPoints(const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints,
+                                     Crit3DInterpolationSettings &mySettings, meteoVariable myVar,
+                                     const std::vector<gis::Crit3DPoint> &targetPoints, const std::vector<double> &targetProxyValues,
+                                     Crit3DInterpolationCache* pointsCache, std::vector<float> &values);
         bool interpolationCv(meteoVariable myVar, const Crit3DTime& myTime);
+        bool interpolationMultiResolutionCheck(meteoVariable myVar, const Crit3DTime& myTime);
+        bool computeMultiResolutionCrossValidation(meteoVariable myVar, const Crit3DTime& myTime,
+                                                   const std::vector<Crit3DInterpolationDataPoint> &interpolationPoints);
         bool computeResidualsAndStatisticsGlocalDetrending(meteoVariable myVar, std::vector<Crit3DInterpolationDataPoint> &interpolationPoints);
 
         bool computeStatisticsCrossValidation();
@@ -374,6 +419,7 @@
         bool assignAltitudeToMeteoPoints(double boundarySize);
 
         Crit3DCrossValidationStatistics getCrossValidationStatistics() const;
+        Crit3DCrossValidationStatistics getMultiResolutionStatistics() const;
         void setCrossValidationStatistics(const Crit3DCrossValidationStatistics &newCrossValidationStatistics);
         void getMeteoPointsCurrentValues(std::vector<float> &validValues);
 
@@ -358,7 +358,7 @@ void Crit3DLocalProxyWidget::plot()
 
         checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                         _interpolationSettings, _meteoSettings, _climateParameters,
-                                        outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                        outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
 
         localSelection(outInterpolationPoints, subsetInterpolationPoints, _x, _y, _interpolationSettings, false);
         detrending(subsetInterpolationPoints, _interpolationSettings.getSelectedCombination(), _interpolationSettings,
@@ -368,7 +368,7 @@ void Crit3DLocalProxyWidget::plot()
     {
         checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                         _interpolationSettings, _meteoSettings, _climateParameters,
-                                        outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                        outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
         localSelection(outInterpolationPoints, subsetInterpolationPoints, _x, _y, _interpolationSettings, false);
     }
     }
@@ -386,7 +386,7 @@ void Crit3DLocalProxyWidget::plot()
 
                 checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                                 _interpolationSettings, _meteoSettings, _climateParameters,
-                                                outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                                outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
 
                 for (int k = 0; k < (int)stations.size(); k++)
                 {
@@ -431,7 +431,7 @@ void Crit3DLocalProxyWidget::plot()
                 outInterpolationPoints.clear();
                 checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                                 _interpolationSettings, _meteoSettings, _climateParameters,
-                                                outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                                outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
 
                 for (int k = 0; k < (int)stations.size(); k++)
                 {
@@ -745,7 +745,7 @@ void Crit3DLocalProxyWidget::showParametersDetails()
             outInterpolationPoints.clear();
             checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                             _interpolationSettings, _meteoSettings, _climateParameters,
-                                            outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                            outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
 
             for (int k = 0; k < (int)stations.size(); k++)
             {
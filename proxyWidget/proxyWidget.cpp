@@ -290,7 +290,7 @@ void Crit3DProxyWidget::plot()
 
         checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                         _interpolationSettings, _meteoSettings, _climateParameters,
-                                        _outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                        _outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
 
         detrending(_outInterpolationPoints, _interpolationSettings.getSelectedCombination(), _interpolationSettings, _climateParameters, myVar, getCurrentTime());
     }
@@ -298,7 +298,7 @@ void Crit3DProxyWidget::plot()
     {
         checkAndPassDataToInterpolation(_quality, myVar, _meteoPoints, getCurrentTime(), _SQinterpolationSettings,
                                         _interpolationSettings, _meteoSettings, _climateParameters,
-                                        _outInterpolationPoints, _checkSpatialQuality, errorStdStr);
+                                        _outInterpolationPoints, _checkSpatialQuality, false, errorStdStr);
     }
     QList<QPointF> pointListPrimary, pointListSecondary, pointListSupplemental, pointListMarked, zeroLine;
     QMap< QString, QPointF > idPointMap1;
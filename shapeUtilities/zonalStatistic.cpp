@@ -64,7 +64,7 @@ std::vector <std::vector<int>> computeMatrixAnalysisRaster(const Crit3DShapeHand
 
     // extract categories from rasterVal
     categories.clear();
-    categories = gis::extractUniqueValues(rasterVal);
+    categories = gis::extractUniqueValues(rasterVal, false);
     size_t nrCategories = categories.size();
 
     // unordered map is faster for search
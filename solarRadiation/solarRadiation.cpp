@@ -31,6 +31,7 @@
 #include "sunPosition.h"
 #include "solarRadiation.h"
 #include "physics.h"
+#include "terrainCache.h"
 
 #include <omp.h>
 #include <math.h>
@@ -55,14 +56,31 @@ Crit3DRadiationMaps::Crit3DRadiationMaps()
 }
 
 Crit3DRadiationMaps::Crit3DRadiationMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings)
+{
+    initializeMaps(dem, gisSettings, "", false);
+}
+
+
+/*!
+ * \brief Crit3DRadiationMaps
+ * slope, aspect and lat/lon maps are loaded from terrainCacheFileName if it refers to the same DEM,
+ * otherwise they are computed and saved in it
+ */
+Crit3DRadiationMaps::Crit3DRadiationMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings,
+                                         const std::string &terrainCacheFileName, bool isParallelComputing)
+{
+    initializeMaps(dem, gisSettings, terrainCacheFileName, isParallelComputing);
+}
+
+
+void Crit3DRadiationMaps::initializeMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings,
+                                         const std::string &terrainCacheFileName, bool isParallelComputing)
 {
     latMap = new gis::Crit3DRasterGrid;
     lonMap = new gis::Crit3DRasterGrid;
-    gis::computeLatLonMaps(dem, latMap, lonMap, gisSettings);
-
     slopeMap = new gis::Crit3DRasterGrid;
     aspectMap = new gis::Crit3DRasterGrid;
-    gis::computeSlopeAspectMaps(dem, slopeMap, aspectMap);
+    gis::computeTerrainMaps(dem, gisSettings, slopeMap, aspectMap, latMap, lonMap, terrainCacheFileName, isParallelComputing);
 
     transmissivityMap = new gis::Crit3DRasterGrid;
     transmissivityMap->initializeGrid(dem, CLEAR_SKY_TRANSMISSIVITY_DEFAULT);
@@ -1071,12 +1089,12 @@ namespace radiation
 
     void updateRadiationMaps(Crit3DRadiationMaps* radiationMaps, const Crit3DTime &myTime)
     {
-        gis::updateMinMaxRasterGrid(radiationMaps->sunElevationMap);
-        gis::updateMinMaxRasterGrid(radiationMaps->transmissivityMap);
-        gis::updateMinMaxRasterGrid(radiationMaps->beamRadiationMap);
-        gis::updateMinMaxRasterGrid(radiationMaps->diffuseRadiationMap);
-        gis::updateMinMaxRasterGrid(radiationMaps->reflectedRadiationMap);
-        gis::updateMinMaxRasterGrid(radiationMaps->globalRadiationMap);
+        gis::updateMinMaxRasterGrid(radiationMaps->sunElevationMap, false);
+        gis::updateMinMaxRasterGrid(radiationMaps->transmissivityMap, false);
+        gis::updateMinMaxRasterGrid(radiationMaps->beamRadiationMap, false);
+        gis::updateMinMaxRasterGrid(radiationMaps->diffuseRadiationMap, false);
+        gis::updateMinMaxRasterGrid(radiationMaps->reflectedRadiationMap, false);
+        gis::updateMinMaxRasterGrid(radiationMaps->globalRadiationMap, false);
 
         radiationMaps->sunElevationMap->setMapTime(myTime);
         radiationMaps->transmissivityMap->setMapTime(myTime);
@@ -14,6 +14,9 @@
     private:
         bool isComputed;
 
+        void initializeMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings,
+                            const std::string &terrainCacheFileName, bool isParallelComputing);
+
 
     public:
         gis::Crit3DRasterGrid* latMap;
@@ -32,6 +35,8 @@
 
         Crit3DRadiationMaps();
         Crit3DRadiationMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings);
+        Crit3DRadiationMaps(const gis::Crit3DRasterGrid& dem, const gis::Crit3DGisSettings& gisSettings,
+                            const std::string &terrainCacheFileName, bool isParallelComputing);
         ~Crit3DRadiationMaps();
 
         void clear();